@@ -1377,6 +1377,9 @@ namespace dxvk {
   void STDMETHODCALLTYPE D3D11DeviceContext::DrawAuto() {
     D3D10DeviceLock lock = LockContext();
 
+    if (unlikely(m_failedShaderStages & VK_SHADER_STAGE_ALL_GRAPHICS))
+      return;
+
     D3D11Buffer* buffer = m_state.ia.vertexBuffers[0].buffer.ptr();
 
     if (buffer == nullptr)
@@ -1401,6 +1404,9 @@ namespace dxvk {
           UINT            StartVertexLocation) {
     D3D10DeviceLock lock = LockContext();
 
+    if (unlikely(m_failedShaderStages & VK_SHADER_STAGE_ALL_GRAPHICS))
+      return;
+
     EmitCs([=] (DxvkContext* ctx) {
       ctx->draw(
         VertexCount, 1,
@@ -1414,6 +1420,9 @@ namespace dxvk {
           UINT            StartIndexLocation,
           INT             BaseVertexLocation) {
     D3D10DeviceLock lock = LockContext();
+
+    if (unlikely(m_failedShaderStages & VK_SHADER_STAGE_ALL_GRAPHICS))
+      return;
     
     EmitCs([=] (DxvkContext* ctx) {
       ctx->drawIndexed(
@@ -1430,6 +1439,9 @@ namespace dxvk {
           UINT            StartVertexLocation,
           UINT            StartInstanceLocation) {
     D3D10DeviceLock lock = LockContext();
+
+    if (unlikely(m_failedShaderStages & VK_SHADER_STAGE_ALL_GRAPHICS))
+      return;
     
     EmitCs([=] (DxvkContext* ctx) {
       ctx->draw(
@@ -1448,6 +1460,9 @@ namespace dxvk {
           INT             BaseVertexLocation,
           UINT            StartInstanceLocation) {
     D3D10DeviceLock lock = LockContext();
+
+    if (unlikely(m_failedShaderStages & VK_SHADER_STAGE_ALL_GRAPHICS))
+      return;
     
     EmitCs([=] (DxvkContext* ctx) {
       ctx->drawIndexed(
@@ -1464,6 +1479,10 @@ namespace dxvk {
           ID3D11Buffer*   pBufferForArgs,
           UINT            AlignedByteOffsetForArgs) {
     D3D10DeviceLock lock = LockContext();
+
+    if (unlikely(m_failedShaderStages & VK_SHADER_STAGE_ALL_GRAPHICS))
+      return;
+    
     SetDrawBuffers(pBufferForArgs, nullptr);
     
     // If possible, batch up multiple indirect draw calls of
@@ -1495,6 +1514,10 @@ namespace dxvk {
           ID3D11Buffer*   pBufferForArgs,
           UINT            AlignedByteOffsetForArgs) {
     D3D10DeviceLock lock = LockContext();
+
+    if (unlikely(m_failedShaderStages & VK_SHADER_STAGE_ALL_GRAPHICS))
+      return;
+    
     SetDrawBuffers(pBufferForArgs, nullptr);
 
     // If possible, batch up multiple indirect draw calls of
@@ -1527,6 +1550,9 @@ namespace dxvk {
           UINT            ThreadGroupCountY,
           UINT            ThreadGroupCountZ) {
     D3D10DeviceLock lock = LockContext();
+
+    if (unlikely(m_failedShaderStages & VK_SHADER_STAGE_COMPUTE_BIT))
+      return;
     
     EmitCs([=] (DxvkContext* ctx) {
       ctx->dispatch(
@@ -1541,6 +1567,10 @@ namespace dxvk {
           ID3D11Buffer*   pBufferForArgs,
           UINT            AlignedByteOffsetForArgs) {
     D3D10DeviceLock lock = LockContext();
+
+    if (unlikely(m_failedShaderStages & VK_SHADER_STAGE_COMPUTE_BIT))
+      return;
+    
     SetDrawBuffers(pBufferForArgs, nullptr);
     
     EmitCs([cOffset = AlignedByteOffsetForArgs]
@@ -1700,7 +1730,10 @@ namespace dxvk {
     if (m_state.vs.shader != shader) {
       m_state.vs.shader = shader;
 
-      BindShader<DxbcProgramType::VertexShader>(GetCommonShader(shader));
+      if (HasXfbVertexShader(m_state.gs.shader.ptr()))
+        BindVertexAndGeometryShaders();
+      else
+        BindShader<DxbcProgramType::VertexShader>(GetCommonShader(shader));
     }
   }
   
@@ -1985,6 +2018,9 @@ namespace dxvk {
       m_state.ds.shader = shader;
 
       BindShader<DxbcProgramType::DomainShader>(GetCommonShader(shader));
+
+      if (HasXfbVertexShader(m_state.gs.shader.ptr()))
+        BindVertexAndGeometryShaders();
     }
   }
   
@@ -2124,9 +2160,15 @@ namespace dxvk {
       Logger::err("D3D11: Class instances not supported");
     
     if (m_state.gs.shader != shader) {
+      bool rebindVs = HasXfbVertexShader(m_state.gs.shader.ptr())
+                   || HasXfbVertexShader(shader);
+
       m_state.gs.shader = shader;
 
-      BindShader<DxbcProgramType::GeometryShader>(GetCommonShader(shader));
+      if (rebindVs)
+        BindVertexAndGeometryShaders();
+      else
+        BindShader<DxbcProgramType::GeometryShader>(GetCommonShader(shader));
     }
   }
   
@@ -3236,16 +3278,27 @@ namespace dxvk {
     uint32_t slotId = computeConstantBufferBinding(ShaderStage,
       D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT);
     
+    VkShaderStageFlagBits stage = GetShaderStage(ShaderStage);
+    
+    Rc<DxvkShader> shader = pShaderModule != nullptr
+      ? pShaderModule->GetShader()
+      : nullptr;
+    
+    // Shaders that failed to translate have already been
+    // reported, so we only need to skip draws that use them
+    if (unlikely(pShaderModule != nullptr && shader == nullptr))
+      m_failedShaderStages |= stage;
+    else
+      m_failedShaderStages &= ~stage;
+    
     EmitCs([
       cSlotId = slotId,
-      cStage  = GetShaderStage(ShaderStage),
+      cStage  = stage,
       cSlice  = pShaderModule           != nullptr
              && pShaderModule->GetIcb() != nullptr
         ? DxvkBufferSlice(pShaderModule->GetIcb())
         : DxvkBufferSlice(),
-      cShader = pShaderModule != nullptr
-        ? pShaderModule->GetShader()
-        : nullptr
+      cShader = std::move(shader)
     ] (DxvkContext* ctx) {
       ctx->bindShader        (cStage, cShader);
       ctx->bindResourceBuffer(cSlotId, cSlice);
@@ -3253,6 +3306,26 @@ namespace dxvk {
   }
 
 
+  void D3D11DeviceContext::BindVertexAndGeometryShaders() {
+    const D3D11CommonShader* vs = GetCommonShader(m_state.vs.shader.ptr());
+    const D3D11CommonShader* gs = GetCommonShader(m_state.gs.shader.ptr());
+
+    // If the geometry shader only captures stream output from the
+    // bound vertex shader, use the vertex shader variant that writes
+    // stream output itself and skip the pass-through geometry shader.
+    if (vs != nullptr && gs != nullptr && gs->HasXfbVertexShader()
+     && m_state.ds.shader == nullptr && vs->GetHash() == gs->GetHash()) {
+      D3D11CommonShader xfbShader = gs->GetXfbVertexShader();
+
+      BindShader<DxbcProgramType::VertexShader>   (&xfbShader);
+      BindShader<DxbcProgramType::GeometryShader> (nullptr);
+    } else {
+      BindShader<DxbcProgramType::VertexShader>   (vs);
+      BindShader<DxbcProgramType::GeometryShader> (gs);
+    }
+  }
+
+
   void D3D11DeviceContext::BindFramebuffer(BOOL Spill) {
     DxvkRenderTargets attachments;
     
@@ -3628,12 +3701,11 @@ namespace dxvk {
   void D3D11DeviceContext::RestoreState() {
     BindFramebuffer(m_state.om.maxUav > 0);
     
-    BindShader<DxbcProgramType::VertexShader>   (GetCommonShader(m_state.vs.shader.ptr()));
     BindShader<DxbcProgramType::HullShader>     (GetCommonShader(m_state.hs.shader.ptr()));
     BindShader<DxbcProgramType::DomainShader>   (GetCommonShader(m_state.ds.shader.ptr()));
-    BindShader<DxbcProgramType::GeometryShader> (GetCommonShader(m_state.gs.shader.ptr()));
     BindShader<DxbcProgramType::PixelShader>    (GetCommonShader(m_state.ps.shader.ptr()));
     BindShader<DxbcProgramType::ComputeShader>  (GetCommonShader(m_state.cs.shader.ptr()));
+    BindVertexAndGeometryShaders();
     
     ApplyInputLayout();
     ApplyPrimitiveTopology();
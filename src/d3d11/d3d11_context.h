@@ -663,6 +663,8 @@ namespace dxvk {
     D3D11ContextState           m_state;
     D3D11CmdData*               m_cmdData;
     
+    VkShaderStageFlags          m_failedShaderStages = 0;
+    
     void ApplyInputLayout();
     
     void ApplyPrimitiveTopology();
@@ -683,6 +685,8 @@ namespace dxvk {
     void BindShader(
       const D3D11CommonShader*                pShaderModule);
     
+    void BindVertexAndGeometryShaders();
+    
     void BindFramebuffer(
             BOOL                              Spill);
     
@@ -847,6 +851,10 @@ namespace dxvk {
       return pShader != nullptr ? pShader->GetCommonShader() : nullptr;
     }
 
+    static bool HasXfbVertexShader(const D3D11GeometryShader* pShader) {
+      return pShader != nullptr && pShader->GetCommonShader()->HasXfbVertexShader();
+    }
+
     D3D10DeviceLock LockContext() {
       return m_multithread.AcquireLock();
     }
@@ -3,43 +3,110 @@
 
 namespace dxvk {
   
-  D3D11CommonShader:: D3D11CommonShader() { }
-  D3D11CommonShader::~D3D11CommonShader() { }
-  
-  
-  D3D11CommonShader::D3D11CommonShader(
-          D3D11Device*    pDevice,
+  D3D11ShaderCompileJob::D3D11ShaderCompileJob(
+          DxvkDevice*     pDevice,
     const DxvkShaderKey*  pShaderKey,
     const DxbcModuleInfo* pDxbcModuleInfo,
-    const void*           pShaderBytecode,
-          size_t          BytecodeLength) {
-    const std::string name = pShaderKey->toString();
-    Logger::debug(str::format("Compiling shader ", name));
-    
-    DxbcReader reader(
-      reinterpret_cast<const char*>(pShaderBytecode),
-      BytecodeLength);
+    const DxbcModule&     Module)
+  : m_device    (pDevice),
+    m_key       (*pShaderKey),
+    m_module    (Module),
+    m_moduleInfo(*pDxbcModuleInfo) {
+    // The tessellation info is owned by the caller
+    if (pDxbcModuleInfo->tess != nullptr) {
+      m_tessInfo = *pDxbcModuleInfo->tess;
+      m_moduleInfo.tess = &m_tessInfo;
+    }
+  }
+  
+  
+  D3D11ShaderCompileJob::~D3D11ShaderCompileJob() {
     
-    DxbcModule module(reader);
+  }
+  
+  
+  void D3D11ShaderCompileJob::run() {
+    // Exceptions must not escape the worker thread. Failed
+    // jobs provide no shader, which is reported on first use.
+    std::string error;
+
+    try {
+      Compile();
+      CreateIcb();
+    } catch (const DxvkError& e) {
+      error = e.message();
+      m_failed = true;
+    } catch (const std::exception& e) {
+      error = e.what();
+      m_failed = true;
+    } catch (...) {
+      error = "Unknown error";
+      m_failed = true;
+    }
     
-    // If requested by the user, dump both the raw DXBC
-    // shader and the compiled SPIR-V module to a file.
-    const std::string dumpPath = env::getEnvVar("DXVK_SHADER_DUMP_PATH");
+    if (m_failed) {
+      Logger::err(str::format("Failed to compile shader ", m_key.toString()));
+      Logger::err(error);
+
+      m_shader = nullptr;
+      m_buffer = nullptr;
+      return;
+    }
     
-    if (dumpPath.size() != 0) {
-      reader.store(std::ofstream(str::format(dumpPath, "/", name, ".dxbc"),
-        std::ios_base::binary | std::ios_base::trunc));
+    m_device->registerShader(m_shader);
+  }
+  
+  
+  void D3D11ShaderCompileJob::ReportFailure() {
+    if (!m_failureReported.exchange(true)) {
+      Logger::err(str::format("D3D11: Shader ", m_key.toString(),
+        " failed to compile, draws using it will be skipped"));
     }
+  }
+  
+  
+  void D3D11ShaderCompileJob::Compile() {
+    const std::string name = m_key.toString();
     
-    // Decide whether we need to create a pass-through
-    // geometry shader for vertex shader stream output
-    bool passthroughShader = pDxbcModuleInfo->xfb != nullptr
-      && module.programInfo().type() != DxbcProgramType::GeometryShader;
+    // Try to skip shader translation entirely if
+    // the shader cache has a matching SPIR-V module
+    DxvkShaderCache& shaderCache = m_device->shaderCache();
+    Sha1Hash cacheKey;
+
+    if (shaderCache.enabled()) {
+      cacheKey = GetCacheKey(&m_key, &m_moduleInfo);
 
-    m_shader = passthroughShader
-      ? module.compilePassthroughShader(*pDxbcModuleInfo, name)
-      : module.compile                 (*pDxbcModuleInfo, name);
-    m_shader->setShaderKey(*pShaderKey);
+      std::stringstream cacheData;
+
+      if (shaderCache.lookup(cacheKey, cacheData))
+        m_shader = DxvkShaderCache::readShader(cacheData);
+    }
+
+    if (m_shader == nullptr) {
+      Logger::debug(str::format("Compiling shader ", name));
+
+      // Decide whether we need to create a pass-through
+      // geometry shader for vertex shader stream output.
+      // Vertex shader variants that write stream output
+      // directly use the shader's own stage in the key.
+      bool passthroughShader = m_moduleInfo.xfb != nullptr
+        && m_module.programInfo().type() != DxbcProgramType::GeometryShader
+        && m_key.type() == VK_SHADER_STAGE_GEOMETRY_BIT;
+
+      m_shader = passthroughShader
+        ? m_module.compilePassthroughShader(m_moduleInfo, name)
+        : m_module.compile                 (m_moduleInfo, name);
+
+      if (shaderCache.enabled()) {
+        std::stringstream cacheData;
+        DxvkShaderCache::writeShader(cacheData, m_shader);
+        shaderCache.store(cacheKey, cacheData);
+      }
+    }
+
+    m_shader->setShaderKey(m_key);
+    
+    const std::string dumpPath = env::getEnvVar("DXVK_SHADER_DUMP_PATH");
     
     if (dumpPath.size() != 0) {
       std::ofstream dumpStream(
@@ -48,7 +115,10 @@ namespace dxvk {
       
       m_shader->dump(dumpStream);
     }
-    
+  }
+  
+  
+  void D3D11ShaderCompileJob::CreateIcb() {
     // Create shader constant buffer if necessary
     if (m_shader->shaderConstants().data() != nullptr) {
       DxvkBufferCreateInfo info;
@@ -64,14 +134,133 @@ namespace dxvk {
         | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
         | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
       
-      m_buffer = pDevice->GetDXVKDevice()->createBuffer(info, memFlags);
+      m_buffer = m_device->createBuffer(info, memFlags);
 
       std::memcpy(m_buffer->mapPtr(0),
         m_shader->shaderConstants().data(),
         m_shader->shaderConstants().sizeInBytes());
     }
+  }
+  
+  
+  D3D11CommonShader:: D3D11CommonShader() { }
+  D3D11CommonShader::~D3D11CommonShader() { }
+  
+  
+  D3D11CommonShader::D3D11CommonShader(
+          D3D11Device*    pDevice,
+    const DxvkShaderKey*  pShaderKey,
+    const DxbcModuleInfo* pDxbcModuleInfo,
+    const void*           pShaderBytecode,
+          size_t          BytecodeLength)
+  : m_name(pShaderKey->toString()),
+    m_hash(Sha1Hash::compute(pShaderBytecode, BytecodeLength)) {
+    DxbcReader reader(
+      reinterpret_cast<const char*>(pShaderBytecode),
+      BytecodeLength);
+    
+    // Parse the container right away so that invalid
+    // shaders get rejected by the creation call. The
+    // module keeps its own copy of the shader code.
+    DxbcModule module(reader);
+    
+    // If requested by the user, dump both the raw DXBC
+    // shader and the compiled SPIR-V module to a file.
+    const std::string dumpPath = env::getEnvVar("DXVK_SHADER_DUMP_PATH");
+    
+    if (dumpPath.size() != 0) {
+      reader.store(std::ofstream(str::format(dumpPath, "/", m_name, ".dxbc"),
+        std::ios_base::binary | std::ios_base::trunc));
+    }
+    
+    Rc<DxvkDevice> device = pDevice->GetDXVKDevice();
+    
+    m_job = new D3D11ShaderCompileJob(device.ptr(),
+      pShaderKey, pDxbcModuleInfo, module);
+    
+    // Stream output info is owned by the caller and
+    // references application memory, so we have to
+    // translate these shaders before returning. Shaders
+    // that are compiled synchronously report failures
+    // to the creation call.
+    if (pDxbcModuleInfo->xfb != nullptr || !device->config().deferShaderTranslation) {
+      m_job->execute();
+
+      if (m_job->HasFailed())
+        throw DxvkError(str::format("Failed to compile shader ", m_name));
+    } else {
+      device->shaderCompiler().queueJob(m_job);
+    }
+    
+    // If stream output is captured from a vertex shader, also
+    // create a variant of that shader which writes the data
+    // directly, so that the pass-through geometry shader can
+    // be skipped when the matching vertex shader is bound.
+    if (pDxbcModuleInfo->xfb != nullptr
+     && pDxbcModuleInfo->xfb->rasterizedStream < 0
+     && module.programInfo().type() == DxbcProgramType::VertexShader) {
+      DxvkShaderKey xfbKey(VK_SHADER_STAGE_VERTEX_BIT, pShaderKey->sha1());
+      
+      m_xfbJob = new D3D11ShaderCompileJob(device.ptr(),
+        &xfbKey, pDxbcModuleInfo, module);
+      m_xfbJob->execute();
+
+      // Not fatal, the pass-through shader still works
+      if (m_xfbJob->HasFailed())
+        m_xfbJob = nullptr;
+    }
+  }
+
+
+  Sha1Hash D3D11ShaderCompileJob::GetCacheKey(
+    const DxvkShaderKey*  pShaderKey,
+    const DxbcModuleInfo* pDxbcModuleInfo) {
+    // The generated code depends on all compiler options as
+    // well as tessellation and stream output info. Options
+    // are written field by field to not include padding.
+    std::stringstream stream;
+    stream << pShaderKey->toString();
+
+    const DxbcOptions& options = pDxbcModuleInfo->options;
+    DxvkShaderCache::writeData(stream, options.useDepthClipWorkaround);
+    DxvkShaderCache::writeData(stream, options.useStorageImageReadWithoutFormat);
+    DxvkShaderCache::writeData(stream, options.useSubgroupOpsForAtomicCounters);
+    DxvkShaderCache::writeData(stream, options.useSubgroupOpsForAtomics);
+    DxvkShaderCache::writeData(stream, options.useDemoteToHelperInvocation);
+    DxvkShaderCache::writeData(stream, options.useSubgroupOpsForEarlyDiscard);
+    DxvkShaderCache::writeData(stream, options.useSdivForBufferIndex);
+    DxvkShaderCache::writeData(stream, options.strictDivision);
+    DxvkShaderCache::writeData(stream, options.constantBufferRangeCheck);
+    DxvkShaderCache::writeData(stream, options.zeroInitWorkgroupMemory);
+    DxvkShaderCache::writeData(stream, options.optimizeShaders);
+    DxvkShaderCache::writeData(stream, options.minSsboAlignment);
+
+    DxvkShaderCache::writeData(stream, pDxbcModuleInfo->tess != nullptr);
+    DxvkShaderCache::writeData(stream, pDxbcModuleInfo->xfb  != nullptr);
+
+    if (pDxbcModuleInfo->tess != nullptr)
+      DxvkShaderCache::writeData(stream, pDxbcModuleInfo->tess->maxTessFactor);
+
+    if (pDxbcModuleInfo->xfb != nullptr) {
+      const DxbcXfbInfo* xfb = pDxbcModuleInfo->xfb;
+
+      for (uint32_t i = 0; i < xfb->entryCount; i++) {
+        const DxbcXfbEntry& entry = xfb->entries[i];
+        stream << (entry.semanticName ? entry.semanticName : "") << '\0';
+        DxvkShaderCache::writeData(stream, entry.semanticIndex);
+        DxvkShaderCache::writeData(stream, entry.componentIndex);
+        DxvkShaderCache::writeData(stream, entry.componentCount);
+        DxvkShaderCache::writeData(stream, entry.streamId);
+        DxvkShaderCache::writeData(stream, entry.bufferId);
+        DxvkShaderCache::writeData(stream, entry.offset);
+      }
+
+      DxvkShaderCache::writeData(stream, xfb->strides);
+      DxvkShaderCache::writeData(stream, xfb->rasterizedStream);
+    }
 
-    pDevice->GetDXVKDevice()->registerShader(m_shader);
+    std::string data = stream.str();
+    return Sha1Hash::compute(data.data(), data.size());
   }
 
   
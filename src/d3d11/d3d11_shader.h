@@ -19,12 +19,89 @@ namespace dxvk {
   
   class D3D11Device;
   
+  /**
+   * \brief Shader translation job
+   * 
+   * Translates a DXBC shader to SPIR-V and creates
+   * the immediate constant buffer, if any. Results
+   * may only be accessed after the job completed.
+   */
+  class D3D11ShaderCompileJob : public DxvkShaderCompileJob {
+    
+  public:
+    
+    D3D11ShaderCompileJob(
+            DxvkDevice*     pDevice,
+      const DxvkShaderKey*  pShaderKey,
+      const DxbcModuleInfo* pDxbcModuleInfo,
+      const DxbcModule&     Module);
+    ~D3D11ShaderCompileJob();
+    
+    Rc<DxvkShader> GetShader() {
+      this->wait();
+
+      if (unlikely(m_failed))
+        ReportFailure();
+
+      return m_shader;
+    }
+    
+    Rc<DxvkBuffer> GetIcb() {
+      this->wait();
+      return m_buffer;
+    }
+    
+    /**
+     * \brief Checks whether translation failed
+     * 
+     * Failed jobs do not provide a shader, so
+     * the stage will be unbound when it is used.
+     * \returns \c true if the shader is unusable
+     */
+    bool HasFailed() {
+      this->wait();
+      return m_failed;
+    }
+    
+  protected:
+    
+    void run() final;
+    
+  private:
+    
+    DxvkDevice*     m_device;
+    DxvkShaderKey   m_key;
+    DxbcModule      m_module;
+    DxbcModuleInfo  m_moduleInfo;
+    DxbcTessInfo    m_tessInfo;
+    
+    Rc<DxvkShader>  m_shader;
+    Rc<DxvkBuffer>  m_buffer;
+    
+    bool              m_failed = false;
+    std::atomic<bool> m_failureReported = { false };
+    
+    void Compile();
+    
+    void ReportFailure();
+    
+    void CreateIcb();
+    
+    static Sha1Hash GetCacheKey(
+      const DxvkShaderKey*  pShaderKey,
+      const DxbcModuleInfo* pDxbcModuleInfo);
+    
+  };
+  
+  
   /**
    * \brief Common shader object
    * 
    * Stores the compiled SPIR-V shader and the SHA-1
    * hash of the original DXBC shader, which can be
-   * used to identify the shader.
+   * used to identify the shader. The shader may be
+   * translated asynchronously, in which case the
+   * first access to the shader waits for it.
    */
   class D3D11CommonShader {
     
@@ -40,21 +117,60 @@ namespace dxvk {
     ~D3D11CommonShader();
 
     Rc<DxvkShader> GetShader() const {
-      return m_shader;
+      return m_job->GetShader();
     }
 
     Rc<DxvkBuffer> GetIcb() const {
-      return m_buffer;
+      return m_job->GetIcb();
     }
     
     std::string GetName() const {
-      return m_shader->debugName();
+      return m_name;
+    }
+    
+    /**
+     * \brief SHA-1 hash of the DXBC code
+     * 
+     * Does not include any stream output info.
+     * \returns Hash of the shader bytecode
+     */
+    const Sha1Hash& GetHash() const {
+      return m_hash;
+    }
+    
+    /**
+     * \brief Checks for a native stream output vertex shader
+     * 
+     * Only the case for stream output shaders that
+     * were created from vertex shader bytecode.
+     * \returns \c true if the variant exists
+     */
+    bool HasXfbVertexShader() const {
+      return m_xfbJob != nullptr;
+    }
+    
+    /**
+     * \brief Vertex shader variant with stream output
+     * 
+     * This variant writes stream output data directly
+     * and can be used instead of a pass-through geometry
+     * shader if the bound vertex shader has the same code.
+     * \returns Vertex shader variant
+     */
+    D3D11CommonShader GetXfbVertexShader() const {
+      D3D11CommonShader result;
+      result.m_name = m_name;
+      result.m_hash = m_hash;
+      result.m_job  = m_xfbJob;
+      return result;
     }
     
   private:
     
-    Rc<DxvkShader> m_shader;
-    Rc<DxvkBuffer> m_buffer;
+    std::string                 m_name;
+    Sha1Hash                    m_hash;
+    Rc<D3D11ShaderCompileJob>   m_job;
+    Rc<D3D11ShaderCompileJob>   m_xfbJob;
     
   };
   
@@ -4,10 +4,15 @@
 
 #include "../dxso/dxso_isgn.h"
 
+#include "../dxvk/dxvk_buffer.h"
+
+#include "../util/util_bit.h"
 #include "../util/util_math.h"
 #include "../util/util_vector.h"
 
+#include <array>
 #include <cstdint>
+#include <vector>
 
 namespace dxvk {
 
@@ -30,10 +35,101 @@ namespace dxvk {
     uint32_t boolBitfield = 0;
   };
 
+  /**
+   * \brief Registers changed since the last upload
+   *
+   * Lets uploads re-pack only the registers the application
+   * actually wrote. If \c all is set, the staged layout does
+   * not match the bound shader and is rebuilt from scratch.
+   */
+  struct D3D9DirtyConstants {
+    constexpr static uint32_t FloatDwords = (caps::MaxFloatConstantsVS + 31) / 32;
+
+    std::array<uint32_t, FloatDwords> floats = { };
+    uint32_t                          ints   = 0;
+    bool                              bools  = false;
+    bool                              all    = true;
+
+    void setFloats(uint32_t first, uint32_t count) {
+      for (uint32_t i = first; i < first + count; i++)
+        floats[i / 32] |= 1u << (i % 32);
+    }
+
+    bool anyFloats() const {
+      for (uint32_t dword : floats) {
+        if (dword)
+          return true;
+      }
+
+      return false;
+    }
+
+    /**
+     * \brief Iterates over runs of dirty float registers
+     *
+     * \param [in] fn Called with the first register
+     *    and the register count of each run
+     */
+    template<typename Fn>
+    void forEachFloatRange(const Fn& fn) const {
+      uint32_t first = 0;
+      uint32_t count = 0;
+
+      for (uint32_t i = 0; i < FloatDwords; i++) {
+        // Skip clean words unless they end a run
+        if (!floats[i] && !count)
+          continue;
+
+        for (uint32_t j = 0; j < 32; j++) {
+          if (floats[i] & (1u << j)) {
+            if (!count++)
+              first = 32 * i + j;
+          } else if (count) {
+            fn(first, count);
+            count = 0;
+          }
+        }
+      }
+
+      if (count)
+        fn(first, count);
+    }
+
+    void clear() {
+      floats = { };
+      ints   = 0;
+      bools  = false;
+      all    = false;
+    }
+  };
+
   struct D3D9ConstantSets {
     Rc<DxvkBuffer>            buffer;
+    std::vector<uint8_t>      staging;
     const DxsoShaderMetaInfo* meta  = nullptr;
     bool                      dirty = true;
+    D3D9DirtyConstants        dirtyRegs;
   };
 
+  /**
+   * \brief Checks whether a register range overlaps packed constants
+   *
+   * \param [in] Ranges Constant ranges read by the shader
+   * \param [in] StartRegister First register to check
+   * \param [in] Count Number of registers to check
+   * \returns \c true if any of the registers is read
+   */
+  inline bool IsConstantRangeUsed(
+    const std::vector<DxsoConstantRange>& Ranges,
+          uint32_t                        StartRegister,
+          uint32_t                        Count) {
+    for (const auto& range : Ranges) {
+      if (StartRegister < range.first + range.count
+       && range.first   < StartRegister + Count)
+        return true;
+    }
+
+    return false;
+  }
+
 }
\ No newline at end of file
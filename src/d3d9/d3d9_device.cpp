@@ -1673,154 +1673,173 @@ namespace dxvk {
 
       states[State] = Value;
 
-      switch (State) {
-        case D3DRS_SEPARATEALPHABLENDENABLE:
-        case D3DRS_ALPHABLENDENABLE:
-        case D3DRS_BLENDOP:
-        case D3DRS_BLENDOPALPHA:
-        case D3DRS_DESTBLEND:
-        case D3DRS_DESTBLENDALPHA:
-        case D3DRS_COLORWRITEENABLE:
-        case D3DRS_COLORWRITEENABLE1:
-        case D3DRS_COLORWRITEENABLE2:
-        case D3DRS_COLORWRITEENABLE3:
-        case D3DRS_SRCBLEND:
-        case D3DRS_SRCBLENDALPHA:
-          m_flags.set(D3D9DeviceFlag::DirtyBlendState);
-          break;
-        
-        case D3DRS_ALPHATESTENABLE: {
-          bool newATOC = IsAlphaToCoverageEnabled();
+      D3D9DeviceFlags dirty;
+      UpdateRenderState(State, Value, oldATOC, oldNVDB, dirty);
+      m_flags.set(dirty);
+    }
 
-          if (oldATOC != newATOC)
-            m_flags.set(D3D9DeviceFlag::DirtyMultiSampleState);
-        }
-        case D3DRS_ALPHAFUNC:
-          m_flags.set(D3D9DeviceFlag::DirtyAlphaTestState);
-          break;
+    return D3D_OK;
+  }
 
-        case D3DRS_BLENDFACTOR:
-          BindBlendFactor();
-          break;
 
-        case D3DRS_MULTISAMPLEMASK:
-          if (m_flags.test(D3D9DeviceFlag::ValidSampleMask))
-            m_flags.set(D3D9DeviceFlag::DirtyMultiSampleState);
-          break;
+  void D3D9DeviceEx::UpdateRenderState(
+          D3DRENDERSTATETYPE  State,
+          DWORD               Value,
+          bool                OldATOC,
+          bool                OldNVDB,
+          D3D9DeviceFlags&    Dirty) {
+    auto& states = m_state.renderStates;
 
-        case D3DRS_ZENABLE:
-        case D3DRS_ZFUNC:
-        case D3DRS_TWOSIDEDSTENCILMODE:
-        case D3DRS_ZWRITEENABLE:
-        case D3DRS_STENCILENABLE:
-        case D3DRS_STENCILFAIL:
-        case D3DRS_STENCILZFAIL:
-        case D3DRS_STENCILPASS:
-        case D3DRS_STENCILFUNC:
-        case D3DRS_CCW_STENCILFAIL:
-        case D3DRS_CCW_STENCILZFAIL:
-        case D3DRS_CCW_STENCILPASS:
-        case D3DRS_CCW_STENCILFUNC:
-        case D3DRS_STENCILMASK:
-        case D3DRS_STENCILWRITEMASK:
-          m_flags.set(D3D9DeviceFlag::DirtyDepthStencilState);
-          break;
+    switch (State) {
+      case D3DRS_SEPARATEALPHABLENDENABLE:
+      case D3DRS_ALPHABLENDENABLE:
+      case D3DRS_BLENDOP:
+      case D3DRS_BLENDOPALPHA:
+      case D3DRS_DESTBLEND:
+      case D3DRS_DESTBLENDALPHA:
+      case D3DRS_COLORWRITEENABLE:
+      case D3DRS_COLORWRITEENABLE1:
+      case D3DRS_COLORWRITEENABLE2:
+      case D3DRS_COLORWRITEENABLE3:
+      case D3DRS_SRCBLEND:
+      case D3DRS_SRCBLENDALPHA:
+        Dirty.set(D3D9DeviceFlag::DirtyBlendState);
+        break;
+      
+      case D3DRS_ALPHATESTENABLE: {
+        bool newATOC = IsAlphaToCoverageEnabled();
 
-        case D3DRS_STENCILREF:
-          BindDepthStencilRefrence();
-          break;
+        if (OldATOC != newATOC)
+          Dirty.set(D3D9DeviceFlag::DirtyMultiSampleState);
+      }
+      case D3DRS_ALPHAFUNC:
+        Dirty.set(D3D9DeviceFlag::DirtyAlphaTestState);
+        break;
 
-        case D3DRS_SCISSORTESTENABLE:
-          m_flags.set(D3D9DeviceFlag::DirtyViewportScissor);
-          break;
+      case D3DRS_BLENDFACTOR:
+        BindBlendFactor();
+        break;
 
-        case D3DRS_SRGBWRITEENABLE:
-          m_flags.set(D3D9DeviceFlag::DirtyFramebuffer);
-          break;
+      case D3DRS_MULTISAMPLEMASK:
+        if (m_flags.test(D3D9DeviceFlag::ValidSampleMask))
+          Dirty.set(D3D9DeviceFlag::DirtyMultiSampleState);
+        break;
 
-        case D3DRS_DEPTHBIAS:
-        case D3DRS_SLOPESCALEDEPTHBIAS:
-        case D3DRS_CULLMODE:
-        case D3DRS_FILLMODE:
-          m_flags.set(D3D9DeviceFlag::DirtyRasterizerState);
-          break;
+      case D3DRS_ZENABLE:
+      case D3DRS_ZFUNC:
+      case D3DRS_TWOSIDEDSTENCILMODE:
+      case D3DRS_ZWRITEENABLE:
+      case D3DRS_STENCILENABLE:
+      case D3DRS_STENCILFAIL:
+      case D3DRS_STENCILZFAIL:
+      case D3DRS_STENCILPASS:
+      case D3DRS_STENCILFUNC:
+      case D3DRS_CCW_STENCILFAIL:
+      case D3DRS_CCW_STENCILZFAIL:
+      case D3DRS_CCW_STENCILPASS:
+      case D3DRS_CCW_STENCILFUNC:
+      case D3DRS_STENCILMASK:
+      case D3DRS_STENCILWRITEMASK:
+        Dirty.set(D3D9DeviceFlag::DirtyDepthStencilState);
+        break;
 
-        case D3DRS_CLIPPLANEENABLE:
-          m_flags.set(D3D9DeviceFlag::DirtyClipPlanes);
-          break;
+      case D3DRS_STENCILREF:
+        BindDepthStencilRefrence();
+        break;
 
-        case D3DRS_ALPHAREF:
-          UpdatePushConstant<D3D9RenderStateItem::AlphaRef>();
-          break;
+      case D3DRS_SCISSORTESTENABLE:
+        Dirty.set(D3D9DeviceFlag::DirtyViewportScissor);
+        break;
 
-        case D3DRS_TEXTUREFACTOR:
-          m_flags.set(D3D9DeviceFlag::DirtyFFPixelData);
-          break;
+      case D3DRS_SRGBWRITEENABLE:
+        Dirty.set(D3D9DeviceFlag::DirtyFramebuffer);
+        break;
 
-        case D3DRS_DIFFUSEMATERIALSOURCE:
-        case D3DRS_AMBIENTMATERIALSOURCE:
-        case D3DRS_SPECULARMATERIALSOURCE:
-        case D3DRS_EMISSIVEMATERIALSOURCE:
-        case D3DRS_COLORVERTEX:
-        case D3DRS_LIGHTING:
-        case D3DRS_NORMALIZENORMALS:
-        case D3DRS_LOCALVIEWER:
-          m_flags.set(D3D9DeviceFlag::DirtyFFVertexShader);
-          break;
+      case D3DRS_DEPTHBIAS:
+      case D3DRS_SLOPESCALEDEPTHBIAS:
+      case D3DRS_CULLMODE:
+      case D3DRS_FILLMODE:
+        Dirty.set(D3D9DeviceFlag::DirtyRasterizerState);
+        break;
 
-        case D3DRS_AMBIENT:
-          m_flags.set(D3D9DeviceFlag::DirtyFFVertexData);
-          break;
+      case D3DRS_CLIPPLANEENABLE:
+        Dirty.set(D3D9DeviceFlag::DirtyClipPlanes);
+        break;
 
-        case D3DRS_SPECULARENABLE:
-          m_flags.set(D3D9DeviceFlag::DirtyFFPixelShader);
-          break;
+      case D3DRS_ALPHAREF:
+        UpdatePushConstant<D3D9RenderStateItem::AlphaRef>();
+        break;
 
-        case D3DRS_FOGENABLE:
-        case D3DRS_FOGVERTEXMODE:
-        case D3DRS_FOGTABLEMODE:
-          m_flags.set(D3D9DeviceFlag::DirtyFogState);
-          break;
+      case D3DRS_TEXTUREFACTOR:
+        Dirty.set(D3D9DeviceFlag::DirtyFFPixelData);
+        break;
 
-        case D3DRS_RANGEFOGENABLE:
-          m_flags.set(D3D9DeviceFlag::DirtyFFVertexShader);
-          break;
+      case D3DRS_DIFFUSEMATERIALSOURCE:
+      case D3DRS_AMBIENTMATERIALSOURCE:
+      case D3DRS_SPECULARMATERIALSOURCE:
+      case D3DRS_EMISSIVEMATERIALSOURCE:
+      case D3DRS_COLORVERTEX:
+      case D3DRS_LIGHTING:
+      case D3DRS_LOCALVIEWER:
+        Dirty.set(D3D9DeviceFlag::DirtyFFVertexShader);
+        break;
 
-        case D3DRS_FOGCOLOR:
-          m_flags.set(D3D9DeviceFlag::DirtyFogColor);
-          break;
+      case D3DRS_NORMALIZENORMALS:
+        m_ffKeyVS.NormalizeNormals = Value != FALSE;
+        Dirty.set(D3D9DeviceFlag::DirtyFFVertexShader);
+        break;
 
-        case D3DRS_FOGSTART:
-          m_flags.set(D3D9DeviceFlag::DirtyFogScale);
-          break;
+      case D3DRS_AMBIENT:
+        Dirty.set(D3D9DeviceFlag::DirtyFFVertexData);
+        break;
 
-        case D3DRS_FOGEND:
-          m_flags.set(D3D9DeviceFlag::DirtyFogScale);
-          m_flags.set(D3D9DeviceFlag::DirtyFogEnd);
-          break;
+      case D3DRS_SPECULARENABLE:
+        Dirty.set(D3D9DeviceFlag::DirtyFFPixelShader);
+        break;
 
-        case D3DRS_FOGDENSITY:
-          m_flags.set(D3D9DeviceFlag::DirtyFogDensity);
-          break;
+      case D3DRS_FOGENABLE:
+      case D3DRS_FOGVERTEXMODE:
+      case D3DRS_FOGTABLEMODE:
+        Dirty.set(D3D9DeviceFlag::DirtyFogState);
+        break;
 
-        case D3DRS_ADAPTIVETESS_X:
-        case D3DRS_ADAPTIVETESS_Z:
-        case D3DRS_ADAPTIVETESS_W:
-          if (states[D3DRS_ADAPTIVETESS_X] == uint32_t(D3D9Format::NVDB) || oldNVDB) {
-            m_flags.set(D3D9DeviceFlag::DirtyDepthBounds);
-            break;
-          }
+      case D3DRS_RANGEFOGENABLE:
+        m_ffKeyVS.RangeFog = Value != FALSE;
+        Dirty.set(D3D9DeviceFlag::DirtyFFVertexShader);
+        break;
 
-        default:
-          static bool s_errorShown[256];
+      case D3DRS_FOGCOLOR:
+        Dirty.set(D3D9DeviceFlag::DirtyFogColor);
+        break;
 
-          if (!std::exchange(s_errorShown[State], true))
-            Logger::warn(str::format("D3D9DeviceEx::SetRenderState: Unhandled render state ", State));
+      case D3DRS_FOGSTART:
+        Dirty.set(D3D9DeviceFlag::DirtyFogScale);
+        break;
+
+      case D3DRS_FOGEND:
+        Dirty.set(D3D9DeviceFlag::DirtyFogScale);
+        Dirty.set(D3D9DeviceFlag::DirtyFogEnd);
+        break;
+
+      case D3DRS_FOGDENSITY:
+        Dirty.set(D3D9DeviceFlag::DirtyFogDensity);
+        break;
+
+      case D3DRS_ADAPTIVETESS_X:
+      case D3DRS_ADAPTIVETESS_Z:
+      case D3DRS_ADAPTIVETESS_W:
+        if (states[D3DRS_ADAPTIVETESS_X] == uint32_t(D3D9Format::NVDB) || OldNVDB) {
+          Dirty.set(D3D9DeviceFlag::DirtyDepthBounds);
           break;
-      }
-    }
+        }
 
-    return D3D_OK;
+      default:
+        static bool s_errorShown[256];
+
+        if (!std::exchange(s_errorShown[State], true))
+          Logger::warn(str::format("D3D9DeviceEx::SetRenderState: Unhandled render state ", State));
+        break;
+    }
   }
 
 
@@ -1976,13 +1995,20 @@ namespace dxvk {
         m_flags.set(D3D9DeviceFlag::DirtySharedPixelShaderData);
       else if (Type == D3DTSS_TEXTURETRANSFORMFLAGS) {
         // This state affects both!
+        m_ffKeyVS.TransformFlags[Stage] = Value & ~(D3DTTFF_PROJECTED);
+        m_ffDirtyStages |= 1u << Stage;
+
         m_flags.set(D3D9DeviceFlag::DirtyFFPixelShader);
         m_flags.set(D3D9DeviceFlag::DirtyFFVertexShader);
       }
-      else if (Type != D3DTSS_TEXCOORDINDEX)
+      else if (Type != D3DTSS_TEXCOORDINDEX) {
+        m_ffDirtyStages |= 1u << Stage;
         m_flags.set(D3D9DeviceFlag::DirtyFFPixelShader);
-      else
+      }
+      else {
+        m_ffKeyVS.TexcoordIndices[Stage] = Value;
         m_flags.set(D3D9DeviceFlag::DirtyFFVertexShader);
+      }
       m_state.textureStages[Stage][Type] = Value;
     }
 
@@ -2125,6 +2151,12 @@ namespace dxvk {
 
     PrepareDraw();
 
+    if (unlikely(HasFailedShaders()))
+      return D3DERR_INVALIDCALL;
+
+    if (m_d3d9Options.mergeDraws && MergeDraw(PrimitiveType, false, StartVertex, 0, PrimitiveCount))
+      return D3D_OK;
+
     EmitCs([this,
       cPrimType    = PrimitiveType,
       cPrimCount   = PrimitiveCount,
@@ -2155,6 +2187,12 @@ namespace dxvk {
 
     PrepareDraw();
 
+    if (unlikely(HasFailedShaders()))
+      return D3DERR_INVALIDCALL;
+
+    if (m_d3d9Options.mergeDraws && MergeDraw(PrimitiveType, true, StartIndex, BaseVertexIndex, PrimitiveCount))
+      return D3D_OK;
+
     EmitCs([this,
       cPrimType        = PrimitiveType,
       cPrimCount       = PrimitiveCount,
@@ -2185,6 +2223,9 @@ namespace dxvk {
 
     PrepareDraw(true);
 
+    if (unlikely(HasFailedShaders()))
+      return D3DERR_INVALIDCALL;
+
     auto drawInfo = GenerateDrawInfo(PrimitiveType, PrimitiveCount, 0);
 
     const uint32_t upSize = drawInfo.vertexCount * VertexStreamZeroStride;
@@ -2228,6 +2269,9 @@ namespace dxvk {
 
     PrepareDraw(true);
 
+    if (unlikely(HasFailedShaders()))
+      return D3DERR_INVALIDCALL;
+
     auto drawInfo = GenerateDrawInfo(PrimitiveType, PrimitiveCount, 0);
 
     const uint32_t vertexSize  = (MinVertexIndex + NumVertices) * VertexStreamZeroStride;
@@ -2405,8 +2449,13 @@ namespace dxvk {
                     || decl->TestFlag(D3D9VertexDeclFlag::HasColor0)     != m_state.vertexDecl->TestFlag(D3D9VertexDeclFlag::HasColor0)
                     || decl->TestFlag(D3D9VertexDeclFlag::HasColor1)     != m_state.vertexDecl->TestFlag(D3D9VertexDeclFlag::HasColor1);
 
-    if (dirtyFFShader)
+    if (dirtyFFShader) {
+      m_ffKeyVS.HasPositionT = decl != nullptr && decl->TestFlag(D3D9VertexDeclFlag::HasPositionT);
+      m_ffKeyVS.HasColor0    = decl != nullptr && decl->TestFlag(D3D9VertexDeclFlag::HasColor0);
+      m_ffKeyVS.HasColor1    = decl != nullptr && decl->TestFlag(D3D9VertexDeclFlag::HasColor1);
+
       m_flags.set(D3D9DeviceFlag::DirtyFFVertexShader);
+    }
 
     changePrivate(m_state.vertexDecl, decl);
 
@@ -2508,28 +2557,18 @@ namespace dxvk {
     auto* oldShader = GetCommonShader(m_state.vertexShader);
     auto* newShader = GetCommonShader(shader);
 
-    bool oldCopies = oldShader && oldShader->GetMeta().needsConstantCopies;
-    bool newCopies = newShader && newShader->GetMeta().needsConstantCopies;
-
-    m_consts[DxsoProgramTypes::VertexShader].dirty |= oldCopies || newCopies || !oldShader;
-    m_consts[DxsoProgramTypes::VertexShader].meta  = newShader ? &newShader->GetMeta() : nullptr;
-
-    if (newShader && oldShader) {
-      m_consts[DxsoProgramTypes::VertexShader].dirty
-        |= newShader->GetMeta().maxConstIndexF > oldShader->GetMeta().maxConstIndexF
-        || newShader->GetMeta().maxConstIndexI > oldShader->GetMeta().maxConstIndexI
-        || newShader->GetMeta().maxConstIndexB > oldShader->GetMeta().maxConstIndexB;
-    }
+    // The shader may still be translated on a worker thread, so it
+    // is only bound at draw time. Until then, its constant metadata
+    // is only used if it is available without waiting.
+    m_consts[DxsoProgramTypes::VertexShader].dirty |= !ConstantLayoutsCompatible(oldShader, newShader);
+    m_consts[DxsoProgramTypes::VertexShader].meta   = nullptr;
+    m_consts[DxsoProgramTypes::VertexShader].dirtyRegs.all = true;
 
     changePrivate(m_state.vertexShader, shader);
 
     if (shader != nullptr) {
-      m_flags.clr(D3D9DeviceFlag::DirtyProgVertexShader);
+      m_flags.set(D3D9DeviceFlag::DirtyProgVertexShader);
       m_flags.set(D3D9DeviceFlag::DirtyFFVertexShader);
-
-      BindShader(
-        DxsoProgramTypes::VertexShader,
-        GetCommonShader(shader));
     }
 
     m_flags.set(D3D9DeviceFlag::DirtyInputLayout);
@@ -2834,27 +2873,18 @@ namespace dxvk {
     auto* oldShader = GetCommonShader(m_state.pixelShader);
     auto* newShader = GetCommonShader(shader);
 
-    bool oldCopies = oldShader && oldShader->GetMeta().needsConstantCopies;
-    bool newCopies = newShader && newShader->GetMeta().needsConstantCopies;
-
-    m_consts[DxsoProgramTypes::PixelShader].dirty |= oldCopies || newCopies || !oldShader;
-    m_consts[DxsoProgramTypes::PixelShader].meta  = newShader ? &newShader->GetMeta() : nullptr;
-
-    if (newShader && oldShader) {
-      m_consts[DxsoProgramTypes::PixelShader].dirty
-        |= newShader->GetMeta().maxConstIndexF > oldShader->GetMeta().maxConstIndexF
-        || newShader->GetMeta().maxConstIndexI > oldShader->GetMeta().maxConstIndexI
-        || newShader->GetMeta().maxConstIndexB > oldShader->GetMeta().maxConstIndexB;
-    }
+    // The shader may still be translated on a worker thread, so it
+    // is only bound at draw time. Until then, its constant metadata
+    // is only used if it is available without waiting.
+    m_consts[DxsoProgramTypes::PixelShader].dirty |= !ConstantLayoutsCompatible(oldShader, newShader);
+    m_consts[DxsoProgramTypes::PixelShader].meta   = nullptr;
+    m_consts[DxsoProgramTypes::PixelShader].dirtyRegs.all = true;
 
     changePrivate(m_state.pixelShader, shader);
 
     if (shader != nullptr) {
+      m_flags.set(D3D9DeviceFlag::DirtyProgPixelShader);
       m_flags.set(D3D9DeviceFlag::DirtyFFPixelShader);
-
-      BindShader(
-        DxsoProgramTypes::PixelShader,
-        GetCommonShader(shader));
     }
 
     return D3D_OK;
@@ -3499,6 +3529,8 @@ namespace dxvk {
 
     m_dirtySamplerStates = 0;
 
+    ResetFixedFunctionKeys();
+
     for (uint32_t i = 0; i < caps::MaxClipPlanes; i++) {
       float plane[4] = { 0, 0, 0, 0 };
       SetClipPlane(i, plane);
@@ -3644,8 +3676,12 @@ namespace dxvk {
     // We need to check our ops and disable respective stages.
     // Given we have transition from a null resource to
     // a valid resource or vice versa.
-    if (pTexture == nullptr || m_state.textures[StateSampler] == nullptr)
+    if (pTexture == nullptr || m_state.textures[StateSampler] == nullptr) {
+      if (StateSampler < caps::TextureStageCount)
+        m_ffDirtyStages |= 1u << StateSampler;
+
       m_flags.set(D3D9DeviceFlag::DirtyFFPixelShader);
+    }
     
     TextureChangePrivate(m_state.textures[StateSampler], pTexture);
 
@@ -3669,6 +3705,142 @@ namespace dxvk {
   }
 
 
+  void D3D9DeviceEx::SetRenderStates(
+    const bit::bitset<RenderStateCount>& Mask,
+    const DWORD*                         pValues) {
+    D3D9DeviceLock lock = LockDevice();
+
+    if (unlikely(ShouldRecord())) {
+      m_recorder->SetRenderStates(Mask, pValues);
+      return;
+    }
+
+    auto& states = m_state.renderStates;
+
+    const bool oldATOC = IsAlphaToCoverageEnabled();
+    const bool oldNVDB = states[D3DRS_ADAPTIVETESS_X] == uint32_t(D3D9Format::NVDB);
+
+    D3D9DeviceFlags dirty;
+
+    for (uint32_t i = 0; i < Mask.dwordCount(); i++) {
+      for (uint32_t rs : bit::BitMask(Mask.dword(i))) {
+        auto  state = D3DRENDERSTATETYPE(i * 32 + rs);
+        DWORD value = pValues[state];
+
+        if (states[state] == value)
+          continue;
+
+        // Driver hacks may consume the value rather
+        // than storing it, so leave those to the setter
+        if (unlikely(state == D3DRS_POINTSIZE || state == D3DRS_ADAPTIVETESS_Y)) {
+          SetRenderState(state, value);
+          continue;
+        }
+
+        states[state] = value;
+        UpdateRenderState(state, value, oldATOC, oldNVDB, dirty);
+      }
+    }
+
+    m_flags.set(dirty);
+  }
+
+
+  void D3D9DeviceEx::SetStateSamplerStates(
+          DWORD               StateSampler,
+          uint32_t            Mask,
+    const DWORD*              pValues) {
+    D3D9DeviceLock lock = LockDevice();
+
+    if (unlikely(ShouldRecord())) {
+      m_recorder->SetStateSamplerStates(StateSampler, Mask, pValues);
+      return;
+    }
+
+    constexpr uint32_t SamplerDescMask
+      = (1u << D3DSAMP_ADDRESSU)      | (1u << D3DSAMP_ADDRESSV)
+      | (1u << D3DSAMP_ADDRESSW)      | (1u << D3DSAMP_MAGFILTER)
+      | (1u << D3DSAMP_MINFILTER)     | (1u << D3DSAMP_MIPFILTER)
+      | (1u << D3DSAMP_MAXANISOTROPY) | (1u << D3DSAMP_MIPMAPLODBIAS)
+      | (1u << D3DSAMP_MAXMIPLEVEL)   | (1u << D3DSAMP_BORDERCOLOR);
+
+    auto& state = m_state.samplerStates[StateSampler];
+
+    uint32_t changed = 0;
+
+    for (uint32_t type : bit::BitMask(Mask)) {
+      if (state[type] != pValues[type]) {
+        state[type] = pValues[type];
+        changed |= 1u << type;
+      }
+    }
+
+    if (changed & SamplerDescMask)
+      m_dirtySamplerStates |= 1u << StateSampler;
+
+    if (changed & (1u << D3DSAMP_SRGBTEXTURE))
+      BindTexture(StateSampler);
+  }
+
+
+  void D3D9DeviceEx::SetTextureStageStates(
+          DWORD               Stage,
+          uint32_t            Mask,
+    const DWORD*              pValues) {
+    D3D9DeviceLock lock = LockDevice();
+
+    if (unlikely(ShouldRecord())) {
+      m_recorder->SetTextureStageStates(Stage, Mask, pValues);
+      return;
+    }
+
+    constexpr uint32_t BumpEnvMask
+      = (1u << D3DTSS_BUMPENVMAT00)   | (1u << D3DTSS_BUMPENVMAT01)
+      | (1u << D3DTSS_BUMPENVMAT10)   | (1u << D3DTSS_BUMPENVMAT11)
+      | (1u << D3DTSS_BUMPENVLSCALE)  | (1u << D3DTSS_BUMPENVLOFFSET);
+
+    constexpr uint32_t TexcoordIndexBit  = 1u << D3DTSS_TEXCOORDINDEX;
+    constexpr uint32_t TransformFlagsBit = 1u << D3DTSS_TEXTURETRANSFORMFLAGS;
+
+    auto& state = m_state.textureStages[Stage];
+
+    uint32_t changed = 0;
+
+    for (uint32_t type : bit::BitMask(Mask)) {
+      if (state[type] != pValues[type]) {
+        state[type] = pValues[type];
+        changed |= 1u << type;
+      }
+    }
+
+    if (!changed)
+      return;
+
+    D3D9DeviceFlags dirty;
+
+    if (changed & BumpEnvMask)
+      dirty.set(D3D9DeviceFlag::DirtySharedPixelShaderData);
+
+    if (changed & TexcoordIndexBit) {
+      m_ffKeyVS.TexcoordIndices[Stage] = state[D3DTSS_TEXCOORDINDEX];
+      dirty.set(D3D9DeviceFlag::DirtyFFVertexShader);
+    }
+
+    // Texture transform flags affect both shaders
+    if (changed & TransformFlagsBit) {
+      m_ffKeyVS.TransformFlags[Stage] = state[D3DTSS_TEXTURETRANSFORMFLAGS] & ~(D3DTTFF_PROJECTED);
+      dirty.set(D3D9DeviceFlag::DirtyFFVertexShader);
+    }
+
+    if (changed & ~(BumpEnvMask | TexcoordIndexBit)) {
+      m_ffDirtyStages |= 1u << Stage;
+      dirty.set(D3D9DeviceFlag::DirtyFFPixelShader);
+    }
+
+    m_flags.set(dirty);
+  }
+
+
   bool D3D9DeviceEx::IsExtended() {
     return m_parent->IsExtended();
   }
@@ -4425,10 +4597,12 @@ namespace dxvk {
     info.stages = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT;
     info.size   = sizeof(D3D9ShaderConstantsVS);
     m_consts[DxsoProgramTypes::VertexShader].buffer = m_dxvkDevice->createBuffer(info, memoryFlags);
+    m_consts[DxsoProgramTypes::VertexShader].staging.resize(info.size);
 
     info.stages = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
     info.size   = sizeof(D3D9ShaderConstantsPS);
     m_consts[DxsoProgramTypes::PixelShader].buffer  = m_dxvkDevice->createBuffer(info, memoryFlags);
+    m_consts[DxsoProgramTypes::PixelShader].staging.resize(info.size);
 
     info.size = caps::MaxClipPlanes * sizeof(D3D9ClipPlane);
     m_vsClipPlanes = m_dxvkDevice->createBuffer(info, memoryFlags);
@@ -4475,6 +4649,8 @@ namespace dxvk {
   template <DxsoProgramType ShaderStage>
   void D3D9DeviceEx::UploadConstants() {
     auto UploadHelper = [&](auto& src) {
+      using ConstantsType = std::remove_reference_t<decltype(src)>;
+
       D3D9ConstantSets& constSet = m_consts[ShaderStage];
 
       if (!constSet.dirty)
@@ -4482,27 +4658,70 @@ namespace dxvk {
 
       constSet.dirty = false;
 
-      DxvkBufferSliceHandle slice = constSet.buffer->allocSlice();
+      // Re-pack changed registers into the staged copy of the
+      // buffer. Everything else is carried over from previous
+      // uploads, including the packed float layout and any
+      // constants defined by the shader itself.
+      auto stagingData = reinterpret_cast<ConstantsType*>(constSet.staging.data());
+      auto srcData     = &src;
 
-      auto dstData = reinterpret_cast<std::remove_reference_t<decltype(src)> *>(slice.mapPtr);
-      auto srcData = &src;
+      const DxsoShaderMetaInfo& meta  = *constSet.meta;
+      D3D9DirtyConstants&       dirty = constSet.dirtyRegs;
 
-      EmitCs([
-        cBuffer = constSet.buffer,
-        cSlice  = slice
-      ] (DxvkContext* ctx) {
-        ctx->invalidateBuffer(cBuffer, cSlice);
-      });
+      auto CopyFloats = [&] (uint32_t dstIndex, uint32_t srcIndex, uint32_t count) {
+        std::memcpy(&stagingData->fConsts[dstIndex], &srcData->fConsts[srcIndex], sizeof(Vector4) * count);
+      };
 
-      if (constSet.meta->maxConstIndexF)
-        std::memcpy(&dstData->fConsts[0], &srcData->fConsts[0], sizeof(Vector4)  * constSet.meta->maxConstIndexF);
-      if (constSet.meta->maxConstIndexI)
-        std::memcpy(&dstData->iConsts[0], &srcData->iConsts[0], sizeof(Vector4i) * constSet.meta->maxConstIndexI);
-      if (constSet.meta->maxConstIndexB)
-        dstData->boolBitfield = srcData->boolBitfield;
+      uint32_t floatCount = meta.maxConstIndexF;
 
-      if (constSet.meta->needsConstantCopies) {
-        Vector4* data = reinterpret_cast<Vector4*>(slice.mapPtr);
+      if (meta.packedConstantsF) {
+        uint32_t dstIndex = 0;
+
+        for (const auto& range : meta.constantRangesF) {
+          if (dirty.all) {
+            CopyFloats(dstIndex, range.first, range.count);
+          }
+          else {
+            dirty.forEachFloatRange([&] (uint32_t first, uint32_t count) {
+              uint32_t lo = std::max(first, range.first);
+              uint32_t hi = std::min(first + count, range.first + range.count);
+
+              if (lo < hi)
+                CopyFloats(dstIndex + lo - range.first, lo, hi - lo);
+            });
+          }
+
+          dstIndex += range.count;
+        }
+
+        floatCount = dstIndex;
+      }
+      else if (dirty.all) {
+        CopyFloats(0, 0, floatCount);
+      }
+      else {
+        dirty.forEachFloatRange([&] (uint32_t first, uint32_t count) {
+          if (first < floatCount)
+            CopyFloats(first, first, std::min(count, floatCount - first));
+        });
+      }
+
+      uint32_t intMask = (1u << meta.maxConstIndexI) - 1;
+
+      if (!dirty.all)
+        intMask &= dirty.ints;
+
+      while (intMask) {
+        uint32_t i = bit::tzcnt(intMask);
+        stagingData->iConsts[i] = srcData->iConsts[i];
+        intMask &= intMask - 1;
+      }
+
+      if (dirty.all || dirty.bools)
+        stagingData->boolBitfield = srcData->boolBitfield;
+
+      if (meta.needsConstantCopies && (dirty.all || dirty.anyFloats())) {
+        Vector4* data = reinterpret_cast<Vector4*>(stagingData);
 
         if (ShaderStage == DxsoProgramTypes::VertexShader) {
           auto& shaderConsts = GetCommonShader(m_state.vertexShader)->GetConstants();
@@ -4517,6 +4736,28 @@ namespace dxvk {
             data[constant.uboIdx] = *reinterpret_cast<const Vector4*>(constant.float32);
         }
       }
+
+      dirty.clear();
+
+      // The buffer is renamed, so the new slice needs all live
+      // data. Write it with one sequential copy per constant type.
+      DxvkBufferSliceHandle slice = constSet.buffer->allocSlice();
+
+      EmitCs([
+        cBuffer = constSet.buffer,
+        cSlice  = slice
+      ] (DxvkContext* ctx) {
+        ctx->invalidateBuffer(cBuffer, cSlice);
+      });
+
+      auto dstData = reinterpret_cast<ConstantsType*>(slice.mapPtr);
+
+      if (floatCount)
+        std::memcpy(&dstData->fConsts[0], &stagingData->fConsts[0], sizeof(Vector4)  * floatCount);
+      if (meta.maxConstIndexI)
+        std::memcpy(&dstData->iConsts[0], &stagingData->iConsts[0], sizeof(Vector4i) * meta.maxConstIndexI);
+      if (meta.maxConstIndexB)
+        dstData->boolBitfield = stagingData->boolBitfield;
     };
 
     return ShaderStage == DxsoProgramTypes::VertexShader
@@ -4602,7 +4843,7 @@ namespace dxvk {
 
     m_initializer->Flush();
 
-    if (m_csIsBusy || !m_csChunk->empty()) {
+    if (m_csIsBusy || !m_csChunk->empty() || m_mergedDraw.drawCount) {
       // Add commands to flush the threaded
       // context, then flush the command list
       EmitCs([](DxvkContext* ctx) {
@@ -4705,12 +4946,7 @@ namespace dxvk {
 
       if (m_flags.test(D3D9DeviceFlag::DirtyFogState)) {
         m_flags.clr(D3D9DeviceFlag::DirtyFogState);
-
-        EmitCs([cMode = mode] (DxvkContext* ctx) {
-          ctx->setSpecConstant(D3D9SpecConstantId::FogEnabled,    true);
-          ctx->setSpecConstant(D3D9SpecConstantId::VertexFogMode, cMode);
-          ctx->setSpecConstant(D3D9SpecConstantId::PixelFogMode,  D3DFOG_NONE);
-        });
+        BindFogState(true, mode, D3DFOG_NONE);
       }
     }
     else if (pixelFog) {
@@ -4720,12 +4956,7 @@ namespace dxvk {
 
       if (m_flags.test(D3D9DeviceFlag::DirtyFogState)) {
         m_flags.clr(D3D9DeviceFlag::DirtyFogState);
-
-        EmitCs([cMode = mode] (DxvkContext* ctx) {
-          ctx->setSpecConstant(D3D9SpecConstantId::FogEnabled,    true);
-          ctx->setSpecConstant(D3D9SpecConstantId::VertexFogMode, D3DFOG_NONE);
-          ctx->setSpecConstant(D3D9SpecConstantId::PixelFogMode,  cMode);
-        });
+        BindFogState(true, D3DFOG_NONE, mode);
       }
     }
     else {
@@ -4734,17 +4965,64 @@ namespace dxvk {
 
       if (m_flags.test(D3D9DeviceFlag::DirtyFogState)) {
         m_flags.clr(D3D9DeviceFlag::DirtyFogState);
-
-        EmitCs([cEnabled = fogEnabled] (DxvkContext* ctx) {
-          ctx->setSpecConstant(D3D9SpecConstantId::FogEnabled,    cEnabled);
-          ctx->setSpecConstant(D3D9SpecConstantId::VertexFogMode, D3DFOG_NONE);
-          ctx->setSpecConstant(D3D9SpecConstantId::PixelFogMode,  D3DFOG_NONE);
-        });
+        BindFogState(fogEnabled, D3DFOG_NONE, D3DFOG_NONE);
       }
     }
   }
 
 
+  void D3D9DeviceEx::BindFogState(
+          bool                              Enabled,
+          D3DFOGMODE                        VertexMode,
+          D3DFOGMODE                        PixelMode) {
+    auto& churn = m_specChurn[uint32_t(D3D9SpecStateGroup::Fog)];
+
+    bool changed = churn.RecordChange(uint32_t(Enabled)
+      | (uint32_t(VertexMode) << 1)
+      | (uint32_t(PixelMode)  << 3));
+
+    if (likely(!churn.IsDynamic())) {
+      EmitCs([
+        cEnabled    = Enabled,
+        cVertexMode = VertexMode,
+        cPixelMode  = PixelMode
+      ] (DxvkContext* ctx) {
+        ctx->setSpecConstant(D3D9SpecConstantId::FogEnabled,    cEnabled);
+        ctx->setSpecConstant(D3D9SpecConstantId::VertexFogMode, cVertexMode);
+        ctx->setSpecConstant(D3D9SpecConstantId::PixelFogMode,  cPixelMode);
+      });
+      return;
+    }
+
+    std::array<uint32_t, 3> data = {{ uint32_t(Enabled), uint32_t(VertexMode), uint32_t(PixelMode) }};
+    UpdatePushConstant<offsetof(D3D9RenderStateInfo, fogEnabled), sizeof(data)>(data.data());
+
+    // Only count changes that would have required
+    // a different pipeline with spec constants
+    EmitCs([cChanged = changed] (DxvkContext* ctx) {
+      ctx->setSpecConstant(D3D9SpecConstantId::FogEnabled,    true);
+      ctx->setSpecConstant(D3D9SpecConstantId::VertexFogMode, D3D9SpecConstantDynamic);
+      ctx->setSpecConstant(D3D9SpecConstantId::PixelFogMode,  D3D9SpecConstantDynamic);
+
+      if (cChanged)
+        ctx->addStatCtr(DxvkStatCounter::PipeDynamicStates, 1);
+    });
+  }
+
+
+  void D3D9DeviceEx::UpdateSpecStateChurn() {
+    m_specChurnFrameId = m_frameId;
+
+    // Re-emit state for groups that switched between
+    // spec constants and dynamic push constant data
+    if (m_specChurn[uint32_t(D3D9SpecStateGroup::AlphaTest)].EndFrame())
+      m_flags.set(D3D9DeviceFlag::DirtyAlphaTestState);
+
+    if (m_specChurn[uint32_t(D3D9SpecStateGroup::Fog)].EndFrame())
+      m_flags.set(D3D9DeviceFlag::DirtyFogState);
+  }
+
+
   void D3D9DeviceEx::BindFramebuffer() {
     m_flags.clr(D3D9DeviceFlag::DirtyFramebuffer);
 
@@ -5038,9 +5316,26 @@ namespace dxvk {
       ? DecodeCompareOp(D3DCMPFUNC(rs[D3DRS_ALPHAFUNC]))
       : VK_COMPARE_OP_ALWAYS;
     
-    EmitCs([cAlphaOp = alphaOp] (DxvkContext* ctx) {
-      ctx->setSpecConstant(D3D9SpecConstantId::AlphaTestEnable, cAlphaOp != VK_COMPARE_OP_ALWAYS);
-      ctx->setSpecConstant(D3D9SpecConstantId::AlphaCompareOp,  cAlphaOp);
+    auto& churn = m_specChurn[uint32_t(D3D9SpecStateGroup::AlphaTest)];
+    bool changed = churn.RecordChange(uint32_t(alphaOp));
+
+    if (likely(!churn.IsDynamic())) {
+      EmitCs([cAlphaOp = alphaOp] (DxvkContext* ctx) {
+        ctx->setSpecConstant(D3D9SpecConstantId::AlphaTestEnable, cAlphaOp != VK_COMPARE_OP_ALWAYS);
+        ctx->setSpecConstant(D3D9SpecConstantId::AlphaCompareOp,  cAlphaOp);
+      });
+      return;
+    }
+
+    uint32_t alphaFunc = uint32_t(alphaOp);
+    UpdatePushConstant<offsetof(D3D9RenderStateInfo, alphaFunc), sizeof(uint32_t)>(&alphaFunc);
+
+    EmitCs([cChanged = changed] (DxvkContext* ctx) {
+      ctx->setSpecConstant(D3D9SpecConstantId::AlphaTestEnable, true);
+      ctx->setSpecConstant(D3D9SpecConstantId::AlphaCompareOp,  D3D9SpecConstantDynamic);
+
+      if (cChanged)
+        ctx->addStatCtr(DxvkStatCounter::PipeDynamicStates, 1);
     });
   }
 
@@ -5186,6 +5481,13 @@ namespace dxvk {
       const uint32_t textureBitMask = 0b11u << offset;
       const uint32_t textureBits = textureType << offset;
 
+      // The fixed-function key stores the texture type
+      if (StateSampler < caps::TextureStageCount
+       && (m_samplerTypeBitfield & textureBitMask) != textureBits) {
+        m_ffDirtyStages |= 1u << StateSampler;
+        m_flags.set(D3D9DeviceFlag::DirtyFFPixelShader);
+      }
+
       m_samplerTypeBitfield &= ~textureBitMask;
       m_samplerTypeBitfield |= textureBits;
     }
@@ -5244,6 +5546,78 @@ namespace dxvk {
   }
 
 
+  bool D3D9DeviceEx::MergeDraw(
+          D3DPRIMITIVETYPE PrimitiveType,
+          bool             Indexed,
+          UINT             First,
+          INT              BaseVertex,
+          UINT             PrimitiveCount) {
+    // Strips and fans cannot be concatenated without inserting
+    // restart indices, and merging instanced draws would change
+    // the order in which primitives are rasterized.
+    bool isList = PrimitiveType == D3DPT_POINTLIST
+               || PrimitiveType == D3DPT_LINELIST
+               || PrimitiveType == D3DPT_TRIANGLELIST;
+
+    if (!isList || GetInstanceCount() != 1)
+      return false;
+
+    // Any state change since the last draw would have emitted
+    // a command, which in turn emits the pending draw first.
+    D3D9MergedDraw& draw = m_mergedDraw;
+
+    if (draw.drawCount) {
+      uint32_t end = draw.first + GetVertexCount(draw.primitiveType, draw.primitiveCount);
+
+      if (draw.primitiveType == PrimitiveType
+       && draw.indexed       == Indexed
+       && draw.baseVertex    == BaseVertex
+       && end                == First) {
+        draw.primitiveCount += PrimitiveCount;
+        draw.drawCount      += 1;
+        return true;
+      }
+
+      EmitMergedDraw();
+    }
+
+    draw.primitiveType  = PrimitiveType;
+    draw.indexed        = Indexed;
+    draw.first          = First;
+    draw.baseVertex     = BaseVertex;
+    draw.primitiveCount = PrimitiveCount;
+    draw.drawCount      = 1;
+    return true;
+  }
+
+
+  void D3D9DeviceEx::EmitMergedDraw() {
+    D3D9MergedDraw draw = m_mergedDraw;
+    m_mergedDraw.drawCount = 0;
+
+    EmitCs([this,
+      cDraw = draw
+    ](DxvkContext* ctx) {
+      auto drawInfo = GenerateDrawInfo(cDraw.primitiveType, cDraw.primitiveCount, 1);
+
+      ApplyPrimitiveType(ctx, cDraw.primitiveType);
+
+      if (cDraw.indexed) {
+        ctx->drawIndexed(
+          drawInfo.vertexCount, drawInfo.instanceCount,
+          cDraw.first, cDraw.baseVertex, 0);
+      } else {
+        ctx->draw(
+          drawInfo.vertexCount, drawInfo.instanceCount,
+          cDraw.first, 0);
+      }
+
+      if (cDraw.drawCount > 1)
+        ctx->addStatCtr(DxvkStatCounter::CmdDrawsMerged, cDraw.drawCount - 1);
+    });
+  }
+
+
   void D3D9DeviceEx::PrepareDraw(bool up) {
     // This is fairly expensive to do!
     // So we only enable it on games & vendors that actually need it (for now)
@@ -5251,6 +5625,9 @@ namespace dxvk {
     if (m_d3d9Options.hasHazards)
       CheckForHazards();
 
+    if (unlikely(m_d3d9Options.adaptiveSpecConstants && m_specChurnFrameId != m_frameId))
+      UpdateSpecStateChurn();
+
     UpdateFog();
 
     if (m_flags.test(D3D9DeviceFlag::DirtyFramebuffer))
@@ -5299,6 +5676,10 @@ namespace dxvk {
         m_flags.set(D3D9DeviceFlag::DirtyInputLayout);
         BindShader(DxsoProgramType::VertexShader, GetCommonShader(m_state.vertexShader));
       }
+
+      if (unlikely(m_d3d9Options.specializeIntBoolConstants))
+        BindSpecializedShader<DxsoProgramTypes::VertexShader>();
+
       UploadConstants<DxsoProgramTypes::VertexShader>();
     }
     else
@@ -5313,6 +5694,12 @@ namespace dxvk {
     };
 
     if (likely(UseProgrammablePS())) {
+      if (unlikely(m_flags.test(D3D9DeviceFlag::DirtyProgPixelShader)))
+        BindShader(DxsoProgramType::PixelShader, GetCommonShader(m_state.pixelShader));
+
+      if (unlikely(m_d3d9Options.specializeIntBoolConstants))
+        BindSpecializedShader<DxsoProgramTypes::PixelShader>();
+
       UploadConstants<DxsoProgramTypes::PixelShader>();
 
       if (GetCommonShader(m_state.pixelShader)->GetInfo().majorVersion() >= 2)
@@ -5370,12 +5757,110 @@ namespace dxvk {
   }
 
 
+  bool D3D9DeviceEx::ConstantLayoutsCompatible(
+    const D3D9CommonShader*                 pOldShader,
+    const D3D9CommonShader*                 pNewShader) {
+    if (pOldShader == nullptr || pNewShader == nullptr
+     || !pOldShader->IsTranslated() || !pNewShader->IsTranslated())
+      return false;
+
+    const auto& oldMeta = pOldShader->GetMeta();
+    const auto& newMeta = pNewShader->GetMeta();
+
+    // Packed constant layouts differ between shaders
+    if (oldMeta.needsConstantCopies || newMeta.needsConstantCopies
+     || oldMeta.packedConstantsF    || newMeta.packedConstantsF)
+      return false;
+
+    return newMeta.maxConstIndexF <= oldMeta.maxConstIndexF
+        && newMeta.maxConstIndexI <= oldMeta.maxConstIndexI
+        && newMeta.maxConstIndexB <= oldMeta.maxConstIndexB;
+  }
+
+
+  bool D3D9DeviceEx::HasFailedShaders() {
+    return (UseProgrammableVS() && m_progShaders[DxsoProgramTypes::VertexShader] == nullptr)
+        || (UseProgrammablePS() && m_progShaders[DxsoProgramTypes::PixelShader]  == nullptr);
+  }
+
+
   void D3D9DeviceEx::BindShader(
         DxsoProgramType                   ShaderStage,
   const D3D9CommonShader*                 pShaderModule) {
+    if (ShaderStage == DxsoProgramType::VertexShader)
+      m_ffBoundVS = false;
+    else
+      m_ffBoundPS = false;
+
+    m_flags.clr(ShaderStage == DxsoProgramType::VertexShader
+      ? D3D9DeviceFlag::DirtyProgVertexShader
+      : D3D9DeviceFlag::DirtyProgPixelShader);
+
+    // Waits for translation if it has not finished yet
+    m_progShaders[ShaderStage]   = pShaderModule->GetShader();
+    m_progSpecDirty[ShaderStage] = pShaderModule->GetVariants() != nullptr;
+
+    m_consts[ShaderStage].meta = &pShaderModule->GetMeta();
+
     EmitCs([
       cStage  = GetShaderStage(ShaderStage),
-      cShader = pShaderModule->GetShader()
+      cShader = m_progShaders[ShaderStage]
+    ] (DxvkContext* ctx) {
+      ctx->bindShader(cStage, cShader);
+    });
+  }
+
+
+  template <DxsoProgramType ShaderStage>
+  void D3D9DeviceEx::BindSpecializedShader() {
+    // Int and bool constants can only have changed if the
+    // constant buffer has to be updated anyway. Otherwise,
+    // only check again if the variant was still compiling.
+    if (!m_consts[ShaderStage].dirty && !m_progSpecDirty[ShaderStage])
+      return;
+
+    m_progSpecDirty[ShaderStage] = false;
+
+    const D3D9CommonShader* shader = ShaderStage == DxsoProgramTypes::VertexShader
+      ? GetCommonShader(m_state.vertexShader)
+      : GetCommonShader(m_state.pixelShader);
+
+    const auto& variants = shader->GetVariants();
+    const auto& meta     = shader->GetMeta();
+
+    if (variants == nullptr || (!meta.maxConstIndexI && !meta.maxConstIndexB))
+      return;
+
+    auto SpecHelper = [&] (const auto& set) {
+      DxsoConstantSpecialization spec;
+      spec.intMask  = (1u << meta.maxConstIndexI) - 1;
+      spec.boolMask = (1u << meta.maxConstIndexB) - 1;
+      spec.bools    = set.boolBitfield & spec.boolMask;
+
+      std::memcpy(spec.ints.data(), set.iConsts.data(), sizeof(Vector4i) * meta.maxConstIndexI);
+      return spec;
+    };
+
+    DxsoConstantSpecialization spec = ShaderStage == DxsoProgramTypes::VertexShader
+      ? SpecHelper(m_state.vsConsts)
+      : SpecHelper(m_state.psConsts);
+
+    bool pending = false;
+    Rc<DxvkShader> variant = variants->GetShader(spec, &pending);
+
+    m_progSpecDirty[ShaderStage] = pending;
+
+    if (variant == nullptr)
+      variant = shader->GetShader();
+
+    if (variant == m_progShaders[ShaderStage])
+      return;
+
+    m_progShaders[ShaderStage] = variant;
+
+    EmitCs([
+      cStage  = GetShaderStage(ShaderStage),
+      cShader = std::move(variant)
     ] (DxvkContext* ctx) {
       ctx->bindShader(cStage, cShader);
     });
@@ -5578,6 +6063,7 @@ namespace dxvk {
     m_state.vsConsts.boolBitfield |= bits & mask;
 
     m_consts[DxsoProgramTypes::VertexShader].dirty = true;
+    m_consts[DxsoProgramTypes::VertexShader].dirtyRegs.bools = true;
   }
 
 
@@ -5586,6 +6072,7 @@ namespace dxvk {
     m_state.psConsts.boolBitfield |= bits & mask;
 
     m_consts[DxsoProgramTypes::PixelShader].dirty = true;
+    m_consts[DxsoProgramTypes::PixelShader].dirtyRegs.bools = true;
   }
 
 
@@ -5638,25 +6125,60 @@ namespace dxvk {
         pConstantData,
         Count);
 
-    auto DetermineMaxCount = [&](const auto& shader) {
+    auto IsRangeUsed = [&](const auto& shader) {
       if (unlikely(shader == nullptr))
-        return 0u;
+        return false;
+
+      // Don't wait for translation here, the constants
+      // will be uploaded when the shader gets bound
+      const D3D9CommonShader* commonShader = GetCommonShader(shader);
 
-      const auto& meta = GetCommonShader(shader)->GetMeta();
+      if (unlikely(!commonShader->IsTranslated()))
+        return true;
 
-      if constexpr      (ConstantType == D3D9ConstantType::Float)
-        return meta.maxConstIndexF;
+      const auto& meta = commonShader->GetMeta();
+
+      if constexpr      (ConstantType == D3D9ConstantType::Float) {
+        if (meta.packedConstantsF)
+          return IsConstantRangeUsed(meta.constantRangesF, StartRegister, Count);
+
+        return StartRegister < meta.maxConstIndexF;
+      }
       else if constexpr (ConstantType == D3D9ConstantType::Int)
-        return meta.maxConstIndexI;
+        return StartRegister < meta.maxConstIndexI;
       else
-        return meta.maxConstIndexB;
+        return StartRegister < meta.maxConstIndexB;
     };
 
-    uint32_t maxCount = ProgramType == DxsoProgramTypes::VertexShader
-      ? DetermineMaxCount(m_state.vertexShader)
-      : DetermineMaxCount(m_state.pixelShader);
+    bool rangeUsed = ProgramType == DxsoProgramTypes::VertexShader
+      ? IsRangeUsed(m_state.vertexShader)
+      : IsRangeUsed(m_state.pixelShader);
 
-    m_consts[ProgramType].dirty |= StartRegister < maxCount;
+    // Applications often set the same per-frame constants again
+    // for every draw. Those can stay in the current buffer slice,
+    // and only registers that actually changed need re-packing.
+    D3D9ConstantSets& constSet = m_consts[ProgramType];
+
+    bool changed = rangeUsed && (constSet.dirtyRegs.all
+      || StateConstantsDiffer<ProgramType, ConstantType, T>(
+        &m_state,
+        StartRegister,
+        pConstantData,
+        Count,
+        m_d3d9Options.d3d9FloatEmulation));
+
+    if (changed) {
+      constSet.dirty = true;
+
+      if constexpr (ConstantType == D3D9ConstantType::Float)
+        constSet.dirtyRegs.setFloats(StartRegister, Count);
+      else if constexpr (ConstantType == D3D9ConstantType::Int) {
+        for (uint32_t i = 0; i < Count; i++)
+          constSet.dirtyRegs.ints |= 1u << (StartRegister + i);
+      }
+      else
+        constSet.dirtyRegs.bools = true;
+    }
 
     UpdateStateConstants<ProgramType, ConstantType, T>(
       &m_state,
@@ -5670,8 +6192,15 @@ namespace dxvk {
 
 
   void D3D9DeviceEx::UpdateFixedFunctionVS() {
+    // Replace the uber shader once the specialized one is ready
+    if (unlikely(m_ffPendingVS != nullptr && m_ffPendingVS->isDone())) {
+      m_ffPendingVS = nullptr;
+      m_ffBoundVS   = false;
+      m_flags.set(D3D9DeviceFlag::DirtyFFVertexShader);
+    }
+
     // Shader...
-    bool hasPositionT = m_state.vertexDecl != nullptr ? m_state.vertexDecl->TestFlag(D3D9VertexDeclFlag::HasPositionT) : false;
+    bool hasPositionT = m_ffKeyVS.HasPositionT;
 
     if (unlikely(hasPositionT && m_state.vertexShader != nullptr && !m_flags.test(D3D9DeviceFlag::DirtyProgVertexShader))) {
       m_flags.set(D3D9DeviceFlag::DirtyInputLayout);
@@ -5682,10 +6211,9 @@ namespace dxvk {
     if (m_flags.test(D3D9DeviceFlag::DirtyFFVertexShader)) {
       m_flags.clr(D3D9DeviceFlag::DirtyFFVertexShader);
 
-      D3D9FFShaderKeyVS key;
-      key.HasColor0    = m_state.vertexDecl != nullptr ? m_state.vertexDecl->TestFlag(D3D9VertexDeclFlag::HasColor0)   : false;
-      key.HasColor1    = m_state.vertexDecl != nullptr ? m_state.vertexDecl->TestFlag(D3D9VertexDeclFlag::HasColor1)   : false;
-      key.HasPositionT = hasPositionT;
+      // Only fields that depend on more than one
+      // state are computed here, see the setters.
+      D3D9FFShaderKeyVS& key = m_ffKeyVS;
 
       bool lighting    = m_state.renderStates[D3DRS_LIGHTING] != 0 && !key.HasPositionT;
       bool colorVertex = m_state.renderStates[D3DRS_COLORVERTEX] != 0;
@@ -5696,20 +6224,12 @@ namespace dxvk {
 
       key.UseLighting      = lighting;
       key.LocalViewer      = m_state.renderStates[D3DRS_LOCALVIEWER] && lighting;
-      key.NormalizeNormals = m_state.renderStates[D3DRS_NORMALIZENORMALS];
 
       key.DiffuseSource  = D3DMATERIALCOLORSOURCE(m_state.renderStates[D3DRS_DIFFUSEMATERIALSOURCE]  & mask);
       key.AmbientSource  = D3DMATERIALCOLORSOURCE(m_state.renderStates[D3DRS_AMBIENTMATERIALSOURCE]  & mask);
       key.SpecularSource = D3DMATERIALCOLORSOURCE(m_state.renderStates[D3DRS_SPECULARMATERIALSOURCE] & mask);
       key.EmissiveSource = D3DMATERIALCOLORSOURCE(m_state.renderStates[D3DRS_EMISSIVEMATERIALSOURCE] & mask);
 
-      key.RangeFog       = m_state.renderStates[D3DRS_RANGEFOGENABLE];
-
-      for (uint32_t i = 0; i < key.TexcoordIndices.size(); i++) {
-        key.TransformFlags[i]  = m_state.textureStages[i][D3DTSS_TEXTURETRANSFORMFLAGS] & ~(D3DTTFF_PROJECTED);
-        key.TexcoordIndices[i] = m_state.textureStages[i][D3DTSS_TEXCOORDINDEX];
-      }
-
       key.LightCount = 0;
 
       if (key.UseLighting) {
@@ -5719,14 +6239,40 @@ namespace dxvk {
         }
       }
 
-      EmitCs([
-        this,
-        cKey     = key,
-       &cShaders = m_ffModules
-      ](DxvkContext* ctx) {
-        auto shader = cShaders.GetShaderModule(this, cKey);
-        ctx->bindShader(VK_SHADER_STAGE_VERTEX_BIT, shader.GetShader());
-      });
+      // Many state changes do not change the key,
+      // e.g. when apps toggle states back and forth
+      bool isBound = m_ffBoundVS && key == m_ffBoundKeyVS;
+
+      if (!isBound) {
+        m_ffBoundKeyVS = key;
+        m_ffBoundVS    = true;
+
+        if (m_d3d9Options.ffUberShaders) {
+          D3D9FFUberKeyVS uberKey = PackFixedFunctionKey(key);
+
+          if (std::memcmp(&uberKey, &m_ffUberKeyVS, sizeof(uberKey))) {
+            m_ffUberKeyVS = uberKey;
+            m_flags.set(D3D9DeviceFlag::DirtyFFVertexData);
+          }
+
+          Rc<DxvkShader> shader = m_ffModules.GetShaderModuleAsync(this, key, &m_ffPendingVS);
+
+          EmitCs([
+            cShader = std::move(shader)
+          ](DxvkContext* ctx) {
+            ctx->bindShader(VK_SHADER_STAGE_VERTEX_BIT, cShader);
+          });
+        } else {
+          EmitCs([
+            this,
+            cKey     = key,
+           &cShaders = m_ffModules
+          ](DxvkContext* ctx) {
+            auto shader = cShaders.GetShaderModule(this, cKey);
+            ctx->bindShader(VK_SHADER_STAGE_VERTEX_BIT, shader.GetShader());
+          });
+        }
+      }
     }
 
     if (hasPositionT && m_flags.test(D3D9DeviceFlag::DirtyFFViewport)) {
@@ -5795,70 +6341,40 @@ namespace dxvk {
       }
 
       data->Material = m_state.material;
+      data->UberKey  = m_ffUberKeyVS;
     }
   }
 
 
   void D3D9DeviceEx::UpdateFixedFunctionPS() {
+    // Replace the uber shader once the specialized one is ready
+    if (unlikely(m_ffPendingPS != nullptr && m_ffPendingPS->isDone())) {
+      m_ffPendingPS = nullptr;
+      m_ffBoundPS   = false;
+      m_flags.set(D3D9DeviceFlag::DirtyFFPixelShader);
+    }
+
     // Shader...
     if (m_flags.test(D3D9DeviceFlag::DirtyFFPixelShader)) {
       m_flags.clr(D3D9DeviceFlag::DirtyFFPixelShader);
 
-      // Used args for a given operation.
-      auto ArgsMask = [](DWORD Op) {
-        switch (Op) {
-          case D3DTOP_DISABLE:
-            return 0b0u; // No Args
-          case D3DTOP_SELECTARG1:
-          case D3DTOP_PREMODULATE:
-            return 0b10u; // Arg 1
-          case D3DTOP_SELECTARG2:
-            return 0b100u; // Arg 2
-          case D3DTOP_MULTIPLYADD:
-          case D3DTOP_LERP:
-            return 0b111u; // Arg 0, 1, 2 
-          default:
-            return 0b110u; // Arg 1, 2
-        }
-      };
+      // Only re-read stages whose state has changed
+      for (uint32_t dirty = m_ffDirtyStages; dirty; dirty &= dirty - 1)
+        UpdateFixedFunctionStage(bit::tzcnt(dirty));
+
+      m_ffDirtyStages = 0;
 
       D3D9FFShaderKeyFS key;
       key.SpecularEnable = m_state.renderStates[D3DRS_SPECULARENABLE];
 
+      // If a stage is disabled or invalid, this
+      // and all subsequent stages get disabled.
       uint32_t idx;
       for (idx = 0; idx < caps::TextureStageCount; idx++) {
-        auto& stage = key.Stages[idx].data;
-        auto& data  = m_state.textureStages[idx];
-
-        // Subsequent stages do not occur if this is true.
-        if (data[D3DTSS_COLOROP] == D3DTOP_DISABLE)
+        if (m_ffInvalidStages & (1u << idx))
           break;
 
-        // If the stage is invalid (ie. no texture bound),
-        // this and all subsequent stages get disabled.
-        if (m_state.textures[idx] == nullptr) {
-          if (((data[D3DTSS_COLORARG0] & D3DTA_SELECTMASK) == D3DTA_TEXTURE && (ArgsMask(data[D3DTSS_COLOROP]) & (1 << 0u)))
-           || ((data[D3DTSS_COLORARG1] & D3DTA_SELECTMASK) == D3DTA_TEXTURE && (ArgsMask(data[D3DTSS_COLOROP]) & (1 << 1u)))
-           || ((data[D3DTSS_COLORARG2] & D3DTA_SELECTMASK) == D3DTA_TEXTURE && (ArgsMask(data[D3DTSS_COLOROP]) & (1 << 2u))))
-            break;
-        }
-
-        stage.ColorOp = data[D3DTSS_COLOROP];
-        stage.AlphaOp = data[D3DTSS_ALPHAOP];
-
-        stage.ColorArg0 = data[D3DTSS_COLORARG0];
-        stage.ColorArg1 = data[D3DTSS_COLORARG1];
-        stage.ColorArg2 = data[D3DTSS_COLORARG2];
-
-        stage.AlphaArg0 = data[D3DTSS_ALPHAARG0];
-        stage.AlphaArg1 = data[D3DTSS_ALPHAARG1];
-        stage.AlphaArg2 = data[D3DTSS_ALPHAARG2];
-
-        const uint32_t samplerOffset = idx * 2;
-        stage.Type         = (m_samplerTypeBitfield >> samplerOffset) & 0xffu;
-        stage.ResultIsTemp = data[D3DTSS_RESULTARG] == D3DTA_TEMP;
-
-        stage.Projected = data[D3DTSS_TEXTURETRANSFORMFLAGS] & D3DTTFF_PROJECTED ? 1 : 0;
+        key.Stages[idx] = m_ffStages[idx];
       }
 
       auto& stage0 = key.Stages[0].data;
@@ -5874,14 +6390,38 @@ namespace dxvk {
       if (idx >= 1)
         key.Stages[idx - 1].data.ResultIsTemp = false;
 
-      EmitCs([
-        this,
-        cKey     = key,
-       &cShaders = m_ffModules
-      ](DxvkContext* ctx) {
-        auto shader = cShaders.GetShaderModule(this, cKey);
-        ctx->bindShader(VK_SHADER_STAGE_FRAGMENT_BIT, shader.GetShader());
-      });
+      bool isBound = m_ffBoundPS && key == m_ffBoundKeyFS;
+
+      if (!isBound) {
+        m_ffBoundKeyFS = key;
+        m_ffBoundPS    = true;
+
+        if (m_d3d9Options.ffUberShaders) {
+          D3D9FFUberKeyFS uberKey = PackFixedFunctionKey(key);
+
+          if (std::memcmp(&uberKey, &m_ffUberKeyFS, sizeof(uberKey))) {
+            m_ffUberKeyFS = uberKey;
+            m_flags.set(D3D9DeviceFlag::DirtyFFPixelData);
+          }
+
+          Rc<DxvkShader> shader = m_ffModules.GetShaderModuleAsync(this, key, &m_ffPendingPS);
+
+          EmitCs([
+            cShader = std::move(shader)
+          ](DxvkContext* ctx) {
+            ctx->bindShader(VK_SHADER_STAGE_FRAGMENT_BIT, cShader);
+          });
+        } else {
+          EmitCs([
+            this,
+            cKey     = key,
+           &cShaders = m_ffModules
+          ](DxvkContext* ctx) {
+            auto shader = cShaders.GetShaderModule(this, cKey);
+            ctx->bindShader(VK_SHADER_STAGE_FRAGMENT_BIT, shader.GetShader());
+          });
+        }
+      }
     }
 
     // Constants
@@ -5902,10 +6442,100 @@ namespace dxvk {
 
       D3D9FixedFunctionPS* data = reinterpret_cast<D3D9FixedFunctionPS*>(slice.mapPtr);
       DecodeD3DCOLOR((D3DCOLOR)rs[D3DRS_TEXTUREFACTOR], data->textureFactor.data);
+      data->UberKey = m_ffUberKeyFS;
     }
   }
 
 
+  void D3D9DeviceEx::UpdateFixedFunctionStage(uint32_t Stage) {
+    // Used args for a given operation.
+    auto ArgsMask = [](DWORD Op) {
+      switch (Op) {
+        case D3DTOP_DISABLE:
+          return 0b0u; // No Args
+        case D3DTOP_SELECTARG1:
+        case D3DTOP_PREMODULATE:
+          return 0b10u; // Arg 1
+        case D3DTOP_SELECTARG2:
+          return 0b100u; // Arg 2
+        case D3DTOP_MULTIPLYADD:
+        case D3DTOP_LERP:
+          return 0b111u; // Arg 0, 1, 2 
+        default:
+          return 0b110u; // Arg 1, 2
+      }
+    };
+
+    auto& data  = m_state.textureStages[Stage];
+    auto& stage = m_ffStages[Stage].data;
+
+    // memcmp safety
+    std::memset(&m_ffStages[Stage], 0, sizeof(D3D9FFShaderStage));
+
+    // Subsequent stages do not occur if this is true.
+    bool invalid = data[D3DTSS_COLOROP] == D3DTOP_DISABLE;
+
+    // If the stage is invalid (ie. no texture bound),
+    // this and all subsequent stages get disabled.
+    if (m_state.textures[Stage] == nullptr) {
+      invalid |= ((data[D3DTSS_COLORARG0] & D3DTA_SELECTMASK) == D3DTA_TEXTURE && (ArgsMask(data[D3DTSS_COLOROP]) & (1 << 0u)))
+              || ((data[D3DTSS_COLORARG1] & D3DTA_SELECTMASK) == D3DTA_TEXTURE && (ArgsMask(data[D3DTSS_COLOROP]) & (1 << 1u)))
+              || ((data[D3DTSS_COLORARG2] & D3DTA_SELECTMASK) == D3DTA_TEXTURE && (ArgsMask(data[D3DTSS_COLOROP]) & (1 << 2u)));
+    }
+
+    if (invalid)
+      m_ffInvalidStages |= 1u << Stage;
+    else
+      m_ffInvalidStages &= ~(1u << Stage);
+
+    stage.ColorOp = data[D3DTSS_COLOROP];
+    stage.AlphaOp = data[D3DTSS_ALPHAOP];
+
+    stage.ColorArg0 = data[D3DTSS_COLORARG0];
+    stage.ColorArg1 = data[D3DTSS_COLORARG1];
+    stage.ColorArg2 = data[D3DTSS_COLORARG2];
+
+    stage.AlphaArg0 = data[D3DTSS_ALPHAARG0];
+    stage.AlphaArg1 = data[D3DTSS_ALPHAARG1];
+    stage.AlphaArg2 = data[D3DTSS_ALPHAARG2];
+
+    const uint32_t samplerOffset = Stage * 2;
+    stage.Type         = (m_samplerTypeBitfield >> samplerOffset) & 0xffu;
+    stage.ResultIsTemp = data[D3DTSS_RESULTARG] == D3DTA_TEMP;
+
+    stage.Projected = data[D3DTSS_TEXTURETRANSFORMFLAGS] & D3DTTFF_PROJECTED ? 1 : 0;
+  }
+
+
+  void D3D9DeviceEx::ResetFixedFunctionKeys() {
+    auto& rs = m_state.renderStates;
+
+    m_ffKeyVS = D3D9FFShaderKeyVS();
+
+    if (m_state.vertexDecl != nullptr) {
+      m_ffKeyVS.HasPositionT = m_state.vertexDecl->TestFlag(D3D9VertexDeclFlag::HasPositionT);
+      m_ffKeyVS.HasColor0    = m_state.vertexDecl->TestFlag(D3D9VertexDeclFlag::HasColor0);
+      m_ffKeyVS.HasColor1    = m_state.vertexDecl->TestFlag(D3D9VertexDeclFlag::HasColor1);
+    }
+
+    m_ffKeyVS.NormalizeNormals = rs[D3DRS_NORMALIZENORMALS] != FALSE;
+    m_ffKeyVS.RangeFog         = rs[D3DRS_RANGEFOGENABLE]   != FALSE;
+
+    for (uint32_t i = 0; i < caps::TextureStageCount; i++) {
+      m_ffKeyVS.TransformFlags[i]  = m_state.textureStages[i][D3DTSS_TEXTURETRANSFORMFLAGS] & ~(D3DTTFF_PROJECTED);
+      m_ffKeyVS.TexcoordIndices[i] = m_state.textureStages[i][D3DTSS_TEXCOORDINDEX];
+    }
+
+    m_ffDirtyStages = (1u << caps::TextureStageCount) - 1;
+
+    m_ffBoundVS = false;
+    m_ffBoundPS = false;
+
+    m_flags.set(D3D9DeviceFlag::DirtyFFVertexShader);
+    m_flags.set(D3D9DeviceFlag::DirtyFFPixelShader);
+  }
+
+
   bool D3D9DeviceEx::UseProgrammableVS() {
     return m_state.vertexShader != nullptr
       && m_state.vertexDecl != nullptr
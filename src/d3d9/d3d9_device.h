@@ -11,6 +11,7 @@
 #include "d3d9_constant_set.h"
 
 #include "d3d9_state.h"
+#include "d3d9_spec_constants.h"
 
 #include "d3d9_options.h"
 
@@ -62,6 +63,7 @@ namespace dxvk {
     DirtyFFViewport,
     DirtyFFPixelData,
     DirtyProgVertexShader,
+    DirtyProgPixelShader,
     DirtySharedPixelShaderData,
     UpDirtiedVertices,
     UpDirtiedIndices,
@@ -76,6 +78,23 @@ namespace dxvk {
     uint32_t instanceCount;
   };
 
+  /**
+   * \brief Draw pending for merging
+   *
+   * Accumulates consecutive list draws with adjacent
+   * ranges until a different draw or any other command
+   * is emitted. \c first is the first vertex for regular
+   * draws, or the first index for indexed draws.
+   */
+  struct D3D9MergedDraw {
+    D3DPRIMITIVETYPE primitiveType  = D3DPRIMITIVETYPE(0);
+    bool             indexed        = false;
+    uint32_t         first          = 0;
+    int32_t          baseVertex     = 0;
+    uint32_t         primitiveCount = 0;
+    uint32_t         drawCount      = 0;
+  };
+
   struct D3D9SamplerPair {
     Rc<DxvkSampler> color;
     Rc<DxvkSampler> depth;
@@ -631,6 +650,43 @@ namespace dxvk {
 
     HRESULT SetStateTransform(uint32_t idx, const D3DMATRIX* pMatrix);
 
+    /**
+     * \brief Sets multiple render states
+     *
+     * Used to apply state blocks. Copies the selected
+     * values and raises the dirty flags of all changed
+     * states once, rather than once per state.
+     * \param [in] Mask Render states to set
+     * \param [in] pValues Values for all render states
+     */
+    void SetRenderStates(
+      const bit::bitset<RenderStateCount>& Mask,
+      const DWORD*                         pValues);
+
+    /**
+     * \brief Sets multiple sampler states of a sampler
+     *
+     * \param [in] StateSampler Sampler index
+     * \param [in] Mask Sampler states to set
+     * \param [in] pValues Values for all sampler states
+     */
+    void SetStateSamplerStates(
+            DWORD               StateSampler,
+            uint32_t            Mask,
+      const DWORD*              pValues);
+
+    /**
+     * \brief Sets multiple texture stage states of a stage
+     *
+     * \param [in] Stage Texture stage index
+     * \param [in] Mask Texture stage states to set
+     * \param [in] pValues Values for all stage states
+     */
+    void SetTextureStageStates(
+            DWORD               Stage,
+            uint32_t            Mask,
+      const DWORD*              pValues);
+
     VkPipelineStageFlags GetEnabledShaderStages() const {
       return m_dxvkDevice->getShaderPipelineStages();
     }
@@ -732,6 +788,25 @@ namespace dxvk {
       return m_amdATOC || (m_nvATOC && alphaTest);
     }
 
+    /**
+     * \brief Updates state derived from a render state
+     *
+     * Must be called after a render state has changed.
+     * Dirty flags are added to \c Dirty rather than set
+     * on the device so that callers can batch them.
+     * \param [in] State The render state
+     * \param [in] Value The new value
+     * \param [in] OldATOC Previous alpha to coverage state
+     * \param [in] OldNVDB Previous depth bounds hack state
+     * \param [out] Dirty Dirty flags to set
+     */
+    void UpdateRenderState(
+            D3DRENDERSTATETYPE  State,
+            DWORD               Value,
+            bool                OldATOC,
+            bool                OldNVDB,
+            D3D9DeviceFlags&    Dirty);
+
     void BindMultiSampleState();
     
     void BindBlendState();
@@ -745,6 +820,13 @@ namespace dxvk {
     void BindRasterizerState();
 
     void BindAlphaTestState();
+
+    void BindFogState(
+            bool                              Enabled,
+            D3DFOGMODE                        VertexMode,
+            D3DFOGMODE                        PixelMode);
+
+    void UpdateSpecStateChurn();
     
     template <DxsoProgramType ShaderStage>
     void UploadConstants();
@@ -774,10 +856,46 @@ namespace dxvk {
 
     void PrepareDraw(bool up = false);
 
+    /**
+     * \brief Checks whether constants can stay in place
+     *
+     * Never waits for shader translation. If either shader
+     * is still being translated, this conservatively fails.
+     * \param [in] pOldShader Previously set shader
+     * \param [in] pNewShader Newly set shader
+     * \returns \c true if the constant buffer contents
+     *    written for the old shader work for the new one
+     */
+    bool ConstantLayoutsCompatible(
+      const D3D9CommonShader*                 pOldShader,
+      const D3D9CommonShader*                 pNewShader);
+
+    /**
+     * \brief Checks for shaders that failed to translate
+     *
+     * These do not provide a shader object, so draws using
+     * them must be skipped. The failure itself is already
+     * logged when the shader gets bound.
+     * \returns \c true if a bound shader is unusable
+     */
+    bool HasFailedShaders();
+
+    bool MergeDraw(
+            D3DPRIMITIVETYPE                  PrimitiveType,
+            bool                              Indexed,
+            UINT                              First,
+            INT                               BaseVertex,
+            UINT                              PrimitiveCount);
+
+    void EmitMergedDraw();
+
     void BindShader(
             DxsoProgramType                   ShaderStage,
       const D3D9CommonShader*                 pShaderModule);
 
+    template <DxsoProgramType ShaderStage>
+    void BindSpecializedShader();
+
     void BindInputLayout();
 
     void BindVertexBuffer(
@@ -836,6 +954,13 @@ namespace dxvk {
     uint32_t                        m_frameLatencyCap;
     uint32_t                        m_frameLatency;
     uint32_t                        m_frameId = 0;
+
+    // Tracks how often spec constant render states change,
+    // so that frequently changing ones can use push constants
+    std::array<D3D9SpecStateChurn,
+      uint32_t(D3D9SpecStateGroup::Count)> m_specChurn;
+    uint32_t                        m_specChurnFrameId = 0;
+    D3D9MergedDraw                  m_mergedDraw;
     std::array<Rc<sync::Signal>,
       MaxFrameLatency>              m_frameEvents;
 
@@ -844,6 +969,26 @@ namespace dxvk {
     DxvkCsChunkRef                  m_csChunk;
 
     D3D9FFShaderModuleSet           m_ffModules;
+    Rc<DxvkShaderCompileJob>        m_ffPendingVS;
+    Rc<DxvkShaderCompileJob>        m_ffPendingPS;
+    D3D9FFUberKeyVS                 m_ffUberKeyVS = { };
+    D3D9FFUberKeyFS                 m_ffUberKeyFS = { };
+
+    // Fixed-function shader keys. Fields that only depend on
+    // a single state are written by the state setters, and
+    // texture stages are re-read only when they are dirty.
+    D3D9FFShaderKeyVS               m_ffKeyVS;
+    std::array<D3D9FFShaderStage,
+      caps::TextureStageCount>      m_ffStages;
+    uint32_t                        m_ffDirtyStages   = 0;
+    uint32_t                        m_ffInvalidStages = 0;
+
+    // Keys of the currently bound fixed-function shaders,
+    // used to skip redundant lookups and shader binds.
+    D3D9FFShaderKeyVS               m_ffBoundKeyVS;
+    D3D9FFShaderKeyFS               m_ffBoundKeyFS;
+    bool                            m_ffBoundVS = false;
+    bool                            m_ffBoundPS = false;
     D3D9SWVPEmulator                m_swvpEmulator;
 
     DxvkCsChunkRef AllocCsChunk() {
@@ -853,6 +998,10 @@ namespace dxvk {
 
     template<typename Cmd>
     void EmitCs(Cmd&& command) {
+      // Any command may depend on the pending draw
+      if (unlikely(m_mergedDraw.drawCount))
+        EmitMergedDraw();
+
       if (unlikely(!m_csChunk->push(command))) {
         EmitCsChunk(std::move(m_csChunk));
 
@@ -864,6 +1013,9 @@ namespace dxvk {
     void EmitCsChunk(DxvkCsChunkRef&& chunk);
 
     void FlushCsChunk() {
+      if (unlikely(m_mergedDraw.drawCount))
+        EmitMergedDraw();
+
       if (likely(!m_csChunk->empty())) {
         EmitCsChunk(std::move(m_csChunk));
         m_csChunk = AllocCsChunk();
@@ -883,6 +1035,11 @@ namespace dxvk {
 
     D3D9ConstantSets                m_consts[DxsoProgramTypes::Count];
 
+    // Programmable shaders that are currently bound, which
+    // may be variants specialized for int and bool constants.
+    Rc<DxvkShader>                  m_progShaders[DxsoProgramTypes::Count];
+    bool                            m_progSpecDirty[DxsoProgramTypes::Count] = { };
+
     Rc<DxvkBuffer>                  m_vsClipPlanes;
 
     Rc<DxvkBuffer>                  m_vsFixedFunction;
@@ -1032,6 +1189,10 @@ namespace dxvk {
 
     void UpdateFixedFunctionPS();
 
+    void UpdateFixedFunctionStage(uint32_t Stage);
+
+    void ResetFixedFunctionKeys();
+
     void ApplyPrimitiveType(
       DxvkContext*      pContext,
       D3DPRIMITIVETYPE  PrimType);
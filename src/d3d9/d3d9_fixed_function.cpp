@@ -7,6 +7,7 @@
 #include "../dxvk/dxvk_spec_const.h"
 
 #include "../spirv/spirv_module.h"
+#include "../spirv/spirv_optimizer.h"
 
 namespace dxvk {
 
@@ -35,20 +36,40 @@ namespace dxvk {
     uint32_t fogDensity = spvModule.opLoad(floatType,
       spvModule.opAccessChain(floatPtr, fogCtx.RenderState, 1, &fogDensityMember));
 
-    uint32_t fogMode = spvModule.specConst32(uint32Type, 0);
+    uint32_t fogModeSpec = spvModule.specConst32(uint32Type, 0);
 
     if (!fogCtx.IsPixel) {
-      spvModule.setDebugName(fogMode, "vertex_fog_mode");
-      spvModule.decorateSpecId(fogMode, getSpecId(D3D9SpecConstantId::VertexFogMode));
+      spvModule.setDebugName(fogModeSpec, "vertex_fog_mode");
+      spvModule.decorateSpecId(fogModeSpec, getSpecId(D3D9SpecConstantId::VertexFogMode));
     }
     else {
-      spvModule.setDebugName(fogMode, "pixel_fog_mode");
-      spvModule.decorateSpecId(fogMode, getSpecId(D3D9SpecConstantId::PixelFogMode));
+      spvModule.setDebugName(fogModeSpec, "pixel_fog_mode");
+      spvModule.decorateSpecId(fogModeSpec, getSpecId(D3D9SpecConstantId::PixelFogMode));
     }
 
-    uint32_t fogEnabled = spvModule.specConstBool(false);
-    spvModule.setDebugName(fogEnabled, "fog_enabled");
-    spvModule.decorateSpecId(fogEnabled, getSpecId(D3D9SpecConstantId::FogEnabled));
+    uint32_t fogEnabledSpec = spvModule.specConstBool(false);
+    spvModule.setDebugName(fogEnabledSpec, "fog_enabled");
+    spvModule.decorateSpecId(fogEnabledSpec, getSpecId(D3D9SpecConstantId::FogEnabled));
+
+    uint32_t fogMode    = fogModeSpec;
+    uint32_t fogEnabled = fogEnabledSpec;
+
+    if (fogCtx.DynamicSpecConstants) {
+      // If the fog mode is dynamic, so is the enable bit
+      fogMode = DoDynamicSpecConstant(spvModule, fogCtx.RenderState, fogModeSpec,
+        fogCtx.IsPixel ? D3D9RenderStateItem::PixelFogMode : D3D9RenderStateItem::VertexFogMode);
+
+      uint32_t fogEnabledMember = spvModule.constu32(uint32_t(D3D9RenderStateItem::FogEnabled));
+      uint32_t fogEnabledDynamic = spvModule.opINotEqual(boolType,
+        spvModule.opLoad(uint32Type, spvModule.opAccessChain(
+          spvModule.defPointerType(uint32Type, spv::StorageClassPushConstant),
+          fogCtx.RenderState, 1, &fogEnabledMember)),
+        spvModule.constu32(0));
+
+      fogEnabled = spvModule.opSelect(boolType,
+        spvModule.opIEqual(boolType, fogModeSpec, spvModule.constu32(D3D9SpecConstantDynamic)),
+        fogEnabledDynamic, fogEnabledSpec);
+    }
 
     uint32_t doFog   = spvModule.allocateId();
     uint32_t skipFog = spvModule.allocateId();
@@ -75,13 +96,22 @@ namespace dxvk {
     if (fogCtx.IsPixel)
       depth = spvModule.opFMul(floatType, z, spvModule.opFDiv(floatType, spvModule.constf32(1.0f), w));
     else {
-      if (fogCtx.RangeFog) {
+      uint32_t rangeDepth = 0;
+      uint32_t planeDepth = 0;
+
+      if (fogCtx.RangeFog || fogCtx.RangeFogId) {
         std::array<uint32_t, 3> indices = { 0, 1, 2 };
         uint32_t pos3 = spvModule.opVectorShuffle(vec3Type, fogCtx.vPos, fogCtx.vPos, indices.size(), indices.data());
-        depth = spvModule.opLength(floatType, pos3);
+        rangeDepth = spvModule.opLength(floatType, pos3);
       }
+
+      if (!fogCtx.RangeFog || fogCtx.RangeFogId)
+        planeDepth = spvModule.opFAbs(floatType, z);
+
+      if (fogCtx.RangeFogId)
+        depth = spvModule.opSelect(floatType, fogCtx.RangeFogId, rangeDepth, planeDepth);
       else
-        depth = spvModule.opFAbs(floatType, z);
+        depth = fogCtx.RangeFog ? rangeDepth : planeDepth;
     }
 
     uint32_t applyFogFactor = spvModule.allocateId();
@@ -179,6 +209,23 @@ namespace dxvk {
     return spvModule.opLoad(returnType, returnValuePtr);
   }
 
+
+  uint32_t DoDynamicSpecConstant(SpirvModule& spvModule, uint32_t renderState, uint32_t specConst, D3D9RenderStateItem item) {
+    uint32_t boolType   = spvModule.defBoolType();
+    uint32_t uint32Type = spvModule.defIntType(32, 0);
+    uint32_t uint32Ptr  = spvModule.defPointerType(uint32Type, spv::StorageClassPushConstant);
+
+    uint32_t member = spvModule.constu32(uint32_t(item));
+    uint32_t value  = spvModule.opLoad(uint32Type,
+      spvModule.opAccessChain(uint32Ptr, renderState, 1, &member));
+
+    // Drivers fold this once the spec constant is known
+    uint32_t isDynamic = spvModule.opIEqual(boolType,
+      specConst, spvModule.constu32(D3D9SpecConstantDynamic));
+
+    return spvModule.opSelect(uint32Type, isDynamic, value, specConst);
+  }
+
     enum FFConstantMembersVS {
       VSConstWorldViewMatrix   = 0,
       VSConstNormalMatrix    = 1,
@@ -213,6 +260,8 @@ namespace dxvk {
       VSConstMaterialEmissive,
       VSConstMaterialPower,
 
+      VSConstUberKey,
+
       VSConstMemberCount
     };
 
@@ -239,6 +288,13 @@ namespace dxvk {
       uint32_t materialPower = { 0 };
     } constants;
 
+    struct {
+      uint32_t flags = { 0 };
+      uint32_t lightCount = { 0 };
+      uint32_t materialSources = { 0 };
+      uint32_t texcoords[8] = { 0 };
+    } uber;
+
     struct {
       uint32_t POSITION = { 0 };
       uint32_t NORMAL = { 0 };
@@ -258,6 +314,7 @@ namespace dxvk {
 
   enum FFConstantMembersPS {
     PSConstTextureFactor = 0,
+    PSConstUberKey,
 
     PSConstMemberCount
   };
@@ -269,6 +326,16 @@ namespace dxvk {
       uint32_t textureFactor = { 0 };
     } constants;
 
+    struct {
+      uint32_t flags = { 0 };
+
+      struct {
+        uint32_t color = { 0 };
+        uint32_t alpha = { 0 };
+        uint32_t flags = { 0 };
+      } stages[8];
+    } uber;
+
     struct {
       uint32_t TEXCOORD[8] = { 0 };
       uint32_t COLOR[2]    = { 0 };
@@ -294,12 +361,16 @@ namespace dxvk {
     D3D9FFShaderCompiler(
             Rc<DxvkDevice>     Device,
       const D3D9FFShaderKeyVS& Key,
-      const std::string&       Name);
+      const std::string&       Name,
+            bool               DynamicSpecConstants,
+            bool               Uber);
 
     D3D9FFShaderCompiler(
             Rc<DxvkDevice>     Device,
       const D3D9FFShaderKeyFS& Key,
-      const std::string&       Name);
+      const std::string&       Name,
+            bool               DynamicSpecConstants,
+            bool               Uber);
 
     Rc<DxvkShader> compile();
 
@@ -323,6 +394,14 @@ namespace dxvk {
 
     void alphaTestPS();
 
+    void loadUberKey(uint32_t constantBuffer, uint32_t member, uint32_t vectorCount, uint32_t* words);
+
+    uint32_t uberFlag(uint32_t word, uint32_t bit);
+
+    uint32_t uberField(uint32_t word, uint32_t offset, uint32_t count);
+
+    uint32_t select(uint32_t typeId, uint32_t count, uint32_t cond, uint32_t a, uint32_t b);
+
     bool isVS() { return m_programType == DxsoProgramType::VertexShader; }
     bool isPS() { return !isVS(); }
 
@@ -355,25 +434,39 @@ namespace dxvk {
 
     uint32_t              m_rsBlock;
     uint32_t              m_mainFuncLabel;
+
+    bool                  m_optimizeShaders;
+    bool                  m_dynamicSpecConstants;
+    bool                  m_uber;
   };
 
   D3D9FFShaderCompiler::D3D9FFShaderCompiler(
           Rc<DxvkDevice>     Device,
     const D3D9FFShaderKeyVS& Key,
-    const std::string&       Name) {
+    const std::string&       Name,
+          bool               DynamicSpecConstants,
+          bool               Uber) {
     m_programType = DxsoProgramTypes::VertexShader;
     m_vsKey    = Key;
     m_filename = Name;
+    m_optimizeShaders = Device->config().optimizeShaders;
+    m_dynamicSpecConstants = DynamicSpecConstants;
+    m_uber     = Uber;
   }
 
 
   D3D9FFShaderCompiler::D3D9FFShaderCompiler(
           Rc<DxvkDevice>     Device,
     const D3D9FFShaderKeyFS& Key,
-    const std::string& Name) {
+    const std::string& Name,
+          bool               DynamicSpecConstants,
+          bool               Uber) {
     m_programType = DxsoProgramTypes::PixelShader;
     m_fsKey    = Key;
     m_filename = Name;
+    m_optimizeShaders = Device->config().optimizeShaders;
+    m_dynamicSpecConstants = DynamicSpecConstants;
+    m_uber     = Uber;
   }
 
 
@@ -429,13 +522,18 @@ namespace dxvk {
 
     DxvkShaderConstData constData = { };
 
+    SpirvCodeBuffer code = m_module.compile();
+
+    if (m_optimizeShaders)
+      code = SpirvOptimizer::optimize(std::move(code));
+
     // Create the shader module object
     return new DxvkShader(
       isVS() ? VK_SHADER_STAGE_VERTEX_BIT : VK_SHADER_STAGE_FRAGMENT_BIT,
       m_resourceSlots.size(),
       m_resourceSlots.data(),
       m_interfaceSlots,
-      m_module.compile(),
+      std::move(code),
       shaderOptions,
       std::move(constData));
   }
@@ -493,6 +591,51 @@ namespace dxvk {
   }
 
 
+  void D3D9FFShaderCompiler::loadUberKey(
+          uint32_t                constantBuffer,
+          uint32_t                member,
+          uint32_t                vectorCount,
+          uint32_t*               words) {
+    uint32_t uvec4Type = m_module.defVectorType(m_uint32Type, 4);
+    uint32_t uvec4Ptr  = m_module.defPointerType(uvec4Type, spv::StorageClassUniform);
+
+    for (uint32_t i = 0; i < vectorCount; i++) {
+      std::array<uint32_t, 2> chain = { m_module.constu32(member), m_module.constu32(i) };
+
+      uint32_t vector = m_module.opLoad(uvec4Type,
+        m_module.opAccessChain(uvec4Ptr, constantBuffer, chain.size(), chain.data()));
+
+      for (uint32_t j = 0; j < 4; j++)
+        words[4 * i + j] = m_module.opCompositeExtract(m_uint32Type, vector, 1, &j);
+    }
+  }
+
+
+  uint32_t D3D9FFShaderCompiler::uberFlag(uint32_t word, uint32_t bit) {
+    uint32_t masked = m_module.opBitwiseAnd(m_uint32Type, word, m_module.constu32(1u << bit));
+    return m_module.opINotEqual(m_module.defBoolType(), masked, m_module.constu32(0));
+  }
+
+
+  uint32_t D3D9FFShaderCompiler::uberField(uint32_t word, uint32_t offset, uint32_t count) {
+    return m_module.opBitFieldUExtract(m_uint32Type, word,
+      m_module.constu32(offset), m_module.constu32(count));
+  }
+
+
+  uint32_t D3D9FFShaderCompiler::select(uint32_t typeId, uint32_t count, uint32_t cond, uint32_t a, uint32_t b) {
+    // OpSelect needs a vector condition for vector operands
+    if (count > 1) {
+      std::array<uint32_t, 4> conds = { cond, cond, cond, cond };
+      cond = m_module.opCompositeConstruct(
+        m_module.defVectorType(m_module.defBoolType(), count),
+        count, conds.data());
+    }
+
+    return m_module.opSelect(typeId, cond, a, b);
+  }
+
+
   void D3D9FFShaderCompiler::compileVS() {
     setupVS();
 
@@ -504,7 +647,14 @@ namespace dxvk {
 
     const uint32_t wIndex = 3;
 
-    if (!m_vsKey.HasPositionT) {
+    // Uber shaders compute both the transformed and the
+    // pre-transformed path and select one at runtime.
+    uint32_t hasPositionT = 0;
+
+    if (m_uber)
+      hasPositionT = uberFlag(m_vs.uber.flags, uint32_t(D3D9FFUberFlagVS::HasPositionT));
+
+    if (m_uber || !m_vsKey.HasPositionT) {
       uint32_t wv = m_vs.constants.worldview;
       uint32_t nrmMtx = m_vs.constants.normal;
 
@@ -515,25 +665,42 @@ namespace dxvk {
       }
       nrmMtx = m_module.opCompositeConstruct(m_mat3Type, mtxIndices.size(), mtxIndices.data());
 
-      normal = m_module.opMatrixTimesVector(m_vec3Type, nrmMtx, normal);
+      uint32_t xfNormal = m_module.opMatrixTimesVector(m_vec3Type, nrmMtx, normal);
 
       // Some games rely no normals not being normal.
-      if (m_vsKey.NormalizeNormals) {
+      if (m_uber || m_vsKey.NormalizeNormals) {
         uint32_t bool_t = m_module.defBoolType();
         uint32_t bool3_t = m_module.defVectorType(bool_t, 3);
 
-        uint32_t isZeroNormal = m_module.opAll(bool_t, m_module.opFOrdEqual(bool3_t, normal, m_module.constvec3f32(0.0f, 0.0f, 0.0f)));
+        uint32_t isZeroNormal = m_module.opAll(bool_t, m_module.opFOrdEqual(bool3_t, xfNormal, m_module.constvec3f32(0.0f, 0.0f, 0.0f)));
 
         std::array<uint32_t, 3> members = { isZeroNormal, isZeroNormal, isZeroNormal };
         uint32_t isZeroNormal3 = m_module.opCompositeConstruct(bool3_t, members.size(), members.data());
 
-        normal = m_module.opNormalize(m_vec3Type, normal);
-        normal = m_module.opSelect(m_vec3Type, isZeroNormal3, m_module.constvec3f32(0.0f, 0.0f, 0.0f), normal);
+        uint32_t normalized = m_module.opNormalize(m_vec3Type, xfNormal);
+        normalized = m_module.opSelect(m_vec3Type, isZeroNormal3, m_module.constvec3f32(0.0f, 0.0f, 0.0f), normalized);
+
+        xfNormal = m_uber
+          ? select(m_vec3Type, 3, uberFlag(m_vs.uber.flags, uint32_t(D3D9FFUberFlagVS::NormalizeNormals)), normalized, xfNormal)
+          : normalized;
       }
 
-      vtx         = m_module.opVectorTimesMatrix(m_vec4Type, vtx, wv);
-      gl_Position = m_module.opVectorTimesMatrix(m_vec4Type, vtx, m_vs.constants.proj);
-    } else {
+      uint32_t xfVtx = m_module.opVectorTimesMatrix(m_vec4Type, vtx, wv);
+      gl_Position = m_module.opVectorTimesMatrix(m_vec4Type, xfVtx, m_vs.constants.proj);
+
+      if (m_uber) {
+        normal = select(m_vec3Type, 3, hasPositionT, normal, xfNormal);
+        vtx    = select(m_vec4Type, 4, hasPositionT, vtx,    xfVtx);
+      } else {
+        normal = xfNormal;
+        vtx    = xfVtx;
+      }
+    }
+
+    if (m_uber || m_vsKey.HasPositionT) {
+      uint32_t xfPosition = gl_Position;
+      gl_Position = m_vs.in.POSITION;
+
       gl_Position = m_module.opFMul(m_vec4Type, gl_Position, m_vs.constants.invExtent);
       gl_Position = m_module.opFAdd(m_vec4Type, gl_Position, m_vs.constants.invOffset);
 
@@ -546,6 +713,9 @@ namespace dxvk {
       uint32_t rhw = m_module.opFDiv             (m_floatType, m_module.constf32(1.0f), w);   // rhw = 1.0f / w
       gl_Position  = m_module.opVectorTimesScalar(m_vec4Type,  gl_Position, rhw);             // gl_Position.xyz *= rhw
       gl_Position  = m_module.opCompositeInsert  (m_vec4Type,  rhw, gl_Position, 1, &wIndex); // gl_Position.w = rhw
+
+      if (m_uber)
+        gl_Position = select(m_vec4Type, 4, hasPositionT, gl_Position, xfPosition);
     }
 
     m_module.opStore(m_vs.out.POSITION, gl_Position);
@@ -559,7 +729,118 @@ namespace dxvk {
 
     m_module.opStore(m_vs.out.NORMAL, outNrm);
 
+    auto CameraSpacePosition = [&] () {
+      return m_module.opCompositeInsert(m_vec4Type, m_module.constf32(1.0f), vtx, 1, &wIndex);
+    };
+
+    auto CameraSpaceReflection = [&] () {
+      uint32_t vtx3 = m_module.opVectorShuffle(m_vec3Type, vtx, vtx, 3, indices.data());
+      vtx3 = m_module.opNormalize(m_vec3Type, vtx3);
+
+      uint32_t reflection = m_module.opReflect(m_vec3Type, vtx3, normal);
+
+      std::array<uint32_t, 4> transformIndices;
+      for (uint32_t i = 0; i < 3; i++)
+        transformIndices[i] = m_module.opCompositeExtract(m_floatType, reflection, 1, &i);
+      transformIndices[3] = m_module.constf32(1.0f);
+
+      return m_module.opCompositeConstruct(m_vec4Type, transformIndices.size(), transformIndices.data());
+    };
+
+    auto SphereMap = [&] () {
+      uint32_t vtx3 = m_module.opVectorShuffle(m_vec3Type, vtx, vtx, 3, indices.data());
+      vtx3 = m_module.opNormalize(m_vec3Type, vtx3);
+
+      uint32_t reflection = m_module.opReflect(m_vec3Type, vtx3, normal);
+      uint32_t m = m_module.opFAdd(m_vec3Type, reflection, m_module.constvec3f32(0, 0, 1));
+      m = m_module.opLength(m_floatType, m);
+      m = m_module.opFMul(m_floatType, m, m_module.constf32(2.0f));
+
+      std::array<uint32_t, 4> transformIndices;
+      for (uint32_t i = 0; i < 2; i++) {
+        transformIndices[i] = m_module.opCompositeExtract(m_floatType, reflection, 1, &i);
+        transformIndices[i] = m_module.opFDiv(m_floatType, transformIndices[i], m);
+        transformIndices[i] = m_module.opFAdd(m_floatType, transformIndices[i], m_module.constf32(0.5f));
+      }
+
+      transformIndices[2] = m_module.constf32(0.0f);
+      transformIndices[3] = m_module.constf32(1.0f);
+
+      return m_module.opCompositeConstruct(m_vec4Type, transformIndices.size(), transformIndices.data());
+    };
+
+    // Generated texture coordinates do not depend on the
+    // stage, so uber shaders compute each of them once.
+    // Indexed by the generation mode, i.e. D3DTSS_TCI_* >> 16.
+    std::array<uint32_t, 5> generatedTexcoords = { };
+
+    if (m_uber) {
+      generatedTexcoords[D3DTSS_TCI_CAMERASPACENORMAL >> 16]            = outNrm;
+      generatedTexcoords[D3DTSS_TCI_CAMERASPACEPOSITION >> 16]          = CameraSpacePosition();
+      generatedTexcoords[D3DTSS_TCI_CAMERASPACEREFLECTIONVECTOR >> 16]  = CameraSpaceReflection();
+      generatedTexcoords[D3DTSS_TCI_SPHEREMAP >> 16]                    = SphereMap();
+    }
+
+    auto UberTexcoord = [&] (uint32_t i) {
+      uint32_t boolType  = m_module.defBoolType();
+      uint32_t uvec4Type = m_module.defVectorType(m_uint32Type, 4);
+      uint32_t bvec4Type = m_module.defVectorType(boolType, 4);
+
+      uint32_t index = uberField(m_vs.uber.texcoords[i], 0,  8);
+      uint32_t mode  = uberField(m_vs.uber.texcoords[i], 8,  8);
+      uint32_t flags = uberField(m_vs.uber.texcoords[i], 16, 8);
+
+      uint32_t transformed = m_vs.in.TEXCOORD[0];
+
+      for (uint32_t j = 1; j < caps::TextureStageCount; j++) {
+        transformed = select(m_vec4Type, 4,
+          m_module.opIEqual(boolType, index, m_module.constu32(j)),
+          m_vs.in.TEXCOORD[j], transformed);
+      }
+
+      for (uint32_t j = 1; j < generatedTexcoords.size(); j++) {
+        transformed = select(m_vec4Type, 4,
+          m_module.opIEqual(boolType, mode, m_module.constu32(j)),
+          generatedTexcoords[j], transformed);
+      }
+
+      // Generated coordinates always use four components
+      uint32_t isGenerated = m_module.opULessThan(boolType,
+        m_module.opISub(m_uint32Type, mode, m_module.constu32(1)),
+        m_module.constu32(generatedTexcoords.size() - 1));
+
+      uint32_t count = m_module.opSelect(m_uint32Type, isGenerated, m_module.constu32(4), flags);
+
+      std::array<uint32_t, 4> counts = { count, count, count, count };
+      uint32_t padMask = m_module.opUGreaterThanEqual(bvec4Type,
+        m_module.constvec4u32(0, 1, 2, 3),
+        m_module.opCompositeConstruct(uvec4Type, counts.size(), counts.data()));
+
+      uint32_t result = m_module.opSelect(m_vec4Type, padMask,
+        m_module.constvec4f32(1.0f, 1.0f, 1.0f, 1.0f), transformed);
+      result = m_module.opVectorTimesMatrix(m_vec4Type, result, m_vs.constants.texcoord[i]);
+      result = select(m_vec4Type, 4, hasPositionT, transformed, result);
+
+      // Pad the unused section of it with the value for projection.
+      uint32_t lastIdx = m_module.opBitwiseAnd(m_uint32Type,
+        m_module.opISub(m_uint32Type, count, m_module.constu32(1)),
+        m_module.constu32(3));
+      uint32_t projValue = m_module.opVectorExtractDynamic(m_floatType, result, lastIdx);
+
+      std::array<uint32_t, 4> projValues = { projValue, projValue, projValue, projValue };
+      result = m_module.opSelect(m_vec4Type, padMask,
+        m_module.opCompositeConstruct(m_vec4Type, projValues.size(), projValues.data()), result);
+
+      uint32_t isTransformed = m_module.opINotEqual(boolType, flags, m_module.constu32(D3DTTFF_DISABLE));
+      return select(m_vec4Type, 4, isTransformed, result, transformed);
+    };
+
     for (uint32_t i = 0; i < caps::TextureStageCount; i++) {
+      if (m_uber) {
+        m_module.opStore(m_vs.out.TEXCOORD[i], UberTexcoord(i));
+        continue;
+      }
+
       uint32_t inputIndex  = m_vsKey.TexcoordIndices[i];
 
       uint32_t transformed;
@@ -579,49 +860,19 @@ namespace dxvk {
           break;
 
         case D3DTSS_TCI_CAMERASPACEPOSITION:
-          transformed = m_module.opCompositeInsert(m_vec4Type, m_module.constf32(1.0f), vtx, 1, &wIndex);
+          transformed = CameraSpacePosition();
           count = 4;
           break;
 
-        case D3DTSS_TCI_CAMERASPACEREFLECTIONVECTOR: {
-          uint32_t vtx3 = m_module.opVectorShuffle(m_vec3Type, vtx, vtx, 3, indices.data());
-          vtx3 = m_module.opNormalize(m_vec3Type, vtx3);
-          
-          uint32_t reflection = m_module.opReflect(m_vec3Type, vtx3, normal);
-
-          std::array<uint32_t, 4> transformIndices;
-          for (uint32_t i = 0; i < 3; i++)
-            transformIndices[i] = m_module.opCompositeExtract(m_floatType, reflection, 1, &i);
-          transformIndices[3] = m_module.constf32(1.0f);
-
-          transformed = m_module.opCompositeConstruct(m_vec4Type, transformIndices.size(), transformIndices.data());
+        case D3DTSS_TCI_CAMERASPACEREFLECTIONVECTOR:
+          transformed = CameraSpaceReflection();
           count = 4;
           break;
-        }
-
-        case D3DTSS_TCI_SPHEREMAP: {
-          uint32_t vtx3 = m_module.opVectorShuffle(m_vec3Type, vtx, vtx, 3, indices.data());
-          vtx3 = m_module.opNormalize(m_vec3Type, vtx3);
 
-          uint32_t reflection = m_module.opReflect(m_vec3Type, vtx3, normal);
-          uint32_t m = m_module.opFAdd(m_vec3Type, reflection, m_module.constvec3f32(0, 0, 1));
-          m = m_module.opLength(m_floatType, m);
-          m = m_module.opFMul(m_floatType, m, m_module.constf32(2.0f));
-
-          std::array<uint32_t, 4> transformIndices;
-          for (uint32_t i = 0; i < 2; i++) {
-            transformIndices[i] = m_module.opCompositeExtract(m_floatType, reflection, 1, &i);
-            transformIndices[i] = m_module.opFDiv(m_floatType, transformIndices[i], m);
-            transformIndices[i] = m_module.opFAdd(m_floatType, transformIndices[i], m_module.constf32(0.5f));
-          }
-
-          transformIndices[2] = m_module.constf32(0.0f);
-          transformIndices[3] = m_module.constf32(1.0f);
-
-          transformed = m_module.opCompositeConstruct(m_vec4Type, transformIndices.size(), transformIndices.data());
+        case D3DTSS_TCI_SPHEREMAP:
+          transformed = SphereMap();
           count = 4;
           break;
-        }
       }
 
       uint32_t type = m_vsKey.TransformFlags[i];
@@ -646,7 +897,24 @@ namespace dxvk {
       m_module.opStore(m_vs.out.TEXCOORD[i], transformed);
     }
 
-    if (m_vsKey.UseLighting) {
+    // Uber shaders branch on the lighting flag at runtime
+    uint32_t litLabel    = 0;
+    uint32_t unlitLabel  = 0;
+    uint32_t endLitLabel = 0;
+
+    if (m_uber) {
+      litLabel    = m_module.allocateId();
+      unlitLabel  = m_module.allocateId();
+      endLitLabel = m_module.allocateId();
+
+      m_module.opSelectionMerge(endLitLabel, spv::SelectionControlMaskNone);
+      m_module.opBranchConditional(
+        uberFlag(m_vs.uber.flags, uint32_t(D3D9FFUberFlagVS::UseLighting)),
+        litLabel, unlitLabel);
+      m_module.opLabel(litLabel);
+    }
+
+    if (m_uber || m_vsKey.UseLighting) {
       auto PickSource = [&](D3DMATERIALCOLORSOURCE Source, uint32_t Material) {
         if (Source == D3DMCS_MATERIAL)
           return Material;
@@ -656,11 +924,64 @@ namespace dxvk {
           return m_vs.in.COLOR[1];
       };
 
+      auto PickSourceUber = [&](uint32_t Index, uint32_t Material) {
+        uint32_t bool_t = m_module.defBoolType();
+        uint32_t source = uberField(m_vs.uber.materialSources, 2 * Index, 2);
+
+        uint32_t color = select(m_vec4Type, 4,
+          m_module.opIEqual(bool_t, source, m_module.constu32(D3DMCS_COLOR1)),
+          m_vs.in.COLOR[0], m_vs.in.COLOR[1]);
+
+        return select(m_vec4Type, 4,
+          m_module.opIEqual(bool_t, source, m_module.constu32(D3DMCS_MATERIAL)),
+          Material, color);
+      };
+
       uint32_t diffuseValue  = m_module.constvec4f32(0.0f, 0.0f, 0.0f, 0.0f);
       uint32_t specularValue = m_module.constvec4f32(0.0f, 0.0f, 0.0f, 0.0f);
       uint32_t ambientValue  = m_module.constvec4f32(0.0f, 0.0f, 0.0f, 0.0f);
 
-      for (uint32_t i = 0; i < m_vsKey.LightCount; i++) {
+      // Uber shaders skip inactive lights, and accumulate
+      // the light colors in private variables instead.
+      uint32_t lightCount  = m_uber ? caps::MaxEnabledLights : m_vsKey.LightCount;
+      uint32_t localViewer = 0;
+
+      uint32_t diffusePtr  = 0;
+      uint32_t specularPtr = 0;
+      uint32_t ambientPtr  = 0;
+
+      if (m_uber) {
+        localViewer = uberFlag(m_vs.uber.flags, uint32_t(D3D9FFUberFlagVS::LocalViewer));
+
+        uint32_t vec4Ptr = m_module.defPointerType(m_vec4Type, spv::StorageClassPrivate);
+        diffusePtr  = m_module.newVar(vec4Ptr, spv::StorageClassPrivate);
+        specularPtr = m_module.newVar(vec4Ptr, spv::StorageClassPrivate);
+        ambientPtr  = m_module.newVar(vec4Ptr, spv::StorageClassPrivate);
+
+        m_module.opStore(diffusePtr,  diffuseValue);
+        m_module.opStore(specularPtr, specularValue);
+        m_module.opStore(ambientPtr,  ambientValue);
+      }
+
+      for (uint32_t i = 0; i < lightCount; i++) {
+        uint32_t endLightLabel = 0;
+
+        if (m_uber) {
+          uint32_t lightLabel = m_module.allocateId();
+          endLightLabel = m_module.allocateId();
+
+          uint32_t isActive = m_module.opULessThan(m_module.defBoolType(),
+            m_module.constu32(i), m_vs.uber.lightCount);
+
+          m_module.opSelectionMerge(endLightLabel, spv::SelectionControlMaskNone);
+          m_module.opBranchConditional(isActive, lightLabel, endLightLabel);
+          m_module.opLabel(lightLabel);
+
+          diffuseValue  = m_module.opLoad(m_vec4Type, diffusePtr);
+          specularValue = m_module.opLoad(m_vec4Type, specularPtr);
+          ambientValue  = m_module.opLoad(m_vec4Type, ambientPtr);
+        }
+
         uint32_t light_ptr_t = m_module.defPointerType(m_vs.lightType, spv::StorageClassUniform);
 
         uint32_t indexVal = m_module.constu32(VSConstLight0 + i);
@@ -740,13 +1061,20 @@ namespace dxvk {
 
         uint32_t diffuseness = m_module.opFMul(m_floatType, hitDot, atten);
 
-        uint32_t mid;
-        if (m_vsKey.LocalViewer) {
-          mid = m_module.opNormalize(m_vec3Type, vtx3);
-          mid = m_module.opFSub(m_vec3Type, hitDir, mid);
+        uint32_t localMid    = 0;
+        uint32_t infiniteMid = 0;
+
+        if (m_uber || m_vsKey.LocalViewer) {
+          localMid = m_module.opNormalize(m_vec3Type, vtx3);
+          localMid = m_module.opFSub(m_vec3Type, hitDir, localMid);
         }
-        else
-          mid = m_module.opFSub(m_vec3Type, hitDir, m_module.constvec3f32(0.0f, 0.0f, 1.0f));
+
+        if (m_uber || !m_vsKey.LocalViewer)
+          infiniteMid = m_module.opFSub(m_vec3Type, hitDir, m_module.constvec3f32(0.0f, 0.0f, 1.0f));
+
+        uint32_t mid = m_uber
+          ? select(m_vec3Type, 3, localViewer, localMid, infiniteMid)
+          : (m_vsKey.LocalViewer ? localMid : infiniteMid);
 
         mid = m_module.opNormalize(m_vec3Type, mid);
 
@@ -764,12 +1092,40 @@ namespace dxvk {
         ambientValue  = m_module.opFAdd(m_vec4Type, ambientValue,  lightAmbient);
         diffuseValue  = m_module.opFAdd(m_vec4Type, diffuseValue,  lightDiffuse);
         specularValue = m_module.opFAdd(m_vec4Type, specularValue, lightSpecular);
+
+        if (m_uber) {
+          m_module.opStore(diffusePtr,  diffuseValue);
+          m_module.opStore(specularPtr, specularValue);
+          m_module.opStore(ambientPtr,  ambientValue);
+
+          m_module.opBranch(endLightLabel);
+          m_module.opLabel(endLightLabel);
+        }
+      }
+
+      if (m_uber) {
+        diffuseValue  = m_module.opLoad(m_vec4Type, diffusePtr);
+        specularValue = m_module.opLoad(m_vec4Type, specularPtr);
+        ambientValue  = m_module.opLoad(m_vec4Type, ambientPtr);
       }
 
-      uint32_t mat_diffuse  = PickSource(m_vsKey.DiffuseSource,  m_vs.constants.materialDiffuse);
-      uint32_t mat_ambient  = PickSource(m_vsKey.AmbientSource,  m_vs.constants.materialAmbient);
-      uint32_t mat_emissive = PickSource(m_vsKey.EmissiveSource, m_vs.constants.materialEmissive);
-      uint32_t mat_specular = PickSource(m_vsKey.SpecularSource, m_vs.constants.materialSpecular);
+      uint32_t mat_diffuse  = 0;
+      uint32_t mat_ambient  = 0;
+      uint32_t mat_emissive = 0;
+      uint32_t mat_specular = 0;
+
+      if (m_uber) {
+        // Same order as the sources in D3D9FFUberKeyVS
+        mat_diffuse  = PickSourceUber(0, m_vs.constants.materialDiffuse);
+        mat_ambient  = PickSourceUber(1, m_vs.constants.materialAmbient);
+        mat_specular = PickSourceUber(2, m_vs.constants.materialSpecular);
+        mat_emissive = PickSourceUber(3, m_vs.constants.materialEmissive);
+      } else {
+        mat_diffuse  = PickSource(m_vsKey.DiffuseSource,  m_vs.constants.materialDiffuse);
+        mat_ambient  = PickSource(m_vsKey.AmbientSource,  m_vs.constants.materialAmbient);
+        mat_emissive = PickSource(m_vsKey.EmissiveSource, m_vs.constants.materialEmissive);
+        mat_specular = PickSource(m_vsKey.SpecularSource, m_vs.constants.materialSpecular);
+      }
       
       std::array<uint32_t, 4> alphaSwizzle = {0, 1, 2, 7};
       uint32_t finalColor0 = m_module.opFFma(m_vec4Type, mat_ambient, m_vs.constants.globalAmbient, mat_emissive);
@@ -791,14 +1147,27 @@ namespace dxvk {
       m_module.opStore(m_vs.out.COLOR[0], finalColor0);
       m_module.opStore(m_vs.out.COLOR[1], finalColor1);
     }
-    else {
+
+    if (m_uber) {
+      m_module.opBranch(endLitLabel);
+      m_module.opLabel(unlitLabel);
+    }
+
+    if (m_uber || !m_vsKey.UseLighting) {
       m_module.opStore(m_vs.out.COLOR[0], m_vs.in.COLOR[0]);
       m_module.opStore(m_vs.out.COLOR[1], m_vs.in.COLOR[1]);
     }
 
+    if (m_uber) {
+      m_module.opBranch(endLitLabel);
+      m_module.opLabel(endLitLabel);
+    }
+
     D3D9FogContext fogCtx;
     fogCtx.IsPixel     = false;
     fogCtx.RangeFog    = m_vsKey.RangeFog;
+    fogCtx.RangeFogId  = m_uber ? uberFlag(m_vs.uber.flags, uint32_t(D3D9FFUberFlagVS::RangeFog)) : 0;
+    fogCtx.DynamicSpecConstants = m_dynamicSpecConstants;
     fogCtx.RenderState = m_rsBlock;
     fogCtx.vPos        = vtx;
     fogCtx.vFog        = m_vs.in.FOG;
@@ -810,12 +1179,16 @@ namespace dxvk {
   void D3D9FFShaderCompiler::setupRenderStateInfo() {
     // TODO: fix duplication of this
 
-    std::array<uint32_t, 5> rsMembers = {{
+    std::array<uint32_t, 9> rsMembers = {{
       m_vec3Type,
       m_floatType,
       m_floatType,
       m_floatType,
-      m_floatType
+      m_floatType,
+      m_uint32Type,
+      m_uint32Type,
+      m_uint32Type,
+      m_uint32Type,
     }};
     
     uint32_t rsStruct = m_module.defStructTypeUnique(rsMembers.size(), rsMembers.data());
@@ -835,6 +1208,14 @@ namespace dxvk {
     m_module.memberDecorateOffset (rsStruct, 3, offsetof(D3D9RenderStateInfo, fogDensity));
     m_module.setDebugMemberName   (rsStruct, 4, "alpha_ref");
     m_module.memberDecorateOffset (rsStruct, 4, offsetof(D3D9RenderStateInfo, alphaRef));
+    m_module.setDebugMemberName   (rsStruct, 5, "alpha_func");
+    m_module.memberDecorateOffset (rsStruct, 5, offsetof(D3D9RenderStateInfo, alphaFunc));
+    m_module.setDebugMemberName   (rsStruct, 6, "fog_enabled");
+    m_module.memberDecorateOffset (rsStruct, 6, offsetof(D3D9RenderStateInfo, fogEnabled));
+    m_module.setDebugMemberName   (rsStruct, 7, "vertex_fog_mode");
+    m_module.memberDecorateOffset (rsStruct, 7, offsetof(D3D9RenderStateInfo, vertexFogMode));
+    m_module.setDebugMemberName   (rsStruct, 8, "pixel_fog_mode");
+    m_module.memberDecorateOffset (rsStruct, 8, offsetof(D3D9RenderStateInfo, pixelFogMode));
     
     m_module.setDebugName         (m_rsBlock, "render_state");
 
@@ -940,6 +1321,10 @@ namespace dxvk {
       m_vec4Type,  // Material Specular
       m_vec4Type,  // Material Emissive
       m_floatType, // Material Power
+
+      m_module.defArrayTypeUnique( // Uber Key
+        m_module.defVectorType(m_uint32Type, 4),
+        m_module.constu32(sizeof(D3D9FFUberKeyVS) / sizeof(Vector4))),
     };
 
     const uint32_t structType =
@@ -972,6 +1357,9 @@ namespace dxvk {
     m_module.memberDecorateOffset(structType, VSConstMaterialPower, offset);
     offset += sizeof(float);
 
+    m_module.decorateArrayStride(members[VSConstUberKey], sizeof(Vector4));
+    m_module.memberDecorateOffset(structType, VSConstUberKey, offsetof(D3D9FixedFunctionVS, UberKey));
+
     m_module.setDebugName(structType, "D3D9FixedFunctionVS");
     uint32_t member = 0;
     m_module.setDebugMemberName(structType, member++, "WorldView");
@@ -1006,6 +1394,7 @@ namespace dxvk {
     m_module.setDebugMemberName(structType, member++, "Material_Specular");
     m_module.setDebugMemberName(structType, member++, "Material_Emissive");
     m_module.setDebugMemberName(structType, member++, "Material_Power");
+    m_module.setDebugMemberName(structType, member++, "UberKey");
 
     m_vs.constantBuffer = m_module.newVar(
       m_module.defPointerType(structType, spv::StorageClassUniform),
@@ -1054,24 +1443,52 @@ namespace dxvk {
     m_vs.constants.materialEmissive = LoadConstant(m_vec4Type,  VSConstMaterialEmissive);
     m_vs.constants.materialPower    = LoadConstant(m_floatType, VSConstMaterialPower);
 
+    if (m_uber) {
+      std::array<uint32_t, sizeof(D3D9FFUberKeyVS) / sizeof(uint32_t)> words;
+      loadUberKey(m_vs.constantBuffer, VSConstUberKey, words.size() / 4, words.data());
+
+      m_vs.uber.flags           = words[offsetof(D3D9FFUberKeyVS, Flags)           / sizeof(uint32_t)];
+      m_vs.uber.lightCount      = words[offsetof(D3D9FFUberKeyVS, LightCount)      / sizeof(uint32_t)];
+      m_vs.uber.materialSources = words[offsetof(D3D9FFUberKeyVS, MaterialSources) / sizeof(uint32_t)];
+
+      for (uint32_t i = 0; i < caps::TextureStageCount; i++)
+        m_vs.uber.texcoords[i]  = words[offsetof(D3D9FFUberKeyVS, Texcoords)       / sizeof(uint32_t) + i];
+    }
+
     // Do IO
     m_vs.in.POSITION = declareIO(true, DxsoSemantic{ DxsoUsage::Position, 0 });
     m_vs.in.NORMAL   = declareIO(true, DxsoSemantic{ DxsoUsage::Normal, 0 });
     for (uint32_t i = 0; i < caps::TextureStageCount; i++)
       m_vs.in.TEXCOORD[i] = declareIO(true, DxsoSemantic{ DxsoUsage::Texcoord, i });
 
-    if (m_vsKey.HasColor0)
-      m_vs.in.COLOR[0] = declareIO(true, DxsoSemantic{ DxsoUsage::Color, 0 });
-    else {
-      m_vs.in.COLOR[0] = m_module.constvec4f32(1.0f, 1.0f, 1.0f, 1.0f);
-      m_isgn.elemCount++;
-    }
+    if (m_uber) {
+      // Attributes missing from the vertex declaration read
+      // zero, so we still need to substitute the defaults
+      uint32_t hasColor0 = uberFlag(m_vs.uber.flags, uint32_t(D3D9FFUberFlagVS::HasColor0));
+      uint32_t hasColor1 = uberFlag(m_vs.uber.flags, uint32_t(D3D9FFUberFlagVS::HasColor1));
 
-    if (m_vsKey.HasColor1)
-      m_vs.in.COLOR[1] = declareIO(true, DxsoSemantic{ DxsoUsage::Color, 1 });
+      m_vs.in.COLOR[0] = select(m_vec4Type, 4, hasColor0,
+        declareIO(true, DxsoSemantic{ DxsoUsage::Color, 0 }),
+        m_module.constvec4f32(1.0f, 1.0f, 1.0f, 1.0f));
+
+      m_vs.in.COLOR[1] = select(m_vec4Type, 4, hasColor1,
+        declareIO(true, DxsoSemantic{ DxsoUsage::Color, 1 }),
+        m_module.constvec4f32(0.0f, 0.0f, 0.0f, 0.0f));
+    }
     else {
-      m_vs.in.COLOR[1] = m_module.constvec4f32(0.0f, 0.0f, 0.0f, 0.0f);
-      m_isgn.elemCount++;
+      if (m_vsKey.HasColor0)
+        m_vs.in.COLOR[0] = declareIO(true, DxsoSemantic{ DxsoUsage::Color, 0 });
+      else {
+        m_vs.in.COLOR[0] = m_module.constvec4f32(1.0f, 1.0f, 1.0f, 1.0f);
+        m_isgn.elemCount++;
+      }
+
+      if (m_vsKey.HasColor1)
+        m_vs.in.COLOR[1] = declareIO(true, DxsoSemantic{ DxsoUsage::Color, 1 });
+      else {
+        m_vs.in.COLOR[1] = m_module.constvec4f32(0.0f, 0.0f, 0.0f, 0.0f);
+        m_isgn.elemCount++;
+      }
     }
 
     // Declare Outputs
@@ -1103,6 +1520,26 @@ namespace dxvk {
     
     uint32_t texture = m_module.constvec4f32(0.0f, 0.0f, 0.0f, 1.0f);
 
+    // Uber shaders wrap each stage in a branch, so the
+    // registers are kept in private variables instead.
+    uint32_t currentPtr   = 0;
+    uint32_t tempPtr      = 0;
+    uint32_t texturePtr   = 0;
+    uint32_t stageEnabled = 0;
+
+    if (m_uber) {
+      uint32_t vec4Ptr = m_module.defPointerType(m_vec4Type, spv::StorageClassPrivate);
+      currentPtr = m_module.newVar(vec4Ptr, spv::StorageClassPrivate);
+      tempPtr    = m_module.newVar(vec4Ptr, spv::StorageClassPrivate);
+      texturePtr = m_module.newVar(vec4Ptr, spv::StorageClassPrivate);
+
+      m_module.opStore(currentPtr, current);
+      m_module.opStore(tempPtr,    temp);
+      m_module.opStore(texturePtr, texture);
+
+      stageEnabled = m_module.constBool(true);
+    }
+
     for (uint32_t i = 0; i < caps::TextureStageCount; i++) {
       const auto& stage = m_fsKey.Stages[i].data;
 
@@ -1335,6 +1772,158 @@ namespace dxvk {
         return dst;
       };
 
+      if (m_uber) {
+        uint32_t bool_t = m_module.defBoolType();
+
+        auto GetArgUber = [&] (uint32_t arg) {
+          std::array<std::pair<uint32_t, uint32_t>, 6> sources = {{
+            { D3DTA_CURRENT,  current  },
+            { D3DTA_DIFFUSE,  diffuse  },
+            { D3DTA_SPECULAR, specular },
+            { D3DTA_TEMP,     temp     },
+            { D3DTA_TEXTURE,  texture  },
+            { D3DTA_TFACTOR,  m_ps.constants.textureFactor },
+          }};
+
+          uint32_t source = uberField(arg, 0, 4); // D3DTA_SELECTMASK
+          uint32_t reg    = m_module.constvec4f32(1.0f, 1.0f, 1.0f, 1.0f);
+
+          for (const auto& s : sources) {
+            reg = select(m_vec4Type, 4,
+              m_module.opIEqual(bool_t, source, m_module.constu32(s.first)),
+              s.second, reg);
+          }
+
+          reg = select(m_vec4Type, 4, uberFlag(arg, 4), Complement(reg),     reg); // D3DTA_COMPLEMENT
+          reg = select(m_vec4Type, 4, uberFlag(arg, 5), AlphaReplicate(reg), reg); // D3DTA_ALPHAREPLICATE
+          return reg;
+        };
+
+        auto DoOpUber = [&] (uint32_t op, uint32_t dst, const std::array<uint32_t, TextureArgCount>& arg) {
+          // Disabled or unimplemented ops leave dst unchanged
+          static constexpr std::array<D3DTEXTUREOP, 21> ops = {
+            D3DTOP_SELECTARG1,              D3DTOP_SELECTARG2,
+            D3DTOP_MODULATE,                D3DTOP_MODULATE2X,
+            D3DTOP_MODULATE4X,              D3DTOP_ADD,
+            D3DTOP_ADDSIGNED,               D3DTOP_ADDSIGNED2X,
+            D3DTOP_SUBTRACT,                D3DTOP_ADDSMOOTH,
+            D3DTOP_BLENDDIFFUSEALPHA,       D3DTOP_BLENDTEXTUREALPHA,
+            D3DTOP_BLENDFACTORALPHA,        D3DTOP_BLENDCURRENTALPHA,
+            D3DTOP_MODULATEALPHA_ADDCOLOR,  D3DTOP_MODULATECOLOR_ADDALPHA,
+            D3DTOP_MODULATEINVALPHA_ADDCOLOR, D3DTOP_MODULATEINVCOLOR_ADDALPHA,
+            D3DTOP_DOTPRODUCT3,             D3DTOP_MULTIPLYADD,
+            D3DTOP_LERP,
+          };
+
+          std::array<SpirvSwitchCaseLabel, ops.size()> cases;
+          std::array<SpirvPhiLabel, ops.size() + 1> results;
+
+          for (uint32_t j = 0; j < ops.size(); j++)
+            cases[j] = { uint32_t(ops[j]), m_module.allocateId() };
+
+          uint32_t defaultLabel = m_module.allocateId();
+          uint32_t endLabel     = m_module.allocateId();
+
+          m_module.opSelectionMerge(endLabel, spv::SelectionControlMaskNone);
+          m_module.opSwitch(op, defaultLabel, cases.size(), cases.data());
+
+          for (uint32_t j = 0; j < ops.size(); j++) {
+            m_module.opLabel(cases[j].labelId);
+            results[j].varId   = DoOp(ops[j], dst, arg);
+            results[j].labelId = cases[j].labelId;
+            m_module.opBranch(endLabel);
+          }
+
+          m_module.opLabel(defaultLabel);
+          results[ops.size()].varId   = dst;
+          results[ops.size()].labelId = defaultLabel;
+          m_module.opBranch(endLabel);
+
+          m_module.opLabel(endLabel);
+          return m_module.opPhi(m_vec4Type, results.size(), results.data());
+        };
+
+        uint32_t colorWord = m_ps.uber.stages[i].color;
+        uint32_t alphaWord = m_ps.uber.stages[i].alpha;
+        uint32_t flagsWord = m_ps.uber.stages[i].flags;
+
+        uint32_t colorOp = uberField(colorWord, 0, 8);
+        uint32_t alphaOp = uberField(alphaWord, 0, 8);
+
+        // This cancels all subsequent stages.
+        stageEnabled = m_module.opLogicalAnd(bool_t, stageEnabled,
+          m_module.opINotEqual(bool_t, colorOp, m_module.constu32(D3DTOP_DISABLE)));
+
+        uint32_t stageLabel    = m_module.allocateId();
+        uint32_t endStageLabel = m_module.allocateId();
+
+        m_module.opSelectionMerge(endStageLabel, spv::SelectionControlMaskNone);
+        m_module.opBranchConditional(stageEnabled, stageLabel, endStageLabel);
+        m_module.opLabel(stageLabel);
+
+        // Only sample the texture if the stage reads it
+        uint32_t sampleLabel    = m_module.allocateId();
+        uint32_t endSampleLabel = m_module.allocateId();
+
+        m_module.opSelectionMerge(endSampleLabel, spv::SelectionControlMaskNone);
+        m_module.opBranchConditional(
+          uberFlag(flagsWord, uint32_t(D3D9FFUberStageFlag::UsesTexture)),
+          sampleLabel, endSampleLabel);
+        m_module.opLabel(sampleLabel);
+
+        SpirvImageOperands imageOperands;
+        uint32_t imageVarId = m_module.opLoad(m_ps.samplers[i].typeId, m_ps.samplers[i].varId);
+        uint32_t sampled = m_module.opImageSampleImplicitLod(m_vec4Type, imageVarId, m_ps.in.TEXCOORD[i], imageOperands);
+
+        // Projection is not valid for cube maps
+        if (D3DRESOURCETYPE(stage.Type + D3DRTYPE_TEXTURE) != D3DRTYPE_CUBETEXTURE) {
+          uint32_t projected = uberFlag(flagsWord, uint32_t(D3D9FFUberStageFlag::Projected));
+          uint32_t sampledProj = m_module.opImageSampleProjImplicitLod(m_vec4Type, imageVarId, m_ps.in.TEXCOORD[i], imageOperands);
+          sampled = select(m_vec4Type, 4, projected, sampledProj, sampled);
+        }
+
+        m_module.opStore(texturePtr, sampled);
+        m_module.opBranch(endSampleLabel);
+        m_module.opLabel(endSampleLabel);
+
+        current = m_module.opLoad(m_vec4Type, currentPtr);
+        temp    = m_module.opLoad(m_vec4Type, tempPtr);
+        texture = m_module.opLoad(m_vec4Type, texturePtr);
+        processedTexture = true;
+
+        std::array<uint32_t, TextureArgCount> colorArgs = {
+          GetArgUber(uberField(colorWord,  8, 8)),
+          GetArgUber(uberField(colorWord, 16, 8)),
+          GetArgUber(uberField(colorWord, 24, 8)) };
+
+        std::array<uint32_t, TextureArgCount> alphaArgs = {
+          GetArgUber(uberField(alphaWord,  8, 8)),
+          GetArgUber(uberField(alphaWord, 16, 8)),
+          GetArgUber(uberField(alphaWord, 24, 8)) };
+
+        uint32_t resultIsTemp = uberFlag(flagsWord, uint32_t(D3D9FFUberStageFlag::ResultIsTemp));
+        uint32_t dst = select(m_vec4Type, 4, resultIsTemp, temp, current);
+
+        uint32_t colorResult = DoOpUber(colorOp, dst, colorArgs);
+        uint32_t alphaResult = DoOpUber(alphaOp, dst, alphaArgs);
+
+        // src0.x, src0.y, src0.z src1.w
+        std::array<uint32_t, 4> indices = { 0, 1, 2, 4 + 3 };
+        uint32_t result = m_module.opVectorShuffle(m_vec4Type, colorResult, alphaResult, indices.size(), indices.data());
+
+        // D3DTOP_DOTPRODUCT3 also has special quirky behaviour here.
+        result = select(m_vec4Type, 4,
+          m_module.opIEqual(bool_t, colorOp, m_module.constu32(D3DTOP_DOTPRODUCT3)),
+          colorResult, result);
+
+        m_module.opStore(tempPtr,    select(m_vec4Type, 4, resultIsTemp, result,  temp));
+        m_module.opStore(currentPtr, select(m_vec4Type, 4, resultIsTemp, current, result));
+
+        m_module.opBranch(endStageLabel);
+        m_module.opLabel(endStageLabel);
+        continue;
+      }
+
       uint32_t& dst = stage.ResultIsTemp ? temp : current;
 
       D3DTEXTUREOP colorOp = (D3DTEXTUREOP)stage.ColorOp;
@@ -1383,15 +1972,22 @@ namespace dxvk {
       }
     }
 
-    if (m_fsKey.SpecularEnable) {
+    if (m_uber)
+      current = m_module.opLoad(m_vec4Type, currentPtr);
+
+    if (m_uber || m_fsKey.SpecularEnable) {
       uint32_t specular = m_module.opFMul(m_vec4Type, m_ps.in.COLOR[1], m_module.constvec4f32(1.0f, 1.0f, 1.0f, 0.0f));
+      uint32_t specularCurrent = m_module.opFAdd(m_vec4Type, current, specular);
 
-      current = m_module.opFAdd(m_vec4Type, current, specular);
+      current = m_uber
+        ? select(m_vec4Type, 4, uberFlag(m_ps.uber.flags, uint32_t(D3D9FFUberFlagFS::SpecularEnable)), specularCurrent, current)
+        : specularCurrent;
     }
 
     D3D9FogContext fogCtx;
     fogCtx.IsPixel     = true;
     fogCtx.RangeFog    = false;
+    fogCtx.DynamicSpecConstants = m_dynamicSpecConstants;
     fogCtx.RenderState = m_rsBlock;
     fogCtx.vPos        = m_ps.in.POS;
     fogCtx.vFog        = m_ps.in.FOG;
@@ -1425,22 +2021,24 @@ namespace dxvk {
 
     // Constant Buffer for PS.
     std::array<uint32_t, PSConstMemberCount> members = {
-      m_vec4Type // Texture Factor
+      m_vec4Type, // Texture Factor
+
+      m_module.defArrayTypeUnique( // Uber Key
+        m_module.defVectorType(m_uint32Type, 4),
+        m_module.constu32(sizeof(D3D9FFUberKeyFS) / sizeof(Vector4))),
     };
 
     const uint32_t structType =
       m_module.defStructType(members.size(), members.data());
 
     m_module.decorateBlock(structType);
-    uint32_t offset = 0;
-
-    for (uint32_t i = 0; i < PSConstMemberCount; i++) {
-      m_module.memberDecorateOffset(structType, i, offset);
-      offset += sizeof(Vector4);
-    }
+    m_module.memberDecorateOffset(structType, PSConstTextureFactor, offsetof(D3D9FixedFunctionPS, textureFactor));
+    m_module.memberDecorateOffset(structType, PSConstUberKey,       offsetof(D3D9FixedFunctionPS, UberKey));
+    m_module.decorateArrayStride(members[PSConstUberKey], sizeof(Vector4));
 
     m_module.setDebugName(structType, "D3D9FixedFunctionPS");
-    m_module.setDebugMemberName(structType, 0, "textureFactor");
+    m_module.setDebugMemberName(structType, PSConstTextureFactor, "textureFactor");
+    m_module.setDebugMemberName(structType, PSConstUberKey,       "UberKey");
 
     m_ps.constantBuffer = m_module.newVar(
       m_module.defPointerType(structType, spv::StorageClassUniform),
@@ -1473,6 +2071,21 @@ namespace dxvk {
 
     m_ps.constants.textureFactor = LoadConstant(m_vec4Type, PSConstTextureFactor);
 
+    if (m_uber) {
+      std::array<uint32_t, sizeof(D3D9FFUberKeyFS) / sizeof(uint32_t)> words;
+      loadUberKey(m_ps.constantBuffer, PSConstUberKey, words.size() / 4, words.data());
+
+      m_ps.uber.flags = words[offsetof(D3D9FFUberKeyFS, Flags) / sizeof(uint32_t)];
+
+      for (uint32_t i = 0; i < caps::TextureStageCount; i++) {
+        uint32_t base = (offsetof(D3D9FFUberKeyFS, Stages) + i * sizeof(D3D9FFUberKeyFS::Stage)) / sizeof(uint32_t);
+
+        m_ps.uber.stages[i].color = words[base + offsetof(D3D9FFUberKeyFS::Stage, Color) / sizeof(uint32_t)];
+        m_ps.uber.stages[i].alpha = words[base + offsetof(D3D9FFUberKeyFS::Stage, Alpha) / sizeof(uint32_t)];
+        m_ps.uber.stages[i].flags = words[base + offsetof(D3D9FFUberKeyFS::Stage, Flags) / sizeof(uint32_t)];
+      }
+    }
+
     // Samplers
     for (uint32_t i = 0; i < caps::TextureStageCount; i++) {
       auto& sampler = m_ps.samplers[i];
@@ -1580,9 +2193,13 @@ namespace dxvk {
     uint32_t alphaRefId = m_module.opLoad(m_floatType,
       m_module.opAccessChain(floatPtr, m_rsBlock, 1, &alphaRefMember));
 
+    uint32_t alphaFunc = m_dynamicSpecConstants
+      ? DoDynamicSpecConstant(m_module, m_rsBlock, alphaFuncId, D3D9RenderStateItem::AlphaFunc)
+      : alphaFuncId;
+
     // switch (alpha_func) { ... }
     m_module.opSelectionMerge(atestTestLabel, spv::SelectionControlMaskNone);
-    m_module.opSwitch(alphaFuncId,
+    m_module.opSwitch(alphaFunc,
       atestCaseLabels[uint32_t(VK_COMPARE_OP_ALWAYS)].labelId,
       atestCaseLabels.size(),
       atestCaseLabels.data());
@@ -1637,16 +2254,26 @@ namespace dxvk {
 
 
   D3D9FFShader::D3D9FFShader(
-          D3D9DeviceEx*         pDevice,
-    const D3D9FFShaderKeyVS&    Key) {
-    Sha1Hash hash = Sha1Hash::compute(&Key, sizeof(Key));
+    const Rc<DxvkDevice>&       Device,
+    const D3D9FFShaderKeyVS&    Key,
+          bool                  DynamicSpecConstants,
+          bool                  Uber) {
+    // Make sure that uber shaders do not share
+    // the hash of the specialized default shader
+    const char uberTag[] = "UBER";
+
+    std::array<Sha1Data, 2> chunks = {{
+      { &Key,    sizeof(Key) },
+      { uberTag, Uber ? sizeof(uberTag) : 0 },
+    }};
+
+    Sha1Hash hash = Sha1Hash::compute(chunks.size(), chunks.data());
     DxvkShaderKey shaderKey = { VK_SHADER_STAGE_VERTEX_BIT, hash };
 
-    std::string name = str::format("FF_", shaderKey.toString());
+    std::string name = str::format(Uber ? "FF_UBER_" : "FF_", shaderKey.toString());
 
     D3D9FFShaderCompiler compiler(
-      pDevice->GetDXVKDevice(),
-      Key, name);
+      Device, Key, name, DynamicSpecConstants, Uber);
 
     m_shader = compiler.compile();
     m_isgn   = compiler.isgn();
@@ -1654,21 +2281,31 @@ namespace dxvk {
     Dump(Key, name);
 
     m_shader->setShaderKey(shaderKey);
-    pDevice->GetDXVKDevice()->registerShader(m_shader);
+    Device->registerShader(m_shader);
   }
 
 
   D3D9FFShader::D3D9FFShader(
-          D3D9DeviceEx*         pDevice,
-    const D3D9FFShaderKeyFS&    Key) {
-    Sha1Hash hash = Sha1Hash::compute(&Key, sizeof(Key));
+    const Rc<DxvkDevice>&       Device,
+    const D3D9FFShaderKeyFS&    Key,
+          bool                  DynamicSpecConstants,
+          bool                  Uber) {
+    // Make sure that uber shaders do not share
+    // the hash of the specialized default shader
+    const char uberTag[] = "UBER";
+
+    std::array<Sha1Data, 2> chunks = {{
+      { &Key,    sizeof(Key) },
+      { uberTag, Uber ? sizeof(uberTag) : 0 },
+    }};
+
+    Sha1Hash hash = Sha1Hash::compute(chunks.size(), chunks.data());
     DxvkShaderKey shaderKey = { VK_SHADER_STAGE_FRAGMENT_BIT, hash };
 
-    std::string name = str::format("FF_", shaderKey.toString());
+    std::string name = str::format(Uber ? "FF_UBER_" : "FF_", shaderKey.toString());
 
     D3D9FFShaderCompiler compiler(
-      pDevice->GetDXVKDevice(),
-      Key, name);
+      Device, Key, name, DynamicSpecConstants, Uber);
 
     m_shader = compiler.compile();
     m_isgn   = compiler.isgn();
@@ -1676,7 +2313,7 @@ namespace dxvk {
     Dump(Key, name);
 
     m_shader->setShaderKey(shaderKey);
-    pDevice->GetDXVKDevice()->registerShader(m_shader);
+    Device->registerShader(m_shader);
   }
 
   template <typename T>
@@ -1704,7 +2341,8 @@ namespace dxvk {
       return entry->second;
     
     D3D9FFShader shader(
-      pDevice, ShaderKey);
+      pDevice->GetDXVKDevice(), ShaderKey,
+      pDevice->GetOptions()->adaptiveSpecConstants);
 
     m_vsModules.insert({ShaderKey, shader});
 
@@ -1721,7 +2359,8 @@ namespace dxvk {
       return entry->second;
     
     D3D9FFShader shader(
-      pDevice, ShaderKey);
+      pDevice->GetDXVKDevice(), ShaderKey,
+      pDevice->GetOptions()->adaptiveSpecConstants);
 
     m_fsModules.insert({ShaderKey, shader});
 
@@ -1729,6 +2368,196 @@ namespace dxvk {
   }
 
 
+  Rc<DxvkShader> D3D9FFShaderModuleSet::GetShaderModuleAsync(
+          D3D9DeviceEx*             pDevice,
+    const D3D9FFShaderKeyVS&        ShaderKey,
+          Rc<DxvkShaderCompileJob>* pJob) {
+    auto entry = m_vsJobs.find(ShaderKey);
+
+    if (entry == m_vsJobs.end()) {
+      Rc<D3D9FFShaderCompileJob<D3D9FFShaderKeyVS>> job =
+        new D3D9FFShaderCompileJob<D3D9FFShaderKeyVS>(pDevice->GetDXVKDevice(), ShaderKey,
+          pDevice->GetOptions()->adaptiveSpecConstants);
+
+      entry = m_vsJobs.insert({ ShaderKey, job }).first;
+      pDevice->GetDXVKDevice()->shaderCompiler().queueJob(job);
+    }
+
+    *pJob = nullptr;
+
+    if (entry->second->isDone()) {
+      Rc<DxvkShader> shader = entry->second->GetShader();
+
+      if (shader != nullptr)
+        return shader;
+    } else {
+      *pJob = entry->second;
+    }
+
+    if (m_vsUber == nullptr) {
+      m_vsUber = D3D9FFShader(pDevice->GetDXVKDevice(), D3D9FFShaderKeyVS(),
+        pDevice->GetOptions()->adaptiveSpecConstants, true).GetShader();
+    }
+
+    return m_vsUber;
+  }
+
+
+  Rc<DxvkShader> D3D9FFShaderModuleSet::GetShaderModuleAsync(
+          D3D9DeviceEx*             pDevice,
+    const D3D9FFShaderKeyFS&        ShaderKey,
+          Rc<DxvkShaderCompileJob>* pJob) {
+    auto entry = m_fsJobs.find(ShaderKey);
+
+    if (entry == m_fsJobs.end()) {
+      Rc<D3D9FFShaderCompileJob<D3D9FFShaderKeyFS>> job =
+        new D3D9FFShaderCompileJob<D3D9FFShaderKeyFS>(pDevice->GetDXVKDevice(), ShaderKey,
+          pDevice->GetOptions()->adaptiveSpecConstants);
+
+      entry = m_fsJobs.insert({ ShaderKey, job }).first;
+      pDevice->GetDXVKDevice()->shaderCompiler().queueJob(job);
+    }
+
+    *pJob = nullptr;
+
+    if (entry->second->isDone()) {
+      Rc<DxvkShader> shader = entry->second->GetShader();
+
+      if (shader != nullptr)
+        return shader;
+    } else {
+      *pJob = entry->second;
+    }
+
+    // Sampler declarations depend on the texture
+    // types, so we need one uber shader for each
+    // combination of texture types in use.
+    D3D9FFShaderKeyFS uberKey;
+    uint32_t textureTypes = 0;
+
+    for (uint32_t i = 0; i < caps::TextureStageCount; i++) {
+      uberKey.Stages[i].data.Type = ShaderKey.Stages[i].data.Type;
+      textureTypes |= ShaderKey.Stages[i].data.Type << (2 * i);
+    }
+
+    auto uber = m_fsUber.find(textureTypes);
+
+    if (uber == m_fsUber.end()) {
+      Rc<DxvkShader> shader = D3D9FFShader(pDevice->GetDXVKDevice(), uberKey,
+        pDevice->GetOptions()->adaptiveSpecConstants, true).GetShader();
+
+      uber = m_fsUber.insert({ textureTypes, shader }).first;
+    }
+
+    return uber->second;
+  }
+
+
+  template<typename T>
+  void D3D9FFShaderCompileJob<T>::run() {
+    try {
+      m_shader = D3D9FFShader(m_device, m_key, m_dynamicSpecConstants).GetShader();
+    } catch (const DxvkError& e) {
+      // Keep using the uber shader for this key
+      Logger::err("D3D9: Failed to compile fixed-function shader");
+      Logger::err(e.message());
+    } catch (const std::exception& e) {
+      Logger::err("D3D9: Failed to compile fixed-function shader");
+      Logger::err(e.what());
+    } catch (...) {
+      Logger::err("D3D9: Failed to compile fixed-function shader");
+    }
+  }
+
+  template class D3D9FFShaderCompileJob<D3D9FFShaderKeyVS>;
+  template class D3D9FFShaderCompileJob<D3D9FFShaderKeyFS>;
+
+
+  D3D9FFUberKeyVS PackFixedFunctionKey(const D3D9FFShaderKeyVS& Key) {
+    D3D9FFUberKeyVS result = { };
+
+    auto SetFlag = [&] (D3D9FFUberFlagVS Flag, bool Value) {
+      if (Value)
+        result.Flags |= 1u << uint32_t(Flag);
+    };
+
+    SetFlag(D3D9FFUberFlagVS::HasPositionT,     Key.HasPositionT);
+    SetFlag(D3D9FFUberFlagVS::HasColor0,        Key.HasColor0);
+    SetFlag(D3D9FFUberFlagVS::HasColor1,        Key.HasColor1);
+    SetFlag(D3D9FFUberFlagVS::UseLighting,      Key.UseLighting);
+    SetFlag(D3D9FFUberFlagVS::NormalizeNormals, Key.NormalizeNormals);
+    SetFlag(D3D9FFUberFlagVS::LocalViewer,      Key.LocalViewer);
+    SetFlag(D3D9FFUberFlagVS::RangeFog,         Key.RangeFog);
+
+    result.LightCount = Key.LightCount;
+
+    result.MaterialSources = uint32_t(Key.DiffuseSource)
+                           | uint32_t(Key.AmbientSource)  << 2
+                           | uint32_t(Key.SpecularSource) << 4
+                           | uint32_t(Key.EmissiveSource) << 6;
+
+    for (uint32_t i = 0; i < caps::TextureStageCount; i++) {
+      result.Texcoords[i] = ((Key.TexcoordIndices[i]       ) & 0xff)
+                          | ((Key.TexcoordIndices[i] >> 16) & 0xff) << 8
+                          | ((Key.TransformFlags[i]        ) & 0xff) << 16;
+    }
+
+    return result;
+  }
+
+
+  D3D9FFUberKeyFS PackFixedFunctionKey(const D3D9FFShaderKeyFS& Key) {
+    D3D9FFUberKeyFS result = { };
+
+    if (Key.SpecularEnable)
+      result.Flags |= 1u << uint32_t(D3D9FFUberFlagFS::SpecularEnable);
+
+    for (uint32_t i = 0; i < caps::TextureStageCount; i++) {
+      const auto& stage = Key.Stages[i].data;
+      auto& dst = result.Stages[i];
+
+      dst.Color = stage.ColorOp
+                | stage.ColorArg0 << 8
+                | stage.ColorArg1 << 16
+                | stage.ColorArg2 << 24;
+
+      dst.Alpha = stage.AlphaOp
+                | stage.AlphaArg0 << 8
+                | stage.AlphaArg1 << 16
+                | stage.AlphaArg2 << 24;
+
+      // The specialized shader samples the texture
+      // whenever any argument or the op refers to it
+      auto IsTexture = [] (uint32_t Arg) {
+        return (Arg & D3DTA_SELECTMASK) == D3DTA_TEXTURE;
+      };
+
+      bool usesTexture = false;
+
+      if (stage.ColorOp != D3DTOP_DISABLE) {
+        usesTexture |= IsTexture(stage.ColorArg0) || IsTexture(stage.ColorArg1) || IsTexture(stage.ColorArg2)
+                    || stage.ColorOp == D3DTOP_BLENDTEXTUREALPHA;
+      }
+
+      if (stage.AlphaOp != D3DTOP_DISABLE) {
+        usesTexture |= IsTexture(stage.AlphaArg0) || IsTexture(stage.AlphaArg1) || IsTexture(stage.AlphaArg2)
+                    || stage.AlphaOp == D3DTOP_BLENDTEXTUREALPHA;
+      }
+
+      if (stage.ResultIsTemp)
+        dst.Flags |= 1u << uint32_t(D3D9FFUberStageFlag::ResultIsTemp);
+
+      if (stage.Projected)
+        dst.Flags |= 1u << uint32_t(D3D9FFUberStageFlag::Projected);
+
+      if (usesTexture)
+        dst.Flags |= 1u << uint32_t(D3D9FFUberStageFlag::UsesTexture);
+    }
+
+    return result;
+  }
+
+
   size_t D3D9FFShaderKeyHash::operator () (const D3D9FFShaderKeyVS& key) const {
     DxvkHashState state;
 
@@ -1771,7 +2600,7 @@ namespace dxvk {
     state.add(boolhash(key.SpecularEnable));
 
     for (uint32_t i = 0; i < caps::TextureStageCount; i++)
-      state.add(uint64hash(key.Stages->uint64[i]));
+      state.add(uint64hash(key.Stages[i].uint64[0]));
 
     return state;
   }
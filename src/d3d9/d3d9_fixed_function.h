@@ -3,8 +3,10 @@
 #include "d3d9_include.h"
 
 #include "d3d9_caps.h"
+#include "d3d9_state.h"
 
 #include "../dxvk/dxvk_shader.h"
+#include "../dxvk/dxvk_shader_compiler.h"
 
 #include "../dxso/dxso_isgn.h"
 
@@ -20,6 +22,8 @@ namespace dxvk {
     // General inputs...
     bool     IsPixel;
     bool     RangeFog;
+    uint32_t RangeFogId = 0; // Runtime value, overrides RangeFog
+    bool     DynamicSpecConstants = false; // Emit dynamic path for the fog mode
     uint32_t RenderState;
     uint32_t vPos;
     uint32_t vFog;
@@ -31,6 +35,11 @@ namespace dxvk {
   // Returns new oColor if PS
   uint32_t DoFixedFunctionFog(SpirvModule& spvModule, const D3D9FogContext& fogCtx);
 
+  // Returns the value of an integer spec constant, or the given
+  // render state member if the spec constant is set to dynamic.
+  // Only needed if adaptive spec constants are enabled.
+  uint32_t DoDynamicSpecConstant(SpirvModule& spvModule, uint32_t renderState, uint32_t specConst, D3D9RenderStateItem item);
+
   struct D3D9FFShaderKeyVS {
     D3D9FFShaderKeyVS() {
       // memcmp safety
@@ -100,6 +109,46 @@ namespace dxvk {
     bool              SpecularEnable;
   };
 
+  /**
+   * \brief Uber vertex shader flags
+   *
+   * Bit indices into \c D3D9FFUberKeyVS::Flags.
+   */
+  enum class D3D9FFUberFlagVS : uint32_t {
+    HasPositionT      = 0,
+    HasColor0         = 1,
+    HasColor1         = 2,
+    UseLighting       = 3,
+    NormalizeNormals  = 4,
+    LocalViewer       = 5,
+    RangeFog          = 6,
+  };
+
+  /**
+   * \brief Uber pixel shader flags
+   *
+   * Bit indices into \c D3D9FFUberKeyFS::Flags.
+   */
+  enum class D3D9FFUberFlagFS : uint32_t {
+    SpecularEnable    = 0,
+  };
+
+  /**
+   * \brief Uber pixel shader stage flags
+   *
+   * Bit indices into the stage flags of \c D3D9FFUberKeyFS.
+   * \c UsesTexture is derived from the ops and arguments,
+   * so that unused textures are not sampled.
+   */
+  enum class D3D9FFUberStageFlag : uint32_t {
+    ResultIsTemp      = 0,
+    Projected         = 1,
+    UsesTexture       = 2,
+  };
+
+  D3D9FFUberKeyVS PackFixedFunctionKey(const D3D9FFShaderKeyVS& Key);
+  D3D9FFUberKeyFS PackFixedFunctionKey(const D3D9FFShaderKeyFS& Key);
+
   struct D3D9FFShaderKeyHash {
     size_t operator () (const D3D9FFShaderKeyVS& key) const;
     size_t operator () (const D3D9FFShaderKeyFS& key) const;
@@ -120,12 +169,16 @@ namespace dxvk {
   public:
 
     D3D9FFShader(
-            D3D9DeviceEx*         pDevice,
-      const D3D9FFShaderKeyVS&    Key);
+      const Rc<DxvkDevice>&       Device,
+      const D3D9FFShaderKeyVS&    Key,
+            bool                  DynamicSpecConstants,
+            bool                  Uber = false);
 
     D3D9FFShader(
-            D3D9DeviceEx*         pDevice,
-      const D3D9FFShaderKeyFS&    Key);
+      const Rc<DxvkDevice>&       Device,
+      const D3D9FFShaderKeyFS&    Key,
+            bool                  DynamicSpecConstants,
+            bool                  Uber = false);
 
     template <typename T>
     void Dump(const T& Key, const std::string& Name);
@@ -143,6 +196,44 @@ namespace dxvk {
   };
 
 
+  /**
+   * \brief Fixed-function shader compile job
+   *
+   * Compiles a specialized fixed-function shader
+   * on a worker thread while the corresponding
+   * uber shader is in use.
+   */
+  template<typename T>
+  class D3D9FFShaderCompileJob : public DxvkShaderCompileJob {
+
+  public:
+
+    D3D9FFShaderCompileJob(
+      const Rc<DxvkDevice>&       Device,
+      const T&                    Key,
+            bool                  DynamicSpecConstants)
+    : m_device(Device), m_key(Key), m_dynamicSpecConstants(DynamicSpecConstants) { }
+
+    Rc<DxvkShader> GetShader() {
+      this->wait();
+      return m_shader;
+    }
+
+  protected:
+
+    void run() final;
+
+  private:
+
+    Rc<DxvkDevice>  m_device;
+    T               m_key;
+    bool            m_dynamicSpecConstants;
+
+    Rc<DxvkShader>  m_shader;
+
+  };
+
+
   class D3D9FFShaderModuleSet : public RcObject {
 
   public:
@@ -155,6 +246,27 @@ namespace dxvk {
             D3D9DeviceEx*         pDevice,
       const D3D9FFShaderKeyFS&    ShaderKey);
 
+    /**
+     * \brief Looks up a fixed-function shader without stalling
+     *
+     * Returns the specialized shader if it is available.
+     * Otherwise, queues a compile job for it if necessary
+     * and returns the uber shader in the meantime.
+     * \param [in] pDevice The device
+     * \param [in] ShaderKey Shader key
+     * \param [out] pJob Pending compile job, if any
+     * \returns The shader to bind
+     */
+    Rc<DxvkShader> GetShaderModuleAsync(
+            D3D9DeviceEx*             pDevice,
+      const D3D9FFShaderKeyVS&        ShaderKey,
+            Rc<DxvkShaderCompileJob>* pJob);
+
+    Rc<DxvkShader> GetShaderModuleAsync(
+            D3D9DeviceEx*             pDevice,
+      const D3D9FFShaderKeyFS&        ShaderKey,
+            Rc<DxvkShaderCompileJob>* pJob);
+
   private:
 
     std::unordered_map<
@@ -167,6 +279,22 @@ namespace dxvk {
       D3D9FFShader,
       D3D9FFShaderKeyHash, D3D9FFShaderKeyEq> m_fsModules;
 
+    std::unordered_map<
+      D3D9FFShaderKeyVS,
+      Rc<D3D9FFShaderCompileJob<D3D9FFShaderKeyVS>>,
+      D3D9FFShaderKeyHash, D3D9FFShaderKeyEq> m_vsJobs;
+
+    std::unordered_map<
+      D3D9FFShaderKeyFS,
+      Rc<D3D9FFShaderCompileJob<D3D9FFShaderKeyFS>>,
+      D3D9FFShaderKeyHash, D3D9FFShaderKeyEq> m_fsJobs;
+
+    Rc<DxvkShader> m_vsUber;
+
+    // Uber pixel shaders are keyed by the
+    // texture types of all texture stages
+    std::unordered_map<uint32_t, Rc<DxvkShader>> m_fsUber;
+
   };
 
 }
\ No newline at end of file
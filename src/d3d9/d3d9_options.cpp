@@ -47,6 +47,10 @@ namespace dxvk {
     this->samplerAnisotropy     = config.getOption<int32_t>("d3d9.samplerAnisotropy", -1);
     this->maxAvailableMemory    = config.getOption<uint32_t>("d3d9.maxAvailableMemory", UINT32_MAX);
     this->supportDFFormats      = config.getOption<bool>("d3d9.supportDFFormats", true);
+    this->ffUberShaders         = config.getOption<bool>   ("d3d9.ffUberShaders",        false);
+    this->specializeIntBoolConstants = config.getOption<bool>("d3d9.specializeIntBoolConstants", false);
+    this->adaptiveSpecConstants = config.getOption<bool>   ("d3d9.adaptiveSpecConstants", false);
+    this->mergeDraws            = config.getOption<bool>   ("d3d9.mergeDraws",           false);
 
     this->d3d9FloatEmulation    = true; // <-- Future Extension?
 
@@ -77,6 +77,34 @@ namespace dxvk {
 
     /// Support the DF16 & DF24 texture format
     bool supportDFFormats;
+
+    /// Use uber shaders for fixed-function state
+    ///
+    /// Draws with fixed-function state that has not been seen
+    /// yet use generic shaders driven by uniform data while
+    /// the specialized shaders are compiled in the background.
+    bool ffUberShaders;
+
+    /// Specialize shaders for integer and bool constants
+    ///
+    /// Compiles variants of shaders that read integer or
+    /// bool constants with the current values baked in,
+    /// so that loops and branches can be resolved.
+    bool specializeIntBoolConstants;
+
+    /// Adaptive spec constants for render states
+    ///
+    /// Alpha test and fog states that change many times per
+    /// frame are passed to shaders through push constants
+    /// rather than creating a pipeline for each combination.
+    bool adaptiveSpecConstants;
+
+    /// Merge consecutive draws
+    ///
+    /// Draws with adjacent vertex or index ranges that are
+    /// issued without any state changes in between are
+    /// submitted as a single draw.
+    bool mergeDraws;
   };
 
 }
\ No newline at end of file
@@ -4,6 +4,279 @@
 
 namespace dxvk {
 
+  D3D9ShaderCompileJob::D3D9ShaderCompileJob(
+          DxvkDevice*           pDevice,
+    const DxvkShaderKey*        pShaderKey,
+    const DxsoModuleInfo*       pDxsoModuleInfo,
+    const void*                 pShaderBytecode,
+    const DxsoAnalysisInfo&     AnalysisInfo)
+  : m_device    (pDevice),
+    m_key       (*pShaderKey),
+    m_moduleInfo(*pDxsoModuleInfo),
+    m_analysis  (AnalysisInfo) {
+    const uint32_t bytecodeLength = AnalysisInfo.bytecodeByteLength;
+    m_bytecode.resize(bytecodeLength);
+    std::memcpy(m_bytecode.data(), pShaderBytecode, bytecodeLength);
+  }
+
+
+  D3D9ShaderCompileJob::~D3D9ShaderCompileJob() {
+
+  }
+
+
+  void D3D9ShaderCompileJob::run() {
+    // Exceptions must not escape the worker thread. Failed
+    // jobs provide no shader, which is reported on first use.
+    std::string error;
+    bool failed = false;
+
+    try {
+      Compile();
+    } catch (const DxvkError& e) {
+      error  = e.message();
+      failed = true;
+    } catch (const std::exception& e) {
+      error  = e.what();
+      failed = true;
+    } catch (...) {
+      error  = "Unknown error";
+      failed = true;
+    }
+
+    if (failed) {
+      Logger::err(str::format("Failed to compile shader ", m_key.toString()));
+      Logger::err(error);
+
+      m_shader = nullptr;
+      return;
+    }
+
+    m_device->registerShader(m_shader);
+  }
+
+
+  void D3D9ShaderCompileJob::ReportFailure() {
+    if (!m_failureReported.exchange(true)) {
+      Logger::err(str::format("D3D9: Shader ", m_key.toString(),
+        " failed to compile, draws using it will be skipped"));
+    }
+  }
+
+
+  void D3D9ShaderCompileJob::Compile() {
+    const std::string name = m_key.toString();
+
+    // Try to skip shader translation entirely if
+    // the shader cache has a matching SPIR-V module
+    DxvkShaderCache& shaderCache = m_device->shaderCache();
+    Sha1Hash cacheKey;
+
+    if (shaderCache.enabled()) {
+      cacheKey = GetCacheKey(&m_key, &m_moduleInfo);
+
+      std::stringstream cacheData;
+
+      if (shaderCache.lookup(cacheKey, cacheData)
+       && !LoadFromCache(cacheData))
+        m_shader = nullptr;
+    }
+
+    if (m_shader == nullptr) {
+      Logger::debug(str::format("Compiling shader ", name));
+
+      // The application's copy of the bytecode may be
+      // gone by now, so we need to parse our own copy
+      DxsoReader reader(
+        reinterpret_cast<const char*>(m_bytecode.data()));
+
+      DxsoModule module(reader);
+
+      m_shader       = module.compile(m_moduleInfo, name, m_analysis);
+      m_isgn         = module.isgn();
+      m_usedSamplers = module.usedSamplers();
+      m_usedRTs      = module.usedRTs();
+
+      m_meta      = module.meta();
+      m_constants = module.constants();
+
+      if (shaderCache.enabled()) {
+        std::stringstream cacheData;
+        StoreToCache(cacheData);
+        shaderCache.store(cacheKey, cacheData);
+      }
+    }
+
+    m_shader->setShaderKey(m_key);
+
+    const std::string dumpPath = env::getEnvVar("DXVK_SHADER_DUMP_PATH");
+    
+    if (dumpPath.size() != 0) {
+      std::ofstream dumpStream(
+        str::format(dumpPath, "/", name, ".spv"),
+        std::ios_base::binary | std::ios_base::trunc);
+      
+      m_shader->dump(dumpStream);
+    }
+  }
+
+
+  bool D3D9ShaderCompileJob::LoadFromCache(
+          std::istream&         Stream) {
+    m_shader = DxvkShaderCache::readShader(Stream);
+
+    return m_shader != nullptr
+        && DxvkShaderCache::readData (Stream, m_isgn)
+        && DxvkShaderCache::readData (Stream, m_usedSamplers)
+        && DxvkShaderCache::readData (Stream, m_usedRTs)
+        && DxvkShaderCache::readData (Stream, m_meta.needsConstantCopies)
+        && DxvkShaderCache::readData (Stream, m_meta.maxConstIndexF)
+        && DxvkShaderCache::readData (Stream, m_meta.maxConstIndexI)
+        && DxvkShaderCache::readData (Stream, m_meta.maxConstIndexB)
+        && DxvkShaderCache::readData (Stream, m_meta.packedConstantsF)
+        && DxvkShaderCache::readArray(Stream, m_meta.constantRangesF)
+        && DxvkShaderCache::readArray(Stream, m_constants);
+  }
+
+
+  void D3D9ShaderCompileJob::StoreToCache(
+          std::ostream&         Stream) const {
+    DxvkShaderCache::writeShader(Stream, m_shader);
+    DxvkShaderCache::writeData  (Stream, m_isgn);
+    DxvkShaderCache::writeData  (Stream, m_usedSamplers);
+    DxvkShaderCache::writeData  (Stream, m_usedRTs);
+    DxvkShaderCache::writeData  (Stream, m_meta.needsConstantCopies);
+    DxvkShaderCache::writeData  (Stream, m_meta.maxConstIndexF);
+    DxvkShaderCache::writeData  (Stream, m_meta.maxConstIndexI);
+    DxvkShaderCache::writeData  (Stream, m_meta.maxConstIndexB);
+    DxvkShaderCache::writeData  (Stream, m_meta.packedConstantsF);
+    DxvkShaderCache::writeArray (Stream, m_meta.constantRangesF);
+    DxvkShaderCache::writeArray (Stream, m_constants);
+  }
+
+
+  Sha1Hash D3D9ShaderCompileJob::GetCacheKey(
+    const DxvkShaderKey*        pShaderKey,
+    const DxsoModuleInfo*       pDxsoModuleInfo) {
+    // Options are written field by field to not include padding
+    std::stringstream stream;
+    stream << pShaderKey->toString();
+
+    const DxsoOptions& options = pDxsoModuleInfo->options;
+    DxvkShaderCache::writeData(stream, options.useDemoteToHelperInvocation);
+    DxvkShaderCache::writeData(stream, options.useSubgroupOpsForEarlyDiscard);
+    DxvkShaderCache::writeData(stream, options.strictConstantCopies);
+    DxvkShaderCache::writeData(stream, options.d3d9FloatEmulation);
+    DxvkShaderCache::writeData(stream, options.strictPow);
+    DxvkShaderCache::writeData(stream, options.optimizeShaders);
+    DxvkShaderCache::writeData(stream, options.dynamicSpecConstants);
+
+    std::string data = stream.str();
+    return Sha1Hash::compute(data.data(), data.size());
+  }
+
+
+  D3D9ShaderVariantSet::D3D9ShaderVariantSet(
+          DxvkDevice*               pDevice,
+    const Rc<D3D9ShaderCompileJob>& BaseJob)
+  : m_device (pDevice),
+    m_baseJob(BaseJob) {
+    m_variants.reserve(MaxVariants);
+  }
+
+
+  Rc<DxvkShader> D3D9ShaderVariantSet::GetShader(
+    const DxsoConstantSpecialization& Spec,
+          bool*                       pPending) {
+    *pPending = false;
+
+    if (m_evictions > MaxEvictions)
+      return nullptr;
+
+    auto Matches = [&Spec] (const Variant& variant) {
+      return !std::memcmp(&variant.spec, &Spec, sizeof(Spec));
+    };
+
+    // Constants usually stay the same for many
+    // draws, so check the last variant first
+    size_t index = m_lastVariant;
+
+    if (index >= m_variants.size() || !Matches(m_variants[index])) {
+      index = 0;
+
+      while (index < m_variants.size() && !Matches(m_variants[index]))
+        index += 1;
+    }
+
+    if (index == m_variants.size()) {
+      if (m_variants.size() < MaxVariants) {
+        m_variants.emplace_back();
+      } else {
+        if (++m_evictions > MaxEvictions) {
+          Logger::info(str::format("Disabling constant specialization for ",
+            m_baseJob->GetShaderKey().toString()));
+          m_variants.clear();
+          return nullptr;
+        }
+
+        index = 0;
+
+        for (size_t i = 1; i < m_variants.size(); i++) {
+          if (m_variants[i].lastUse < m_variants[index].lastUse)
+            index = i;
+        }
+      }
+
+      m_variants[index].spec = Spec;
+      m_variants[index].job  = CreateJob(Spec);
+    }
+
+    Variant& variant = m_variants[index];
+    variant.lastUse = ++m_useCounter;
+    m_lastVariant = index;
+
+    if (!variant.job->isDone()) {
+      *pPending = true;
+      return nullptr;
+    }
+
+    // Compile errors leave the shader null,
+    // the generic shader is used in that case
+    return variant.job->GetShader();
+  }
+
+
+  Rc<D3D9ShaderCompileJob> D3D9ShaderVariantSet::CreateJob(
+    const DxsoConstantSpecialization& Spec) const {
+    const DxvkShaderKey& baseKey = m_baseJob->GetShaderKey();
+
+    // Derive a unique key so that the shader cache and
+    // the state cache treat each variant separately
+    std::stringstream stream;
+    stream << baseKey.toString();
+
+    DxvkShaderCache::writeData(stream, Spec.intMask);
+    DxvkShaderCache::writeData(stream, Spec.boolMask);
+    DxvkShaderCache::writeData(stream, Spec.bools);
+    DxvkShaderCache::writeData(stream, Spec.ints);
+
+    std::string data = stream.str();
+
+    DxvkShaderKey key(VkShaderStageFlagBits(baseKey.type()),
+      Sha1Hash::compute(data.data(), data.size()));
+
+    DxsoModuleInfo moduleInfo = m_baseJob->GetModuleInfo();
+    moduleInfo.specConsts = Spec;
+
+    Rc<D3D9ShaderCompileJob> job = new D3D9ShaderCompileJob(m_device,
+      &key, &moduleInfo, m_baseJob->GetBytecode().data(),
+      m_baseJob->GetAnalysis());
+
+    m_device->shaderCompiler().queueJob(job);
+    return job;
+  }
+
+
   D3D9CommonShader::D3D9CommonShader() {}
 
   D3D9CommonShader::D3D9CommonShader(
@@ -12,13 +285,10 @@ namespace dxvk {
       const DxsoModuleInfo*       pDxsoModuleInfo,
       const void*                 pShaderBytecode,
       const DxsoAnalysisInfo&     AnalysisInfo,
-            DxsoModule*           pModule) {
+            DxsoModule*           pModule)
+  : m_name(pShaderKey->toString()),
+    m_info(pModule->info()) {
     const uint32_t bytecodeLength = AnalysisInfo.bytecodeByteLength;
-    m_bytecode.resize(bytecodeLength);
-    std::memcpy(m_bytecode.data(), pShaderBytecode, bytecodeLength);
-
-    const std::string name = pShaderKey->toString();
-    Logger::debug(str::format("Compiling shader ", name));
     
     // If requested by the user, dump both the raw DXBC
     // shader and the compiled SPIR-V module to a file.
@@ -28,7 +298,7 @@ namespace dxvk {
       DxsoReader reader(
         reinterpret_cast<const char*>(pShaderBytecode));
 
-      reader.store(std::ofstream(str::format(dumpPath, "/", name, ".dxso"),
+      reader.store(std::ofstream(str::format(dumpPath, "/", m_name, ".dxso"),
         std::ios_base::binary | std::ios_base::trunc), bytecodeLength);
 
       char comment[2048];
@@ -40,36 +310,27 @@ namespace dxvk {
         &blob);
       
       if (SUCCEEDED(hr)) {
-        std::ofstream disassembledOut(str::format(dumpPath, "/", name, ".dxso.dis"), std::ios_base::binary | std::ios_base::trunc);
+        std::ofstream disassembledOut(str::format(dumpPath, "/", m_name, ".dxso.dis"), std::ios_base::binary | std::ios_base::trunc);
         disassembledOut.write(
           reinterpret_cast<const char*>(blob->GetBufferPointer()),
           blob->GetBufferSize());
       }
     }
-    
-    // Decide whether we need to create a pass-through
-    // geometry shader for vertex shader stream output
 
-    m_shader       = pModule->compile(*pDxsoModuleInfo, name, AnalysisInfo);
-    m_isgn         = pModule->isgn();
-    m_usedSamplers = pModule->usedSamplers();
-    m_usedRTs      = pModule->usedRTs();
+    Rc<DxvkDevice> device = pDevice->GetDXVKDevice();
 
-    m_info      = pModule->info();
-    m_meta      = pModule->meta();
-    m_constants = pModule->constants();
+    m_job = new D3D9ShaderCompileJob(device.ptr(),
+      pShaderKey, pDxsoModuleInfo, pShaderBytecode, AnalysisInfo);
 
-    m_shader->setShaderKey(*pShaderKey);
-    
-    if (dumpPath.size() != 0) {
-      std::ofstream dumpStream(
-        str::format(dumpPath, "/", name, ".spv"),
-        std::ios_base::binary | std::ios_base::trunc);
-      
-      m_shader->dump(dumpStream);
-    }
+    device->shaderCompiler().queueJob(m_job);
+
+    // Without deferred translation, the job has already been
+    // executed, so report failures to the creation call.
+    if (!device->config().deferShaderTranslation && m_job->GetShader() == nullptr)
+      throw DxvkError(str::format("Failed to compile shader ", m_name));
 
-    pDevice->GetDXVKDevice()->registerShader(m_shader);
+    if (pDevice->GetOptions()->specializeIntBoolConstants)
+      m_variants = new D3D9ShaderVariantSet(device.ptr(), m_job);
   }
 
 
@@ -5,12 +5,188 @@
 
 namespace dxvk {
 
+  /**
+   * \brief Shader translation job
+   * 
+   * Translates a DXSO shader to SPIR-V and gathers
+   * the shader metadata required by the device.
+   * Results may only be accessed after the job
+   * completed.
+   */
+  class D3D9ShaderCompileJob : public DxvkShaderCompileJob {
+
+  public:
+
+    D3D9ShaderCompileJob(
+            DxvkDevice*           pDevice,
+      const DxvkShaderKey*        pShaderKey,
+      const DxsoModuleInfo*       pDxsoModuleInfo,
+      const void*                 pShaderBytecode,
+      const DxsoAnalysisInfo&     AnalysisInfo);
+
+    ~D3D9ShaderCompileJob();
+
+    Rc<DxvkShader> GetShader() {
+      this->wait();
+      return m_shader;
+    }
+
+    const std::vector<uint8_t>& GetBytecode() const {
+      return m_bytecode;
+    }
+
+    const DxsoIsgn& GetIsgn() {
+      this->wait();
+      return m_isgn;
+    }
+
+    const DxsoShaderMetaInfo& GetMeta() {
+      this->wait();
+      return m_meta;
+    }
+
+    const DxsoDefinedConstants& GetConstants() {
+      this->wait();
+      return m_constants;
+    }
+
+    uint32_t GetUsedSamplers() {
+      this->wait();
+      return m_usedSamplers;
+    }
+
+    uint32_t GetUsedRTs() {
+      this->wait();
+      return m_usedRTs;
+    }
+
+    const DxvkShaderKey& GetShaderKey() const {
+      return m_key;
+    }
+
+    const DxsoModuleInfo& GetModuleInfo() const {
+      return m_moduleInfo;
+    }
+
+    const DxsoAnalysisInfo& GetAnalysis() const {
+      return m_analysis;
+    }
+
+    /**
+     * \brief Reports a failed translation
+     *
+     * Logs an error the first time a shader that
+     * failed to compile is used by the device.
+     */
+    void ReportFailure();
+
+  protected:
+
+    void run() final;
+
+  private:
+
+    DxvkDevice*           m_device;
+    DxvkShaderKey         m_key;
+    DxsoModuleInfo        m_moduleInfo;
+    DxsoAnalysisInfo      m_analysis;
+
+    std::vector<uint8_t>  m_bytecode;
+
+    DxsoIsgn              m_isgn;
+    uint32_t              m_usedSamplers = 0;
+    uint32_t              m_usedRTs      = 0;
+
+    DxsoShaderMetaInfo    m_meta;
+    DxsoDefinedConstants  m_constants;
+
+    Rc<DxvkShader>        m_shader;
+
+    std::atomic<bool>     m_failureReported = { false };
+
+    void Compile();
+
+    bool LoadFromCache(
+            std::istream&         Stream);
+
+    void StoreToCache(
+            std::ostream&         Stream) const;
+
+    static Sha1Hash GetCacheKey(
+      const DxvkShaderKey*        pShaderKey,
+      const DxsoModuleInfo*       pDxsoModuleInfo);
+
+  };
+
+
+  /**
+   * \brief Shader variant set
+   *
+   * Stores variants of a shader that were compiled with
+   * its integer and bool constants baked in, so that
+   * loops and branches depending on them can be folded.
+   * The number of variants is limited, and the least
+   * recently used one is replaced when a new one is
+   * needed. Shaders whose constants change too often
+   * will stop being specialized. Must only be used
+   * while the device is locked.
+   */
+  class D3D9ShaderVariantSet : public RcObject {
+
+  public:
+
+    D3D9ShaderVariantSet(
+            DxvkDevice*               pDevice,
+      const Rc<D3D9ShaderCompileJob>& BaseJob);
+
+    /**
+     * \brief Looks up specialized shader
+     *
+     * Queues a compile job if no variant for the given
+     * constant values exists yet. Until that job has
+     * finished, the generic shader should be used.
+     * \param [in] Spec Constant values
+     * \param [out] pPending Set to \c true if the variant
+     *    is being compiled and should be queried again
+     * \returns Specialized shader, or \c nullptr
+     */
+    Rc<DxvkShader> GetShader(
+      const DxsoConstantSpecialization& Spec,
+            bool*                       pPending);
+
+  private:
+
+    struct Variant {
+      DxsoConstantSpecialization  spec;
+      Rc<D3D9ShaderCompileJob>    job;
+      uint64_t                    lastUse = 0;
+    };
+
+    static constexpr uint32_t MaxVariants  = 8;
+    static constexpr uint32_t MaxEvictions = 4 * MaxVariants;
+
+    DxvkDevice*                   m_device;
+    Rc<D3D9ShaderCompileJob>      m_baseJob;
+
+    std::vector<Variant>          m_variants;
+    size_t                        m_lastVariant = 0;
+    uint64_t                      m_useCounter  = 0;
+    uint32_t                      m_evictions   = 0;
+
+    Rc<D3D9ShaderCompileJob> CreateJob(
+      const DxsoConstantSpecialization& Spec) const;
+
+  };
+
+
   /**
    * \brief Common shader object
    * 
    * Stores the compiled SPIR-V shader and the SHA-1
    * hash of the original DXBC shader, which can be
-   * used to identify the shader.
+   * used to identify the shader. The shader may be
+   * translated asynchronously, in which case the
+   * first access to any shader data waits for it.
    */
   class D3D9CommonShader {
 
@@ -28,46 +204,64 @@ namespace dxvk {
 
 
     Rc<DxvkShader> GetShader() const {
-      return m_shader;
+      Rc<DxvkShader> shader = m_job->GetShader();
+
+      if (unlikely(shader == nullptr))
+        m_job->ReportFailure();
+
+      return shader;
     }
 
     std::string GetName() const {
-      return m_shader->debugName();
+      return m_name;
     }
 
     const std::vector<uint8_t>& GetBytecode() const {
-      return m_bytecode;
+      return m_job->GetBytecode();
     }
 
     const DxsoIsgn& GetIsgn() const {
-      return m_isgn;
+      return m_job->GetIsgn();
     }
 
-    const DxsoShaderMetaInfo& GetMeta() const { return m_meta; }
-    const DxsoDefinedConstants& GetConstants() const { return m_constants; }
+    /**
+     * \brief Checks whether translation has finished
+     *
+     * If so, shader data can be accessed without
+     * blocking the calling thread.
+     */
+    bool IsTranslated() const {
+      return m_job->isDone();
+    }
+
+    const DxsoShaderMetaInfo& GetMeta() const { return m_job->GetMeta(); }
+    const DxsoDefinedConstants& GetConstants() const { return m_job->GetConstants(); }
     bool IsSamplerUsed(uint32_t index) const {
-      return m_usedSamplers & (1u << index);
+      return m_job->GetUsedSamplers() & (1u << index);
     }
 
     bool IsRTUsed(uint32_t index) const {
-      return m_usedRTs & (1u << index);
+      return m_job->GetUsedRTs() & (1u << index);
     }
 
     const DxsoProgramInfo& GetInfo() const { return m_info; }
 
-  private:
-
-    DxsoIsgn              m_isgn;
-    uint32_t              m_usedSamplers;
-    uint32_t              m_usedRTs;
+    /**
+     * \brief Specialized shader variants
+     * \returns Variant set, or \c nullptr if constant
+     *    specialization is disabled
+     */
+    const Rc<D3D9ShaderVariantSet>& GetVariants() const {
+      return m_variants;
+    }
 
-    DxsoProgramInfo       m_info;
-    DxsoShaderMetaInfo    m_meta;
-    DxsoDefinedConstants  m_constants;
+  private:
 
-    Rc<DxvkShader>        m_shader;
+    std::string               m_name;
+    DxsoProgramInfo           m_info;
 
-    std::vector<uint8_t>  m_bytecode;
+    Rc<D3D9ShaderCompileJob>  m_job;
+    Rc<D3D9ShaderVariantSet>  m_variants;
 
   };
 
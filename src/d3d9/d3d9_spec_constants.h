@@ -13,4 +13,92 @@ namespace dxvk {
     PixelFogMode    = 5,
   };
 
-}
\ No newline at end of file
+  /**
+   * \brief Dynamic spec constant value
+   *
+   * If the alpha compare op or a fog mode spec constant
+   * has this value, shaders read the actual state from
+   * the render state push constant block instead.
+   */
+  constexpr uint32_t D3D9SpecConstantDynamic = ~0u;
+
+  /**
+   * \brief Spec constant groups
+   *
+   * Groups of render states which can be provided
+   * either through spec constants or dynamically.
+   */
+  enum class D3D9SpecStateGroup : uint32_t {
+    AlphaTest = 0,
+    Fog       = 1,
+    Count
+  };
+
+  /**
+   * \brief Spec constant churn tracker
+   *
+   * Counts how often the render states of a group change
+   * per frame. Groups that change often enough to cause
+   * a large number of pipeline variants are switched to
+   * dynamic values, and switched back once they did not
+   * change for a while, so that static states still get
+   * fully specialized pipelines.
+   */
+  class D3D9SpecStateChurn {
+
+  public:
+
+    bool IsDynamic() const {
+      return m_dynamic;
+    }
+
+    /**
+     * \brief Records a state change
+     *
+     * \param [in] value Packed spec constant values
+     * \returns \c true if the values differ from
+     *    the ones recorded by the previous change
+     */
+    bool RecordChange(uint32_t value) {
+      bool changed = value != m_value;
+
+      m_changes += 1;
+      m_value    = value;
+      return changed;
+    }
+
+    /**
+     * \brief Ends the current frame
+     * \returns \c true if the group switched between
+     *    spec constants and dynamic values
+     */
+    bool EndFrame() {
+      bool wasDynamic = m_dynamic;
+
+      if (!m_dynamic) {
+        m_dynamic = m_changes >= EnableThreshold;
+      } else {
+        m_quietFrames = m_changes ? 0 : m_quietFrames + 1;
+        m_dynamic     = m_quietFrames < DisableFrames;
+      }
+
+      if (m_dynamic != wasDynamic)
+        m_quietFrames = 0;
+
+      m_changes = 0;
+      return m_dynamic != wasDynamic;
+    }
+
+  private:
+
+    static constexpr uint32_t EnableThreshold = 8;
+    static constexpr uint32_t DisableFrames   = 600;
+
+    uint32_t m_changes     = 0;
+    uint32_t m_quietFrames = 0;
+    uint32_t m_value       = ~0u;
+    bool     m_dynamic     = false;
+
+  };
+
+}
@@ -3,10 +3,12 @@
 #include "d3d9_caps.h"
 #include "d3d9_constant_set.h"
 #include "../dxso/dxso_common.h"
+#include "../util/util_bit.h"
 #include "../util/util_matrix.h"
 
 #include <array>
 #include <bitset>
+#include <cstring>
 #include <optional>
 
 namespace dxvk {
@@ -38,6 +40,13 @@ namespace dxvk {
     float fogDensity = 1.0f;
 
     float alphaRef   = 0.0f;
+
+    // Only read if the corresponding spec
+    // constants are set to dynamic values
+    uint32_t alphaFunc     = VK_COMPARE_OP_ALWAYS;
+    uint32_t fogEnabled    = 0;
+    uint32_t vertexFogMode = 0;
+    uint32_t pixelFogMode  = 0;
   };
 
   enum class D3D9RenderStateItem {
@@ -46,6 +55,10 @@ namespace dxvk {
     FogEnd,
     FogDensity,
     AlphaRef,
+    AlphaFunc,
+    FogEnabled,
+    VertexFogMode,
+    PixelFogMode,
     Count
   };
 
@@ -96,6 +109,45 @@ namespace dxvk {
   };
 
 
+  /**
+   * \brief Packed fixed-function vertex shader key
+   *
+   * Read by the fixed-function uber vertex shader
+   * instead of compiling the key into the shader.
+   * Each texcoord entry stores the texcoord index
+   * in bits 0-7, the texcoord generation mode in
+   * bits 8-15 and the transform flags in 16-23.
+   */
+  struct alignas(16) D3D9FFUberKeyVS {
+    uint32_t Flags;
+    uint32_t LightCount;
+    uint32_t MaterialSources;
+    uint32_t Reserved;
+
+    std::array<uint32_t, caps::TextureStageCount> Texcoords;
+  };
+
+
+  /**
+   * \brief Packed fixed-function pixel shader key
+   *
+   * Read by the fixed-function uber pixel shader. The
+   * color and alpha words of each stage store the op
+   * in bits 0-7, followed by one byte per argument.
+   */
+  struct alignas(16) D3D9FFUberKeyFS {
+    uint32_t Flags;
+    uint32_t Reserved[3];
+
+    struct Stage {
+      uint32_t Color;
+      uint32_t Alpha;
+      uint32_t Flags;
+      uint32_t Reserved;
+    } Stages[caps::TextureStageCount];
+  };
+
+
   struct D3D9FixedFunctionVS {
     Matrix4 WorldView;
     Matrix4 NormalMatrix;
@@ -108,11 +160,15 @@ namespace dxvk {
     Vector4 GlobalAmbient;
     std::array<D3D9Light, caps::MaxEnabledLights> Lights;
     D3DMATERIAL9 Material;
+
+    D3D9FFUberKeyVS UberKey;
   };
 
 
   struct D3D9FixedFunctionPS {
     Vector4 textureFactor;
+
+    D3D9FFUberKeyFS UberKey;
   };
 
   struct D3D9SharedPS {
@@ -252,6 +308,52 @@ namespace dxvk {
       : UpdateHelper(pState->psConsts);
   }
 
+  template <
+    DxsoProgramType  ProgramType,
+    D3D9ConstantType ConstantType,
+    typename         T>
+  bool StateConstantsDiffer(
+    const D3D9CapturableState* pState,
+          UINT                 StartRegister,
+    const T*                   pConstantData,
+          UINT                 Count,
+          bool                 FloatEmu) {
+    auto CompareHelper = [&] (const auto& set) {
+      if constexpr (ConstantType == D3D9ConstantType::Float) {
+        auto src = reinterpret_cast<const Vector4*>(pConstantData);
+
+        if (!FloatEmu)
+          return std::memcmp(&set.fConsts[StartRegister], src, Count * sizeof(Vector4)) != 0;
+
+        for (uint32_t i = 0; i < Count; i++) {
+          Vector4 value = replaceNaN(src[i]);
+
+          if (std::memcmp(&set.fConsts[StartRegister + i], &value, sizeof(Vector4)))
+            return true;
+        }
+
+        return false;
+      }
+      else if constexpr (ConstantType == D3D9ConstantType::Int) {
+        return std::memcmp(&set.iConsts[StartRegister], pConstantData, Count * sizeof(Vector4i)) != 0;
+      }
+      else {
+        for (uint32_t i = 0; i < Count; i++) {
+          const uint32_t idxBit = 1u << (StartRegister + i);
+
+          if (bool(set.boolBitfield & idxBit) != bool(pConstantData[i]))
+            return true;
+        }
+
+        return false;
+      }
+    };
+
+    return ProgramType == DxsoProgramTypes::VertexShader
+      ? CompareHelper(pState->vsConsts)
+      : CompareHelper(pState->psConsts);
+  }
+
   enum class D3D9CapturedStateFlag : uint32_t {
     VertexDecl,
     Indices,
@@ -277,36 +379,45 @@ namespace dxvk {
   struct D3D9StateCaptures {
     D3D9CapturedStateFlags flags;
 
-    std::bitset<RenderStateCount>                       renderStates;
+    bit::bitset<RenderStateCount>                       renderStates;
 
-    std::bitset<SamplerCount>                           samplers;
+    bit::bitset<SamplerCount>                           samplers;
     std::array<
-      std::bitset<SamplerStateCount>,
+      bit::bitset<SamplerStateCount>,
       SamplerCount>                                     samplerStates;
 
-    std::bitset<caps::MaxStreams>                       vertexBuffers;
-    std::bitset<SamplerCount>                           textures;
-    std::bitset<caps::MaxClipPlanes>                    clipPlanes;
-    std::bitset<caps::MaxStreams>                       streamFreq;
-    std::bitset<caps::MaxTransforms>                    transforms;
-    std::bitset<caps::TextureStageCount>                textureStages;
+    bit::bitset<caps::MaxStreams>                       vertexBuffers;
+    bit::bitset<SamplerCount>                           textures;
+    bit::bitset<caps::MaxClipPlanes>                    clipPlanes;
+    bit::bitset<caps::MaxStreams>                       streamFreq;
+    bit::bitset<caps::MaxTransforms>                    transforms;
+    bit::bitset<caps::TextureStageCount>                textureStages;
     std::array<
-      std::bitset<D3DTSS_CONSTANT>,
+      bit::bitset<D3DTSS_CONSTANT>,
       caps::TextureStageCount>                          textureStageStates;
 
     struct {
-      std::bitset<caps::MaxFloatConstantsVS>            fConsts;
-      std::bitset<caps::MaxOtherConstants>              iConsts;
-      std::bitset<caps::MaxOtherConstants>              bConsts;
+      bit::bitset<caps::MaxFloatConstantsVS>            fConsts;
+      bit::bitset<caps::MaxOtherConstants>              iConsts;
+      bit::bitset<caps::MaxOtherConstants>              bConsts;
     } vsConsts;
 
     struct {
-      std::bitset<caps::MaxFloatConstantsPS>            fConsts;
-      std::bitset<caps::MaxOtherConstants>              iConsts;
-      std::bitset<caps::MaxOtherConstants>              bConsts;
+      bit::bitset<caps::MaxFloatConstantsPS>            fConsts;
+      bit::bitset<caps::MaxOtherConstants>              iConsts;
+      bit::bitset<caps::MaxOtherConstants>              bConsts;
     } psConsts;
   };
 
+  // State blocks scan most capture masks as a single dword
+  static_assert(SamplerCount              <= 32
+             && SamplerStateCount         <= 32
+             && caps::MaxStreams          <= 32
+             && caps::MaxClipPlanes       <= 32
+             && caps::TextureStageCount   <= 32
+             && D3DTSS_CONSTANT           <= 32
+             && caps::MaxOtherConstants   <= 32);
+
   struct Direct3DState9 : public D3D9CapturableState {
     Direct3DState9() {
       for (uint32_t i = 0; i < renderTargets.size(); i++)
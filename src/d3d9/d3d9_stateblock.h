@@ -120,43 +120,29 @@ namespace dxvk {
         dst->SetVertexDeclaration(src->vertexDecl);
 
       if (m_captures.flags.test(D3D9CapturedStateFlag::StreamFreq)) {
-        for (uint32_t i = 0; i < caps::MaxStreams; i++) {
-          if (m_captures.streamFreq[i])
-            dst->SetStreamSourceFreq(i, src->streamFreq[i]);
-        }
+        for (uint32_t i : bit::BitMask(m_captures.streamFreq.dword(0)))
+          dst->SetStreamSourceFreq(i, src->streamFreq[i]);
       }
 
       if (m_captures.flags.test(D3D9CapturedStateFlag::Indices))
         dst->SetIndices(src->indices);
 
-      if (m_captures.flags.test(D3D9CapturedStateFlag::RenderStates)) {
-        for (uint32_t i = 0; i < m_captures.renderStates.size(); i++) {
-          if (m_captures.renderStates[i])
-            dst->SetRenderState(D3DRENDERSTATETYPE(i), src->renderStates[i]);
-        }
-      }
+      if (m_captures.flags.test(D3D9CapturedStateFlag::RenderStates))
+        dst->SetRenderStates(m_captures.renderStates, src->renderStates.data());
 
       if (m_captures.flags.test(D3D9CapturedStateFlag::SamplerStates)) {
-        for (uint32_t i = 0; i < m_captures.samplerStates.size(); i++) {
-          if (m_captures.samplers[i]) {
-            for (uint32_t j = 0; j < m_captures.samplerStates[i].size(); j++) {
-              if (m_captures.samplerStates[i][j])
-                dst->SetStateSamplerState(i, D3DSAMPLERSTATETYPE(j), src->samplerStates[i][j]);
-            }
-          }
-        }
+        for (uint32_t i : bit::BitMask(m_captures.samplers.dword(0)))
+          dst->SetStateSamplerStates(i, m_captures.samplerStates[i].dword(0), src->samplerStates[i].data());
       }
 
       if (m_captures.flags.test(D3D9CapturedStateFlag::VertexBuffers)) {
-        for (uint32_t i = 0; i < m_captures.vertexBuffers.size(); i++) {
-          if (m_captures.vertexBuffers[i]) {
-            const auto& vbo = src->vertexBuffers[i];
-            dst->SetStreamSource(
-              i,
-              vbo.vertexBuffer,
-              vbo.offset,
-              vbo.stride);
-          }
+        for (uint32_t i : bit::BitMask(m_captures.vertexBuffers.dword(0))) {
+          const auto& vbo = src->vertexBuffers[i];
+          dst->SetStreamSource(
+            i,
+            vbo.vertexBuffer,
+            vbo.offset,
+            vbo.stride);
         }
       }
 
@@ -164,10 +150,8 @@ namespace dxvk {
         dst->SetMaterial(&src->material);
 
       if (m_captures.flags.test(D3D9CapturedStateFlag::Textures)) {
-        for (uint32_t i = 0; i < m_captures.textures.size(); i++) {
-          if (m_captures.textures[i])
-            dst->SetStateTexture(i, src->textures[i]);
-        }
+        for (uint32_t i : bit::BitMask(m_captures.textures.dword(0)))
+          dst->SetStateTexture(i, src->textures[i]);
       }
 
       if (m_captures.flags.test(D3D9CapturedStateFlag::VertexShader))
@@ -177,21 +161,17 @@ namespace dxvk {
         dst->SetPixelShader(src->pixelShader);
 
       if (m_captures.flags.test(D3D9CapturedStateFlag::Transforms)) {
-        for (uint32_t i = 0; i < m_captures.transforms.size(); i++) {
-          if (m_captures.transforms[i])
-            dst->SetStateTransform(i, reinterpret_cast<const D3DMATRIX*>(&src->transforms[i]));
+        for (uint32_t i = 0; i < m_captures.transforms.dwordCount(); i++) {
+          for (uint32_t t : bit::BitMask(m_captures.transforms.dword(i))) {
+            uint32_t idx = i * 32 + t;
+            dst->SetStateTransform(idx, reinterpret_cast<const D3DMATRIX*>(&src->transforms[idx]));
+          }
         }
       }
 
       if (m_captures.flags.test(D3D9CapturedStateFlag::TextureStages)) {
-        for (uint32_t i = 0; i < m_captures.textureStages.size(); i++) {
-          if (m_captures.textureStages[i]) {
-            for (uint32_t j = 0; j < m_captures.textureStageStates[i].size(); j++) {
-              if (m_captures.textureStageStates[i][j])
-                dst->SetTextureStageState(i, (D3DTEXTURESTAGESTATETYPE)j, src->textureStages[i][j]);
-            }
-          }
-        }
+        for (uint32_t i : bit::BitMask(m_captures.textureStages.dword(0)))
+          dst->SetTextureStageStates(i, m_captures.textureStageStates[i].dword(0), src->textureStages[i].data());
       }
 
       if (m_captures.flags.test(D3D9CapturedStateFlag::Viewport))
@@ -201,50 +181,32 @@ namespace dxvk {
         dst->SetScissorRect(&src->scissorRect);
 
       if (m_captures.flags.test(D3D9CapturedStateFlag::ClipPlanes)) {
-        for (uint32_t i = 0; i < m_captures.clipPlanes.size(); i++) {
-          if (m_captures.clipPlanes[i])
-            dst->SetClipPlane(i, src->clipPlanes[i].coeff);
-        }
+        for (uint32_t i : bit::BitMask(m_captures.clipPlanes.dword(0)))
+          dst->SetClipPlane(i, src->clipPlanes[i].coeff);
       }
 
       if (m_captures.flags.test(D3D9CapturedStateFlag::VsConstants)) {
-        for (uint32_t i = 0; i < m_captures.vsConsts.fConsts.size(); i++) {
-          if (m_captures.vsConsts.fConsts[i])
-            dst->SetVertexShaderConstantF(i, (float*)&src->vsConsts.fConsts[i], 1);
-        }
+        m_captures.vsConsts.fConsts.forEachRange([&] (uint32_t first, uint32_t count) {
+          dst->SetVertexShaderConstantF(first, (float*)&src->vsConsts.fConsts[first], count);
+        });
 
-        for (uint32_t i = 0; i < m_captures.vsConsts.iConsts.size(); i++) {
-          if (m_captures.vsConsts.iConsts[i])
-            dst->SetVertexShaderConstantI(i, (int*)&src->vsConsts.iConsts[i], 1);
-        }
-
-        uint32_t boolMask = 0;
-        for (uint32_t i = 0; i < m_captures.vsConsts.bConsts.size(); i++) {
-          if (m_captures.vsConsts.bConsts[i])
-            boolMask |= 1u << i;
-        }
+        m_captures.vsConsts.iConsts.forEachRange([&] (uint32_t first, uint32_t count) {
+          dst->SetVertexShaderConstantI(first, (int*)&src->vsConsts.iConsts[first], count);
+        });
 
-        dst->SetVertexBoolBitfield(boolMask, src->vsConsts.boolBitfield);
+        dst->SetVertexBoolBitfield(m_captures.vsConsts.bConsts.dword(0), src->vsConsts.boolBitfield);
       }
 
       if (m_captures.flags.test(D3D9CapturedStateFlag::PsConstants)) {
-        for (uint32_t i = 0; i < m_captures.psConsts.fConsts.size(); i++) {
-          if (m_captures.psConsts.fConsts[i])
-            dst->SetPixelShaderConstantF(i, (float*)&src->psConsts.fConsts[i], 1);
-        }
+        m_captures.psConsts.fConsts.forEachRange([&] (uint32_t first, uint32_t count) {
+          dst->SetPixelShaderConstantF(first, (float*)&src->psConsts.fConsts[first], count);
+        });
 
-        for (uint32_t i = 0; i < m_captures.psConsts.iConsts.size(); i++) {
-          if (m_captures.psConsts.iConsts[i])
-            dst->SetPixelShaderConstantI(i, (int*)&src->psConsts.iConsts[i], 1);
-        }
+        m_captures.psConsts.iConsts.forEachRange([&] (uint32_t first, uint32_t count) {
+          dst->SetPixelShaderConstantI(first, (int*)&src->psConsts.iConsts[first], count);
+        });
 
-        uint32_t boolMask = 0;
-        for (uint32_t i = 0; i < m_captures.psConsts.bConsts.size(); i++) {
-          if (m_captures.psConsts.bConsts[i])
-            boolMask |= 1u << i;
-        }
-
-        dst->SetPixelBoolBitfield(boolMask, src->psConsts.boolBitfield);
+        dst->SetPixelBoolBitfield(m_captures.psConsts.bConsts.dword(0), src->psConsts.boolBitfield);
       }
     }
 
@@ -273,11 +235,11 @@ namespace dxvk {
         for (uint32_t i = 0; i < Count; i++) {
           uint32_t reg = StartRegister + i;
           if      constexpr (ConstantType == D3D9ConstantType::Float)
-            setCaptures.fConsts[reg] = true;
+            setCaptures.fConsts.set(reg, true);
           else if constexpr (ConstantType == D3D9ConstantType::Int)
-            setCaptures.iConsts[reg] = true;
+            setCaptures.iConsts.set(reg, true);
           else if constexpr (ConstantType == D3D9ConstantType::Bool)
-            setCaptures.bConsts[reg] = true;
+            setCaptures.bConsts.set(reg, true);
         }
 
         UpdateStateConstants<
@@ -301,6 +263,20 @@ namespace dxvk {
     HRESULT SetVertexBoolBitfield(uint32_t mask, uint32_t bits);
     HRESULT SetPixelBoolBitfield(uint32_t mask, uint32_t bits);
 
+    HRESULT SetRenderStates(
+      const bit::bitset<RenderStateCount>& Mask,
+      const DWORD*                         pValues);
+
+    HRESULT SetStateSamplerStates(
+            DWORD               StateSampler,
+            uint32_t            Mask,
+      const DWORD*              pValues);
+
+    HRESULT SetTextureStageStates(
+            DWORD               Stage,
+            uint32_t            Mask,
+      const DWORD*              pValues);
+
     inline bool IsApplying() {
       return m_applying;
     }
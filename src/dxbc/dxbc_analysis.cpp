@@ -27,6 +27,14 @@ namespace dxvk {
   
   
   void DxbcAnalyzer::processInstruction(const DxbcShaderInstruction& ins) {
+    if (!m_analysis->xRegInfos.empty()) {
+      for (uint32_t i = 0; i < ins.dstCount; i++)
+        analyzeOperand(ins.dst[i]);
+      
+      for (uint32_t i = 0; i < ins.srcCount; i++)
+        analyzeOperand(ins.src[i]);
+    }
+    
     switch (ins.opClass) {
       case DxbcInstClass::Atomic: {
         const uint32_t operandId = ins.dstCount - 1;
@@ -37,6 +45,23 @@ namespace dxvk {
         }
       } break;
       
+      case DxbcInstClass::Declaration: {
+        if (ins.op == DxbcOpcode::DclIndexableTemp) {
+          const uint32_t registerId = ins.imm[0].u32;
+          
+          if (registerId >= m_analysis->xRegInfos.size())
+            m_analysis->xRegInfos.resize(registerId + 1);
+          
+          // Hull shader phases may declare the same array
+          // multiple times, so use the smallest size seen
+          DxbcXregInfo& info = m_analysis->xRegInfos[registerId];
+          
+          info.alength = info.alength
+            ? std::min(info.alength, ins.imm[1].u32)
+            : ins.imm[1].u32;
+        }
+      } break;
+      
       case DxbcInstClass::TextureSample:
       case DxbcInstClass::VectorDeriv: {
         m_analysis->usesDerivatives = true;
@@ -58,6 +83,28 @@ namespace dxvk {
   }
   
   
+  void DxbcAnalyzer::analyzeOperand(const DxbcRegister& reg) {
+    for (uint32_t i = 0; i < reg.idxDim; i++) {
+      if (reg.idx[i].relReg != nullptr)
+        analyzeOperand(*reg.idx[i].relReg);
+    }
+    
+    // Arrays accessed with a relative or out-of-bounds
+    // index must remain arrays in the generated code
+    if (reg.type == DxbcOperandType::IndexableTemp) {
+      const uint32_t registerId = reg.idx[0].offset;
+      
+      if (registerId < m_analysis->xRegInfos.size()) {
+        DxbcXregInfo& info = m_analysis->xRegInfos[registerId];
+        
+        if (reg.idx[1].relReg != nullptr
+         || uint32_t(reg.idx[1].offset) >= info.alength)
+          info.dynamicIndexing = true;
+      }
+    }
+  }
+  
+  
   DxbcClipCullInfo DxbcAnalyzer::getClipCullInfo(const Rc<DxbcIsgn>& sgn) const {
     DxbcClipCullInfo result;
     
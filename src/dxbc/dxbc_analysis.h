@@ -21,6 +21,18 @@ namespace dxvk {
     bool accessAtomicOp  = false;
   };
   
+  /**
+   * \brief Info about indexable temp arrays
+   * 
+   * Arrays that are only ever accessed with
+   * immediate, in-bounds indices can be lowered
+   * to individual registers by the compiler.
+   */
+  struct DxbcXregInfo {
+    uint32_t alength          = 0;
+    bool     dynamicIndexing  = false;
+  };
+  
   /**
    * \brief Counts cull and clip distances
    */
@@ -34,6 +46,7 @@ namespace dxvk {
    */
   struct DxbcAnalysisInfo {
     std::array<DxbcUavInfo, 64> uavInfos;
+    std::vector<DxbcXregInfo>   xRegInfos;
     
     DxbcClipCullInfo clipCullIn;
     DxbcClipCullInfo clipCullOut;
@@ -78,6 +91,9 @@ namespace dxvk {
     
     DxbcAnalysisInfo* m_analysis = nullptr;
     
+    void analyzeOperand(
+      const DxbcRegister&       reg);
+    
     DxbcClipCullInfo getClipCullInfo(
       const Rc<DxbcIsgn>& sgn) const;
     
@@ -249,13 +249,18 @@ namespace dxvk {
         shaderOptions.xfbStrides[i] = m_moduleInfo.xfb->strides[i];
     }
 
+    SpirvCodeBuffer code = m_module.compile();
+
+    if (m_moduleInfo.options.optimizeShaders)
+      code = SpirvOptimizer::optimize(std::move(code));
+
     // Create the shader module object
     return new DxvkShader(
       m_programInfo.shaderStage(),
       m_resourceSlots.size(),
       m_resourceSlots.data(),
       m_interfaceSlots,
-      m_module.compile(),
+      std::move(code),
       shaderOptions,
       std::move(m_immConstData));
   }
@@ -398,11 +403,30 @@ namespace dxvk {
     if (regId >= m_xRegs.size())
       m_xRegs.resize(regId + 1);
     
-    m_xRegs.at(regId).ccount = info.type.ccount;
-    m_xRegs.at(regId).varId  = emitNewVariable(info);
-    
-    m_module.setDebugName(m_xRegs.at(regId).varId,
-      str::format("x", regId).c_str());
+    DxbcXreg& xReg = m_xRegs.at(regId);
+    xReg.ccount = info.type.ccount;
+    xReg.varId  = 0;
+    xReg.elementIds.clear();
+    
+    // Arrays that are only indexed with immediate values
+    // are lowered to one register per element, so that
+    // the driver does not have to keep them in memory.
+    bool promote = regId < m_analysis->xRegInfos.size()
+      && !m_analysis->xRegInfos[regId].dynamicIndexing;
+    
+    if (promote) {
+      DxbcRegisterInfo elementInfo = info;
+      elementInfo.type.alength = 0;
+      
+      for (uint32_t i = 0; i < info.type.alength; i++) {
+        const uint32_t varId = emitNewVariable(elementInfo);
+        m_module.setDebugName(varId, str::format("x", regId, "_", i).c_str());
+        xReg.elementIds.push_back(varId);
+      }
+    } else {
+      xReg.varId = emitNewVariable(info);
+      m_module.setDebugName(xReg.varId, str::format("x", regId).c_str());
+    }
   }
   
   
@@ -2260,9 +2284,12 @@ namespace dxvk {
     }
     
     // Retrieve destination pointer for the atomic operation>
-    const DxbcRegisterPointer pointer = emitGetAtomicPointer(
+    const DxbcRegisterValue address = emitCalcAtomicAddress(
       ins.dst[ins.dstCount - 1], ins.src[0]);
     
+    const DxbcRegisterPointer pointer = emitGetAtomicPointer(
+      ins.dst[ins.dstCount - 1], address);
+    
     // Load source values
     std::array<DxbcRegisterValue, 2> src;
     
@@ -2289,6 +2316,13 @@ namespace dxvk {
     const uint32_t scopeId     = m_module.constu32(scope);
     const uint32_t semanticsId = m_module.constu32(semantics);
     
+    // Aggregate additions to UAVs within the subgroup. Only do
+    // this on compute to avoid having to deal with helper
+    // invocations, same as for append/consume counters.
+    const bool useSubgroupOps = isUav
+      && m_moduleInfo.options.useSubgroupOpsForAtomics
+      && m_programInfo.type() == DxbcProgramType::ComputeShader;
+    
     // Perform the atomic operation on the given pointer
     DxbcRegisterValue value;
     value.type = pointer.type;
@@ -2314,9 +2348,12 @@ namespace dxvk {
       
       case DxbcOpcode::AtomicIAdd:
       case DxbcOpcode::ImmAtomicIAdd:
-        value.id = m_module.opAtomicIAdd(typeId,
-          pointer.id, scopeId, semanticsId,
-          src[0].id);
+        value.id = useSubgroupOps
+          ? emitSubgroupAtomicIAdd(pointer, address,
+              src[0].id, scopeId, semanticsId, isImm)
+          : m_module.opAtomicIAdd(typeId,
+              pointer.id, scopeId, semanticsId,
+              src[0].id);
         break;
       
       case DxbcOpcode::AtomicAnd:
@@ -2536,6 +2573,102 @@ namespace dxvk {
   }
   
   
+  uint32_t DxbcCompiler::emitSubgroupAtomicIAdd(
+    const DxbcRegisterPointer&    pointer,
+    const DxbcRegisterValue&      address,
+          uint32_t                value,
+          uint32_t                scopeId,
+          uint32_t                semanticsId,
+          bool                    needsResult) {
+    m_module.enableCapability(spv::CapabilityGroupNonUniform);
+    m_module.enableCapability(spv::CapabilityGroupNonUniformBallot);
+    m_module.enableCapability(spv::CapabilityGroupNonUniformVote);
+    m_module.enableCapability(spv::CapabilityGroupNonUniformArithmetic);
+    
+    const uint32_t typeId = getVectorTypeId(pointer.type);
+    const uint32_t subgroupScopeId = m_module.constu32(spv::ScopeSubgroup);
+    
+    // We can only combine the operations of all active lanes
+    // if they access the same address, otherwise we need to
+    // fall back to performing one atomic op per invocation.
+    uint32_t isUniform = m_module.opGroupNonUniformAllEqual(
+      m_module.defBoolType(), subgroupScopeId, address.id);
+    
+    uint32_t labelUniform   = m_module.allocateId();
+    uint32_t labelDivergent = m_module.allocateId();
+    uint32_t labelEnd       = m_module.allocateId();
+    
+    m_module.opSelectionMerge(labelEnd, spv::SelectionControlMaskNone);
+    m_module.opBranchConditional(isUniform, labelUniform, labelDivergent);
+    
+    // Uniform address: One elected lane adds the sum of all
+    // values, and each lane computes its own result from the
+    // broadcasted old value and its exclusive prefix sum.
+    m_module.opLabel(labelUniform);
+    
+    uint32_t total = m_module.opGroupNonUniformIAdd(typeId,
+      subgroupScopeId, spv::GroupOperationReduce, value);
+    
+    uint32_t offset = needsResult
+      ? m_module.opGroupNonUniformIAdd(typeId,
+          subgroupScopeId, spv::GroupOperationExclusiveScan, value)
+      : 0;
+    
+    uint32_t election = m_module.opGroupNonUniformElect(
+      m_module.defBoolType(), subgroupScopeId);
+    
+    DxbcConditional elect;
+    elect.labelIf  = m_module.allocateId();
+    elect.labelEnd = m_module.allocateId();
+    
+    m_module.opSelectionMerge(elect.labelEnd, spv::SelectionControlMaskNone);
+    m_module.opBranchConditional(election, elect.labelIf, elect.labelEnd);
+    
+    m_module.opLabel(elect.labelIf);
+    
+    uint32_t uniformResult = m_module.opAtomicIAdd(typeId,
+      pointer.id, scopeId, semanticsId, total);
+    
+    m_module.opBranch(elect.labelEnd);
+    m_module.opLabel (elect.labelEnd);
+    
+    if (needsResult) {
+      std::array<SpirvPhiLabel, 2> phiLabels = {{
+        { uniformResult,                 elect.labelIf },
+        { m_module.constUndef(typeId),   labelUniform  },
+      }};
+      
+      uniformResult = m_module.opPhi(typeId,
+        phiLabels.size(), phiLabels.data());
+      uniformResult = m_module.opGroupNonUniformBroadcastFirst(typeId,
+        subgroupScopeId, uniformResult);
+      uniformResult = m_module.opIAdd(typeId, uniformResult, offset);
+    }
+    
+    m_module.opBranch(labelEnd);
+    
+    // Divergent addresses: Regular atomic op per invocation
+    m_module.opLabel(labelDivergent);
+    
+    uint32_t divergentResult = m_module.opAtomicIAdd(typeId,
+      pointer.id, scopeId, semanticsId, value);
+    
+    m_module.opBranch(labelEnd);
+    m_module.opLabel (labelEnd);
+    
+    if (!needsResult)
+      return 0;
+    
+    std::array<SpirvPhiLabel, 2> phiLabels = {{
+      { uniformResult,   elect.labelEnd },
+      { divergentResult, labelDivergent },
+    }};
+    
+    return m_module.opPhi(typeId,
+      phiLabels.size(), phiLabels.data());
+  }
+  
+  
   void DxbcCompiler::emitBarrier(const DxbcShaderInstruction& ins) {
     // sync takes no operands. Instead, the synchronization
     // scope is defined by the operand control bits.
@@ -4581,6 +4714,14 @@ namespace dxvk {
     //    (1) element index (relative)
     const uint32_t regId = operand.idx[0].offset;
     
+    if (!m_xRegs.at(regId).elementIds.empty()) {
+      DxbcRegisterPointer result;
+      result.type.ctype  = DxbcScalarType::Float32;
+      result.type.ccount = m_xRegs[regId].ccount;
+      result.id = m_xRegs[regId].elementIds.at(operand.idx[1].offset);
+      return result;
+    }
+    
     const DxbcRegisterValue vectorId
       = emitIndexLoad(operand.idx[1]);
     
@@ -4859,13 +5000,50 @@ namespace dxvk {
   }
   
   
-  DxbcRegisterPointer DxbcCompiler::emitGetAtomicPointer(
+  DxbcRegisterValue DxbcCompiler::emitCalcAtomicAddress(
     const DxbcRegister&           operand,
     const DxbcRegister&           address) {
-    // Query information about the resource itself
     const uint32_t registerId = operand.idx[0].offset;
     const DxbcBufferInfo resourceInfo = getBufferInfo(operand);
     
+    bool isTgsm = operand.type == DxbcOperandType::ThreadGroupSharedMemory;
+    
+    // Compute the actual address into the resource
+    switch (resourceInfo.type) {
+      case DxbcResourceType::Raw:
+        return emitCalcBufferIndexRaw(emitRegisterLoad(
+          address, DxbcRegMask(true, false, false, false)));
+        
+      case DxbcResourceType::Structured: {
+        const DxbcRegisterValue addressComponents = emitRegisterLoad(
+          address, DxbcRegMask(true, true, false, false));
+        
+        return emitCalcBufferIndexStructured(
+          emitRegisterExtract(addressComponents, DxbcRegMask(true, false, false, false)),
+          emitRegisterExtract(addressComponents, DxbcRegMask(false, true, false, false)),
+          resourceInfo.stride);
+      };
+      
+      case DxbcResourceType::Typed: {
+        if (isTgsm)
+          throw DxvkError("DxbcCompiler: TGSM cannot be typed");
+        
+        return emitLoadTexCoord(address,
+          m_uavs.at(registerId).imageInfo);
+      }
+      
+      default:
+        throw DxvkError("DxbcCompiler: Unhandled resource type");
+    }
+  }
+  
+  
+  DxbcRegisterPointer DxbcCompiler::emitGetAtomicPointer(
+    const DxbcRegister&           operand,
+    const DxbcRegisterValue&      address) {
+    // Query information about the resource itself
+    const DxbcBufferInfo resourceInfo = getBufferInfo(operand);
+    
     // For UAVs and shared memory, different methods
     // of obtaining the final pointer are used.
     bool isTgsm = operand.type == DxbcOperandType::ThreadGroupSharedMemory;
@@ -4873,36 +5051,6 @@ namespace dxvk {
                && resourceInfo.type != DxbcResourceType::Typed
                && !isTgsm;
     
-    // Compute the actual address into the resource
-    const DxbcRegisterValue addressValue = [&] {
-      switch (resourceInfo.type) {
-        case DxbcResourceType::Raw:
-          return emitCalcBufferIndexRaw(emitRegisterLoad(
-            address, DxbcRegMask(true, false, false, false)));
-          
-        case DxbcResourceType::Structured: {
-          const DxbcRegisterValue addressComponents = emitRegisterLoad(
-            address, DxbcRegMask(true, true, false, false));
-          
-          return emitCalcBufferIndexStructured(
-            emitRegisterExtract(addressComponents, DxbcRegMask(true, false, false, false)),
-            emitRegisterExtract(addressComponents, DxbcRegMask(false, true, false, false)),
-            resourceInfo.stride);
-        };
-        
-        case DxbcResourceType::Typed: {
-          if (isTgsm)
-            throw DxvkError("DxbcCompiler: TGSM cannot be typed");
-          
-          return emitLoadTexCoord(address,
-            m_uavs.at(registerId).imageInfo);
-        }
-        
-        default:
-          throw DxvkError("DxbcCompiler: Unhandled resource type");
-      }
-    }();
-    
     // Compute the actual pointer
     DxbcRegisterPointer result;
     result.type.ctype  = resourceInfo.stype;
@@ -4910,15 +5058,15 @@ namespace dxvk {
 
     if (isTgsm) {
       result.id = m_module.opAccessChain(resourceInfo.typeId,
-        resourceInfo.varId, 1, &addressValue.id);
+        resourceInfo.varId, 1, &address.id);
     } else if (isSsbo) {
-      uint32_t indices[2] = { m_module.constu32(0), addressValue.id };
+      uint32_t indices[2] = { m_module.constu32(0), address.id };
       result.id = m_module.opAccessChain(resourceInfo.typeId,
         resourceInfo.varId, 2, indices);
     } else {
       result.id = m_module.opImageTexelPointer(
         m_module.defPointerType(getVectorTypeId(result.type), spv::StorageClassImage),
-        resourceInfo.varId, addressValue.id, m_module.constu32(0));
+        resourceInfo.varId, address.id, m_module.constu32(0));
     }
 
     return result;
@@ -6480,6 +6628,15 @@ namespace dxvk {
       spv::BuiltInCullDistance,
       spv::StorageClassOutput);
     
+    // Write stream output data directly from the vertex
+    // shader, rather than using a pass-through GS for it
+    if (m_moduleInfo.xfb != nullptr) {
+      m_module.enableCapability(spv::CapabilityTransformFeedback);
+      m_module.setExecutionMode(m_entryPointId, spv::ExecutionModeXfb);
+
+      emitXfbOutputDeclarations();
+    }
+    
     // Main function of the vertex shader
     m_vs.functionId = m_module.allocateId();
     m_module.setDebugName(m_vs.functionId, "vs_main");
@@ -6690,6 +6847,7 @@ namespace dxvk {
     this->emitOutputSetup();
     this->emitClipCullStore(DxbcSystemValue::ClipDistance, m_clipDistances);
     this->emitClipCullStore(DxbcSystemValue::CullDistance, m_cullDistances);
+    this->emitXfbOutputSetup(0, false);
     this->emitFunctionEnd();
   }
   
@@ -6798,6 +6956,11 @@ namespace dxvk {
   void DxbcCompiler::emitXfbOutputDeclarations() {
     for (uint32_t i = 0; i < m_moduleInfo.xfb->entryCount; i++) {
       const DxbcXfbEntry* xfbEntry = m_moduleInfo.xfb->entries + i;
+
+      // Only geometry shaders can write to streams other than 0
+      if (xfbEntry->streamId != 0 && m_programInfo.type() != DxbcProgramType::GeometryShader)
+        continue;
+
       const DxbcSgnEntry* sigEntry = m_osgn->find(
         xfbEntry->semanticName,
         xfbEntry->semanticIndex,
@@ -6830,8 +6993,11 @@ namespace dxvk {
         str::format("xfb", i).c_str());
       
       m_module.decorateXfb(xfbVar.varId,
-        xfbEntry->streamId, xfbEntry->bufferId, xfbEntry->offset,
+        xfbEntry->bufferId, xfbEntry->offset,
         m_moduleInfo.xfb->strides[xfbEntry->bufferId]);
+
+      if (m_programInfo.type() == DxbcProgramType::GeometryShader)
+        m_module.decorateStream(xfbVar.varId, xfbEntry->streamId);
     }
 
     // TODO Compact location/component assignment
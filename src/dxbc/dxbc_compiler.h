@@ -4,6 +4,7 @@
 #include <vector>
 
 #include "../spirv/spirv_module.h"
+#include "../spirv/spirv_optimizer.h"
 
 #include "dxbc_analysis.h"
 #include "dxbc_chunk_isgn.h"
@@ -85,6 +86,7 @@ namespace dxvk {
   struct DxbcXreg {
     uint32_t ccount = 0;
     uint32_t varId  = 0;
+    std::vector<uint32_t> elementIds;
   };
   
   
@@ -673,6 +675,14 @@ namespace dxvk {
     void emitAtomicCounter(
       const DxbcShaderInstruction&  ins);
     
+    uint32_t emitSubgroupAtomicIAdd(
+      const DxbcRegisterPointer&    pointer,
+      const DxbcRegisterValue&      address,
+            uint32_t                value,
+            uint32_t                scopeId,
+            uint32_t                semanticsId,
+            bool                    needsResult);
+    
     void emitBarrier(
       const DxbcShaderInstruction&  ins);
     
@@ -900,10 +910,14 @@ namespace dxvk {
     DxbcRegisterPointer emitGetOperandPtr(
       const DxbcRegister&           operand);
     
-    DxbcRegisterPointer emitGetAtomicPointer(
+    DxbcRegisterValue emitCalcAtomicAddress(
       const DxbcRegister&           operand,
       const DxbcRegister&           address);
     
+    DxbcRegisterPointer emitGetAtomicPointer(
+      const DxbcRegister&           operand,
+      const DxbcRegisterValue&      address);
+    
     ///////////////////////////////
     // Resource load/store methods
     DxbcRegisterValue emitRawBufferLoad(
@@ -357,4 +357,99 @@ namespace dxvk {
     }
   }
   
-}
\ No newline at end of file
+  
+  DxbcInstructionList::DxbcInstructionList() {
+    
+  }
+  
+  
+  DxbcInstructionList::DxbcInstructionList(DxbcCodeSlice code) {
+    struct InstructionOperands {
+      uint32_t dstIndex;
+      uint32_t srcIndex;
+      uint32_t immIndex;
+    };
+    
+    struct RelativeIndex {
+      uint32_t regIndex;
+      uint32_t dimIndex;
+      uint32_t relIndex;
+    };
+    
+    // Operand arrays may be reallocated while decoding,
+    // so we store array indices and resolve them to
+    // pointers once all instructions are decoded.
+    std::vector<InstructionOperands> operands;
+    std::vector<RelativeIndex>       relIndices;
+    
+    // Count instructions up front to avoid reallocations.
+    // Most instructions have two or three operands.
+    uint32_t instructionCount = 0;
+    
+    for (DxbcCodeSlice slice = code; !slice.atEnd(); instructionCount++) {
+      const uint32_t token = slice.at(0);
+      const uint32_t length = bit::extract(token, 0, 10) == uint32_t(DxbcOpcode::CustomData)
+        ? slice.at(1) : bit::extract(token, 24, 30);
+      
+      if (!length)
+        break;
+      
+      slice = slice.skip(length);
+    }
+    
+    m_instructions.reserve(instructionCount);
+    m_registers.reserve(instructionCount * 3);
+    operands.reserve(instructionCount);
+    
+    DxbcDecodeContext decoder;
+    
+    while (!code.atEnd()) {
+      decoder.decodeInstruction(code);
+      
+      const DxbcShaderInstruction& ins = decoder.getInstruction();
+      
+      InstructionOperands entry;
+      entry.dstIndex = m_registers.size();
+      m_registers.insert(m_registers.end(), ins.dst, ins.dst + ins.dstCount);
+      
+      entry.srcIndex = m_registers.size();
+      m_registers.insert(m_registers.end(), ins.src, ins.src + ins.srcCount);
+      
+      entry.immIndex = m_immediates.size();
+      m_immediates.insert(m_immediates.end(), ins.imm, ins.imm + ins.immCount);
+      
+      // Relative indices point into the decode context, which
+      // remains valid until the next instruction is decoded.
+      // Registers appended here are processed by the same loop
+      // in case they use relative indexing themselves.
+      for (uint32_t i = entry.dstIndex; i < m_registers.size(); i++) {
+        for (uint32_t j = 0; j < DxbcMaxRegIndexDim; j++) {
+          const DxbcRegister* relReg = m_registers[i].idx[j].relReg;
+          
+          if (relReg != nullptr) {
+            relIndices.push_back({ i, j, uint32_t(m_registers.size()) });
+            m_registers.push_back(*relReg);
+          }
+        }
+      }
+      
+      operands.push_back(entry);
+      m_instructions.push_back(ins);
+    }
+    
+    for (const auto& rel : relIndices)
+      m_registers[rel.regIndex].idx[rel.dimIndex].relReg = &m_registers[rel.relIndex];
+    
+    for (size_t i = 0; i < m_instructions.size(); i++) {
+      m_instructions[i].dst = m_registers.data() + operands[i].dstIndex;
+      m_instructions[i].src = m_registers.data() + operands[i].srcIndex;
+      m_instructions[i].imm = m_immediates.data() + operands[i].immIndex;
+    }
+  }
+  
+  
+  DxbcInstructionList::~DxbcInstructionList() {
+    
+  }
+  
+}
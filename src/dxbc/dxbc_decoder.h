@@ -1,6 +1,7 @@
 #pragma once
 
 #include <array>
+#include <vector>
 
 #include "dxbc_common.h"
 #include "dxbc_decoder.h"
@@ -375,7 +376,8 @@ namespace dxvk {
    * Note that this structure may store pointer to
    * external structures, such as the original code
    * buffer. This is safe to use if and only if:
-   * - The \ref DxbcDecodeContext that created it
+   * - The \ref DxbcDecodeContext or the
+   *   \ref DxbcInstructionList that created it
    *   still exists and was not moved
    * - The code buffer that was being decoded
    *   still exists and was not moved.
@@ -494,4 +496,57 @@ namespace dxvk {
     
   };
   
+  
+  /**
+   * \brief Decoded instruction list
+   * 
+   * Decodes an entire code slice once and stores all
+   * instructions in flat arrays, so that multiple passes
+   * over the shader can iterate over the decoded form
+   * without parsing operand tokens again. Instructions
+   * point into this object's operand arrays, and custom
+   * data blocks point into the original code buffer,
+   * which must therefore outlive the list.
+   */
+  class DxbcInstructionList {
+    
+  public:
+    
+    DxbcInstructionList();
+    DxbcInstructionList(DxbcCodeSlice code);
+    
+    DxbcInstructionList             (const DxbcInstructionList&) = delete;
+    DxbcInstructionList& operator = (const DxbcInstructionList&) = delete;
+    
+    ~DxbcInstructionList();
+    
+    /**
+     * \brief Number of instructions
+     * \returns Instruction count
+     */
+    size_t size() const {
+      return m_instructions.size();
+    }
+    
+    /**
+     * \brief Retrieves an instruction
+     * 
+     * \param [in] index Instruction index
+     * \returns Reference to the decoded instruction
+     */
+    const DxbcShaderInstruction& operator [] (size_t index) const {
+      return m_instructions[index];
+    }
+    
+    auto begin() const { return m_instructions.cbegin(); }
+    auto end()   const { return m_instructions.cend(); }
+    
+  private:
+    
+    std::vector<DxbcShaderInstruction> m_instructions;
+    std::vector<DxbcRegister>          m_registers;
+    std::vector<DxbcImmediate>         m_immediates;
+    
+  };
+  
 }
@@ -46,6 +46,10 @@ namespace dxvk {
     if (m_shexChunk == nullptr)
       throw DxvkError("DxbcModule::compile: No SHDR/SHEX chunk");
     
+    // Decode the shader once so that the analyzer
+    // and compiler can both use the decoded code
+    DxbcInstructionList instructions(m_shexChunk->slice());
+    
     DxbcAnalysisInfo analysisInfo;
     
     DxbcAnalyzer analyzer(moduleInfo,
@@ -53,7 +57,7 @@ namespace dxvk {
       m_isgnChunk, m_osgnChunk,
       m_psgnChunk, analysisInfo);
     
-    this->runAnalyzer(analyzer, m_shexChunk->slice());
+    this->runAnalyzer(analyzer, instructions);
     
     DxbcCompiler compiler(
       fileName, moduleInfo,
@@ -61,7 +65,7 @@ namespace dxvk {
       m_isgnChunk, m_osgnChunk,
       m_psgnChunk, analysisInfo);
     
-    this->runCompiler(compiler, m_shexChunk->slice());
+    this->runCompiler(compiler, instructions);
     
     return compiler.finalize();
   }
@@ -87,30 +91,18 @@ namespace dxvk {
 
 
   void DxbcModule::runAnalyzer(
-          DxbcAnalyzer&       analyzer,
-          DxbcCodeSlice       slice) const {
-    DxbcDecodeContext decoder;
-    
-    while (!slice.atEnd()) {
-      decoder.decodeInstruction(slice);
-      
-      analyzer.processInstruction(
-        decoder.getInstruction());
-    }
+          DxbcAnalyzer&         analyzer,
+    const DxbcInstructionList&  instructions) const {
+    for (const auto& ins : instructions)
+      analyzer.processInstruction(ins);
   }
   
   
   void DxbcModule::runCompiler(
-          DxbcCompiler&       compiler,
-          DxbcCodeSlice       slice) const {
-    DxbcDecodeContext decoder;
-    
-    while (!slice.atEnd()) {
-      decoder.decodeInstruction(slice);
-      
-      compiler.processInstruction(
-        decoder.getInstruction());
-    }
+          DxbcCompiler&         compiler,
+    const DxbcInstructionList&  instructions) const {
+    for (const auto& ins : instructions)
+      compiler.processInstruction(ins);
   }
   
 }
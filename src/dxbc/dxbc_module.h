@@ -84,12 +84,12 @@ namespace dxvk {
     Rc<DxbcShex> m_shexChunk;
     
     void runAnalyzer(
-            DxbcAnalyzer&       analyzer,
-            DxbcCodeSlice       slice) const;
+            DxbcAnalyzer&         analyzer,
+      const DxbcInstructionList&  instructions) const;
     
     void runCompiler(
-            DxbcCompiler&       compiler,
-            DxbcCodeSlice       slice) const;
+            DxbcCompiler&         compiler,
+      const DxbcInstructionList&  instructions) const;
     
   };
   
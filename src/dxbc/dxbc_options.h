@@ -21,6 +21,10 @@ namespace dxvk {
     /// atomic operations for append/consume buffers.
     bool useSubgroupOpsForAtomicCounters = false;
 
+    /// Use subgroup operations to aggregate atomic
+    /// additions to the same UAV address.
+    bool useSubgroupOpsForAtomics = false;
+
     /// Use a SPIR-V extension to implement D3D-style discards
     bool useDemoteToHelperInvocation = false;
 
@@ -42,6 +46,9 @@ namespace dxvk {
     /// Clear thread-group shared memory to zero
     bool zeroInitWorkgroupMemory = false;
 
+    /// Run the SPIR-V optimizer on translated shaders
+    bool optimizeShaders = false;
+
     /// Minimum storage buffer alignment
     VkDeviceSize minSsboAlignment = 0;
   };
@@ -10,6 +10,33 @@ namespace dxvk {
     const DxsoInstructionContext& ctx) {
     DxsoOpcode opcode = ctx.instruction.opcode;
 
+    // Constants defined in the shader are not read from the
+    // constant buffer, unless they are relatively addressed
+    if (opcode == DxsoOpcode::Def && ctx.dst.id.num < m_definedConstantsF.size())
+      m_definedConstantsF.set(ctx.dst.id.num);
+
+    for (uint32_t i = 0; i < ctx.srcCount; i++) {
+      const DxsoRegister& reg = ctx.src[i];
+
+      if (reg.id.type != DxsoRegisterType::Const)
+        continue;
+
+      // Matrix instructions read one register per matrix row
+      uint32_t regCount = i == 1 ? getMatrixRowCount(opcode) : 1;
+
+      if (reg.hasRelative || reg.id.num + regCount > m_analysis->usedConstantsF.size()) {
+        m_analysis->relativeConstantsF = true;
+        continue;
+      }
+
+      for (uint32_t j = reg.id.num; j < reg.id.num + regCount; j++) {
+        if (!m_definedConstantsF.test(j))
+          m_analysis->usedConstantsF.set(j);
+      }
+    }
+
+    this->validateControlFlow(opcode);
+
     if (opcode == DxsoOpcode::TexKill)
       m_analysis->usesKill = true;
 
@@ -40,6 +67,68 @@ namespace dxvk {
       m_analysis->usesDerivatives = true;
   }
 
+  void DxsoAnalyzer::validateControlFlow(DxsoOpcode opcode) {
+    // Mirrors the checks done by the compiler, so that shaders it
+    // would reject fail at creation time even if the translation
+    // itself is deferred to a worker thread.
+    switch (opcode) {
+      case DxsoOpcode::If:
+      case DxsoOpcode::Ifc:
+        m_controlFlowBlocks.push_back({ false, false });
+        break;
+
+      case DxsoOpcode::Else:
+        if (m_controlFlowBlocks.empty()
+         || m_controlFlowBlocks.back().isLoop
+         || m_controlFlowBlocks.back().hasElse)
+          throw DxvkError("DxsoAnalyzer: 'Else' without 'If' found");
+        m_controlFlowBlocks.back().hasElse = true;
+        break;
+
+      case DxsoOpcode::EndIf:
+        if (m_controlFlowBlocks.empty()
+         || m_controlFlowBlocks.back().isLoop)
+          throw DxvkError("DxsoAnalyzer: 'EndIf' without 'If' found");
+        m_controlFlowBlocks.pop_back();
+        break;
+
+      case DxsoOpcode::Rep:
+      case DxsoOpcode::Loop:
+        m_controlFlowBlocks.push_back({ true, false });
+        m_loopDepth += 1;
+        break;
+
+      case DxsoOpcode::EndRep:
+      case DxsoOpcode::EndLoop:
+        if (m_controlFlowBlocks.empty()
+         || !m_controlFlowBlocks.back().isLoop)
+          throw DxvkError("DxsoAnalyzer: 'EndRep' without 'Rep' or 'Loop' found");
+        m_controlFlowBlocks.pop_back();
+        m_loopDepth -= 1;
+        break;
+
+      case DxsoOpcode::Break:
+      case DxsoOpcode::BreakC:
+        if (!m_loopDepth)
+          throw DxvkError("DxsoAnalyzer: 'Break' outside 'Rep' or 'Loop' found");
+        break;
+
+      default:
+        break;
+    }
+  }
+
+  uint32_t DxsoAnalyzer::getMatrixRowCount(DxsoOpcode opcode) {
+    switch (opcode) {
+      case DxsoOpcode::M3x2: return 2;
+      case DxsoOpcode::M3x3: return 3;
+      case DxsoOpcode::M3x4: return 4;
+      case DxsoOpcode::M4x3: return 3;
+      case DxsoOpcode::M4x4: return 4;
+      default:               return 1;
+    }
+  }
+
   void DxsoAnalyzer::finalize(size_t tokenCount) {
     m_analysis->bytecodeByteLength = tokenCount * sizeof(uint32_t);
   }
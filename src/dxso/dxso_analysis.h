@@ -1,8 +1,13 @@
 #pragma once
 
+#include <bitset>
+#include <vector>
+
 #include "dxso_modinfo.h"
 #include "dxso_decoder.h"
 
+#include "../d3d9/d3d9_caps.h"
+
 namespace dxvk {
 
   struct DxsoAnalysisInfo {
@@ -10,6 +15,13 @@ namespace dxvk {
 
     bool usesDerivatives = false;
     bool usesKill        = false;
+
+    /// Float constants that are read from the constant
+    /// buffer, i.e. not defined before they are used
+    std::bitset<caps::MaxFloatConstantsSoftware> usedConstantsF;
+
+    /// Whether float constants are relatively addressed
+    bool relativeConstantsF = false;
   };
 
   class DxsoAnalyzer {
@@ -32,6 +44,20 @@ namespace dxvk {
 
     DxsoAnalysisInfo* m_analysis = nullptr;
 
+    struct ControlFlowBlock {
+      bool isLoop;
+      bool hasElse;
+    };
+
+    std::bitset<caps::MaxFloatConstantsSoftware> m_definedConstantsF;
+
+    std::vector<ControlFlowBlock> m_controlFlowBlocks;
+    uint32_t                      m_loopDepth = 0;
+
+    void validateControlFlow(DxsoOpcode opcode);
+
+    static uint32_t getMatrixRowCount(DxsoOpcode opcode);
+
   };
 
 }
\ No newline at end of file
@@ -53,6 +53,25 @@ namespace dxvk {
     for (uint32_t i = 0; i < m_cBool.size(); i++)
       m_cBool.at(i)  = 0;
 
+    // Specialized constants behave like defined ones, so
+    // any defi or defb instruction will override them.
+    const auto& spec = m_moduleInfo.specConsts;
+
+    for (uint32_t mask = spec.intMask; mask; mask &= mask - 1) {
+      uint32_t i = bit::tzcnt(mask);
+      const auto& data = spec.ints[i];
+
+      m_cInt.at(i) = m_module.constvec4i32(data[0], data[1], data[2], data[3]);
+      m_module.setDebugName(m_cInt.at(i), str::format("cI", i, "_spec").c_str());
+    }
+
+    for (uint32_t mask = spec.boolMask; mask; mask &= mask - 1) {
+      uint32_t i = bit::tzcnt(mask);
+
+      m_cBool.at(i) = m_module.constBool((spec.bools >> i) & 1);
+      m_module.setDebugName(m_cBool.at(i), str::format("cB", i, "_spec").c_str());
+    }
+
     m_vs.addr        = DxsoRegisterPointer{ };
     m_vs.oPos        = DxsoRegisterPointer{ };
     m_fog            = DxsoRegisterPointer{ };
@@ -204,13 +223,18 @@ namespace dxvk {
 
     DxvkShaderConstData constData = { };
 
+    SpirvCodeBuffer code = m_module.compile();
+
+    if (m_moduleInfo.options.optimizeShaders)
+      code = SpirvOptimizer::optimize(std::move(code));
+
     // Create the shader module object
     return new DxvkShader(
       m_programInfo.shaderStage(),
       m_resourceSlots.size(),
       m_resourceSlots.data(),
       m_interfaceSlots,
-      m_module.compile(),
+      std::move(code),
       shaderOptions,
       std::move(constData));
   }
@@ -220,6 +244,7 @@ namespace dxvk {
     m_module.enableCapability(spv::CapabilityShader);
     m_module.enableCapability(spv::CapabilityImageQuery);
 
+    this->initConstantLayout();
     this->emitDclConstantBuffer();
     this->emitDclInputArray();
 
@@ -233,6 +258,52 @@ namespace dxvk {
   }
 
 
+  void DxsoCompiler::initConstantLayout() {
+    // If float constants are never relatively addressed, we know
+    // exactly which ones the shader reads, so only those need to
+    // be uploaded. Pack them without gaps in register order.
+    if (m_analysis->relativeConstantsF)
+      return;
+
+    const auto& used = m_analysis->usedConstantsF;
+    uint32_t count = getFloatConstantCount();
+
+    // Registers past the end of the constant array have no
+    // slot in the packed layout, so keep the regular one.
+    if ((used >> count).any())
+      return;
+
+    m_cFloatIndex.resize(count, UnmappedConstantIndex);
+
+    uint32_t packedIndex = 0;
+
+    for (uint32_t i = 0; i < count; i++) {
+      if (!used.test(i))
+        continue;
+
+      m_cFloatIndex[i] = packedIndex++;
+      m_meta.maxConstIndexF = i + 1;
+
+      if (!m_meta.constantRangesF.empty()
+       && m_meta.constantRangesF.back().first
+        + m_meta.constantRangesF.back().count == i)
+        m_meta.constantRangesF.back().count += 1;
+      else
+        m_meta.constantRangesF.push_back({ i, 1 });
+    }
+
+    // A single range starting at c0 is already what
+    // the regular layout uploads, so don't bother
+    m_meta.packedConstantsF = m_meta.constantRangesF.size() > 1
+      || (m_meta.constantRangesF.size() == 1 && m_meta.constantRangesF[0].first != 0);
+
+    if (!m_meta.packedConstantsF) {
+      m_meta.constantRangesF.clear();
+      m_cFloatIndex.clear();
+    }
+  }
+
+
   void DxsoCompiler::emitDclConstantBuffer() {
     std::array<uint32_t, 3> members = {
       // float f[256 or 224]
@@ -830,9 +901,13 @@ namespace dxvk {
 
         if (!relative) {
           result.id = m_cFloat.at(reg.id.num);
-          m_meta.maxConstIndexF = std::max(m_meta.maxConstIndexF, reg.id.num + 1);
-          // TODO: Remove me for proper SWVP impl.
-          m_meta.maxConstIndexF = std::min(m_meta.maxConstIndexF, getFloatConstantCount());
+
+          // Defined constants are not read from the buffer
+          if (!result.id) {
+            m_meta.maxConstIndexF = std::max(m_meta.maxConstIndexF, reg.id.num + 1);
+            // TODO: Remove me for proper SWVP impl.
+            m_meta.maxConstIndexF = std::min(m_meta.maxConstIndexF, getFloatConstantCount());
+          }
         } else {
           m_meta.maxConstIndexF = getFloatConstantCount();
           m_meta.needsConstantCopies |= m_moduleInfo.options.strictConstantCopies
@@ -860,7 +935,18 @@ namespace dxvk {
     if (result.id)
       return result;
 
-    uint32_t relativeIdx = this->emitArrayIndex(reg.id.num, relative);
+    uint32_t constIdx = reg.id.num;
+
+    if (reg.id.type == DxsoRegisterType::Const && !m_cFloatIndex.empty()) {
+      constIdx = m_cFloatIndex.at(constIdx);
+
+      // Every register the compiler reads must have been seen by
+      // the analysis pass, otherwise we'd silently read slot 0
+      if (constIdx == UnmappedConstantIndex)
+        throw DxvkError(str::format("DxsoCompiler: Constant c", reg.id.num, " not in packed layout"));
+    }
+
+    uint32_t relativeIdx = this->emitArrayIndex(constIdx, relative);
 
     if (reg.id.type != DxsoRegisterType::ConstBool) {
       uint32_t structIdx = reg.id.type == DxsoRegisterType::Const
@@ -3090,15 +3176,20 @@ void DxsoCompiler::emitControlFlowGenericLoop(
   void DxsoCompiler::setupRenderStateInfo() {
     uint32_t boolType  = m_module.defBoolType();
     uint32_t floatType = m_module.defFloatType(32);
+    uint32_t uintType  = m_module.defIntType(32, 0);
     uint32_t vec3Type  = m_module.defVectorType(floatType, 3);
     uint32_t floatPtr  = m_module.defPointerType(floatType, spv::StorageClassPushConstant);
 
-    std::array<uint32_t, 5> rsMembers = {{
+    std::array<uint32_t, 9> rsMembers = {{
       vec3Type,
       floatType,
       floatType,
       floatType,
-      floatType
+      floatType,
+      uintType,
+      uintType,
+      uintType,
+      uintType,
     }};
     
     uint32_t rsStruct = m_module.defStructTypeUnique(rsMembers.size(), rsMembers.data());
@@ -3118,14 +3209,23 @@ void DxsoCompiler::emitControlFlowGenericLoop(
     m_module.memberDecorateOffset (rsStruct, 3, offsetof(D3D9RenderStateInfo, fogDensity));
     m_module.setDebugMemberName   (rsStruct, 4, "alpha_ref");
     m_module.memberDecorateOffset (rsStruct, 4, offsetof(D3D9RenderStateInfo, alphaRef));
+    m_module.setDebugMemberName   (rsStruct, 5, "alpha_func");
+    m_module.memberDecorateOffset (rsStruct, 5, offsetof(D3D9RenderStateInfo, alphaFunc));
+    m_module.setDebugMemberName   (rsStruct, 6, "fog_enabled");
+    m_module.memberDecorateOffset (rsStruct, 6, offsetof(D3D9RenderStateInfo, fogEnabled));
+    m_module.setDebugMemberName   (rsStruct, 7, "vertex_fog_mode");
+    m_module.memberDecorateOffset (rsStruct, 7, offsetof(D3D9RenderStateInfo, vertexFogMode));
+    m_module.setDebugMemberName   (rsStruct, 8, "pixel_fog_mode");
+    m_module.memberDecorateOffset (rsStruct, 8, offsetof(D3D9RenderStateInfo, pixelFogMode));
     
     m_module.setDebugName         (m_rsBlock, "render_state");
 
-    // Only need alpha ref for PS 3.
+    // Only need alpha ref and func for PS 3.
     // No FF fog component.
     if (m_programInfo.majorVersion() == 3) {
       m_interfaceSlots.pushConstOffset = offsetof(D3D9RenderStateInfo, alphaRef);
-      m_interfaceSlots.pushConstSize   = sizeof(float);
+      m_interfaceSlots.pushConstSize   = offsetof(D3D9RenderStateInfo, fogEnabled)
+                                       - offsetof(D3D9RenderStateInfo, alphaRef);
     }
     else {
       m_interfaceSlots.pushConstOffset = 0;
@@ -3150,6 +3250,7 @@ void DxsoCompiler::emitControlFlowGenericLoop(
     D3D9FogContext fogCtx;
     fogCtx.IsPixel     = true;
     fogCtx.RangeFog    = false;
+    fogCtx.DynamicSpecConstants = m_moduleInfo.options.dynamicSpecConstants;
     fogCtx.RenderState = m_rsBlock;
     fogCtx.vPos        = m_module.opLoad(getVectorTypeId(vPosPtr.type),    vPosPtr.id);
     fogCtx.vFog        = m_module.opLoad(getVectorTypeId(vFogPtr.type),    vFogPtr.id);
@@ -3219,9 +3320,13 @@ void DxsoCompiler::emitControlFlowGenericLoop(
       uint32_t alphaRefId = m_module.opLoad(floatType,
         m_module.opAccessChain(floatPtr, m_rsBlock, 1, &alphaRefMember));
       
+      uint32_t alphaFunc = m_moduleInfo.options.dynamicSpecConstants
+        ? DoDynamicSpecConstant(m_module, m_rsBlock, alphaFuncId, D3D9RenderStateItem::AlphaFunc)
+        : alphaFuncId;
+      
       // switch (alpha_func) { ... }
       m_module.opSelectionMerge(atestTestLabel, spv::SelectionControlMaskNone);
-      m_module.opSwitch(alphaFuncId,
+      m_module.opSwitch(alphaFunc,
         atestCaseLabels[uint32_t(VK_COMPARE_OP_ALWAYS)].labelId,
         atestCaseLabels.size(),
         atestCaseLabels.data());
@@ -7,6 +7,7 @@
 
 #include "../d3d9/d3d9_caps.h"
 #include "../spirv/spirv_module.h"
+#include "../spirv/spirv_optimizer.h"
 
 namespace dxvk {
 
@@ -285,6 +286,13 @@ namespace dxvk {
     std::array<uint32_t, caps::MaxOtherConstantsSoftware> m_cInt;
     std::array<uint32_t, caps::MaxOtherConstantsSoftware> m_cBool;
 
+    ////////////////////////////////////////
+    // Constant buffer index of each float
+    // constant if the constants are packed
+    static constexpr uint32_t UnmappedConstantIndex = ~0u;
+
+    std::vector<uint32_t> m_cFloatIndex;
+
     //////////////////////
     // Loop counter
     DxsoRegisterPointer m_loopCounter;
@@ -350,6 +358,8 @@ namespace dxvk {
     // Common shader dcls
     void emitDclConstantBuffer();
 
+    void initConstantLayout();
+
     void emitDclInputArray();
     void emitDclOutputArray();
 
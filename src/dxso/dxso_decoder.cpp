@@ -173,6 +173,8 @@ namespace dxvk {
     const uint32_t tokenLength =
       m_ctx.instruction.tokenLength;
 
+    m_ctx.srcCount = 0;
+
     switch (m_ctx.instruction.opcode) {
       case DxsoOpcode::If:
       case DxsoOpcode::Ifc:
@@ -187,6 +189,7 @@ namespace dxvk {
 
           sourceIdx++;
         }
+        m_ctx.srcCount = sourceIdx;
         return true;
       }
 
@@ -221,6 +224,7 @@ namespace dxvk {
             sourceIdx++;
           }
         }
+        m_ctx.srcCount = sourceIdx;
         return true;
       }
 
@@ -197,6 +197,7 @@ namespace dxvk {
     std::array<
       DxsoRegister,
       DxsoMaxOperandCount>      src;
+    uint32_t                    srcCount = 0;
 
     DxsoDefinition              def;
 
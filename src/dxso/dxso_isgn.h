@@ -29,11 +29,25 @@ namespace dxvk {
 
   using DxsoDefinedConstants = std::vector<DxsoDefinedConstant>;
 
+  /**
+   * \brief Range of consecutive float constants
+   */
+  struct DxsoConstantRange {
+    uint32_t first;
+    uint32_t count;
+  };
+
   struct DxsoShaderMetaInfo {
     bool needsConstantCopies = false;
     uint32_t maxConstIndexF = 0;
     uint32_t maxConstIndexI = 0;
     uint32_t maxConstIndexB = 0;
+
+    /// If set, the float constants read by the shader are packed
+    /// into the constant buffer in the order of these ranges,
+    /// rather than being stored at their register index.
+    bool packedConstantsF = false;
+    std::vector<DxsoConstantRange> constantRangesF;
   };
 
 }
\ No newline at end of file
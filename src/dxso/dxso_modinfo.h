@@ -2,8 +2,26 @@
 
 #include "dxso_options.h"
 
+#include "../d3d9/d3d9_caps.h"
+
 namespace dxvk {
 
+  /**
+   * \brief Integer and bool constant values
+   *
+   * Registers whose bit is set in the respective mask
+   * are compiled as constants with the given values,
+   * as if they were defined by \c defi or \c defb.
+   * This allows loops and branches that depend on
+   * them to be resolved by the driver's compiler.
+   */
+  struct DxsoConstantSpecialization {
+    uint32_t intMask  = 0;
+    uint32_t boolMask = 0;
+    uint32_t bools    = 0;
+    std::array<std::array<int32_t, 4>, caps::MaxOtherConstants> ints = { };
+  };
+
   /**
    * \brief Shader module info
    *
@@ -11,7 +29,8 @@ namespace dxvk {
    * This data can be supplied by the client API implementation.
    */
   struct DxsoModuleInfo {
-    DxsoOptions options;
+    DxsoOptions                 options;
+    DxsoConstantSpecialization  specConsts;
   };
 
-}
\ No newline at end of file
+}
@@ -33,6 +33,8 @@ namespace dxvk {
 
     strictPow            = options.strictPow;
     d3d9FloatEmulation   = options.d3d9FloatEmulation;
+    optimizeShaders      = device->config().optimizeShaders;
+    dynamicSpecConstants = options.adaptiveSpecConstants;
   }
 
 }
\ No newline at end of file
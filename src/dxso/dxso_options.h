@@ -30,6 +30,13 @@ namespace dxvk {
 
     /// Whether or not we should care about pow(0, 0) = 1
     bool strictPow;
+
+    /// Run the SPIR-V optimizer on translated shaders
+    bool optimizeShaders = false;
+
+    /// Emit the dynamic path for spec constants that
+    /// the device may serve from push constants instead
+    bool dynamicSpecConstants = false;
   };
 
 }
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include "dxvk_compute.h"
 #include "dxvk_device.h"
 #include "dxvk_pipemanager.h"
+#include "dxvk_pipetelemetry.h"
 #include "dxvk_spec_const.h"
 #include "dxvk_state_cache.h"
 
@@ -45,6 +46,8 @@ namespace dxvk {
     const DxvkComputePipelineStateInfo& state) {
     DxvkComputePipelineInstance* instance = nullptr;
 
+    auto t0 = DxvkPipelineTelemetry::Clock::now();
+
     { std::lock_guard<sync::Spinlock> lock(m_mutex);
 
       instance = this->findInstance(state);
@@ -60,17 +63,35 @@ namespace dxvk {
     if (!instance)
       return VK_NULL_HANDLE;
 
-    this->writePipelineStateToCache(state);
+    auto t1 = DxvkPipelineTelemetry::Clock::now();
+
+    DxvkStateCacheKey key = this->getStateCacheKey();
+
+    bool cached = this->writePipelineStateToCache(key, state);
+
+    m_pipeMgr->m_telemetry->addRecord(VK_PIPELINE_BIND_POINT_COMPUTE, key, cached
+      ? DxvkPipelineCompileSource::StateCacheHit
+      : DxvkPipelineCompileSource::DemandMiss, t0, t1);
     return instance->pipeline();
   }
 
 
   void DxvkComputePipeline::compilePipeline(
     const DxvkComputePipelineStateInfo& state) {
-    std::lock_guard<sync::Spinlock> lock(m_mutex);
+    DxvkPipelineTelemetry::TimePoint t0, t1;
 
-    if (!this->findInstance(state))
+    { std::lock_guard<sync::Spinlock> lock(m_mutex);
+
+      if (this->findInstance(state))
+        return;
+
+      t0 = DxvkPipelineTelemetry::Clock::now();
       this->createInstance(state);
+      t1 = DxvkPipelineTelemetry::Clock::now();
+    }
+
+    m_pipeMgr->m_telemetry->addRecord(VK_PIPELINE_BIND_POINT_COMPUTE,
+      this->getStateCacheKey(), DxvkPipelineCompileSource::Prewarm, t0, t1);
   }
   
   
@@ -112,13 +133,13 @@ namespace dxvk {
     DxvkShaderModuleCreateInfo moduleInfo;
     moduleInfo.fsDualSrcBlend = false;
 
-    auto csm = m_shaders.cs->createShaderModule(m_vkd, m_slotMapping, moduleInfo);
+    auto csm = m_pipeMgr->m_moduleCache->getShaderModule(m_shaders.cs, m_slotMapping, moduleInfo);
 
     VkComputePipelineCreateInfo info;
     info.sType                = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
     info.pNext                = nullptr;
     info.flags                = 0;
-    info.stage                = csm.stageInfo(&specInfo);
+    info.stage                = csm->stageInfo(&specInfo);
     info.layout               = m_layout->pipelineLayout();
     info.basePipelineHandle   = VK_NULL_HANDLE;
     info.basePipelineIndex    = -1;
@@ -128,12 +149,14 @@ namespace dxvk {
     
     VkPipeline pipeline = VK_NULL_HANDLE;
     if (m_vkd->vkCreateComputePipelines(m_vkd->device(),
-          m_pipeMgr->m_cache->handle(), 1, &info, nullptr, &pipeline) != VK_SUCCESS) {
+          m_pipeMgr->pipelineCache()->handle(), 1, &info, nullptr, &pipeline) != VK_SUCCESS) {
       Logger::err("DxvkComputePipeline: Failed to compile pipeline");
       Logger::err(str::format("  cs  : ", m_shaders.cs->debugName()));
       return VK_NULL_HANDLE;
     }
     
+    m_pipeMgr->pipelineCache()->update();
+
     auto t1 = std::chrono::high_resolution_clock::now();
     auto td = std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0);
     Logger::debug(str::format("DxvkComputePipeline: Finished in ", td.count(), " ms"));
@@ -146,17 +169,23 @@ namespace dxvk {
   }
   
   
-  void DxvkComputePipeline::writePipelineStateToCache(
+  bool DxvkComputePipeline::writePipelineStateToCache(
+    const DxvkStateCacheKey&            key,
     const DxvkComputePipelineStateInfo& state) const {
     if (m_pipeMgr->m_stateCache == nullptr)
-      return;
-    
+      return false;
+
+    return m_pipeMgr->m_stateCache->addComputePipeline(key, state);
+  }
+
+
+  DxvkStateCacheKey DxvkComputePipeline::getStateCacheKey() const {
     DxvkStateCacheKey key;
 
     if (m_shaders.cs != nullptr)
       key.cs = m_shaders.cs->getShaderKey();
 
-    m_pipeMgr->m_stateCache->addComputePipeline(key, state);
+    return key;
   }
   
 }
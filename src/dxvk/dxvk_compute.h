@@ -14,6 +14,7 @@ namespace dxvk {
   
   class DxvkDevice;
   class DxvkPipelineManager;
+  struct DxvkStateCacheKey;
   
   /**
    * \brief Shaders used in compute pipelines
@@ -152,9 +153,12 @@ namespace dxvk {
     void destroyPipeline(
             VkPipeline                    pipeline);
 
-    void writePipelineStateToCache(
+    bool writePipelineStateToCache(
+      const DxvkStateCacheKey&            key,
       const DxvkComputePipelineStateInfo& state) const;
     
+    DxvkStateCacheKey getStateCacheKey() const;
+    
   };
   
 }
\ No newline at end of file
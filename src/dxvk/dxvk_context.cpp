@@ -2347,6 +2347,13 @@ namespace dxvk {
   }
   
   
+  void DxvkContext::addStatCtr(
+          DxvkStatCounter     ctr,
+          uint32_t            val) {
+    m_cmd->addStatCtr(ctr, val);
+  }
+  
+  
   void DxvkContext::setPredicate(
     const DxvkBufferSlice&    predicate,
           VkConditionalRenderingFlagsEXT flags) {
@@ -4002,7 +4009,7 @@ namespace dxvk {
   
   
   void DxvkContext::updateTransformFeedbackBuffers() {
-    auto gsOptions = m_state.gp.shaders.gs->shaderOptions();
+    auto xfbOptions = m_state.gp.shaders.lastPreRasterizationStage()->shaderOptions();
 
     VkBuffer     xfbBuffers[MaxNumXfbBuffers];
     VkDeviceSize xfbOffsets[MaxNumXfbBuffers];
@@ -4020,7 +4027,7 @@ namespace dxvk {
       
       if (physSlice.handle != VK_NULL_HANDLE) {
         auto buffer = m_state.xfb.buffers[i].buffer();
-        buffer->setXfbVertexStride(gsOptions.xfbStrides[i]);
+        buffer->setXfbVertexStride(xfbOptions.xfbStrides[i]);
         
         m_cmd->trackResource(buffer);
       }
@@ -922,6 +922,18 @@ namespace dxvk {
             uint32_t            index,
             uint32_t            value);
     
+    /**
+     * \brief Increments a stat counter
+     * 
+     * Allows client APIs to report statistics
+     * that the backend cannot collect itself.
+     * \param [in] ctr The counter to increment
+     * \param [in] val Value to add
+     */
+    void addStatCtr(
+            DxvkStatCounter     ctr,
+            uint32_t            val);
+    
     /**
      * \brief Sets predicate
      *
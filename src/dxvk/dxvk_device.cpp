@@ -162,6 +162,7 @@ namespace dxvk {
   DxvkStatCounters DxvkDevice::getStatCounters() {
     DxvkMemoryStats mem = m_objects.memoryManager().getMemoryStats();
     DxvkPipelineCount pipe = m_objects.pipelineManager().getPipelineCount();
+    DxvkPipelineCompileStats compile = m_objects.pipelineManager().getCompileStats();
     
     DxvkStatCounters result;
     result.setCtr(DxvkStatCounter::MemoryAllocated,   mem.memoryAllocated);
@@ -171,6 +172,19 @@ namespace dxvk {
     result.setCtr(DxvkStatCounter::PipeCompilerBusy,  m_objects.pipelineManager().isCompilingShaders());
     result.setCtr(DxvkStatCounter::GpuIdleTicks,      m_submissionQueue.gpuIdleTicks());
     result.setCtr(DxvkStatCounter::SamplerCount,      m_numSamplers.load());
+    result.setCtr(DxvkStatCounter::PipeStallTime,     compile.stallTimeUs);
+    result.setCtr(DxvkStatCounter::PipeStallCount,    compile.stallCount);
+    result.setCtr(DxvkStatCounter::PipeSpecCount,     compile.speculativeCount);
+    result.setCtr(DxvkStatCounter::PipeSpecHits,      compile.speculativeHits);
+
+    // Background compiler lanes are laid out in priority order
+    for (uint32_t i = 0; i < DxvkCompilerPriorityCount; i++) {
+      DxvkCompilerLaneStats lane = m_objects.pipelineManager().getCompilerLaneStats(DxvkCompilerPriority(i));
+
+      result.setCtr(DxvkStatCounter(uint32_t(DxvkStatCounter::PipeQueueDemand)   + i), lane.queueDepth);
+      result.setCtr(DxvkStatCounter(uint32_t(DxvkStatCounter::PipeLatencyDemand) + i),
+        lane.itemCount ? lane.totalLatencyUs / lane.itemCount : 0);
+    }
 
     std::lock_guard<sync::Spinlock> lock(m_statLock);
     result.merge(m_statCounters);
@@ -348,6 +348,28 @@ namespace dxvk {
      */
     void registerShader(
       const Rc<DxvkShader>&         shader);
+
+    /**
+     * \brief Persistent shader cache
+     *
+     * Allows front-ends to store and retrieve
+     * translated shaders across runs.
+     * \returns Shader cache
+     */
+    DxvkShaderCache& shaderCache() {
+      return m_objects.shaderCache();
+    }
+
+    /**
+     * \brief Shader compiler
+     *
+     * Allows front-ends to translate
+     * shaders on worker threads.
+     * \returns Shader compiler
+     */
+    DxvkShaderCompiler& shaderCompiler() {
+      return m_objects.shaderCompiler();
+    }
     
     /**
      * \brief Presents a swap chain image
@@ -4,6 +4,7 @@
 #include "dxvk_device.h"
 #include "dxvk_graphics.h"
 #include "dxvk_pipemanager.h"
+#include "dxvk_pipetelemetry.h"
 #include "dxvk_spec_const.h"
 #include "dxvk_state_cache.h"
 
@@ -58,8 +59,23 @@ namespace dxvk {
     m_vsIn  = m_shaders.vs != nullptr ? m_shaders.vs->interfaceSlots().inputSlots  : 0;
     m_fsOut = m_shaders.fs != nullptr ? m_shaders.fs->interfaceSlots().outputSlots : 0;
 
-    if (m_shaders.gs != nullptr && m_shaders.gs->hasCapability(spv::CapabilityTransformFeedback))
+    // Stream output is written by the last pre-rasterization
+    // stage, which is not necessarily a geometry shader.
+    DxvkShader* lastStage = m_shaders.lastPreRasterizationStage();
+
+    if (lastStage != nullptr && lastStage->hasCapability(spv::CapabilityTransformFeedback))
       m_flags.set(DxvkGraphicsPipelineFlag::HasTransformFeedback);
+
+    // Link the last pre-rasterization stage against the fragment
+    // shader so that outputs it does not read get stripped. Stream
+    // output may capture any output, so leave those shaders alone.
+    if (lastStage != nullptr && !lastStage->hasCapability(spv::CapabilityTransformFeedback)) {
+      m_linkedStage   = lastStage->stage();
+      m_unusedOutputs = lastStage->interfaceSlots().outputSlots;
+
+      if (m_shaders.fs != nullptr)
+        m_unusedOutputs &= ~m_shaders.fs->interfaceSlots().inputSlots;
+    }
     
     VkShaderStageFlags stoStages = m_layout->getStorageDescriptorStages();
 
@@ -98,38 +114,84 @@ namespace dxvk {
     const DxvkGraphicsPipelineStateInfo& state,
     const DxvkRenderPass*                renderPass) {
     DxvkGraphicsPipelineInstance* instance = nullptr;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+
+    bool speculative = false;
+
+    // Include the time spent waiting for the lock, since a
+    // worker may currently be compiling the same pipeline
+    auto t0 = DxvkPipelineTelemetry::Clock::now();
 
     { std::lock_guard<sync::Spinlock> lock(m_mutex);
     
       instance = this->findInstance(state, renderPass);
       
+      if (instance) {
+        speculative = instance->consumeSpeculative();
+
+        if (likely(!speculative))
+          return instance->pipeline();
+      } else {
+        instance = this->createInstance(state, renderPass, false);
+      }
+
       if (instance)
-        return instance->pipeline();
-      
-      instance = this->createInstance(state, renderPass);
+        pipeline = instance->pipeline();
     }
     
     if (!instance)
       return VK_NULL_HANDLE;
 
-    this->writePipelineStateToCache(state, renderPass->format());
-    return instance->pipeline();
+    auto t1 = DxvkPipelineTelemetry::Clock::now();
+
+    DxvkStateCacheKey key = this->getStateCacheKey();
+
+    // Speculatively compiled pipelines are not written to the
+    // state cache until the application actually uses them
+    bool cached = this->writePipelineStateToCache(key, state, renderPass->format());
+
+    if (speculative) {
+      m_pipeMgr->m_telemetry->addSpeculativeHit();
+    } else {
+      m_pipeMgr->m_telemetry->addRecord(VK_PIPELINE_BIND_POINT_GRAPHICS, key, cached
+        ? DxvkPipelineCompileSource::StateCacheHit
+        : DxvkPipelineCompileSource::DemandMiss, t0, t1);
+    }
+
+    return pipeline;
   }
 
 
   void DxvkGraphicsPipeline::compilePipeline(
     const DxvkGraphicsPipelineStateInfo& state,
-    const DxvkRenderPass*                renderPass) {
-    std::lock_guard<sync::Spinlock> lock(m_mutex);
+    const DxvkRenderPass*                renderPass,
+          bool                           speculative) {
+    DxvkPipelineTelemetry::TimePoint t0, t1;
 
-    if (!this->findInstance(state, renderPass))
-      this->createInstance(state, renderPass);
+    { std::lock_guard<sync::Spinlock> lock(m_mutex);
+
+      if (this->findInstance(state, renderPass))
+        return;
+
+      t0 = DxvkPipelineTelemetry::Clock::now();
+
+      if (!this->createInstance(state, renderPass, speculative))
+        return;
+
+      t1 = DxvkPipelineTelemetry::Clock::now();
+    }
+
+    m_pipeMgr->m_telemetry->addRecord(VK_PIPELINE_BIND_POINT_GRAPHICS,
+      this->getStateCacheKey(), speculative
+        ? DxvkPipelineCompileSource::Speculative
+        : DxvkPipelineCompileSource::Prewarm, t0, t1);
   }
 
 
   DxvkGraphicsPipelineInstance* DxvkGraphicsPipeline::createInstance(
     const DxvkGraphicsPipelineStateInfo& state,
-    const DxvkRenderPass*                renderPass) {
+    const DxvkRenderPass*                renderPass,
+          bool                           speculative) {
     // If the pipeline state vector is invalid, don't try
     // to create a new pipeline, it won't work anyway.
     if (!this->validatePipelineState(state))
@@ -138,7 +200,7 @@ namespace dxvk {
     VkPipeline newPipelineHandle = this->createPipeline(state, renderPass);
 
     m_pipeMgr->m_numGraphicsPipelines += 1;
-    return &m_pipelines.emplace_back(state, renderPass, newPipelineHandle);
+    return &m_pipelines.emplace_back(state, renderPass, newPipelineHandle, speculative);
   }
   
   
@@ -228,11 +290,11 @@ namespace dxvk {
     auto fsm  = createShaderModule(m_shaders.fs,  moduleInfo);
 
     std::vector<VkPipelineShaderStageCreateInfo> stages;
-    if (vsm)  stages.push_back(vsm.stageInfo(&specInfo));
-    if (tcsm) stages.push_back(tcsm.stageInfo(&specInfo));
-    if (tesm) stages.push_back(tesm.stageInfo(&specInfo));
-    if (gsm)  stages.push_back(gsm.stageInfo(&specInfo));
-    if (fsm)  stages.push_back(fsm.stageInfo(&specInfo));
+    if (vsm  != nullptr) stages.push_back(vsm->stageInfo(&specInfo));
+    if (tcsm != nullptr) stages.push_back(tcsm->stageInfo(&specInfo));
+    if (tesm != nullptr) stages.push_back(tesm->stageInfo(&specInfo));
+    if (gsm  != nullptr) stages.push_back(gsm->stageInfo(&specInfo));
+    if (fsm  != nullptr) stages.push_back(fsm->stageInfo(&specInfo));
 
     // Fix up color write masks using the component mappings
     std::array<VkPipelineColorBlendAttachmentState, MaxNumRenderTargets> omBlendAttachments;
@@ -271,8 +333,10 @@ namespace dxvk {
       }
     }
 
-    int32_t rasterizedStream = m_shaders.gs != nullptr
-      ? m_shaders.gs->shaderOptions().rasterizedStream
+    DxvkShader* lastStage = m_shaders.lastPreRasterizationStage();
+
+    int32_t rasterizedStream = lastStage != nullptr
+      ? lastStage->shaderOptions().rasterizedStream
       : 0;
     
     // Compact vertex bindings so that we can more easily update vertex buffers
@@ -443,12 +507,14 @@ namespace dxvk {
     
     VkPipeline pipeline = VK_NULL_HANDLE;
     if (m_vkd->vkCreateGraphicsPipelines(m_vkd->device(),
-          m_pipeMgr->m_cache->handle(), 1, &info, nullptr, &pipeline) != VK_SUCCESS) {
+          m_pipeMgr->pipelineCache()->handle(), 1, &info, nullptr, &pipeline) != VK_SUCCESS) {
       Logger::err("DxvkGraphicsPipeline: Failed to compile pipeline");
       this->logPipelineState(LogLevel::Error, state);
       return VK_NULL_HANDLE;
     }
     
+    m_pipeMgr->pipelineCache()->update();
+
     auto t1 = std::chrono::high_resolution_clock::now();
     auto td = std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0);
     Logger::debug(str::format("DxvkGraphicsPipeline: Finished in ", td.count(), " ms"));
@@ -461,12 +527,18 @@ namespace dxvk {
   }
 
 
-  DxvkShaderModule DxvkGraphicsPipeline::createShaderModule(
+  Rc<DxvkSharedShaderModule> DxvkGraphicsPipeline::createShaderModule(
     const Rc<DxvkShader>&                shader,
     const DxvkShaderModuleCreateInfo&    info) const {
-    return shader != nullptr
-      ? shader->createShaderModule(m_vkd, m_slotMapping, info)
-      : DxvkShaderModule();
+    if (shader == nullptr)
+      return nullptr;
+
+    DxvkShaderModuleCreateInfo stageInfo = info;
+
+    if (shader->stage() == m_linkedStage)
+      stageInfo.unusedOutputs = m_unusedOutputs;
+
+    return m_pipeMgr->m_moduleCache->getShaderModule(shader, m_slotMapping, stageInfo);
   }
 
 
@@ -497,20 +569,25 @@ namespace dxvk {
   }
   
   
-  void DxvkGraphicsPipeline::writePipelineStateToCache(
+  bool DxvkGraphicsPipeline::writePipelineStateToCache(
+    const DxvkStateCacheKey&             key,
     const DxvkGraphicsPipelineStateInfo& state,
     const DxvkRenderPassFormat&          format) const {
     if (m_pipeMgr->m_stateCache == nullptr)
-      return;
+      return false;
     
+    return m_pipeMgr->m_stateCache->addGraphicsPipeline(key, state, format);
+  }
+
+
+  DxvkStateCacheKey DxvkGraphicsPipeline::getStateCacheKey() const {
     DxvkStateCacheKey key;
     if (m_shaders.vs  != nullptr) key.vs = m_shaders.vs->getShaderKey();
     if (m_shaders.tcs != nullptr) key.tcs = m_shaders.tcs->getShaderKey();
     if (m_shaders.tes != nullptr) key.tes = m_shaders.tes->getShaderKey();
     if (m_shaders.gs  != nullptr) key.gs = m_shaders.gs->getShaderKey();
     if (m_shaders.fs  != nullptr) key.fs = m_shaders.fs->getShaderKey();
-
-    m_pipeMgr->m_stateCache->addGraphicsPipeline(key, state, format);
+    return key;
   }
   
   
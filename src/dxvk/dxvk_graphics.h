@@ -15,6 +15,8 @@ namespace dxvk {
   
   class DxvkDevice;
   class DxvkPipelineManager;
+  class DxvkSharedShaderModule;
+  struct DxvkStateCacheKey;
 
   /**
    * \brief Flags that describe pipeline properties
@@ -37,6 +39,20 @@ namespace dxvk {
     Rc<DxvkShader> tes;
     Rc<DxvkShader> gs;
     Rc<DxvkShader> fs;
+
+    /**
+     * \brief Last pre-rasterization stage
+     * 
+     * This is the stage that writes stream output
+     * and the final vertex position, if any.
+     * \returns Geometry, tessellation evaluation
+     *    or vertex shader, whichever is bound
+     */
+    DxvkShader* lastPreRasterizationStage() const {
+      if (gs  != nullptr) return gs.ptr();
+      if (tes != nullptr) return tes.ptr();
+      return vs.ptr();
+    }
   };
 
 
@@ -151,15 +167,18 @@ namespace dxvk {
     DxvkGraphicsPipelineInstance()
     : m_stateVector (),
       m_renderPass  (VK_NULL_HANDLE),
-      m_pipeline    (VK_NULL_HANDLE) { }
+      m_pipeline    (VK_NULL_HANDLE),
+      m_speculative (false) { }
 
     DxvkGraphicsPipelineInstance(
       const DxvkGraphicsPipelineStateInfo&  state,
       const DxvkRenderPass*                 rp,
-            VkPipeline                      pipe)
+            VkPipeline                      pipe,
+            bool                            speculative)
     : m_stateVector (state),
       m_renderPass  (rp),
-      m_pipeline    (pipe) { }
+      m_pipeline    (pipe),
+      m_speculative (speculative) { }
 
     /**
      * \brief Checks for matching pipeline state
@@ -183,11 +202,24 @@ namespace dxvk {
       return m_pipeline;
     }
 
+    /**
+     * \brief Checks for first use of a speculative pipeline
+     * 
+     * Clears the speculative flag, so this will only
+     * return \c true once for any given instance.
+     * \returns \c true if the pipeline was compiled
+     *    speculatively and has not been used before
+     */
+    bool consumeSpeculative() {
+      return std::exchange(m_speculative, false);
+    }
+
   private:
 
     DxvkGraphicsPipelineStateInfo m_stateVector;
     const DxvkRenderPass*         m_renderPass;
     VkPipeline                    m_pipeline;
+    bool                          m_speculative;
 
   };
 
@@ -260,10 +292,14 @@ namespace dxvk {
      * and stores the result for future use.
      * \param [in] state Pipeline state vector
      * \param [in] renderPass The render pass
+     * \param [in] speculative Whether the pipeline
+     *    was predicted rather than taken from the
+     *    state cache
      */
     void compilePipeline(
       const DxvkGraphicsPipelineStateInfo&    state,
-      const DxvkRenderPass*                   renderPass);
+      const DxvkRenderPass*                   renderPass,
+            bool                              speculative);
     
   private:
     
@@ -277,6 +313,9 @@ namespace dxvk {
     
     uint32_t m_vsIn  = 0;
     uint32_t m_fsOut = 0;
+
+    VkShaderStageFlags m_linkedStage   = 0;
+    uint32_t           m_unusedOutputs = 0;
     
     DxvkGraphicsPipelineFlags           m_flags;
     DxvkGraphicsCommonPipelineStateInfo m_common;
@@ -287,7 +326,8 @@ namespace dxvk {
     
     DxvkGraphicsPipelineInstance* createInstance(
       const DxvkGraphicsPipelineStateInfo& state,
-      const DxvkRenderPass*                renderPass);
+      const DxvkRenderPass*                renderPass,
+            bool                           speculative);
     
     DxvkGraphicsPipelineInstance* findInstance(
       const DxvkGraphicsPipelineStateInfo& state,
@@ -300,17 +340,20 @@ namespace dxvk {
     void destroyPipeline(
             VkPipeline                     pipeline) const;
     
-    DxvkShaderModule createShaderModule(
+    Rc<DxvkSharedShaderModule> createShaderModule(
       const Rc<DxvkShader>&                shader,
       const DxvkShaderModuleCreateInfo&    info) const;
     
     bool validatePipelineState(
       const DxvkGraphicsPipelineStateInfo& state) const;
     
-    void writePipelineStateToCache(
+    bool writePipelineStateToCache(
+      const DxvkStateCacheKey&             key,
       const DxvkGraphicsPipelineStateInfo& state,
       const DxvkRenderPassFormat&          format) const;
     
+    DxvkStateCacheKey getStateCacheKey() const;
+    
     void logPipelineState(
             LogLevel                       level,
       const DxvkGraphicsPipelineStateInfo& state) const;
@@ -10,6 +10,8 @@
 #include "dxvk_meta_resolve.h"
 #include "dxvk_pipemanager.h"
 #include "dxvk_renderpass.h"
+#include "dxvk_shader_cache.h"
+#include "dxvk_shader_compiler.h"
 #include "dxvk_unbound.h"
 
 #include "../util/util_lazy.h"
@@ -27,7 +29,9 @@ namespace dxvk {
       m_pipelineManager (device, &m_renderPassPool),
       m_eventPool       (device),
       m_queryPool       (device),
-      m_dummyResources  (device) {
+      m_dummyResources  (device),
+      m_shaderCache     (device),
+      m_shaderCompiler  (device) {
 
     }
 
@@ -55,6 +59,14 @@ namespace dxvk {
       return m_dummyResources;
     }
 
+    DxvkShaderCache& shaderCache() {
+      return m_shaderCache;
+    }
+
+    DxvkShaderCompiler& shaderCompiler() {
+      return m_shaderCompiler;
+    }
+
     DxvkMetaClearObjects& metaClear() {
       return m_metaClear.get(m_device);
     }
@@ -88,12 +100,18 @@ namespace dxvk {
 
     DxvkUnboundResources          m_dummyResources;
 
+    DxvkShaderCache               m_shaderCache;
+
     Lazy<DxvkMetaClearObjects>    m_metaClear;
     Lazy<DxvkMetaCopyObjects>     m_metaCopy;
     Lazy<DxvkMetaResolveObjects>  m_metaResolve;
     Lazy<DxvkMetaMipGenObjects>   m_metaMipGen;
     Lazy<DxvkMetaPackObjects>     m_metaPack;
 
+    // Must be destroyed first since pending
+    // jobs may use any of the other objects
+    DxvkShaderCompiler            m_shaderCompiler;
+
   };
 
 }
\ No newline at end of file
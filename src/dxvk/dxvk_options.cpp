@@ -4,8 +4,13 @@ namespace dxvk {
 
   DxvkOptions::DxvkOptions(const Config& config) {
     enableStateCache      = config.getOption<bool>    ("dxvk.enableStateCache",       true);
+    enablePipelineCache   = config.getOption<bool>    ("dxvk.enablePipelineCache",    true);
+    enableShaderCache     = config.getOption<bool>    ("dxvk.enableShaderCache",      true);
+    deferShaderTranslation = config.getOption<bool>   ("dxvk.deferShaderTranslation", true);
+    optimizeShaders       = config.getOption<bool>    ("dxvk.optimizeShaders",        false);
     enableTransferQueue   = config.getOption<bool>    ("dxvk.enableTransferQueue",    true);
     numCompilerThreads    = config.getOption<int32_t> ("dxvk.numCompilerThreads",     0);
+    speculativePipelineBudget = config.getOption<int32_t>("dxvk.speculativePipelineBudget", 4);
     asyncPresent          = config.getOption<Tristate>("dxvk.asyncPresent",           Tristate::Auto);
     useRawSsbo            = config.getOption<Tristate>("dxvk.useRawSsbo",             Tristate::Auto);
     useEarlyDiscard       = config.getOption<Tristate>("dxvk.useEarlyDiscard",        Tristate::Auto);
@@ -11,6 +11,18 @@ namespace dxvk {
     /// Enable state cache
     bool enableStateCache;
 
+    /// Enable persistent Vulkan pipeline cache
+    bool enablePipelineCache;
+
+    /// Enable persistent shader cache
+    bool enableShaderCache;
+
+    /// Translate shaders on worker threads
+    bool deferShaderTranslation;
+
+    /// Optimize translated SPIR-V shaders
+    bool optimizeShaders;
+
     /// Use transfer queue if available
     bool enableTransferQueue;
 
@@ -18,6 +30,10 @@ namespace dxvk {
     /// when using the state cache
     int32_t numCompilerThreads;
 
+    /// Maximum number of speculatively compiled
+    /// pipeline variants per new set of shaders
+    int32_t speculativePipelineBudget;
+
     /// Asynchronous presentation
     Tristate asyncPresent;
 
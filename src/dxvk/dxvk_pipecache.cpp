@@ -1,26 +1,253 @@
+#include "dxvk_device.h"
 #include "dxvk_pipecache.h"
 
 namespace dxvk {
-  
+
+  /* Maximum amount of cache data we are willing to load */
+  constexpr uint32_t MaxPipelineCacheSize = 512 << 20;
+
   DxvkPipelineCache::DxvkPipelineCache(
-    const Rc<vk::DeviceFn>& vkd)
-  : m_vkd(vkd) {
+    const DxvkDevice*       device)
+  : m_vkd(device->vkd()) {
+    const auto& properties = device->properties().core.properties;
+
+    m_header.vendorId      = properties.vendorID;
+    m_header.deviceId      = properties.deviceID;
+    m_header.driverVersion = properties.driverVersion;
+
+    std::memcpy(m_header.uuid, properties.pipelineCacheUUID, VK_UUID_SIZE);
+
+    std::string usePipelineCache = env::getEnvVar("DXVK_PIPELINE_CACHE");
+
+    // Use separate files for different devices so that
+    // multi-GPU systems do not overwrite each other's data
+    if (usePipelineCache != "0" && device->config().enablePipelineCache)
+      m_fileName = util::getCacheFileName(str::format("_",
+        std::hex, m_header.vendorId, "_",
+        std::hex, m_header.deviceId, ".dxvk-pipecache"));
+
+    std::vector<char> data;
+
+    if (!m_fileName.empty())
+      data = loadCacheData();
+
     VkPipelineCacheCreateInfo info;
     info.sType            = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
     info.pNext            = nullptr;
     info.flags            = 0;
-    info.initialDataSize  = 0;
-    info.pInitialData     = nullptr;
-    
-    if (m_vkd->vkCreatePipelineCache(m_vkd->device(),
-        &info, nullptr, &m_handle) != VK_SUCCESS)
+    info.initialDataSize  = data.size();
+    info.pInitialData     = data.data();
+
+    VkResult status = m_vkd->vkCreatePipelineCache(
+      m_vkd->device(), &info, nullptr, &m_handle);
+
+    if (status != VK_SUCCESS && !data.empty()) {
+      // The driver may still reject data that passed our own
+      // checks, in which case we start with an empty cache
+      Logger::warn("DXVK: Pipeline cache data rejected by driver");
+
+      info.initialDataSize  = 0;
+      info.pInitialData     = nullptr;
+
+      status = m_vkd->vkCreatePipelineCache(
+        m_vkd->device(), &info, nullptr, &m_handle);
+    }
+
+    if (status != VK_SUCCESS)
       throw DxvkError("DxvkPipelineCache: Failed to create cache");
+
+    if (!m_fileName.empty()) {
+      m_writerThread = dxvk::thread([this] () { writerFunc(); });
+      m_writerThread.set_priority(ThreadPriority::Lowest);
+    }
   }
-  
-  
+
+
   DxvkPipelineCache::~DxvkPipelineCache() {
+    if (m_writerThread.joinable()) {
+      { std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopThread = true;
+        m_cond.notify_one();
+      }
+
+      m_writerThread.join();
+    }
+
     m_vkd->vkDestroyPipelineCache(
       m_vkd->device(), m_handle, nullptr);
   }
-  
+
+
+  std::vector<char> DxvkPipelineCache::loadCacheData() const {
+    std::ifstream file(m_fileName, std::ios_base::binary);
+
+    if (!file) {
+      Logger::warn("DXVK: No pipeline cache file found");
+      return std::vector<char>();
+    }
+
+    DxvkPipelineCacheHeader header;
+
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))
+     || std::memcmp(header.magic, m_header.magic, sizeof(header.magic))
+     || header.version != m_header.version) {
+      Logger::warn("DXVK: Invalid pipeline cache header");
+      return std::vector<char>();
+    }
+
+    // Cache data is only valid for the exact same device and driver
+    if (header.vendorId      != m_header.vendorId
+     || header.deviceId      != m_header.deviceId
+     || header.driverVersion != m_header.driverVersion
+     || std::memcmp(header.uuid, m_header.uuid, VK_UUID_SIZE)) {
+      Logger::warn("DXVK: Pipeline cache out of date, discarding");
+      return std::vector<char>();
+    }
+
+    if (header.dataSize > MaxPipelineCacheSize) {
+      Logger::warn("DXVK: Pipeline cache too large, discarding");
+      return std::vector<char>();
+    }
+
+    std::vector<char> data(header.dataSize);
+
+    if (!file.read(data.data(), data.size())
+     || !validateCacheData(header, data)) {
+      Logger::warn("DXVK: Pipeline cache corrupted, discarding");
+      return std::vector<char>();
+    }
+
+    Logger::info(str::format("DXVK: Read ", data.size(), " bytes of pipeline cache data"));
+    return data;
+  }
+
+
+  bool DxvkPipelineCache::validateCacheData(
+    const DxvkPipelineCacheHeader&  header,
+    const std::vector<char>&        data) const {
+    if (!(Sha1Hash::compute(data.data(), data.size()) == header.dataHash))
+      return false;
+
+    // Also check the header written by the driver itself, see
+    // the Vulkan spec on vkGetPipelineCacheData for the layout
+    struct VkHeader {
+      uint32_t length;
+      uint32_t version;
+      uint32_t vendorId;
+      uint32_t deviceId;
+      uint8_t  uuid[VK_UUID_SIZE];
+    } vkHeader;
+
+    if (data.size() < sizeof(vkHeader))
+      return false;
+
+    std::memcpy(&vkHeader, data.data(), sizeof(vkHeader));
+
+    return vkHeader.version  == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+        && vkHeader.vendorId == header.vendorId
+        && vkHeader.deviceId == header.deviceId
+        && !std::memcmp(vkHeader.uuid, header.uuid, VK_UUID_SIZE);
+  }
+
+
+  bool DxvkPipelineCache::fetchCacheData(
+          std::vector<char>&        data) const {
+    VkResult status;
+
+    // Pipelines compiled on other threads may grow the
+    // cache between querying its size and fetching the
+    // data, in which case the driver returns incomplete
+    // data and we have to try again.
+    do {
+      size_t dataSize = 0;
+
+      if (m_vkd->vkGetPipelineCacheData(m_vkd->device(),
+            m_handle, &dataSize, nullptr) != VK_SUCCESS)
+        return false;
+
+      data.resize(dataSize);
+
+      status = m_vkd->vkGetPipelineCacheData(m_vkd->device(),
+        m_handle, &dataSize, data.data());
+
+      data.resize(dataSize);
+    } while (status == VK_INCOMPLETE);
+
+    return status == VK_SUCCESS;
+  }
+
+
+  bool DxvkPipelineCache::storeCacheData() {
+    std::vector<char> data;
+
+    if (!fetchCacheData(data)) {
+      Logger::warn("DXVK: Failed to retrieve pipeline cache data");
+      return false;
+    }
+
+    // Retrying would not help here, since
+    // the cache is never going to shrink
+    if (data.size() > MaxPipelineCacheSize) {
+      Logger::warn("DXVK: Pipeline cache too large, not writing");
+      return true;
+    }
+
+    DxvkPipelineCacheHeader header = m_header;
+    header.dataSize = data.size();
+    header.dataHash = Sha1Hash::compute(data.data(), data.size());
+
+    // Write to a temporary file first so that we never leave
+    // a partially written cache behind if the process dies
+    std::string tmpName = m_fileName + ".tmp";
+
+    { std::ofstream file = util::createCacheFile(tmpName);
+
+      file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+      file.write(data.data(), data.size());
+      file.flush();
+
+      if (!file) {
+        Logger::warn("DXVK: Failed to write pipeline cache");
+        return false;
+      }
+    }
+
+    if (!env::replaceFile(tmpName, m_fileName)) {
+      Logger::warn("DXVK: Failed to replace pipeline cache file");
+      return false;
+    }
+
+    return true;
+  }
+
+
+  void DxvkPipelineCache::writerFunc() {
+    env::setThreadName("dxvk-pcache");
+
+    // Pipelines tend to be compiled in bursts, so instead
+    // of serializing the cache after every single pipeline,
+    // check for changes in regular intervals.
+    const auto interval = std::chrono::seconds(10);
+
+    bool stop = false;
+
+    while (!stop) {
+      { std::unique_lock<std::mutex> lock(m_mutex);
+
+        m_cond.wait_for(lock, interval, [this] () {
+          return m_stopThread;
+        });
+
+        stop = m_stopThread;
+      }
+
+      uint32_t updateCounter = m_updateCounter.load();
+
+      // Only consider the data written if storing it succeeded,
+      // so that failed updates are retried on the next interval
+      if (updateCounter != m_updateWritten && storeCacheData())
+        m_updateWritten = updateCounter;
+    }
+  }
+
 }
@@ -12,17 +12,41 @@
 
 namespace dxvk {
   
+  class DxvkDevice;
+  
+  /**
+   * \brief Pipeline cache file header
+   * 
+   * Identifies the device and driver that the cache
+   * data was created for, since driver caches are not
+   * portable. Also stores a check sum of the cache
+   * data in order to detect corrupted files.
+   */
+  struct DxvkPipelineCacheHeader {
+    char      magic[4]      = { 'D', 'X', 'P', 'C' };
+    uint32_t  version       = 1;
+    uint32_t  vendorId      = 0;
+    uint32_t  deviceId      = 0;
+    uint32_t  driverVersion = 0;
+    uint8_t   uuid[VK_UUID_SIZE] = { };
+    uint32_t  dataSize      = 0;
+    Sha1Hash  dataHash      = Sha1Hash::compute(nullptr, 0);
+  };
+  
   /**
    * \brief Pipeline cache
    * 
    * Allows the Vulkan implementation to
    * re-use previously compiled pipelines.
+   * Unless disabled, the cache data is loaded
+   * from disk on creation and written back
+   * periodically by a background thread.
    */
   class DxvkPipelineCache : public RcObject {
     
   public:
     
-    DxvkPipelineCache(const Rc<vk::DeviceFn>& vkd);
+    DxvkPipelineCache(const DxvkDevice* device);
     ~DxvkPipelineCache();
     
     /**
@@ -33,10 +57,44 @@ namespace dxvk {
       return m_handle;
     }
     
+    /**
+     * \brief Notifies the cache about a new pipeline
+     * 
+     * Marks the cache data as out of date so that
+     * it will be written to disk on the next update.
+     */
+    void update() {
+      m_updateCounter += 1;
+    }
+    
   private:
     
     Rc<vk::DeviceFn>        m_vkd;
-    VkPipelineCache         m_handle;
+    VkPipelineCache         m_handle = VK_NULL_HANDLE;
+    
+    DxvkPipelineCacheHeader m_header;
+    std::string             m_fileName;
+    
+    std::atomic<uint32_t>   m_updateCounter = { 0u };
+    uint32_t                m_updateWritten = 0u;
+    
+    std::mutex              m_mutex;
+    std::condition_variable m_cond;
+    bool                    m_stopThread = false;
+    dxvk::thread            m_writerThread;
+    
+    std::vector<char> loadCacheData() const;
+    
+    bool validateCacheData(
+      const DxvkPipelineCacheHeader&  header,
+      const std::vector<char>&        data) const;
+    
+    bool fetchCacheData(
+            std::vector<char>&        data) const;
+    
+    bool storeCacheData();
+    
+    void writerFunc();
     
   };
   
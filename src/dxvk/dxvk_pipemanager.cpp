@@ -1,5 +1,6 @@
 #include "dxvk_device.h"
 #include "dxvk_pipemanager.h"
+#include "dxvk_pipetelemetry.h"
 #include "dxvk_state_cache.h"
 
 namespace dxvk {
@@ -43,7 +44,9 @@ namespace dxvk {
     const DxvkDevice*         device,
           DxvkRenderPassPool* passManager)
   : m_device    (device),
-    m_cache     (new DxvkPipelineCache(device->vkd())) {
+    m_cache     (new DxvkPipelineCache(device)),
+    m_telemetry (new DxvkPipelineTelemetry()),
+    m_moduleCache(new DxvkShaderModuleCache(device)) {
     std::string useStateCache = env::getEnvVar("DXVK_STATE_CACHE");
     
     if (useStateCache != "0" && device->config().enableStateCache)
@@ -52,7 +55,9 @@ namespace dxvk {
   
   
   DxvkPipelineManager::~DxvkPipelineManager() {
-    
+    // Shaders may outlive the pipeline manager, and
+    // with it the cache, so release modules now
+    m_moduleCache->clear();
   }
   
   
@@ -113,5 +118,18 @@ namespace dxvk {
     return m_stateCache != nullptr
         && m_stateCache->isCompilingShaders();
   }
+
+
+  DxvkCompilerLaneStats DxvkPipelineManager::getCompilerLaneStats(
+          DxvkCompilerPriority    priority) const {
+    return m_stateCache != nullptr
+      ? m_stateCache->getCompilerLaneStats(priority)
+      : DxvkCompilerLaneStats();
+  }
+
+
+  DxvkPipelineCompileStats DxvkPipelineManager::getCompileStats() const {
+    return m_telemetry->getStats();
+  }
   
-}
+}
\ No newline at end of file
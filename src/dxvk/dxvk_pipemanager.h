@@ -6,10 +6,12 @@
 
 #include "dxvk_compute.h"
 #include "dxvk_graphics.h"
+#include "dxvk_shader_module_cache.h"
 
 namespace dxvk {
 
   class DxvkStateCache;
+  class DxvkPipelineTelemetry;
 
   /**
    * \brief Pipeline count
@@ -21,6 +23,51 @@ namespace dxvk {
     uint32_t numGraphicsPipelines;
     uint32_t numComputePipelines;
   };
+
+
+  /**
+   * \brief Pipeline compiler priority
+   * 
+   * Background compiler lanes, in the order in
+   * which they are served by the worker threads.
+   */
+  enum class DxvkCompilerPriority : uint32_t {
+    Demand      = 0,  ///< Variants of pipelines the app is using
+    Prewarm     = 1,  ///< Pipelines from the state cache
+    Speculative = 2,  ///< Pipelines that may be used later
+  };
+
+  constexpr uint32_t DxvkCompilerPriorityCount = 3;
+
+
+  /**
+   * \brief Pipeline compiler lane statistics
+   * 
+   * Latencies are measured from the time a
+   * work item gets queued until it completes.
+   */
+  struct DxvkCompilerLaneStats {
+    uint32_t queueDepth     = 0;
+    uint64_t itemCount      = 0;
+    uint64_t totalLatencyUs = 0;
+    uint64_t maxLatencyUs   = 0;
+  };
+
+
+  /**
+   * \brief Pipeline compile statistics
+   * 
+   * Stall times and counts only include pipelines
+   * compiled on demand. Speculative hits are
+   * speculatively compiled pipelines that were
+   * later used by the application.
+   */
+  struct DxvkPipelineCompileStats {
+    uint64_t stallTimeUs      = 0;
+    uint64_t stallCount       = 0;
+    uint64_t speculativeCount = 0;
+    uint64_t speculativeHits  = 0;
+  };
   
   
   struct DxvkPipelineKeyHash {
@@ -101,11 +148,36 @@ namespace dxvk {
      * \returns \c true if shaders are being compiled
      */
     bool isCompilingShaders() const;
+
+    /**
+     * \brief Retrieves background compiler statistics
+     * 
+     * \param [in] priority Compiler lane
+     * \returns Statistics for the given lane
+     */
+    DxvkCompilerLaneStats getCompilerLaneStats(
+            DxvkCompilerPriority    priority) const;
+
+    /**
+     * \brief Retrieves pipeline compile statistics
+     * \returns Pipeline compile statistics
+     */
+    DxvkPipelineCompileStats getCompileStats() const;
+
+    /**
+     * \brief Retrieves Vulkan pipeline cache
+     * \returns Pipeline cache object
+     */
+    DxvkPipelineCache* pipelineCache() const {
+      return m_cache.ptr();
+    }
     
   private:
     
     const DxvkDevice*         m_device;
     Rc<DxvkPipelineCache>     m_cache;
+    Rc<DxvkPipelineTelemetry> m_telemetry;
+    Rc<DxvkShaderModuleCache> m_moduleCache;
     Rc<DxvkStateCache>        m_stateCache;
 
     std::atomic<uint32_t>     m_numComputePipelines  = { 0 };
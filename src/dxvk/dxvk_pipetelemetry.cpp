@@ -0,0 +1,162 @@
+#include <algorithm>
+#include <array>
+#include <fstream>
+
+#include "dxvk_pipetelemetry.h"
+
+namespace dxvk {
+
+  static const char* getCompileSourceName(DxvkPipelineCompileSource source) {
+    switch (source) {
+      case DxvkPipelineCompileSource::Prewarm:       return "prewarm";
+      case DxvkPipelineCompileSource::StateCacheHit: return "statecache";
+      case DxvkPipelineCompileSource::DemandMiss:    return "miss";
+      case DxvkPipelineCompileSource::Speculative:   return "speculative";
+    }
+
+    return "unknown";
+  }
+
+
+  static std::string getShaderKeyName(const DxvkShaderKey& key) {
+    return key.eq(DxvkShaderKey()) ? std::string("-") : key.toString();
+  }
+
+
+  static bool isFasterCompile(
+    const DxvkPipelineCompileRecord& a,
+    const DxvkPipelineCompileRecord& b) {
+    return a.durationUs > b.durationUs;
+  }
+
+
+  DxvkPipelineTelemetry::DxvkPipelineTelemetry()
+  : m_startTime (Clock::now()),
+    m_reportFile(env::getEnvVar("DXVK_PIPELINE_REPORT")) {
+
+  }
+
+
+  DxvkPipelineTelemetry::~DxvkPipelineTelemetry() {
+    this->logSummary();
+
+    if (!m_reportFile.empty())
+      this->writeReport();
+  }
+
+
+  void DxvkPipelineTelemetry::addRecord(
+          VkPipelineBindPoint       bindPoint,
+    const DxvkStateCacheKey&        shaders,
+          DxvkPipelineCompileSource source,
+          TimePoint                 startTime,
+          TimePoint                 endTime) {
+    using std::chrono::duration_cast;
+    using std::chrono::microseconds;
+
+    DxvkPipelineCompileRecord record;
+    record.startUs    = duration_cast<microseconds>(startTime - m_startTime).count();
+    record.durationUs = duration_cast<microseconds>(endTime - startTime).count();
+    record.threadId   = GetCurrentThreadId();
+    record.bindPoint  = bindPoint;
+    record.source     = source;
+    record.shaders    = shaders;
+
+    if (source == DxvkPipelineCompileSource::StateCacheHit
+     || source == DxvkPipelineCompileSource::DemandMiss) {
+      m_stallTime  += record.durationUs;
+      m_stallCount += 1;
+    }
+
+    if (source == DxvkPipelineCompileSource::Speculative)
+      m_specCount += 1;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_counts[uint32_t(source)] += 1;
+    m_times [uint32_t(source)] += record.durationUs;
+
+    // Keep the slowest stalls in a min-heap so that the summary
+    // can list them without storing every single compile
+    if (source == DxvkPipelineCompileSource::StateCacheHit
+     || source == DxvkPipelineCompileSource::DemandMiss) {
+      if (m_stalls.size() < MaxStallCount) {
+        m_stalls.push_back(record);
+        std::push_heap(m_stalls.begin(), m_stalls.end(), &isFasterCompile);
+      } else if (record.durationUs > m_stalls.front().durationUs) {
+        std::pop_heap(m_stalls.begin(), m_stalls.end(), &isFasterCompile);
+        m_stalls.back() = record;
+        std::push_heap(m_stalls.begin(), m_stalls.end(), &isFasterCompile);
+      }
+    }
+
+    if (!m_reportFile.empty() && m_records.size() < MaxRecordCount)
+      m_records.push_back(record);
+  }
+
+
+  void DxvkPipelineTelemetry::logSummary() const {
+    uint64_t totalCount = 0;
+
+    for (uint64_t count : m_counts)
+      totalCount += count;
+
+    if (!totalCount)
+      return;
+
+    Logger::info("DXVK: Pipeline compile summary:");
+
+    for (uint32_t i = 0; i < DxvkPipelineCompileSourceCount; i++) {
+      Logger::info(str::format("  ", getCompileSourceName(DxvkPipelineCompileSource(i)),
+        ": ", m_counts[i], " pipelines, ", m_times[i] / 1000, " ms"));
+    }
+
+    if (m_counts[uint32_t(DxvkPipelineCompileSource::Speculative)]) {
+      uint64_t hits = m_specHits.load();
+
+      Logger::info(str::format("  speculative hits: ", hits, " (",
+        (100 * hits) / m_counts[uint32_t(DxvkPipelineCompileSource::Speculative)], "%)"));
+    }
+
+    // List the worst offenders so that stutter can be
+    // attributed to individual shaders and pipelines
+    std::vector<DxvkPipelineCompileRecord> stalls = m_stalls;
+    std::sort_heap(stalls.begin(), stalls.end(), &isFasterCompile);
+
+    for (const auto& record : stalls) {
+      std::string shaders = record.bindPoint == VK_PIPELINE_BIND_POINT_COMPUTE
+        ? getShaderKeyName(record.shaders.cs)
+        : str::format(getShaderKeyName(record.shaders.vs), " ", getShaderKeyName(record.shaders.fs));
+
+      Logger::info(str::format("  stall: ", record.durationUs / 1000, " ms at ",
+        record.startUs / 1000, " ms (", getCompileSourceName(record.source), "): ", shaders));
+    }
+  }
+
+
+  void DxvkPipelineTelemetry::writeReport() const {
+    std::ofstream file(m_reportFile, std::ios_base::trunc);
+
+    if (!file) {
+      Logger::warn(str::format("DXVK: Failed to write pipeline report to ", m_reportFile));
+      return;
+    }
+
+    file << "time_us,duration_us,thread,source,type,vs,tcs,tes,gs,fs,cs" << std::endl;
+
+    for (const auto& record : m_records) {
+      file << record.startUs << ","
+           << record.durationUs << ","
+           << record.threadId << ","
+           << getCompileSourceName(record.source) << ","
+           << (record.bindPoint == VK_PIPELINE_BIND_POINT_COMPUTE ? "compute" : "graphics") << ","
+           << getShaderKeyName(record.shaders.vs) << ","
+           << getShaderKeyName(record.shaders.tcs) << ","
+           << getShaderKeyName(record.shaders.tes) << ","
+           << getShaderKeyName(record.shaders.gs) << ","
+           << getShaderKeyName(record.shaders.fs) << ","
+           << getShaderKeyName(record.shaders.cs) << std::endl;
+    }
+  }
+
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+#include "dxvk_state_cache_types.h"
+
+namespace dxvk {
+
+  /**
+   * \brief Pipeline compile source
+   *
+   * Describes why and where a pipeline got compiled.
+   */
+  enum class DxvkPipelineCompileSource : uint32_t {
+    Prewarm       = 0,  ///< Compiled in the background by the state cache
+    StateCacheHit = 1,  ///< Compiled on demand, but known to the state cache
+    DemandMiss    = 2,  ///< Compiled on demand, unknown to the state cache
+    Speculative   = 3,  ///< Compiled in the background based on a prediction
+  };
+
+  constexpr uint32_t DxvkPipelineCompileSourceCount = 4;
+
+
+  /**
+   * \brief Pipeline compile record
+   *
+   * Stores information about a single pipeline
+   * compilation. Times are in microseconds, start
+   * times are relative to device creation.
+   */
+  struct DxvkPipelineCompileRecord {
+    uint64_t                  startUs;
+    uint64_t                  durationUs;
+    uint32_t                  threadId;
+    VkPipelineBindPoint       bindPoint;
+    DxvkPipelineCompileSource source;
+    DxvkStateCacheKey         shaders;
+  };
+
+
+  /**
+   * \brief Pipeline compile telemetry
+   *
+   * Tracks graphics and compute pipeline compilations in
+   * order to attribute stutter to pipeline compilation.
+   * On-demand compilation time is exposed as a stat counter,
+   * and a summary with the slowest stalls is logged when the
+   * device gets destroyed. Individual records are only kept
+   * if \c DXVK_PIPELINE_REPORT is set, in which case they
+   * will be written to the given file in CSV format.
+   */
+  class DxvkPipelineTelemetry : public RcObject {
+
+  public:
+
+    using Clock     = std::chrono::high_resolution_clock;
+    using TimePoint = Clock::time_point;
+
+    DxvkPipelineTelemetry();
+    ~DxvkPipelineTelemetry();
+
+    /**
+     * \brief Adds a compile record
+     *
+     * \param [in] bindPoint Pipeline type
+     * \param [in] shaders Pipeline shader keys
+     * \param [in] source Compile source
+     * \param [in] startTime Compile start time
+     * \param [in] endTime Compile end time
+     */
+    void addRecord(
+            VkPipelineBindPoint       bindPoint,
+      const DxvkStateCacheKey&        shaders,
+            DxvkPipelineCompileSource source,
+            TimePoint                 startTime,
+            TimePoint                 endTime);
+
+    /**
+     * \brief Records use of a speculative pipeline
+     *
+     * Called when the application uses a speculatively
+     * compiled pipeline for the first time, i.e. when a
+     * demand compilation was avoided.
+     */
+    void addSpeculativeHit() {
+      m_specHits += 1;
+    }
+
+    /**
+     * \brief Retrieves compile statistics
+     * \returns Compile statistics
+     */
+    DxvkPipelineCompileStats getStats() const {
+      DxvkPipelineCompileStats result;
+      result.stallTimeUs      = m_stallTime.load();
+      result.stallCount       = m_stallCount.load();
+      result.speculativeCount = m_specCount.load();
+      result.speculativeHits  = m_specHits.load();
+      return result;
+    }
+
+  private:
+
+    static constexpr size_t MaxRecordCount = 1u << 20;
+    static constexpr size_t MaxStallCount  = 10;
+
+    TimePoint                               m_startTime;
+    std::string                             m_reportFile;
+
+    std::atomic<uint64_t>                   m_stallTime  = { 0ull };
+    std::atomic<uint64_t>                   m_stallCount = { 0ull };
+    std::atomic<uint64_t>                   m_specCount  = { 0ull };
+    std::atomic<uint64_t>                   m_specHits   = { 0ull };
+
+    std::mutex                              m_mutex;
+
+    std::array<uint64_t, DxvkPipelineCompileSourceCount> m_counts = { };
+    std::array<uint64_t, DxvkPipelineCompileSourceCount> m_times  = { };
+
+    std::vector<DxvkPipelineCompileRecord>  m_stalls;
+    std::vector<DxvkPipelineCompileRecord>  m_records;
+
+    void logSummary() const;
+
+    void writeReport() const;
+
+  };
+
+}
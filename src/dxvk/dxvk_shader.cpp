@@ -1,6 +1,8 @@
 #include "dxvk_shader.h"
+#include "dxvk_shader_module_cache.h"
 
 #include <algorithm>
+#include <unordered_map>
 
 namespace dxvk {
   
@@ -94,6 +96,9 @@ namespace dxvk {
   }
 
 
+  std::atomic<uint64_t> DxvkShader::s_cookie = { 0ull };
+
+
   DxvkShader::DxvkShader(
           VkShaderStageFlagBits   stage,
           uint32_t                slotCount,
@@ -103,7 +108,8 @@ namespace dxvk {
     const DxvkShaderOptions&      options,
           DxvkShaderConstData&&   constData)
   : m_stage(stage), m_code(code), m_interface(iface),
-    m_options(options), m_constData(std::move(constData)) {
+    m_options(options), m_constData(std::move(constData)),
+    m_cookie(++s_cookie) {
     // Write back resource slot infos
     for (uint32_t i = 0; i < slotCount; i++)
       m_slots.push_back(slotInfos[i]);
@@ -115,8 +121,12 @@ namespace dxvk {
     for (auto ins : code) {
       if (ins.opCode() == spv::OpDecorate) {
         if (ins.arg(2) == spv::DecorationBinding
-         || ins.arg(2) == spv::DecorationSpecId)
+         || ins.arg(2) == spv::DecorationSpecId) {
           m_idOffsets.push_back(ins.offset() + 3);
+
+          if (ins.arg(3) < MaxNumResourceSlots)
+            m_idSlots.push_back(ins.arg(3));
+        }
         
         if (ins.arg(2) == spv::DecorationLocation && ins.arg(3) == 1) {
           m_o1LocOffset = ins.offset() + 3;
@@ -130,11 +140,22 @@ namespace dxvk {
       if (ins.opCode() == spv::OpCapability)
         m_capabilities.push_back(spv::Capability(ins.arg(1)));
     }
+
+    std::sort(m_idSlots.begin(), m_idSlots.end());
+    m_idSlots.erase(std::unique(m_idSlots.begin(), m_idSlots.end()), m_idSlots.end());
   }
   
   
   DxvkShader::~DxvkShader() {
-    
+    if (m_moduleCache != nullptr)
+      m_moduleCache->purgeShader(m_cookie);
+  }
+  
+  
+  void DxvkShader::setModuleCache(
+    const Rc<DxvkShaderModuleCache>& cache) {
+    std::lock_guard<sync::Spinlock> lock(m_moduleCacheLock);
+    m_moduleCache = cache;
   }
   
   
@@ -160,6 +181,17 @@ namespace dxvk {
   }
   
   
+  std::vector<uint32_t> DxvkShader::getBindingIds(
+    const DxvkDescriptorSlotMapping& mapping) const {
+    std::vector<uint32_t> result(m_idSlots.size());
+
+    for (size_t i = 0; i < m_idSlots.size(); i++)
+      result[i] = mapping.getBindingId(m_idSlots[i]);
+
+    return result;
+  }
+
+
   DxvkShaderModule DxvkShader::createShaderModule(
     const Rc<vk::DeviceFn>&          vkd,
     const DxvkDescriptorSlotMapping& mapping,
@@ -177,6 +209,12 @@ namespace dxvk {
     // location 1, index 0 to location 0, index 1
     if (info.fsDualSrcBlend && m_o1IdxOffset && m_o1LocOffset)
       std::swap(code[m_o1IdxOffset], code[m_o1LocOffset]);
+
+    // Remove outputs that the next stage does not read
+    uint32_t unusedOutputs = info.unusedOutputs & m_interface.outputSlots;
+
+    if (unusedOutputs)
+      spirvCode = stripOutputs(spirvCode, unusedOutputs);
     
     return DxvkShaderModule(vkd, this, spirvCode);
   }
@@ -185,5 +223,210 @@ namespace dxvk {
   void DxvkShader::dump(std::ostream& outputStream) const {
     m_code.decompress().store(outputStream);
   }
+
+
+  SpirvCodeBuffer DxvkShader::stripOutputs(
+          SpirvCodeBuffer&        code,
+          uint32_t                outputMask) {
+    uint32_t idBound = code.data()[3];
+
+    std::vector<uint32_t> locations (idBound, ~0u);
+    std::vector<uint32_t> ptrStorage(idBound, ~0u);
+    std::vector<uint32_t> ptrPointee(idBound, 0);
+    std::vector<bool>     isArray   (idBound, false);
+
+    // Root output variable for each stripped variable and
+    // each pointer derived from one, or zero otherwise
+    std::vector<uint32_t> roots (idBound, 0);
+    std::vector<bool>     loaded(idBound, false);
+    std::vector<bool>     keep  (idBound, false);
+
+    std::unordered_map<uint32_t, uint32_t> privatePtrTypes;
+
+    for (auto ins : code) {
+      switch (ins.opCode()) {
+        case spv::OpDecorate:
+          if (ins.arg(2) == spv::DecorationLocation)
+            locations[ins.arg(1)] = ins.arg(3);
+          break;
+
+        case spv::OpTypeArray:
+          isArray[ins.arg(1)] = true;
+          break;
+
+        case spv::OpTypePointer:
+          ptrStorage[ins.arg(1)] = ins.arg(2);
+          ptrPointee[ins.arg(1)] = ins.arg(3);
+
+          if (ins.arg(2) == spv::StorageClassPrivate)
+            privatePtrTypes.insert({ ins.arg(3), ins.arg(1) });
+          break;
+
+        case spv::OpVariable: {
+          uint32_t varId = ins.arg(2);
+          uint32_t location = locations[varId];
+
+          // Arrays span multiple locations, leave them alone
+          if (ins.arg(3) == spv::StorageClassOutput && location < 32
+           && (outputMask & (1u << location)) && !isArray[ptrPointee[ins.arg(1)]])
+            roots[varId] = varId;
+        } break;
+
+        default:
+          break;
+      }
+    }
+
+    // Find pointers derived from stripped outputs, and keep
+    // any output that is used in ways other than plain loads
+    // and stores, e.g. passed to a function. Literals that
+    // happen to match an ID do the same, which is harmless.
+    for (auto ins : code) {
+      uint32_t first = 1;
+
+      switch (ins.opCode()) {
+        case spv::OpName:
+        case spv::OpDecorate:
+        case spv::OpEntryPoint:
+        case spv::OpVariable:
+          continue;
+
+        case spv::OpAccessChain:
+        case spv::OpInBoundsAccessChain:
+          roots[ins.arg(2)] = roots[ins.arg(3)];
+          first = 4;
+          break;
+
+        case spv::OpLoad:
+          loaded[roots[ins.arg(3)]] = true;
+          first = 4;
+          break;
+
+        case spv::OpStore:
+          first = 2;
+          break;
+
+        default:
+          break;
+      }
+
+      for (uint32_t i = first; i < ins.length(); i++) {
+        uint32_t word = ins.arg(i);
+
+        if (word < idBound && roots[word])
+          keep[roots[word]] = true;
+      }
+    }
+
+    // Allocate private pointer types for all stripped outputs
+    // and derived pointers where no such type exists yet
+    std::unordered_map<uint32_t, uint32_t> ptrTypes;
+    std::unordered_map<uint32_t, uint32_t> newPtrTypes;
+    bool hasStrippedOutputs = false;
+
+    for (auto ins : code) {
+      uint32_t typeId = 0;
+
+      if (ins.opCode() == spv::OpVariable
+       || ins.opCode() == spv::OpAccessChain
+       || ins.opCode() == spv::OpInBoundsAccessChain) {
+        uint32_t root = roots[ins.arg(2)];
+
+        if (root && !keep[root])
+          typeId = ins.arg(1);
+
+        if (root == ins.arg(2) && !keep[root])
+          hasStrippedOutputs = true;
+      }
+
+      if (!typeId || ptrTypes.find(typeId) != ptrTypes.end())
+        continue;
+
+      auto entry = privatePtrTypes.find(ptrPointee[typeId]);
+
+      if (entry != privatePtrTypes.end()) {
+        ptrTypes.insert({ typeId, entry->second });
+      } else {
+        ptrTypes.insert({ typeId, idBound });
+        newPtrTypes.insert({ typeId, idBound++ });
+      }
+    }
+
+    if (!hasStrippedOutputs)
+      return code;
+
+    // Rebuild the module. Stripped outputs are turned into
+    // private variables and removed from the interface, and
+    // stores to them are removed unless they are read back.
+    auto isStripped = [&] (uint32_t id) {
+      return id < roots.size() && roots[id] && !keep[roots[id]];
+    };
+
+    std::vector<uint32_t> result(code.data(), code.data() + 5);
+    result[3] = idBound;
+
+    for (auto ins : code) {
+      const uint32_t offset = result.size();
+
+      for (uint32_t i = 0; i < ins.length(); i++)
+        result.push_back(ins.arg(i));
+
+      switch (ins.opCode()) {
+        case spv::OpEntryPoint: {
+          // Skip the literal name string to get to the interface
+          uint32_t first = 3;
+
+          while (first < ins.length() && (ins.arg(first++) & 0xFF000000u))
+            continue;
+
+          result.resize(offset + first);
+
+          for (uint32_t i = first; i < ins.length(); i++) {
+            if (roots[ins.arg(i)] != ins.arg(i) || keep[ins.arg(i)])
+              result.push_back(ins.arg(i));
+          }
+
+          result[offset] = spv::OpEntryPoint | (uint32_t(result.size() - offset) << spv::WordCountShift);
+        } break;
+
+        case spv::OpDecorate:
+          if (isStripped(ins.arg(1)))
+            result.resize(offset);
+          break;
+
+        case spv::OpTypePointer: {
+          auto entry = newPtrTypes.find(ins.arg(1));
+
+          if (entry != newPtrTypes.end()) {
+            result.push_back(spv::OpTypePointer | (4u << spv::WordCountShift));
+            result.push_back(entry->second);
+            result.push_back(spv::StorageClassPrivate);
+            result.push_back(ptrPointee[ins.arg(1)]);
+          }
+        } break;
+
+        case spv::OpVariable:
+        case spv::OpAccessChain:
+        case spv::OpInBoundsAccessChain:
+          if (isStripped(ins.arg(2))) {
+            result[offset + 1] = ptrTypes[ins.arg(1)];
+
+            if (ins.opCode() == spv::OpVariable)
+              result[offset + 3] = spv::StorageClassPrivate;
+          }
+          break;
+
+        case spv::OpStore:
+          if (isStripped(ins.arg(1)) && !loaded[roots[ins.arg(1)]])
+            result.resize(offset);
+          break;
+
+        default:
+          break;
+      }
+    }
+
+    return SpirvCodeBuffer(result.size(), result.data());
+  }
   
 }
\ No newline at end of file
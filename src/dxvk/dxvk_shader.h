@@ -14,6 +14,7 @@ namespace dxvk {
   
   class DxvkShader;
   class DxvkShaderModule;
+  class DxvkShaderModuleCache;
   
   /**
    * \brief Built-in specialization constants
@@ -108,6 +109,9 @@ namespace dxvk {
    */
   struct DxvkShaderModuleCreateInfo {
     bool fsDualSrcBlend;
+    /// Output locations that are not consumed
+    /// by the next stage and can be stripped
+    uint32_t unusedOutputs = 0;
   };
   
   
@@ -120,7 +124,7 @@ namespace dxvk {
    * needs to be created from he shader object.
    */
   class DxvkShader : public RcObject {
-    
+    friend class DxvkShaderCache;
   public:
     
     DxvkShader(
@@ -164,6 +168,17 @@ namespace dxvk {
     void defineResourceSlots(
             DxvkDescriptorSlotMapping& mapping) const;
     
+    /**
+     * \brief Computes remapped binding IDs
+     * 
+     * Shader modules created with two mappings that
+     * produce the same binding IDs will be identical.
+     * \param [in] mapping Resource slot mapping
+     * \returns Binding IDs of all remapped slots
+     */
+    std::vector<uint32_t> getBindingIds(
+      const DxvkDescriptorSlotMapping& mapping) const;
+    
     /**
      * \brief Creates a shader module
      * 
@@ -241,6 +256,28 @@ namespace dxvk {
       return m_key.toString();
     }
     
+    /**
+     * \brief Unique shader cookie
+     * 
+     * Identifies the shader object without keeping
+     * it alive. Cookies are never reused.
+     * \returns Shader cookie
+     */
+    uint64_t cookie() const {
+      return m_cookie;
+    }
+    
+    /**
+     * \brief Registers a shader module cache
+     * 
+     * The cache will be notified when the shader is
+     * destroyed so that it can release all modules
+     * created for this shader.
+     * \param [in] cache Shader module cache
+     */
+    void setModuleCache(
+      const Rc<DxvkShaderModuleCache>& cache);
+    
   private:
     
     VkShaderStageFlagBits m_stage;
@@ -248,6 +285,7 @@ namespace dxvk {
     
     std::vector<DxvkResourceSlot> m_slots;
     std::vector<size_t>           m_idOffsets;
+    std::vector<uint32_t>         m_idSlots;
     DxvkInterfaceSlots            m_interface;
     DxvkShaderOptions             m_options;
     DxvkShaderConstData           m_constData;
@@ -255,8 +293,19 @@ namespace dxvk {
 
     std::vector<spv::Capability>  m_capabilities;
 
+    uint64_t                      m_cookie;
+
+    sync::Spinlock                m_moduleCacheLock;
+    Rc<DxvkShaderModuleCache>     m_moduleCache;
+
     size_t m_o1IdxOffset = 0;
     size_t m_o1LocOffset = 0;
+
+    static std::atomic<uint64_t> s_cookie;
+
+    static SpirvCodeBuffer stripOutputs(
+            SpirvCodeBuffer&        code,
+            uint32_t                outputMask);
     
   };
   
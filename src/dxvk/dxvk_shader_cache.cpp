@@ -0,0 +1,337 @@
+#include <cstring>
+
+#include <version.h>
+
+#include "dxvk_device.h"
+#include "dxvk_shader_cache.h"
+
+namespace dxvk {
+
+  DxvkShaderCache::DxvkShaderCache(const DxvkDevice* device) {
+    m_header.buildHash = Sha1Hash::compute(
+      DXVK_VERSION, std::strlen(DXVK_VERSION));
+
+    std::string useShaderCache = env::getEnvVar("DXVK_SHADER_CACHE");
+
+    if (useShaderCache == "0" || !device->config().enableShaderCache)
+      return;
+
+    m_fileName = util::getCacheFileName(".dxvk-shader-cache");
+    readCacheFile();
+
+    auto reader = acquireReader();
+
+    if (!reader) {
+      Logger::warn("DXVK: Failed to open shader cache");
+      m_fileName.clear();
+      return;
+    }
+
+    releaseReader(std::move(reader));
+
+    m_writerThread = dxvk::thread([this] () { writerFunc(); });
+    m_writerThread.set_priority(ThreadPriority::Lowest);
+  }
+
+
+  DxvkShaderCache::~DxvkShaderCache() {
+    if (m_writerThread.joinable()) {
+      { std::lock_guard<std::mutex> lock(m_writerLock);
+        m_stopThread = true;
+        m_writerCond.notify_one();
+      }
+
+      m_writerThread.join();
+
+      Logger::info(str::format("DXVK: Shader cache: ",
+        m_hitCount.load(), " hits, ", m_missCount.load(), " misses"));
+    }
+  }
+
+
+  bool DxvkShaderCache::lookup(
+    const Sha1Hash&           key,
+          std::stringstream&  data) {
+    if (!enabled())
+      return false;
+
+    // Only copy the entry info while holding the lock,
+    // reading the data can take a while
+    DxvkShaderCacheEntryInfo info;
+
+    { std::lock_guard<std::mutex> lock(m_readerLock);
+
+      auto entry = m_entries.find(key);
+
+      if (entry == m_entries.end()) {
+        m_missCount += 1;
+        return false;
+      }
+
+      info = entry->second;
+    }
+
+    auto reader = acquireReader();
+
+    std::string buffer(info.size, '\0');
+
+    bool valid = reader != nullptr;
+
+    if (valid) {
+      reader->clear();
+      reader->seekg(info.offset);
+
+      valid = reader->read(&buffer[0], buffer.size())
+        && Sha1Hash::compute(buffer.data(), buffer.size()) == info.hash;
+
+      releaseReader(std::move(reader));
+    }
+
+    if (!valid) {
+      Logger::warn("DXVK: Corrupted shader cache entry");
+
+      std::lock_guard<std::mutex> lock(m_readerLock);
+      auto entry = m_entries.find(key);
+
+      if (entry != m_entries.end() && entry->second.offset == info.offset)
+        m_entries.erase(entry);
+
+      m_missCount += 1;
+      return false;
+    }
+
+    data.str(std::move(buffer));
+    m_hitCount += 1;
+    return true;
+  }
+
+
+  void DxvkShaderCache::store(
+    const Sha1Hash&           key,
+    const std::stringstream&  data) {
+    if (!enabled())
+      return;
+
+    // Entries that are already queued are not visible to
+    // lookups yet, but must not be written a second time
+    { std::lock_guard<std::mutex> lock(m_readerLock);
+
+      if (m_entries.find(key) != m_entries.end()
+       || !m_pending.insert(key).second)
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_writerLock);
+    m_writerQueue.push({ key, data.str() });
+    m_writerCond.notify_one();
+  }
+
+
+  void DxvkShaderCache::writeShader(
+          std::ostream&       stream,
+    const Rc<DxvkShader>&     shader) {
+    writeData(stream, shader->m_stage);
+    writeArray(stream, shader->m_slots);
+    writeData(stream, shader->m_interface);
+    writeData(stream, shader->m_options);
+
+    const DxvkShaderConstData& constData = shader->m_constData;
+    writeData(stream, uint32_t(constData.sizeInBytes() / sizeof(uint32_t)));
+    stream.write(reinterpret_cast<const char*>(constData.data()), constData.sizeInBytes());
+
+    shader->m_code.store(stream);
+  }
+
+
+  Rc<DxvkShader> DxvkShaderCache::readShader(
+          std::istream&       stream) {
+    VkShaderStageFlagBits         stage;
+    std::vector<DxvkResourceSlot> slots;
+    DxvkInterfaceSlots            iface;
+    DxvkShaderOptions             options;
+    std::vector<uint32_t>         constData;
+    SpirvCompressedBuffer         code;
+
+    if (!readData (stream, stage)
+     || !readArray(stream, slots)
+     || !readData (stream, iface)
+     || !readData (stream, options)
+     || !readArray(stream, constData)
+     || !code.load(stream))
+      return nullptr;
+
+    return new DxvkShader(stage,
+      slots.size(), slots.data(), iface,
+      code.decompress(), options,
+      DxvkShaderConstData(constData.size(), constData.data()));
+  }
+
+
+  std::unique_ptr<std::ifstream> DxvkShaderCache::acquireReader() {
+    { std::lock_guard<std::mutex> lock(m_readerLock);
+
+      if (!m_readers.empty()) {
+        auto reader = std::move(m_readers.back());
+        m_readers.pop_back();
+        return reader;
+      }
+    }
+
+    auto reader = std::make_unique<std::ifstream>(
+      m_fileName, std::ios_base::binary);
+
+    if (!*reader)
+      return nullptr;
+
+    return reader;
+  }
+
+
+  void DxvkShaderCache::releaseReader(
+          std::unique_ptr<std::ifstream>&& reader) {
+    std::lock_guard<std::mutex> lock(m_readerLock);
+    m_readers.push_back(std::move(reader));
+  }
+
+
+  void DxvkShaderCache::readCacheFile() {
+    std::ifstream file(m_fileName, std::ios_base::binary);
+
+    if (!file) {
+      createCacheFile();
+      return;
+    }
+
+    file.seekg(0, std::ios_base::end);
+    std::streamoff fileSize = file.tellg();
+    file.seekg(0, std::ios_base::beg);
+
+    DxvkShaderCacheHeader header;
+
+    if (!readData(file, header)
+     || std::memcmp(header.magic, m_header.magic, sizeof(header.magic))
+     || header.version != m_header.version
+     || !(header.buildHash == m_header.buildHash)) {
+      Logger::warn("DXVK: Shader cache out of date, discarding");
+      file.close();
+      createCacheFile();
+      return;
+    }
+
+    std::streamoff validSize = sizeof(header);
+    DxvkShaderCacheEntryHeader entry;
+
+    // Only scan entry headers here, entry data is validated
+    // on lookup since it is usually not needed as a whole.
+    while (readData(file, entry)) {
+      std::streamoff offset = validSize + sizeof(entry);
+
+      if (offset + entry.dataSize > fileSize)
+        break;
+
+      m_entries[entry.key] = { offset, entry.dataSize, entry.dataHash };
+      validSize = offset + entry.dataSize;
+
+      file.seekg(validSize);
+    }
+
+    file.close();
+
+    // If the process got killed while writing an entry, drop
+    // the incomplete data so that new entries can be appended
+    if (validSize != fileSize) {
+      Logger::warn("DXVK: Shader cache truncated, removing invalid entries");
+      truncateCacheFile(validSize);
+    }
+
+    Logger::info(str::format("DXVK: Found ", m_entries.size(), " shader cache entries"));
+  }
+
+
+  void DxvkShaderCache::truncateCacheFile(
+          std::streamoff      size) {
+    std::string tmpName = m_fileName + ".tmp";
+
+    { std::ifstream src(m_fileName, std::ios_base::binary);
+      std::ofstream dst(tmpName, std::ios_base::binary | std::ios_base::trunc);
+
+      std::vector<char> buffer(1 << 20);
+
+      while (size > 0 && src && dst) {
+        std::streamoff chunk = std::min<std::streamoff>(size, buffer.size());
+        src.read(buffer.data(), chunk);
+        dst.write(buffer.data(), chunk);
+        size -= chunk;
+      }
+
+      dst.flush();
+
+      if (!src || !dst) {
+        Logger::warn("DXVK: Failed to truncate shader cache");
+        m_entries.clear();
+        dst.close();
+        createCacheFile();
+        return;
+      }
+    }
+
+    if (!env::replaceFile(tmpName, m_fileName)) {
+      Logger::warn("DXVK: Failed to replace shader cache file");
+      m_entries.clear();
+      createCacheFile();
+    }
+  }
+
+
+  void DxvkShaderCache::createCacheFile() {
+    std::ofstream file = util::createCacheFile(m_fileName);
+
+    writeData(file, m_header);
+    file.flush();
+  }
+
+
+  void DxvkShaderCache::writerFunc() {
+    env::setThreadName("dxvk-shader-cache");
+
+    std::ofstream file(m_fileName, std::ios_base::binary | std::ios_base::app);
+    file.seekp(0, std::ios_base::end);
+
+    while (true) {
+      std::pair<Sha1Hash, std::string> item;
+
+      { std::unique_lock<std::mutex> lock(m_writerLock);
+
+        m_writerCond.wait(lock, [this] () {
+          return m_stopThread || !m_writerQueue.empty();
+        });
+
+        if (m_writerQueue.empty())
+          break;
+
+        item = std::move(m_writerQueue.front());
+        m_writerQueue.pop();
+      }
+
+      DxvkShaderCacheEntryHeader entry;
+      entry.key      = item.first;
+      entry.dataHash = Sha1Hash::compute(item.second.data(), item.second.size());
+      entry.dataSize = item.second.size();
+
+      std::streamoff offset = std::streamoff(file.tellp()) + sizeof(entry);
+
+      writeData(file, entry);
+      file.write(item.second.data(), item.second.size());
+      file.flush();
+
+      // Make the entry available to lookups once it is on disk
+      std::lock_guard<std::mutex> lock(m_readerLock);
+
+      if (file)
+        m_entries[entry.key] = { offset, entry.dataSize, entry.dataHash };
+
+      m_pending.erase(entry.key);
+    }
+  }
+
+}
@@ -0,0 +1,220 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <fstream>
+#include <memory>
+#include <queue>
+#include <sstream>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "dxvk_shader.h"
+
+#include "../util/sha1/sha1_util.h"
+#include "../util/util_env.h"
+
+namespace dxvk {
+
+  class DxvkDevice;
+
+  /**
+   * \brief Shader cache file header
+   *
+   * Stores a hash of the DXVK version string so
+   * that cached shaders get discarded whenever
+   * the shader compilers may have changed.
+   */
+  struct DxvkShaderCacheHeader {
+    char      magic[4]  = { 'D', 'X', 'S', 'C' };
+    uint32_t  version   = 3;
+    Sha1Hash  buildHash = Sha1Hash::compute(nullptr, 0);
+  };
+
+  /**
+   * \brief Shader cache entry header
+   *
+   * Precedes the serialized data of each entry. The
+   * data hash is used to detect corrupted entries.
+   */
+  struct DxvkShaderCacheEntryHeader {
+    Sha1Hash  key;
+    Sha1Hash  dataHash;
+    uint32_t  dataSize;
+  };
+
+  /**
+   * \brief Shader cache entry location
+   */
+  struct DxvkShaderCacheEntryInfo {
+    std::streamoff  offset;
+    uint32_t        size;
+    Sha1Hash        hash;
+  };
+
+  /**
+   * \brief Shader cache key hash
+   */
+  struct DxvkShaderCacheKeyHash {
+    size_t operator () (const Sha1Hash& key) const {
+      return key.dword(0);
+    }
+  };
+
+  /**
+   * \brief Persistent shader cache
+   *
+   * Stores translated SPIR-V shaders along with any
+   * front-end specific metadata on disk, so that the
+   * shader translation can be skipped on later runs.
+   * Entries are identified by a key which front-ends
+   * must compute from the original shader hash and
+   * all options that affect the generated code.
+   *
+   * New entries are appended to the cache file by a
+   * background thread, and can be looked up as soon
+   * as they are written. Only the entry index is kept
+   * in memory, entry data is read on demand. File
+   * streams are pooled so that multiple threads can
+   * read entries in parallel.
+   */
+  class DxvkShaderCache {
+
+  public:
+
+    DxvkShaderCache(const DxvkDevice* device);
+    ~DxvkShaderCache();
+
+    /**
+     * \brief Checks whether the cache is enabled
+     * \returns \c true if shaders are cached
+     */
+    bool enabled() const {
+      return !m_fileName.empty();
+    }
+
+    /**
+     * \brief Looks up a cache entry
+     *
+     * \param [in] key Entry key
+     * \param [out] data Serialized entry data
+     * \returns \c true if a valid entry was found
+     */
+    bool lookup(
+      const Sha1Hash&           key,
+            std::stringstream&  data);
+
+    /**
+     * \brief Adds an entry to the cache
+     *
+     * The entry will be written to disk asynchronously.
+     * \param [in] key Entry key
+     * \param [in] data Serialized entry data
+     */
+    void store(
+      const Sha1Hash&           key,
+      const std::stringstream&  data);
+
+    /**
+     * \brief Serializes a shader object
+     *
+     * \param [in] stream Output stream
+     * \param [in] shader Shader to write
+     */
+    static void writeShader(
+            std::ostream&       stream,
+      const Rc<DxvkShader>&     shader);
+
+    /**
+     * \brief Deserializes a shader object
+     *
+     * \param [in] stream Input stream
+     * \returns Shader object, or \c nullptr on error
+     */
+    static Rc<DxvkShader> readShader(
+            std::istream&       stream);
+
+    /**
+     * \brief Writes plain data to a stream
+     */
+    template<typename T>
+    static void writeData(std::ostream& stream, const T& data) {
+      stream.write(reinterpret_cast<const char*>(&data), sizeof(T));
+    }
+
+    /**
+     * \brief Reads plain data from a stream
+     */
+    template<typename T>
+    static bool readData(std::istream& stream, T& data) {
+      return bool(stream.read(reinterpret_cast<char*>(&data), sizeof(T)));
+    }
+
+    /**
+     * \brief Writes an array of plain data to a stream
+     */
+    template<typename T>
+    static void writeArray(std::ostream& stream, const std::vector<T>& data) {
+      writeData(stream, uint32_t(data.size()));
+      stream.write(reinterpret_cast<const char*>(data.data()), sizeof(T) * data.size());
+    }
+
+    /**
+     * \brief Reads an array of plain data from a stream
+     */
+    template<typename T>
+    static bool readArray(std::istream& stream, std::vector<T>& data) {
+      uint32_t size = 0;
+
+      if (!readData(stream, size) || size > MaxArraySize)
+        return false;
+
+      data.resize(size);
+      return bool(stream.read(reinterpret_cast<char*>(data.data()), sizeof(T) * size));
+    }
+
+  private:
+
+    static constexpr uint32_t MaxArraySize = 1u << 24;
+
+    std::string                     m_fileName;
+    DxvkShaderCacheHeader           m_header;
+
+    std::mutex                      m_readerLock;
+    std::vector<std::unique_ptr<std::ifstream>> m_readers;
+
+    std::unordered_map<
+      Sha1Hash,
+      DxvkShaderCacheEntryInfo,
+      DxvkShaderCacheKeyHash>       m_entries;
+
+    std::unordered_set<
+      Sha1Hash,
+      DxvkShaderCacheKeyHash>       m_pending;
+
+    std::atomic<uint32_t>           m_hitCount  = { 0u };
+    std::atomic<uint32_t>           m_missCount = { 0u };
+
+    std::mutex                      m_writerLock;
+    std::condition_variable         m_writerCond;
+    std::queue<std::pair<Sha1Hash, std::string>> m_writerQueue;
+    bool                            m_stopThread = false;
+    dxvk::thread                    m_writerThread;
+
+    std::unique_ptr<std::ifstream> acquireReader();
+
+    void releaseReader(
+            std::unique_ptr<std::ifstream>&& reader);
+
+    void readCacheFile();
+
+    void truncateCacheFile(
+            std::streamoff      size);
+
+    void createCacheFile();
+
+    void writerFunc();
+
+  };
+
+}
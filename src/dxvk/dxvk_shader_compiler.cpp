@@ -0,0 +1,106 @@
+#include "dxvk_device.h"
+#include "dxvk_shader_compiler.h"
+
+namespace dxvk {
+
+  DxvkShaderCompileJob::~DxvkShaderCompileJob() {
+
+  }
+
+
+  void DxvkShaderCompileJob::execute() {
+    State expected = State::Pending;
+
+    if (!m_state.compare_exchange_strong(expected, State::Running))
+      return;
+
+    this->run();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_state.store(State::Done, std::memory_order_release);
+    m_cond.notify_all();
+  }
+
+
+  void DxvkShaderCompileJob::waitSlow() {
+    this->execute();
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    m_cond.wait(lock, [this] () {
+      return m_state.load() == State::Done;
+    });
+  }
+
+
+  DxvkShaderCompiler::DxvkShaderCompiler(const DxvkDevice* device) {
+    if (!device->config().deferShaderTranslation)
+      return;
+
+    // Translation is usually fast compared to pipeline
+    // compilation, so we do not need many threads here
+    uint32_t numCpuCores = dxvk::thread::hardware_concurrency();
+    uint32_t numWorkers  = numCpuCores / 4;
+
+    if (numWorkers < 1) numWorkers = 1;
+    if (numWorkers > 4) numWorkers = 4;
+
+    Logger::info(str::format("DXVK: Using ", numWorkers, " shader translation threads"));
+
+    // Workers run at normal priority since the application
+    // thread may have to wait for a job that a worker has
+    // already started. Jobs that are still queued get
+    // executed by the waiting thread instead.
+    for (uint32_t i = 0; i < numWorkers; i++)
+      m_workers.emplace_back([this] () { workerFunc(); });
+  }
+
+
+  DxvkShaderCompiler::~DxvkShaderCompiler() {
+    { std::lock_guard<std::mutex> lock(m_mutex);
+      m_stopped = true;
+      m_cond.notify_all();
+    }
+
+    for (auto& worker : m_workers)
+      worker.join();
+  }
+
+
+  void DxvkShaderCompiler::queueJob(
+    const Rc<DxvkShaderCompileJob>& job) {
+    if (m_workers.empty()) {
+      job->execute();
+      return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_queue.push(job);
+    m_cond.notify_one();
+  }
+
+
+  void DxvkShaderCompiler::workerFunc() {
+    env::setThreadName("dxvk-shader");
+
+    while (true) {
+      Rc<DxvkShaderCompileJob> job;
+
+      { std::unique_lock<std::mutex> lock(m_mutex);
+
+        m_cond.wait(lock, [this] () {
+          return m_stopped || !m_queue.empty();
+        });
+
+        if (m_queue.empty())
+          break;
+
+        job = std::move(m_queue.front());
+        m_queue.pop();
+      }
+
+      job->execute();
+    }
+  }
+
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <queue>
+#include <vector>
+
+#include "dxvk_include.h"
+
+namespace dxvk {
+
+  class DxvkDevice;
+
+  /**
+   * \brief Shader compile job
+   *
+   * Base class for front-end shader translation work
+   * which can be executed on a worker thread. Results
+   * must not be accessed before \c wait returned.
+   */
+  class DxvkShaderCompileJob : public RcObject {
+
+  public:
+
+    virtual ~DxvkShaderCompileJob();
+
+    /**
+     * \brief Executes the job
+     *
+     * Does nothing if the job has already
+     * been started by another thread.
+     */
+    void execute();
+
+    /**
+     * \brief Waits for the job to complete
+     *
+     * If no worker has picked up the job yet, it will
+     * be executed on the calling thread rather than
+     * waiting for previously queued jobs to finish.
+     */
+    void wait() {
+      if (likely(m_state.load(std::memory_order_acquire) == State::Done))
+        return;
+
+      waitSlow();
+    }
+
+    /**
+     * \brief Checks whether the job has completed
+     *
+     * Unlike \c wait, this never blocks.
+     * \returns \c true if results can be accessed
+     */
+    bool isDone() const {
+      return m_state.load(std::memory_order_acquire) == State::Done;
+    }
+
+  protected:
+
+    /**
+     * \brief Performs the actual work
+     *
+     * Must not throw. Errors have to be handled
+     * and reported by the implementation.
+     */
+    virtual void run() = 0;
+
+  private:
+
+    enum class State : uint32_t {
+      Pending, Running, Done,
+    };
+
+    std::atomic<State>      m_state = { State::Pending };
+
+    std::mutex              m_mutex;
+    std::condition_variable m_cond;
+
+    void waitSlow();
+
+  };
+
+
+  /**
+   * \brief Shader compiler
+   *
+   * Runs shader translation jobs on a pool of worker
+   * threads, so that shader creation calls can return
+   * before the shader is actually translated. Jobs
+   * still queued on destruction are executed before
+   * the worker threads exit.
+   */
+  class DxvkShaderCompiler {
+
+  public:
+
+    DxvkShaderCompiler(const DxvkDevice* device);
+    ~DxvkShaderCompiler();
+
+    /**
+     * \brief Queues a job for execution
+     *
+     * If deferred shader translation is disabled,
+     * the job will be executed immediately.
+     * \param [in] job The job to execute
+     */
+    void queueJob(
+      const Rc<DxvkShaderCompileJob>& job);
+
+  private:
+
+    std::mutex                            m_mutex;
+    std::condition_variable               m_cond;
+    std::queue<Rc<DxvkShaderCompileJob>>  m_queue;
+    bool                                  m_stopped = false;
+
+    std::vector<dxvk::thread>             m_workers;
+
+    void workerFunc();
+
+  };
+
+}
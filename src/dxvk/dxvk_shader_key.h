@@ -34,6 +34,22 @@ namespace dxvk {
             Sha1Hash              hash)
     : m_type(stage), m_sha1(hash) { }
     
+    /**
+     * \brief Shader stage
+     * \returns Shader stage
+     */
+    VkShaderStageFlags type() const {
+      return m_type;
+    }
+    
+    /**
+     * \brief Shader hash
+     * \returns SHA-1 hash of the shader
+     */
+    const Sha1Hash& sha1() const {
+      return m_sha1;
+    }
+    
     /**
      * \brief Generates string from shader key
      * \returns String representation of the key
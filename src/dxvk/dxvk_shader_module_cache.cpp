@@ -0,0 +1,117 @@
+#include "dxvk_device.h"
+#include "dxvk_shader_module_cache.h"
+
+namespace dxvk {
+
+  bool DxvkShaderModuleKey::eq(const DxvkShaderModuleKey& other) const {
+    return shaderCookie   == other.shaderCookie
+        && bindingIds     == other.bindingIds
+        && fsDualSrcBlend == other.fsDualSrcBlend
+        && unusedOutputs  == other.unusedOutputs;
+  }
+
+
+  size_t DxvkShaderModuleKey::hash() const {
+    DxvkHashState state;
+    state.add(shaderCookie);
+    state.add(uint32_t(fsDualSrcBlend));
+    state.add(unusedOutputs);
+
+    for (uint32_t id : bindingIds)
+      state.add(id);
+
+    return state;
+  }
+
+
+  DxvkShaderModuleCache::DxvkShaderModuleCache(const DxvkDevice* device)
+  : m_vkd(device->vkd()) {
+
+  }
+
+
+  DxvkShaderModuleCache::~DxvkShaderModuleCache() {
+    Logger::debug(str::format("DXVK: Shader module cache: ",
+      m_hitCount, " hits, ", m_missCount, " misses"));
+  }
+
+
+  Rc<DxvkSharedShaderModule> DxvkShaderModuleCache::getShaderModule(
+    const Rc<DxvkShader>&             shader,
+    const DxvkDescriptorSlotMapping&  mapping,
+    const DxvkShaderModuleCreateInfo& info) {
+    DxvkShaderModuleKey key;
+    key.shaderCookie   = shader->cookie();
+    key.bindingIds     = shader->getBindingIds(mapping);
+    key.fsDualSrcBlend = info.fsDualSrcBlend
+      && shader->stage() == VK_SHADER_STAGE_FRAGMENT_BIT;
+    key.unusedOutputs  = info.unusedOutputs
+      & shader->interfaceSlots().outputSlots;
+
+    { std::lock_guard<std::mutex> lock(m_mutex);
+
+      auto entry = m_entries.find(key);
+
+      if (entry != m_entries.end()) {
+        m_lruList.splice(m_lruList.begin(), m_lruList, entry->second);
+        m_hitCount += 1;
+        return entry->second->second;
+      }
+    }
+
+    // Create the module without holding the lock so that
+    // multiple compiler threads can do this in parallel
+    DxvkShaderModuleCreateInfo moduleInfo;
+    moduleInfo.fsDualSrcBlend = key.fsDualSrcBlend;
+    moduleInfo.unusedOutputs  = key.unusedOutputs;
+
+    Rc<DxvkSharedShaderModule> module = new DxvkSharedShaderModule(
+      shader->createShaderModule(m_vkd, mapping, moduleInfo));
+
+    shader->setModuleCache(this);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_missCount += 1;
+
+    // Another thread may have created the same module
+    auto entry = m_entries.find(key);
+
+    if (entry != m_entries.end())
+      return entry->second->second;
+
+    m_lruList.emplace_front(key, module);
+    m_entries.insert({ std::move(key), m_lruList.begin() });
+
+    while (m_lruList.size() > MaxModuleCount) {
+      m_entries.erase(m_lruList.back().first);
+      m_lruList.pop_back();
+    }
+
+    return module;
+  }
+
+
+
+  void DxvkShaderModuleCache::purgeShader(
+          uint64_t                    cookie) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (auto e = m_lruList.begin(); e != m_lruList.end(); ) {
+      if (e->first.shaderCookie == cookie) {
+        m_entries.erase(e->first);
+        e = m_lruList.erase(e);
+      } else {
+        e++;
+      }
+    }
+  }
+
+
+  void DxvkShaderModuleCache::clear() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_entries.clear();
+    m_lruList.clear();
+  }
+
+}
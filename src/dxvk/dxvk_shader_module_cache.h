@@ -0,0 +1,138 @@
+#pragma once
+
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+#include "dxvk_shader.h"
+
+namespace dxvk {
+
+  class DxvkDevice;
+
+  /**
+   * \brief Shared shader module
+   *
+   * Reference-counted shader module, so that modules
+   * can be evicted from the cache while a pipeline
+   * using them is still being compiled.
+   */
+  class DxvkSharedShaderModule : public RcObject {
+
+  public:
+
+    DxvkSharedShaderModule(DxvkShaderModule&& module)
+    : m_module(std::move(module)) { }
+
+    /**
+     * \brief Shader stage creation info
+     *
+     * \param [in] specInfo Specialization info
+     * \returns Shader stage create info
+     */
+    VkPipelineShaderStageCreateInfo stageInfo(
+      const VkSpecializationInfo* specInfo) const {
+      return m_module.stageInfo(specInfo);
+    }
+
+  private:
+
+    DxvkShaderModule m_module;
+
+  };
+
+
+  /**
+   * \brief Shader module key
+   *
+   * Identifies a shader module by the shader cookie
+   * and all parameters that affect the final code,
+   * i.e. the binding IDs that the shader's resource
+   * slots are mapped to and the module create info.
+   * Since unused outputs depend on the next stage,
+   * linked modules are cached per shader pair.
+   */
+  struct DxvkShaderModuleKey {
+    uint64_t              shaderCookie;
+    std::vector<uint32_t> bindingIds;
+    bool                  fsDualSrcBlend;
+    uint32_t              unusedOutputs;
+
+    bool eq(const DxvkShaderModuleKey& other) const;
+
+    size_t hash() const;
+  };
+
+
+  /**
+   * \brief Shader module cache
+   *
+   * Keeps recently used shader modules around so that
+   * pipelines which share a shader do not each have to
+   * decompress and remap the SPIR-V code and create a
+   * new Vulkan shader module. Least recently used
+   * modules are evicted once the cache is full.
+   *
+   * The cache does not keep shaders alive. Instead,
+   * shaders purge their modules on destruction.
+   */
+  class DxvkShaderModuleCache : public RcObject {
+
+  public:
+
+    DxvkShaderModuleCache(const DxvkDevice* device);
+    ~DxvkShaderModuleCache();
+
+    /**
+     * \brief Retrieves a shader module
+     *
+     * Creates a new module on a cache miss.
+     * \param [in] shader The shader object
+     * \param [in] mapping Resource slot mapping
+     * \param [in] info Module create info
+     * \returns The shader module
+     */
+    Rc<DxvkSharedShaderModule> getShaderModule(
+      const Rc<DxvkShader>&             shader,
+      const DxvkDescriptorSlotMapping&  mapping,
+      const DxvkShaderModuleCreateInfo& info);
+
+    /**
+     * \brief Removes all modules of a shader
+     *
+     * Called when the shader object gets destroyed.
+     * \param [in] cookie Shader cookie
+     */
+    void purgeShader(
+            uint64_t                    cookie);
+
+    /**
+     * \brief Removes all modules
+     *
+     * Must be called before the device is destroyed,
+     * since shaders may keep the cache object alive.
+     */
+    void clear();
+
+  private:
+
+    static constexpr size_t MaxModuleCount = 1024;
+
+    using Entry = std::pair<DxvkShaderModuleKey, Rc<DxvkSharedShaderModule>>;
+
+    Rc<vk::DeviceFn>    m_vkd;
+
+    std::mutex          m_mutex;
+    std::list<Entry>    m_lruList;
+
+    std::unordered_map<
+      DxvkShaderModuleKey,
+      std::list<Entry>::iterator,
+      DxvkHash, DxvkEq> m_entries;
+
+    uint64_t            m_hitCount  = 0;
+    uint64_t            m_missCount = 0;
+
+  };
+
+}
@@ -2,46 +2,13 @@
 #include "dxvk_pipemanager.h"
 #include "dxvk_state_cache.h"
 
+#include <cstddef>
+
 namespace dxvk {
 
   static const Sha1Hash       g_nullHash      = Sha1Hash::compute(nullptr, 0);
   static const DxvkShaderKey  g_nullShaderKey = DxvkShaderKey();
 
-  template<typename T>
-  bool readCacheEntryTyped(std::istream& stream, T& entry) {
-    auto data = reinterpret_cast<char*>(&entry);
-    auto size = sizeof(entry);
-
-    if (!stream.read(data, size))
-      return false;
-    
-    Sha1Hash expectedHash = std::exchange(entry.hash, g_nullHash);
-    Sha1Hash computedHash = Sha1Hash::compute(entry);
-    return expectedHash == computedHash;
-  }
-
-
-  bool DxvkStateCacheKey::eq(const DxvkStateCacheKey& key) const {
-    return this->vs.eq(key.vs)
-        && this->tcs.eq(key.tcs)
-        && this->tes.eq(key.tes)
-        && this->gs.eq(key.gs)
-        && this->fs.eq(key.fs)
-        && this->cs.eq(key.cs);
-  }
-
-
-  size_t DxvkStateCacheKey::hash() const {
-    DxvkHashState hash;
-    hash.add(this->vs.hash());
-    hash.add(this->tcs.hash());
-    hash.add(this->tes.hash());
-    hash.add(this->gs.hash());
-    hash.add(this->fs.hash());
-    hash.add(this->cs.hash());
-    return hash;
-  }
-
 
   DxvkStateCache::DxvkStateCache(
     const DxvkDevice*           device,
@@ -55,28 +22,17 @@ namespace dxvk {
       Logger::warn("DXVK: Creating new state cache file");
 
       // Start with an empty file
-      std::ofstream file(getCacheFileName(),
-        std::ios_base::binary |
-        std::ios_base::trunc);
-
-      if (!file && env::createDirectory(getCacheDir())) {
-        file = std::ofstream(getCacheFileName(),
-          std::ios_base::binary |
-          std::ios_base::trunc);
-      }
+      std::ofstream file = util::createCacheFile(getCacheFileName());
 
       // Write header with the current version number
-      DxvkStateCacheHeader header;
-
-      auto data = reinterpret_cast<const char*>(&header);
-      auto size = sizeof(header);
-
-      file.write(data, size);
+      writeCacheHeader(file);
 
       // Write all valid entries to the cache file in
       // case we're recovering a corrupted cache file
       for (auto& e : m_entries)
         writeCacheEntry(file, e);
+      
+      file.flush();
     }
 
     // Use half the available CPU cores for pipeline compilation
@@ -93,11 +49,21 @@ namespace dxvk {
     
     Logger::info(str::format("DXVK: Using ", numWorkers, " compiler threads"));
     
+    // Initially allow all workers to serve all lanes, the
+    // limit gets adjusted once we know the app's CPU load
+    m_workerCount    = numWorkers;
+    m_workerLimit    = numWorkers;
+    m_numCpuCores    = numCpuCores;
+    m_cpuSampleTime  = WorkerClock::now();
+    m_cpuProcessTime = env::getProcessCpuTime();
+
+    m_specBudget = std::max(device->config().speculativePipelineBudget, 0);
+
     // Start the worker threads and the file writer
     m_workerBusy.store(numWorkers);
 
     for (uint32_t i = 0; i < numWorkers; i++) {
-      m_workerThreads.emplace_back([this] () { workerFunc(); });
+      m_workerThreads.emplace_back([this, i] () { workerFunc(i); });
       m_workerThreads[i].set_priority(ThreadPriority::Lowest);
     }
     
@@ -119,16 +85,36 @@ namespace dxvk {
       worker.join();
     
     m_writerThread.join();
+
+    static const std::array<const char*, DxvkCompilerPriorityCount> laneNames = {
+      "demand", "prewarm", "speculative" };
+
+    for (uint32_t i = 0; i < DxvkCompilerPriorityCount; i++) {
+      const DxvkCompilerLaneStats& stats = m_workerStats[i];
+
+      if (stats.itemCount) {
+        Logger::info(str::format("DXVK: Compiled ", stats.itemCount, " ", laneNames[i],
+          " items, average latency: ", stats.totalLatencyUs / (1000 * stats.itemCount),
+          " ms, max latency: ", stats.maxLatencyUs / 1000, " ms"));
+      }
+    }
   }
 
 
-  void DxvkStateCache::addGraphicsPipeline(
+  bool DxvkStateCache::addGraphicsPipeline(
     const DxvkStateCacheKey&              shaders,
     const DxvkGraphicsPipelineStateInfo&  state,
     const DxvkRenderPassFormat&           format) {
     if (shaders.vs.eq(g_nullShaderKey))
-      return;
+      return false;
     
+    // The app is using this pipeline right now, so any remaining
+    // cached states for it should be compiled as soon as possible
+    queuePipelines(shaders, DxvkCompilerPriority::Demand);
+
+    if (m_specBudget)
+      predictPipelines(shaders, state, format);
+
     // Do not add an entry that is already in the cache
     auto entries = m_entryMap.equal_range(shaders);
 
@@ -136,7 +122,7 @@ namespace dxvk {
       const DxvkStateCacheEntry& entry = m_entries[e->second];
 
       if (entry.format.eq(format) && entry.gpState == state)
-        return;
+        return true;
     }
 
     // Queue a job to write this pipeline to the cache
@@ -146,21 +132,24 @@ namespace dxvk {
       DxvkComputePipelineStateInfo(),
       format, g_nullHash });
     m_writerCond.notify_one();
+    return false;
   }
 
 
-  void DxvkStateCache::addComputePipeline(
+  bool DxvkStateCache::addComputePipeline(
     const DxvkStateCacheKey&              shaders,
     const DxvkComputePipelineStateInfo&   state) {
     if (shaders.cs.eq(g_nullShaderKey))
-      return;
+      return false;
+
+    queuePipelines(shaders, DxvkCompilerPriority::Demand);
 
     // Do not add an entry that is already in the cache
     auto entries = m_entryMap.equal_range(shaders);
 
     for (auto e = entries.first; e != entries.second; e++) {
       if (m_entries[e->second].cpState == state)
-        return;
+        return true;
     }
 
     // Queue a job to write this pipeline to the cache
@@ -170,6 +159,7 @@ namespace dxvk {
       DxvkGraphicsPipelineStateInfo(), state,
       DxvkRenderPassFormat(), g_nullHash });
     m_writerCond.notify_one();
+    return false;
   }
 
 
@@ -191,18 +181,18 @@ namespace dxvk {
     for (auto p = pipelines.first; p != pipelines.second; p++) {
       WorkerItem item;
 
-      if (!getShaderByKey(p->second.vs,  item.gp.vs)
-       || !getShaderByKey(p->second.tcs, item.gp.tcs)
-       || !getShaderByKey(p->second.tes, item.gp.tes)
-       || !getShaderByKey(p->second.gs,  item.gp.gs)
-       || !getShaderByKey(p->second.fs,  item.gp.fs)
-       || !getShaderByKey(p->second.cs,  item.cp.cs))
+      if (!getWorkerItem(p->second, item))
         continue;
       
       if (!workerLock)
         workerLock = std::unique_lock<std::mutex>(m_workerLock);
       
-      m_workerQueue.push(item);
+      // Skip pipelines that have been queued before
+      if (m_workerPending.find(p->second) != m_workerPending.end()
+       || m_workerDone.find(p->second) != m_workerDone.end())
+        continue;
+
+      pushWorkerItem(std::move(item), DxvkCompilerPriority::Prewarm);
     }
 
     if (workerLock)
@@ -210,6 +200,46 @@ namespace dxvk {
   }
 
 
+  void DxvkStateCache::queuePipelines(
+    const DxvkStateCacheKey&              shaders,
+          DxvkCompilerPriority            priority) {
+    std::lock_guard<std::mutex> entryLock(m_entryLock);
+    std::lock_guard<std::mutex> workerLock(m_workerLock);
+
+    auto pending = m_workerPending.find(shaders);
+
+    if (pending != m_workerPending.end()) {
+      // Already queued in the same or a more important lane
+      if (uint32_t(pending->second) <= uint32_t(priority))
+        return;
+
+      // The stale item in the old lane will be skipped
+      m_workerStats[uint32_t(pending->second)].queueDepth -= 1;
+    } else {
+      // Only queue pipelines that have cached states and
+      // have not been compiled by any worker before
+      if (m_workerDone.find(shaders) != m_workerDone.end()
+       || m_entryMap.find(shaders) == m_entryMap.end())
+        return;
+    }
+
+    WorkerItem item;
+
+    if (!getWorkerItem(shaders, item))
+      return;
+
+    pushWorkerItem(std::move(item), priority);
+    m_workerCond.notify_all();
+  }
+
+
+  DxvkCompilerLaneStats DxvkStateCache::getCompilerLaneStats(
+          DxvkCompilerPriority            priority) {
+    std::lock_guard<std::mutex> workerLock(m_workerLock);
+    return m_workerStats[uint32_t(priority)];
+  }
+
+
   DxvkShaderKey DxvkStateCache::getShaderKey(const Rc<DxvkShader>& shader) const {
     return shader != nullptr ? shader->getShaderKey() : g_nullShaderKey;
   }
@@ -245,6 +275,124 @@ namespace dxvk {
   }
 
 
+  bool DxvkStateCache::getWorkerItem(
+    const DxvkStateCacheKey&        key,
+          WorkerItem&               item) const {
+    item.key = key;
+
+    return getShaderByKey(key.vs,  item.gp.vs)
+        && getShaderByKey(key.tcs, item.gp.tcs)
+        && getShaderByKey(key.tes, item.gp.tes)
+        && getShaderByKey(key.gs,  item.gp.gs)
+        && getShaderByKey(key.fs,  item.gp.fs)
+        && getShaderByKey(key.cs,  item.cp.cs);
+  }
+
+
+  void DxvkStateCache::pushWorkerItem(
+          WorkerItem&&              item,
+          DxvkCompilerPriority      priority) {
+    item.priority  = priority;
+    item.queueTime = WorkerClock::now();
+
+    // Predicted pipelines are not tracked per shader
+    // set since they do not come from cached entries
+    if (item.states.empty())
+      m_workerPending[item.key] = priority;
+
+    m_workerStats[uint32_t(priority)].queueDepth += 1;
+    m_workerQueues[uint32_t(priority)].push(std::move(item));
+  }
+
+
+  bool DxvkStateCache::hasWorkerItem(
+          uint32_t                  workerId) const {
+    for (uint32_t i = 0; i < DxvkCompilerPriorityCount; i++) {
+      // Workers above the current limit only serve the
+      // demand lane in order to leave the CPU to the app
+      if (i != uint32_t(DxvkCompilerPriority::Demand) && workerId >= m_workerLimit)
+        break;
+
+      if (!m_workerQueues[i].empty())
+        return true;
+    }
+
+    return false;
+  }
+
+
+  bool DxvkStateCache::popWorkerItem(
+          uint32_t                  workerId,
+          WorkerItem&               item) {
+    for (uint32_t i = 0; i < DxvkCompilerPriorityCount; i++) {
+      if (i != uint32_t(DxvkCompilerPriority::Demand) && workerId >= m_workerLimit)
+        break;
+
+      auto& queue = m_workerQueues[i];
+
+      while (!queue.empty()) {
+        item = std::move(queue.front());
+        queue.pop();
+
+        if (!item.states.empty()) {
+          m_workerStats[i].queueDepth -= 1;
+          return true;
+        }
+
+        // Skip items that have been moved to another lane
+        auto pending = m_workerPending.find(item.key);
+
+        if (pending == m_workerPending.end() || pending->second != item.priority)
+          continue;
+
+        m_workerPending.erase(pending);
+        m_workerDone.insert(item.key);
+        m_workerStats[i].queueDepth -= 1;
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+
+  void DxvkStateCache::updateWorkerLimit() {
+    auto now = WorkerClock::now();
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+      now - m_cpuSampleTime).count();
+
+    if (elapsed < 500000)
+      return;
+
+    uint64_t processTime = env::getProcessCpuTime();
+    uint64_t workerTime  = m_workerCpuTime.load();
+
+    uint64_t processDelta = processTime - m_cpuProcessTime;
+    uint64_t workerDelta  = workerTime  - m_cpuWorkerTime;
+
+    // CPU time spent by anything other than the compiler
+    // workers, i.e. the app, the CS thread and the driver
+    double appCores = processDelta > workerDelta
+      ? double(processDelta - workerDelta) / double(elapsed)
+      : 0.0;
+
+    // Leave one core of headroom so that the background
+    // compiler does not compete with a CPU-bound app
+    double freeCores = double(m_numCpuCores) - appCores - 1.0;
+
+    uint32_t limit = freeCores > 1.0 ? uint32_t(freeCores) : 1u;
+    limit = std::min(limit, m_workerCount);
+
+    if (limit > m_workerLimit)
+      m_workerCond.notify_all();
+
+    m_workerLimit    = limit;
+    m_cpuSampleTime  = now;
+    m_cpuProcessTime = processTime;
+    m_cpuWorkerTime  = workerTime;
+  }
+
+
   void DxvkStateCache::compilePipelines(const WorkerItem& item) {
     DxvkStateCacheKey key;
     key.vs  = getShaderKey(item.gp.vs);
@@ -254,7 +402,14 @@ namespace dxvk {
     key.fs  = getShaderKey(item.gp.fs);
     key.cs  = getShaderKey(item.cp.cs);
 
-    if (item.cp.cs == nullptr) {
+    if (!item.states.empty()) {
+      auto pipeline = m_pipeManager->createGraphicsPipeline(item.gp);
+
+      for (const auto& entry : item.states) {
+        auto rp = m_passManager->getRenderPass(entry.format);
+        pipeline->compilePipeline(entry.gpState, rp, true);
+      }
+    } else if (item.cp.cs == nullptr) {
       auto pipeline = m_pipeManager->createGraphicsPipeline(item.gp);
       auto entries = m_entryMap.equal_range(key);
 
@@ -262,7 +417,7 @@ namespace dxvk {
         const auto& entry = m_entries[e->second];
 
         auto rp = m_passManager->getRenderPass(entry.format);
-        pipeline->compilePipeline(entry.gpState, rp);
+        pipeline->compilePipeline(entry.gpState, rp, false);
       }
     } else {
       auto pipeline = m_pipeManager->createComputePipeline(item.cp);
@@ -276,6 +431,210 @@ namespace dxvk {
   }
 
 
+  void DxvkStateCache::predictPipelines(
+    const DxvkStateCacheKey&              shaders,
+    const DxvkGraphicsPipelineStateInfo&  state,
+    const DxvkRenderPassFormat&           format) {
+    DxvkStateCacheEntry base;
+    base.shaders = shaders;
+    base.gpState = state;
+    base.format  = format;
+
+    std::vector<std::pair<uint32_t, DxvkStateCacheEntry>> predicted;
+
+    { std::lock_guard<std::mutex> lock(m_predictorLock);
+
+      auto last = m_predictorLast.find(shaders);
+
+      // If the shaders have been used before, learn which state
+      // changes follow each other, but don't predict anything.
+      if (last != m_predictorLast.end()) {
+        learnStateTransition(last->second, base);
+        last->second = base;
+        return;
+      }
+
+      m_predictorLast.insert({ shaders, base });
+
+      for (uint32_t i = 0; i < PredictorDeltaCount; i++) {
+        PredictorKey key = { PredictorDelta(i), hashStateDelta(PredictorDelta(i), base) };
+        auto candidates = m_predictorTable.find(key);
+
+        if (candidates == m_predictorTable.end())
+          continue;
+
+        for (const auto& c : candidates->second) {
+          // Ignore transitions that have only been observed once
+          if (c.count < 2)
+            continue;
+
+          DxvkStateCacheEntry entry = base;
+          applyStateDelta(PredictorDelta(i), c.entry, entry);
+          predicted.push_back({ c.count, entry });
+        }
+      }
+    }
+
+    std::sort(predicted.begin(), predicted.end(),
+      [] (const auto& a, const auto& b) { return a.first > b.first; });
+
+    WorkerItem item;
+
+    for (const auto& p : predicted) {
+      if (item.states.size() >= m_specBudget)
+        break;
+
+      // Skip states that are already in the state cache
+      // since those get compiled in the demand lane anyway
+      auto entries = m_entryMap.equal_range(shaders);
+      bool skip = false;
+
+      for (auto e = entries.first; e != entries.second && !skip; e++) {
+        const DxvkStateCacheEntry& entry = m_entries[e->second];
+        skip = entry.format.eq(p.second.format) && entry.gpState == p.second.gpState;
+      }
+
+      for (size_t i = 0; i < item.states.size() && !skip; i++)
+        skip = item.states[i].format.eq(p.second.format) && item.states[i].gpState == p.second.gpState;
+
+      if (!skip)
+        item.states.push_back(p.second);
+    }
+
+    if (item.states.empty())
+      return;
+
+    std::lock_guard<std::mutex> entryLock(m_entryLock);
+
+    if (!getWorkerItem(shaders, item))
+      return;
+
+    std::lock_guard<std::mutex> workerLock(m_workerLock);
+
+    // Don't let speculative work pile up if
+    // the workers cannot keep up with it
+    if (m_workerStats[uint32_t(DxvkCompilerPriority::Speculative)].queueDepth >= 64)
+      return;
+
+    pushWorkerItem(std::move(item), DxvkCompilerPriority::Speculative);
+    m_workerCond.notify_all();
+  }
+
+
+  void DxvkStateCache::learnStateTransition(
+    const DxvkStateCacheEntry&      prev,
+    const DxvkStateCacheEntry&      next) {
+    for (uint32_t i = 0; i < PredictorDeltaCount; i++) {
+      PredictorDelta type = PredictorDelta(i);
+
+      size_t prevHash = hashStateDelta(type, prev);
+      size_t nextHash = hashStateDelta(type, next);
+
+      if (prevHash == nextHash)
+        continue;
+
+      PredictorKey key = { type, prevHash };
+      auto entry = m_predictorTable.find(key);
+
+      if (entry == m_predictorTable.end()) {
+        if (m_predictorTable.size() >= 4096)
+          continue;
+
+        entry = m_predictorTable.insert({ key, { } }).first;
+      }
+
+      auto& candidates = entry->second;
+      PredictorCandidate* least = nullptr;
+      bool found = false;
+
+      for (auto& c : candidates) {
+        if (c.hash == nextHash) {
+          c.count += 1;
+          found = true;
+          break;
+        }
+
+        if (!least || c.count < least->count)
+          least = &c;
+      }
+
+      if (found)
+        continue;
+
+      // Keep a small number of candidates per source
+      // state, and replace the least frequent one
+      if (candidates.size() < 4)
+        candidates.push_back({ next, nextHash, 1 });
+      else if (least->count <= 1)
+        *least = { next, nextHash, 1 };
+      else
+        least->count -= 1;
+    }
+  }
+
+
+  size_t DxvkStateCache::hashStateDelta(
+          PredictorDelta            type,
+    const DxvkStateCacheEntry&      entry) {
+    DxvkHashState hash;
+
+    if (type == PredictorDelta::RenderPass) {
+      hash.add(entry.format.hash());
+      hash.add(entry.gpState.rsSampleCount);
+      hash.add(entry.gpState.msSampleCount);
+      return hash;
+    }
+
+    size_t begin = type == PredictorDelta::Blend
+      ? offsetof(DxvkGraphicsPipelineStateInfo, omEnableLogicOp)
+      : offsetof(DxvkGraphicsPipelineStateInfo, dsEnableDepthTest);
+    size_t end   = type == PredictorDelta::Blend
+      ? offsetof(DxvkGraphicsPipelineStateInfo, scSpecConstants)
+      : offsetof(DxvkGraphicsPipelineStateInfo, omEnableLogicOp);
+
+    auto data = reinterpret_cast<const uint32_t*>(&entry.gpState);
+
+    for (size_t i = begin / sizeof(uint32_t); i < end / sizeof(uint32_t); i++)
+      hash.add(data[i]);
+
+    return hash;
+  }
+
+
+  void DxvkStateCache::applyStateDelta(
+          PredictorDelta            type,
+    const DxvkStateCacheEntry&      src,
+          DxvkStateCacheEntry&      dst) {
+    switch (type) {
+      case PredictorDelta::Blend:
+        dst.gpState.omEnableLogicOp = src.gpState.omEnableLogicOp;
+        dst.gpState.omLogicOp       = src.gpState.omLogicOp;
+
+        for (uint32_t i = 0; i < MaxNumRenderTargets; i++) {
+          dst.gpState.omBlendAttachments[i] = src.gpState.omBlendAttachments[i];
+          dst.gpState.omComponentMapping[i] = src.gpState.omComponentMapping[i];
+        }
+        break;
+
+      case PredictorDelta::DepthStencil:
+        dst.gpState.dsEnableDepthTest       = src.gpState.dsEnableDepthTest;
+        dst.gpState.dsEnableDepthWrite      = src.gpState.dsEnableDepthWrite;
+        dst.gpState.dsEnableDepthBoundsTest = src.gpState.dsEnableDepthBoundsTest;
+        dst.gpState.dsEnableStencilTest     = src.gpState.dsEnableStencilTest;
+        dst.gpState.dsDepthCompareOp        = src.gpState.dsDepthCompareOp;
+        dst.gpState.dsStencilOpFront        = src.gpState.dsStencilOpFront;
+        dst.gpState.dsStencilOpBack         = src.gpState.dsStencilOpBack;
+        break;
+
+      case PredictorDelta::RenderPass:
+        dst.format                = src.format;
+        dst.gpState.rsSampleCount = src.gpState.rsSampleCount;
+        dst.gpState.msSampleCount = src.gpState.msSampleCount;
+        break;
+    }
+  }
+
+
   bool DxvkStateCache::readCacheFile() {
     // Open state file and just fail if it doesn't exist
     std::ifstream ifile(getCacheFileName(), std::ios_base::binary);
@@ -357,156 +716,44 @@ namespace dxvk {
   }
 
 
-  bool DxvkStateCache::readCacheHeader(
-          std::istream&             stream,
-          DxvkStateCacheHeader&     header) const {
-    DxvkStateCacheHeader expected;
-
-    auto data = reinterpret_cast<char*>(&header);
-    auto size = sizeof(header);
-
-    if (!stream.read(data, size))
-      return false;
-    
-    for (uint32_t i = 0; i < 4; i++) {
-      if (expected.magic[i] != header.magic[i])
-        return false;
-    }
-    
-    return true;
-  }
-
-
-  bool DxvkStateCache::readCacheEntry(
-          uint32_t                  version,
-          std::istream&             stream, 
-          DxvkStateCacheEntry&      entry) const {
-    if (version <= 4) {
-      DxvkStateCacheEntryV4 v4;
-
-      if (!readCacheEntryTyped(stream, v4))
-        return false;
-      
-      if (version == 2)
-        convertEntryV2(v4);
-      
-      return convertEntryV4(v4, entry);
-    } else {
-      return readCacheEntryTyped(stream, entry);
-    }
-  }
-
-
-  void DxvkStateCache::writeCacheEntry(
-          std::ostream&             stream, 
-          DxvkStateCacheEntry&      entry) const {
-    entry.hash = Sha1Hash::compute(entry);
-
-    auto data = reinterpret_cast<const char*>(&entry);
-    auto size = sizeof(DxvkStateCacheEntry);
-
-    stream.write(data, size);
-    stream.flush();
-  }
-
-
-  bool DxvkStateCache::convertEntryV2(
-          DxvkStateCacheEntryV4&    entry) const {
-    // Semantics changed:
-    // v2: rsDepthClampEnable
-    // v3: rsDepthClipEnable
-    entry.gpState.rsDepthClipEnable = !entry.gpState.rsDepthClipEnable;
-
-    // Frontend changed: Depth bias
-    // will typically be disabled
-    entry.gpState.rsDepthBiasEnable = VK_FALSE;
-    return true;
-  }
-
-
-  bool DxvkStateCache::convertEntryV4(
-    const DxvkStateCacheEntryV4&    in,
-          DxvkStateCacheEntry&      out) const {
-    out.shaders = in.shaders;
-    out.cpState = in.cpState;
-    out.format  = in.format;
-    out.hash    = in.hash;
-
-    out.gpState.bsBindingMask           = in.gpState.bsBindingMask;
-    
-    out.gpState.iaPrimitiveTopology     = in.gpState.iaPrimitiveTopology;
-    out.gpState.iaPrimitiveRestart      = in.gpState.iaPrimitiveRestart;
-    out.gpState.iaPatchVertexCount      = in.gpState.iaPatchVertexCount;
-    
-    out.gpState.ilAttributeCount        = in.gpState.ilAttributeCount;
-    out.gpState.ilBindingCount          = in.gpState.ilBindingCount;
-
-    for (uint32_t i = 0; i < in.gpState.ilAttributeCount; i++)
-      out.gpState.ilAttributes[i]       = in.gpState.ilAttributes[i];
-
-    for (uint32_t i = 0; i < in.gpState.ilBindingCount; i++) {
-      out.gpState.ilBindings[i]         = in.gpState.ilBindings[i];
-      out.gpState.ilDivisors[i]         = in.gpState.ilDivisors[i];
-    }
-    
-    out.gpState.rsDepthClipEnable       = in.gpState.rsDepthClipEnable;
-    out.gpState.rsDepthBiasEnable       = in.gpState.rsDepthBiasEnable;
-    out.gpState.rsPolygonMode           = in.gpState.rsPolygonMode;
-    out.gpState.rsCullMode              = in.gpState.rsCullMode;
-    out.gpState.rsFrontFace             = in.gpState.rsFrontFace;
-    out.gpState.rsViewportCount         = in.gpState.rsViewportCount;
-    out.gpState.rsSampleCount           = in.gpState.rsSampleCount;
-    
-    out.gpState.msSampleCount           = in.gpState.msSampleCount;
-    out.gpState.msSampleMask            = in.gpState.msSampleMask;
-    out.gpState.msEnableAlphaToCoverage = in.gpState.msEnableAlphaToCoverage;
-    
-    out.gpState.dsEnableDepthTest       = in.gpState.dsEnableDepthTest;
-    out.gpState.dsEnableDepthWrite      = in.gpState.dsEnableDepthWrite;
-    out.gpState.dsEnableStencilTest     = in.gpState.dsEnableStencilTest;
-    out.gpState.dsDepthCompareOp        = in.gpState.dsDepthCompareOp;
-    out.gpState.dsStencilOpFront        = in.gpState.dsStencilOpFront;
-    out.gpState.dsStencilOpBack         = in.gpState.dsStencilOpBack;
-    
-    out.gpState.omEnableLogicOp         = in.gpState.omEnableLogicOp;
-    out.gpState.omLogicOp               = in.gpState.omLogicOp;
-
-    for (uint32_t i = 0; i < MaxNumRenderTargets; i++) {
-      out.gpState.omBlendAttachments[i] = in.gpState.omBlendAttachments[i];
-      out.gpState.omComponentMapping[i] = in.gpState.omComponentMapping[i];
-    }
-
-    return true;
-  }
-
-
-  void DxvkStateCache::workerFunc() {
+  void DxvkStateCache::workerFunc(uint32_t workerId) {
     env::setThreadName("dxvk-shader");
 
+    uint64_t cpuTime = env::getThreadCpuTime();
+
     while (!m_stopThreads.load()) {
       WorkerItem item;
 
       { std::unique_lock<std::mutex> lock(m_workerLock);
 
-        if (m_workerQueue.empty()) {
+        updateWorkerLimit();
+
+        if (!popWorkerItem(workerId, item)) {
           m_workerBusy -= 1;
-          m_workerCond.wait(lock, [this] () {
-            return m_workerQueue.size()
+          m_workerCond.wait(lock, [this, workerId] () {
+            return hasWorkerItem(workerId)
                 || m_stopThreads.load();
           });
-
-          if (!m_workerQueue.empty())
-            m_workerBusy += 1;
+          m_workerBusy += 1;
+          continue;
         }
-
-        if (m_workerQueue.empty())
-          break;
-        
-        item = m_workerQueue.front();
-        m_workerQueue.pop();
       }
 
       compilePipelines(item);
+
+      uint64_t newCpuTime = env::getThreadCpuTime();
+      m_workerCpuTime += newCpuTime - cpuTime;
+      cpuTime = newCpuTime;
+
+      uint64_t latency = std::chrono::duration_cast<std::chrono::microseconds>(
+        WorkerClock::now() - item.queueTime).count();
+
+      { std::lock_guard<std::mutex> lock(m_workerLock);
+        DxvkCompilerLaneStats& stats = m_workerStats[uint32_t(item.priority)];
+        stats.itemCount      += 1;
+        stats.totalLatencyUs += latency;
+        stats.maxLatencyUs    = std::max(stats.maxLatencyUs, latency);
+      }
     }
   }
 
@@ -540,29 +787,13 @@ namespace dxvk {
       }
 
       writeCacheEntry(file, entry);
+      file.flush();
     }
   }
 
 
   std::string DxvkStateCache::getCacheFileName() const {
-    std::string path = getCacheDir();
-
-    if (!path.empty() && *path.rbegin() != '/')
-      path += '/';
-    
-    std::string exeName = env::getExeName();
-    auto extp = exeName.find_last_of('.');
-    
-    if (extp != std::string::npos && exeName.substr(extp + 1) == "exe")
-      exeName.erase(extp);
-    
-    path += exeName + ".dxvk-cache";
-    return path;
-  }
-
-
-  std::string DxvkStateCache::getCacheDir() const {
-    return env::getEnvVar("DXVK_STATE_CACHE_PATH");
+    return util::getCacheFileName(".dxvk-cache");
   }
 
 }
@@ -1,11 +1,14 @@
 #pragma once
 
+#include <array>
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <fstream>
 #include <mutex>
 #include <queue>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include "dxvk_state_cache_types.h"
@@ -42,8 +45,9 @@ namespace dxvk {
      * \param [in] shaders Shader keys
      * \param [in] state Graphics pipeline state
      * \param [in] format Render pass format
+     * \returns \c true if the pipeline was already cached
      */
-    void addGraphicsPipeline(
+    bool addGraphicsPipeline(
       const DxvkStateCacheKey&              shaders,
       const DxvkGraphicsPipelineStateInfo&  state,
       const DxvkRenderPassFormat&           format);
@@ -55,8 +59,9 @@ namespace dxvk {
      * will write a new pipeline to the cache file.
      * \param [in] shaders Shader keys
      * \param [in] state Compute pipeline state
+     * \returns \c true if the pipeline was already cached
      */
-    void addComputePipeline(
+    bool addComputePipeline(
       const DxvkStateCacheKey&              shaders,
       const DxvkComputePipelineStateInfo&   state);
 
@@ -79,13 +84,118 @@ namespace dxvk {
       return m_workerBusy.load() > 0;
     }
 
+    /**
+     * \brief Queues pipelines for a set of shaders
+     * 
+     * Compiles all cached pipeline states for the given
+     * shaders in the background. If the pipelines are
+     * already queued in a lower-priority lane, they
+     * will be moved to the given lane.
+     * \param [in] shaders Shader keys
+     * \param [in] priority Compiler lane
+     */
+    void queuePipelines(
+      const DxvkStateCacheKey&              shaders,
+            DxvkCompilerPriority            priority);
+
+    /**
+     * \brief Retrieves compiler lane statistics
+     * 
+     * \param [in] priority Compiler lane
+     * \returns Statistics for the given lane
+     */
+    DxvkCompilerLaneStats getCompilerLaneStats(
+            DxvkCompilerPriority            priority);
+
+    /**
+     * \brief Reads state cache file header
+     * 
+     * Only validates the magic number. Version and
+     * entry size must be checked by the caller.
+     * \param [in] stream Input stream
+     * \param [out] header The header
+     * \returns \c true if the header is valid
+     */
+    static bool readCacheHeader(
+            std::istream&             stream,
+            DxvkStateCacheHeader&     header);
+
+    /**
+     * \brief Reads a single state cache entry
+     * 
+     * Converts entries from older versions to the
+     * current format, and verifies the check sum.
+     * \param [in] version State cache file version
+     * \param [in] stream Input stream
+     * \param [out] entry The entry
+     * \returns \c true if the entry is valid
+     */
+    static bool readCacheEntry(
+            uint32_t                  version,
+            std::istream&             stream, 
+            DxvkStateCacheEntry&      entry);
+    
+    /**
+     * \brief Writes state cache file header
+     * 
+     * Writes a header for the current version.
+     * \param [in] stream Output stream
+     */
+    static void writeCacheHeader(
+            std::ostream&             stream);
+
+    /**
+     * \brief Writes a single state cache entry
+     * 
+     * Computes the check sum of the entry before
+     * writing it. Does not flush the stream.
+     * \param [in] stream Output stream
+     * \param [in] entry The entry
+     */
+    static void writeCacheEntry(
+            std::ostream&             stream, 
+            DxvkStateCacheEntry&      entry);
+
   private:
 
     using WriterItem = DxvkStateCacheEntry;
 
+    using WorkerClock = std::chrono::high_resolution_clock;
+
     struct WorkerItem {
       DxvkGraphicsPipelineShaders gp;
       DxvkComputePipelineShaders  cp;
+      DxvkStateCacheKey           key;
+      DxvkCompilerPriority        priority;
+      WorkerClock::time_point     queueTime;
+      std::vector<DxvkStateCacheEntry> states;
+    };
+
+    enum class PredictorDelta : uint32_t {
+      Blend        = 0,
+      DepthStencil = 1,
+      RenderPass   = 2,
+    };
+
+    static constexpr uint32_t PredictorDeltaCount = 3;
+
+    struct PredictorKey {
+      PredictorDelta  type;
+      size_t          state;
+
+      bool eq(const PredictorKey& other) const {
+        return type == other.type && state == other.state;
+      }
+
+      size_t hash() const {
+        return state ^ size_t(type);
+      }
+    };
+
+    struct PredictorCandidate {
+      DxvkStateCacheEntry entry;
+      size_t              hash;
+      uint32_t            count;
     };
 
     DxvkPipelineManager*              m_pipeManager;
@@ -110,10 +220,42 @@ namespace dxvk {
 
     std::mutex                        m_workerLock;
     std::condition_variable           m_workerCond;
-    std::queue<WorkerItem>            m_workerQueue;
     std::atomic<uint32_t>             m_workerBusy;
     std::vector<dxvk::thread>         m_workerThreads;
 
+    std::array<std::queue<WorkerItem>,
+      DxvkCompilerPriorityCount>      m_workerQueues;
+    std::array<DxvkCompilerLaneStats,
+      DxvkCompilerPriorityCount>      m_workerStats;
+
+    std::unordered_map<
+      DxvkStateCacheKey, DxvkCompilerPriority,
+      DxvkHash, DxvkEq> m_workerPending;
+
+    std::unordered_set<
+      DxvkStateCacheKey,
+      DxvkHash, DxvkEq> m_workerDone;
+
+    uint32_t                          m_workerCount    = 0;
+    uint32_t                          m_workerLimit    = 0;
+    uint32_t                          m_numCpuCores    = 0;
+    WorkerClock::time_point           m_cpuSampleTime;
+    uint64_t                          m_cpuProcessTime = 0;
+    uint64_t                          m_cpuWorkerTime  = 0;
+    std::atomic<uint64_t>             m_workerCpuTime  = { 0ull };
+
+    uint32_t                          m_specBudget = 0;
+
+    std::mutex                        m_predictorLock;
+
+    std::unordered_map<
+      DxvkStateCacheKey, DxvkStateCacheEntry,
+      DxvkHash, DxvkEq> m_predictorLast;
+
+    std::unordered_map<
+      PredictorKey, std::vector<PredictorCandidate>,
+      DxvkHash, DxvkEq> m_predictorTable;
+
     std::mutex                        m_writerLock;
     std::condition_variable           m_writerCond;
     std::queue<WriterItem>            m_writerQueue;
@@ -137,35 +279,55 @@ namespace dxvk {
     void compilePipelines(
       const WorkerItem&               item);
 
-    bool readCacheFile();
+    bool getWorkerItem(
+      const DxvkStateCacheKey&        key,
+            WorkerItem&               item) const;
 
-    bool readCacheHeader(
-            std::istream&             stream,
-            DxvkStateCacheHeader&     header) const;
+    void pushWorkerItem(
+            WorkerItem&&              item,
+            DxvkCompilerPriority      priority);
 
-    bool readCacheEntry(
-            uint32_t                  version,
-            std::istream&             stream, 
-            DxvkStateCacheEntry&      entry) const;
-    
-    void writeCacheEntry(
-            std::ostream&             stream, 
-            DxvkStateCacheEntry&      entry) const;
-    
-    bool convertEntryV2(
-            DxvkStateCacheEntryV4&    entry) const;
+    bool hasWorkerItem(
+            uint32_t                  workerId) const;
+
+    bool popWorkerItem(
+            uint32_t                  workerId,
+            WorkerItem&               item);
+
+    void updateWorkerLimit();
+
+    void predictPipelines(
+      const DxvkStateCacheKey&              shaders,
+      const DxvkGraphicsPipelineStateInfo&  state,
+      const DxvkRenderPassFormat&           format);
+
+    void learnStateTransition(
+      const DxvkStateCacheEntry&      prev,
+      const DxvkStateCacheEntry&      next);
+
+    static size_t hashStateDelta(
+            PredictorDelta            type,
+      const DxvkStateCacheEntry&      entry);
+
+    static void applyStateDelta(
+            PredictorDelta            type,
+      const DxvkStateCacheEntry&      src,
+            DxvkStateCacheEntry&      dst);
+
+    bool readCacheFile();
+
+    static bool convertEntryV2(
+            DxvkStateCacheEntryV4&    entry);
     
-    bool convertEntryV4(
+    static bool convertEntryV4(
       const DxvkStateCacheEntryV4&    in,
-            DxvkStateCacheEntry&      out) const;
+            DxvkStateCacheEntry&      out);
     
-    void workerFunc();
+    void workerFunc(uint32_t workerId);
 
     void writerFunc();
 
     std::string getCacheFileName() const;
-    
-    std::string getCacheDir() const;
 
   };
 
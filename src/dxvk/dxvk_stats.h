@@ -12,6 +12,7 @@ namespace dxvk {
    */
   enum class DxvkStatCounter : uint32_t {
     CmdDrawCalls,             ///< Number of draw calls
+    CmdDrawsMerged,           ///< Number of client API draws merged into others
     CmdDispatchCalls,         ///< Number of compute calls
     CmdRenderPassCount,       ///< Number of render passes
     MemoryAllocationCount,    ///< Number of memory allocations
@@ -20,6 +21,17 @@ namespace dxvk {
     PipeCountGraphics,        ///< Number of graphics pipelines
     PipeCountCompute,         ///< Number of compute pipelines
     PipeCompilerBusy,         ///< Boolean indicating compiler activity
+    PipeQueueDemand,          ///< Queued demand compiler items
+    PipeQueuePrewarm,         ///< Queued prewarm compiler items
+    PipeQueueSpeculative,     ///< Queued speculative compiler items
+    PipeLatencyDemand,        ///< Average demand item latency in microseconds
+    PipeLatencyPrewarm,       ///< Average prewarm item latency in microseconds
+    PipeLatencySpeculative,   ///< Average speculative item latency in microseconds
+    PipeStallTime,            ///< Time spent compiling pipelines on demand, in microseconds
+    PipeStallCount,           ///< Number of pipelines compiled on demand
+    PipeSpecCount,            ///< Number of speculatively compiled pipelines
+    PipeSpecHits,             ///< Number of speculative pipelines used by the app
+    PipeDynamicStates,        ///< Number of spec constant changes served without a pipeline change
     QueueSubmitCount,         ///< Number of command buffer submissions
     QueuePresentCount,        ///< Number of present calls / frames
     GpuIdleTicks,             ///< GPU idle time in microseconds
@@ -3,7 +3,14 @@
 #include "dxvk_format.h"
 #include "dxvk_util.h"
 
+#include "../util/util_env.h"
+
 namespace dxvk::util {
+
+  static std::string getCacheDir() {
+    return env::getEnvVar("DXVK_STATE_CACHE_PATH");
+  }
+
   
   VkPipelineStageFlags pipelineStages(
           VkShaderStageFlags shaderStages) {
@@ -183,4 +190,38 @@ namespace dxvk::util {
         || factor == VK_BLEND_FACTOR_ONE_MINUS_SRC1_ALPHA;
   }
 
+
+
+  std::string getCacheFileName(
+    const std::string&                suffix) {
+    std::string path = getCacheDir();
+
+    if (!path.empty() && *path.rbegin() != '/')
+      path += '/';
+    
+    std::string exeName = env::getExeName();
+    auto extp = exeName.find_last_of('.');
+    
+    if (extp != std::string::npos && exeName.substr(extp + 1) == "exe")
+      exeName.erase(extp);
+    
+    return path + exeName + suffix;
+  }
+
+
+  std::ofstream createCacheFile(
+    const std::string&                fileName) {
+    std::ofstream file(fileName,
+      std::ios_base::binary |
+      std::ios_base::trunc);
+
+    if (!file && env::createDirectory(getCacheDir())) {
+      file = std::ofstream(fileName,
+        std::ios_base::binary |
+        std::ios_base::trunc);
+    }
+
+    return file;
+  }
+
 }
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <fstream>
+
 #include "dxvk_include.h"
 
 namespace dxvk::util {
@@ -247,4 +249,27 @@ namespace dxvk::util {
   bool isDualSourceBlendFactor(
           VkBlendFactor               factor);
   
+  /**
+   * \brief Computes path of a cache file
+   * 
+   * Cache files are stored in the directory given by
+   * \c DXVK_STATE_CACHE_PATH and named after the
+   * executable, without its \c .exe extension.
+   * \param [in] suffix Appended to the executable name
+   * \returns Path of the cache file
+   */
+  std::string getCacheFileName(
+    const std::string&                suffix);
+  
+  /**
+   * \brief Creates or truncates a cache file
+   * 
+   * Creates the cache directory if the file
+   * cannot be opened because it is missing.
+   * \param [in] fileName Path of the cache file
+   * \returns Output file stream, may be invalid
+   */
+  std::ofstream createCacheFile(
+    const std::string&                fileName);
+  
 }
@@ -17,6 +17,7 @@ namespace dxvk::hud {
     { "version",      HudElement::DxvkVersion       },
     { "api",          HudElement::DxvkClientApi     },
     { "compiler",     HudElement::CompilerActivity  },
+    { "pipestalls",   HudElement::PipelineStalls    },
   }};
   
   
@@ -22,7 +22,8 @@ namespace dxvk::hud {
     DxvkVersion       = 8,
     DxvkClientApi     = 9,
     CompilerActivity  = 10,
-    StatSamplers      = 11
+    StatSamplers      = 11,
+    PipelineStalls    = 12,
   };
   
   using HudElements = Flags<HudElement>;
@@ -26,6 +26,13 @@ namespace dxvk::hud {
     // we don't want to update this every frame
     if (m_elements.test(HudElement::StatGpuLoad))
       this->updateGpuLoad();
+
+    // Store the time spent compiling pipelines on
+    // demand in order to attribute stutter to it
+    if (m_elements.test(HudElement::PipelineStalls)) {
+      m_stallDataPoints[m_stallDataPointId] = m_diffCounters.getCtr(DxvkStatCounter::PipeStallTime);
+      m_stallDataPointId = (m_stallDataPointId + 1) % NumStallDataPoints;
+    }
   }
   
   
@@ -51,6 +58,9 @@ namespace dxvk::hud {
     if (m_elements.test(HudElement::StatGpuLoad))
       position = this->printGpuLoad(context, renderer, position);
     
+    if (m_elements.test(HudElement::PipelineStalls))
+      position = this->printPipelineStalls(context, renderer, position);
+    
     if (m_elements.test(HudElement::CompilerActivity)) {
       this->printCompilerActivity(context, renderer,
         { position.x, float(renderer.surfaceSize().height) - 20.0f });
@@ -88,6 +98,7 @@ namespace dxvk::hud {
     const uint64_t gpCalls = m_diffCounters.getCtr(DxvkStatCounter::CmdDrawCalls)       / frameCount;
     const uint64_t cpCalls = m_diffCounters.getCtr(DxvkStatCounter::CmdDispatchCalls)   / frameCount;
     const uint64_t rpCalls = m_diffCounters.getCtr(DxvkStatCounter::CmdRenderPassCount) / frameCount;
+    const uint64_t mgCalls = m_diffCounters.getCtr(DxvkStatCounter::CmdDrawsMerged)     / frameCount;
     
     const std::string strDrawCalls      = str::format("Draw calls:     ", gpCalls);
     const std::string strDispatchCalls  = str::format("Dispatch calls: ", cpCalls);
@@ -108,7 +119,16 @@ namespace dxvk::hud {
       { 1.0f, 1.0f, 1.0f, 1.0f },
       strRenderPasses);
     
-    return { position.x, position.y + 64 };
+    // Only shown if the client API merges draws
+    if (!mgCalls)
+      return { position.x, position.y + 64 };
+
+    renderer.drawText(context, 16.0f,
+      { position.x, position.y + 60.0f },
+      { 1.0f, 1.0f, 1.0f, 1.0f },
+      str::format("Merged draws:   ", mgCalls));
+    
+    return { position.x, position.y + 84 };
   }
   
   
@@ -136,6 +156,7 @@ namespace dxvk::hud {
           HudPos            position) {
     const uint64_t gpCount = m_prevCounters.getCtr(DxvkStatCounter::PipeCountGraphics);
     const uint64_t cpCount = m_prevCounters.getCtr(DxvkStatCounter::PipeCountCompute);
+    const uint64_t dsCount = m_prevCounters.getCtr(DxvkStatCounter::PipeDynamicStates);
     
     const std::string strGpCount = str::format("Graphics pipelines: ", gpCount);
     const std::string strCpCount = str::format("Compute pipelines:  ", cpCount);
@@ -150,7 +171,50 @@ namespace dxvk::hud {
       { 1.0f, 1.0f, 1.0f, 1.0f },
       strCpCount);
     
-    return { position.x, position.y + 44.0f };
+    float y = position.y + 40.0f;
+
+    // Only shown if the client API reports spec constant
+    // changes that were handled without a new pipeline
+    if (dsCount) {
+      renderer.drawText(context, 16.0f,
+        { position.x, y },
+        { 1.0f, 1.0f, 1.0f, 1.0f },
+        str::format("Avoided variants:   ", dsCount));
+
+      y += 20.0f;
+    }
+
+    // Background compiler lanes in priority order. Only
+    // shown once the state cache has queued any work.
+    static const std::array<const char*, 3> laneNames = {{
+      "Demand lane:        ",
+      "Prewarm lane:       ",
+      "Speculative lane:   ",
+    }};
+
+    bool hasLaneStats = false;
+
+    for (uint32_t i = 0; i < laneNames.size(); i++) {
+      hasLaneStats |= m_prevCounters.getCtr(DxvkStatCounter(uint32_t(DxvkStatCounter::PipeQueueDemand)   + i))
+                   || m_prevCounters.getCtr(DxvkStatCounter(uint32_t(DxvkStatCounter::PipeLatencyDemand) + i));
+    }
+
+    if (hasLaneStats) {
+      for (uint32_t i = 0; i < laneNames.size(); i++) {
+        const uint64_t queued    = m_prevCounters.getCtr(DxvkStatCounter(uint32_t(DxvkStatCounter::PipeQueueDemand)   + i));
+        const uint64_t latencyUs = m_prevCounters.getCtr(DxvkStatCounter(uint32_t(DxvkStatCounter::PipeLatencyDemand) + i));
+
+        renderer.drawText(context, 16.0f,
+          { position.x, y },
+          { 1.0f, 1.0f, 1.0f, 1.0f },
+          str::format(laneNames[i], queued, " queued, ",
+            latencyUs / 1000, ".", (latencyUs / 100) % 10, " ms avg"));
+
+        y += 20.0f;
+      }
+    }
+    
+    return { position.x, y + 4.0f };
   }
   
   
@@ -236,6 +300,64 @@ namespace dxvk::hud {
     return { position.x, position.y + 24.0f };
   }
 
+
+  HudPos HudStats::printPipelineStalls(
+    const Rc<DxvkContext>&  context,
+          HudRenderer&      renderer,
+          HudPos            position) {
+    std::array<HudLineVertex, NumStallDataPoints * 2> vData;
+
+    // Anything above two frames at 60 FPS is
+    // displayed as a full-height red bar
+    const float maxUs = 33'333.3f;
+
+    uint32_t maxUsInWindow = 0;
+
+    for (uint32_t i = 0; i < NumStallDataPoints; i++) {
+      uint32_t us = m_stallDataPoints[(m_stallDataPointId + i) % NumStallDataPoints];
+      maxUsInWindow = std::max(maxUsInWindow, us);
+
+      float r = std::min(float(us) / maxUs, 1.0f);
+
+      HudNormColor color = {
+        uint8_t(255.0f * r),
+        uint8_t(255.0f * (1.0f - r)),
+        uint8_t(0), uint8_t(255) };
+
+      float x = position.x + float(i);
+      float y = position.y + 24.0f;
+      float h = us ? std::max(40.0f * r, 2.0f) : 0.0f;
+
+      vData[2 * i + 0] = HudLineVertex { { x, y     }, color };
+      vData[2 * i + 1] = HudLineVertex { { x, y - h }, color };
+    }
+
+    renderer.drawLines(context, vData.size(), vData.data());
+
+    const uint64_t stallCount = m_prevCounters.getCtr(DxvkStatCounter::PipeStallCount);
+    const uint64_t stallTime  = m_prevCounters.getCtr(DxvkStatCounter::PipeStallTime);
+
+    renderer.drawText(context, 14.0f,
+      { position.x, position.y + 44.0f },
+      { 1.0f, 1.0f, 1.0f, 1.0f },
+      str::format("stalls: ", stallCount, " (", stallTime / 1000, " ms)"));
+
+    renderer.drawText(context, 14.0f,
+      { position.x + 150.0f, position.y + 44.0f },
+      { 1.0f, 1.0f, 1.0f, 1.0f },
+      str::format("max: ", maxUsInWindow / 1000, ".", (maxUsInWindow / 100) % 10));
+
+    const uint64_t specCount = m_prevCounters.getCtr(DxvkStatCounter::PipeSpecCount);
+    const uint64_t specHits  = m_prevCounters.getCtr(DxvkStatCounter::PipeSpecHits);
+
+    renderer.drawText(context, 14.0f,
+      { position.x, position.y + 62.0f },
+      { 1.0f, 1.0f, 1.0f, 1.0f },
+      str::format("speculative: ", specHits, " / ", specCount, " used"));
+
+    return { position.x, position.y + 84.0f };
+  }
+
   
   HudElements HudStats::filterElements(HudElements elements) {
     return elements & HudElements(
@@ -245,7 +367,8 @@ namespace dxvk::hud {
       HudElement::StatSamplers,
       HudElement::StatMemory,
       HudElement::StatGpuLoad,
-      HudElement::CompilerActivity);
+      HudElement::CompilerActivity,
+      HudElement::PipelineStalls);
   }
   
 }
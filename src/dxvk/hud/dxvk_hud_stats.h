@@ -1,5 +1,6 @@
 #pragma once
 
+#include <array>
 #include <chrono>
 
 #include "../dxvk_stats.h"
@@ -46,6 +47,11 @@ namespace dxvk::hud {
     
     std::string m_gpuLoadString = "GPU: ";
 
+    constexpr static uint32_t NumStallDataPoints = 300;
+
+    std::array<uint32_t, NumStallDataPoints> m_stallDataPoints = {};
+    uint32_t                                  m_stallDataPointId = 0;
+
     void updateGpuLoad();
     
     HudPos printDrawCallStats(
@@ -82,6 +88,11 @@ namespace dxvk::hud {
       const Rc<DxvkContext>&  context,
             HudRenderer&      renderer,
             HudPos            position);
+
+    HudPos printPipelineStalls(
+      const Rc<DxvkContext>&  context,
+            HudRenderer&      renderer,
+            HudPos            position);
     
     static HudElements filterElements(HudElements elements);
     
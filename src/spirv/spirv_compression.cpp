@@ -1,64 +1,116 @@
+#define SPV_ENABLE_UTILITY_CODE
+
+#include <algorithm>
+
 #include "spirv_compression.h"
 
+#include "../util/util_likely.h"
+
 namespace dxvk {
 
-  SpirvCompressedBuffer::SpirvCompressedBuffer()
-  : m_size(0) {
+  template<bool Validate>
+  static inline bool readVarInt(
+    const uint8_t*&         src,
+    const uint8_t*          end,
+          uint64_t&         value) {
+    // Fast path for the common single-byte case
+    if ((!Validate || src != end) && !(*src & 0x80)) {
+      value = *(src++);
+      return true;
+    }
+
+    value = 0;
 
+    for (uint32_t shift = 0; ; shift += 7) {
+      // Encoded values never exceed 33 bits
+      if (Validate && (src == end || shift > 28))
+        return false;
+
+      const uint8_t byte = *(src++);
+      value |= uint64_t(byte & 0x7F) << shift;
+
+      if (!(byte & 0x80))
+        return true;
+    }
   }
 
 
-  SpirvCompressedBuffer::SpirvCompressedBuffer(
-    const SpirvCodeBuffer& code)
-  : m_size(code.dwords()) {
-    const uint32_t* data = code.data();
+  static uint32_t computeResultIndex(uint32_t opCode) {
+    bool hasResult = false;
+    bool hasType   = false;
+
+    spv::HasResultAndType(spv::Op(opCode), &hasResult, &hasType);
+    return hasResult ? (hasType ? 2 : 1) : 0;
+  }
 
-    // The compression works by eliminating leading null bytes
-    // from DWORDs, exploiting that SPIR-V IDs are consecutive
-    // integers that usually fall into the 16-bit range. For
-    // each DWORD, a two-bit integer is stored which indicates
-    // the number of bytes it takes in the compressed buffer.
-    // This way, it can achieve a compression ratio of ~50%.
-    m_mask.reserve((m_size + NumMaskWords - 1) / NumMaskWords);
-    m_code.reserve((m_size + 1) / 2);
 
-    uint64_t dstWord  = 0;
-    uint32_t dstShift = 0;
+  struct SpirvResultIndexTable {
+    SpirvResultIndexTable() {
+      for (uint32_t i = 0; i < Size; i++)
+        indices[i] = uint8_t(computeResultIndex(i));
+    }
 
-    for (uint32_t i = 0; i < m_size; i += NumMaskWords) {
-      uint64_t byteCounts = 0;
+    // Covers all core opcodes, extension
+    // opcodes are looked up on demand.
+    constexpr static uint32_t Size = 1024;
+    uint8_t indices[Size];
+  };
 
-      for (uint32_t w = 0; w < NumMaskWords && i + w < m_size; w++) {
-        uint64_t word = data[i + w];
-        uint64_t bytes = 0;
 
-        if      (word < (1 <<  8)) bytes = 0;
-        else if (word < (1 << 16)) bytes = 1;
-        else if (word < (1 << 24)) bytes = 2;
-        else                       bytes = 3;
+  static const SpirvResultIndexTable g_resultIndices;
 
-        byteCounts |= bytes << (2 * w);
 
-        uint32_t bits = 8 * bytes + 8;
-        uint32_t rem  = bit::pack(dstWord, dstShift, word, bits);
+  static inline uint32_t getResultIndex(uint32_t opCode) {
+    return likely(opCode < SpirvResultIndexTable::Size)
+      ? g_resultIndices.indices[opCode]
+      : computeResultIndex(opCode);
+  }
 
-        if (unlikely(rem != 0)) {
-          m_code.push_back(dstWord);
 
-          dstWord  = 0;
-          dstShift = 0;
+  static bool isModule(const uint32_t* data, uint32_t size) {
+    if (size < 5 || data[0] != spv::MagicNumber)
+      return false;
 
-          bit::pack(dstWord, dstShift, word >> (bits - rem), rem);
-        }
-      }
+    uint32_t offset = 5;
 
-      m_mask.push_back(byteCounts);
+    while (offset < size) {
+      const uint32_t length = data[offset] >> spv::WordCountShift;
+
+      if (!length || size - offset < length)
+        return false;
+
+      offset += length;
     }
 
-    if (dstShift)
-      m_code.push_back(dstWord);
+    return true;
+  }
+
+
+  SpirvCompressedBuffer::SpirvCompressedBuffer()
+  : m_size(0) {
+
+  }
+
+
+  SpirvCompressedBuffer::SpirvCompressedBuffer(
+    const SpirvCodeBuffer& code)
+  : m_size(code.dwords()) {
+    const uint32_t* data = code.data();
+
+    if (!m_size)
+      return;
+
+    m_code.reserve(2 * m_size);
+
+    if (isModule(data, m_size)) {
+      this->encodeModule(data);
+    } else {
+      m_code.push_back(ModeRaw);
+
+      for (uint32_t i = 0; i < m_size; i++)
+        this->putVarInt(data[i]);
+    }
 
-    m_mask.shrink_to_fit();
     m_code.shrink_to_fit();
   }
 
@@ -70,41 +122,186 @@ namespace dxvk {
 
   SpirvCodeBuffer SpirvCompressedBuffer::decompress() const {
     SpirvCodeBuffer code(m_size);
-    uint32_t* data = code.data();
+    decode<false>(m_code.data(), m_code.size(), code.data(), m_size);
+    return code;
+  }
+
+
+  void SpirvCompressedBuffer::store(std::ostream& stream) const {
+    uint32_t codeSize = m_code.size();
+
+    stream.write(reinterpret_cast<const char*>(&m_size), sizeof(m_size));
+    stream.write(reinterpret_cast<const char*>(&codeSize), sizeof(codeSize));
+    stream.write(reinterpret_cast<const char*>(m_code.data()), m_code.size());
+  }
+
+
+  bool SpirvCompressedBuffer::load(std::istream& stream) {
+    uint32_t codeSize = 0;
+
+    if (!stream.read(reinterpret_cast<char*>(&m_size), sizeof(m_size))
+     || !stream.read(reinterpret_cast<char*>(&codeSize), sizeof(codeSize)))
+      return false;
+
+    // Sanity check to avoid huge allocations on bad data. Each
+    // DWORD takes at most five bytes, plus the mode byte.
+    if (codeSize > 5 * uint64_t(m_size) + 1)
+      return false;
 
-    if (m_size == 0)
-      return code;
+    m_code.resize(codeSize);
 
-    uint32_t maskIdx = 0;
-    uint32_t codeIdx = 0;
+    if (!stream.read(reinterpret_cast<char*>(m_code.data()), m_code.size()))
+      return false;
 
-    uint64_t srcWord  = m_code[codeIdx++];
-    uint32_t srcShift = 0;
+    return decode<true>(m_code.data(), m_code.size(), nullptr, m_size);
+  }
+
+
+  void SpirvCompressedBuffer::putVarInt(uint64_t value) {
+    while (value >= 0x80) {
+      m_code.push_back(uint8_t(value | 0x80));
+      value >>= 7;
+    }
+
+    m_code.push_back(uint8_t(value));
+  }
+
+
+  void SpirvCompressedBuffer::encodeModule(const uint32_t* data) {
+    m_code.push_back(ModeModule);
+
+    for (uint32_t i = 0; i < 5; i++)
+      this->putVarInt(data[i]);
+
+    // Operands are encoded relative to the expected next result
+    // ID if that yields a smaller number than the raw value. The
+    // lowest bit of each encoded operand indicates which is used.
+    uint32_t maxId = 0;
+
+    for (uint32_t i = 5; i < m_size; ) {
+      const uint32_t opCode = data[i] & spv::OpCodeMask;
+      const uint32_t length = data[i] >> spv::WordCountShift;
+
+      this->putVarInt((uint64_t(opCode) << 5) | (length < 32 ? length : 0));
+
+      if (length >= 32)
+        this->putVarInt(length);
 
-    for (uint32_t i = 0; i < m_size; i += NumMaskWords) {
-      uint64_t srcMask = m_mask[maskIdx++];
+      const uint32_t resultIndex = getResultIndex(opCode);
 
-      for (uint32_t w = 0; w < NumMaskWords && i + w < m_size; w++) {
-        uint32_t bits = 8 * ((srcMask & 3) + 1);
+      for (uint32_t j = 1; j < length; j++) {
+        const uint32_t word = data[i + j];
+        const uint64_t base = uint64_t(maxId) + 1;
 
-        uint64_t word = 0;
-        uint32_t rem = bit::unpack(word, srcWord, srcShift, bits);
+        uint64_t value = uint64_t(word) << 1;
 
-        if (unlikely(rem != 0)) {
-          srcWord  = m_code[codeIdx++];
-          srcShift = 0;
+        if (word <= base)
+          value = std::min(value, ((base - word) << 1) | 1);
 
-          uint64_t tmp = 0;
-          bit::unpack(tmp, srcWord, srcShift, rem);
-          word |= tmp << (bits - rem);
-        }
+        this->putVarInt(value);
 
-        data[i + w] = word;
-        srcMask >>= 2;
+        if (j == resultIndex)
+          maxId = std::max(maxId, word);
       }
+
+      i += length;
     }
+  }
 
-    return code;
+
+  template<bool Validate>
+  bool SpirvCompressedBuffer::decode(
+    const uint8_t*          src,
+          size_t            srcSize,
+          uint32_t*         dst,
+          uint32_t          dstSize) {
+    const uint8_t* end = src + srcSize;
+
+    if (!dstSize)
+      return !srcSize;
+
+    if (Validate && !srcSize)
+      return false;
+
+    const uint8_t mode = *(src++);
+    uint64_t value = 0;
+
+    if (mode == ModeRaw) {
+      for (uint32_t i = 0; i < dstSize; i++) {
+        if (!readVarInt<Validate>(src, end, value))
+          return false;
+
+        if (Validate && (value >> 32))
+          return false;
+
+        if (!Validate)
+          dst[i] = uint32_t(value);
+      }
+
+      return !Validate || src == end;
+    }
+
+    if (Validate && (mode != ModeModule || dstSize < 5))
+      return false;
+
+    for (uint32_t i = 0; i < 5; i++) {
+      if (!readVarInt<Validate>(src, end, value))
+        return false;
+
+      if (!Validate)
+        dst[i] = uint32_t(value);
+    }
+
+    uint32_t maxId = 0;
+
+    for (uint32_t i = 5; i < dstSize; ) {
+      if (!readVarInt<Validate>(src, end, value))
+        return false;
+
+      const uint32_t opCode = uint32_t(value >> 5);
+      uint32_t length = uint32_t(value & 31);
+
+      if (!length) {
+        if (!readVarInt<Validate>(src, end, value))
+          return false;
+
+        length = uint32_t(value);
+
+        if (Validate && (value < 32 || value > 0xFFFF))
+          return false;
+      }
+
+      if (Validate && (opCode > spv::OpCodeMask || dstSize - i < length))
+        return false;
+
+      if (!Validate)
+        dst[i] = opCode | (length << spv::WordCountShift);
+
+      const uint32_t resultIndex = getResultIndex(opCode);
+
+      for (uint32_t j = 1; j < length; j++) {
+        if (!readVarInt<Validate>(src, end, value))
+          return false;
+
+        const uint64_t base = uint64_t(maxId) + 1;
+        const uint64_t word = (value & 1)
+          ? base - (value >> 1)
+          : value >> 1;
+
+        if (Validate && (value & 1 ? (value >> 1) > base : (word >> 32)))
+          return false;
+
+        if (!Validate)
+          dst[i + j] = uint32_t(word);
+
+        if (j == resultIndex)
+          maxId = std::max(maxId, uint32_t(word));
+      }
+
+      i += length;
+    }
+
+    return !Validate || src == end;
   }
 
-}
\ No newline at end of file
+}
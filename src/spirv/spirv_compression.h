@@ -11,9 +11,16 @@ namespace dxvk {
    *
    * Implements a fast in-memory compression
    * to keep memory footprint low.
+   *
+   * SPIR-V modules are stored as a byte stream of
+   * variable-length integers. Instruction headers are
+   * packed into a single integer, and operands are
+   * stored either as-is or relative to the highest
+   * result ID defined so far, whichever is smaller.
+   * Since most operands are type IDs, recent result
+   * IDs or small literals, most words take one byte.
    */
   class SpirvCompressedBuffer {
-    constexpr static uint32_t NumMaskWords = 32;
   public:
 
     SpirvCompressedBuffer();
@@ -25,11 +32,50 @@ namespace dxvk {
     
     SpirvCodeBuffer decompress() const;
 
+    /**
+     * \brief Writes compressed data to a stream
+     * \param [in] stream Output stream
+     */
+    void store(std::ostream& stream) const;
+
+    /**
+     * \brief Reads compressed data from a stream
+     * 
+     * Validates that the data can be decompressed
+     * without reading past the end of the buffer.
+     * \param [in] stream Input stream
+     * \returns \c true on success
+     */
+    bool load(std::istream& stream);
+
+    /**
+     * \brief Compressed size
+     * \returns Size of the compressed data, in bytes
+     */
+    size_t compressedSize() const {
+      return m_code.size();
+    }
+
   private:
 
+    enum Mode : uint8_t {
+      ModeRaw     = 0,  ///< Arbitrary words
+      ModeModule  = 1,  ///< SPIR-V module with header
+    };
+
     uint32_t              m_size;
-    std::vector<uint64_t> m_mask;
-    std::vector<uint64_t> m_code;
+    std::vector<uint8_t>  m_code;
+
+    void putVarInt(uint64_t value);
+
+    void encodeModule(const uint32_t* data);
+
+    template<bool Validate>
+    static bool decode(
+      const uint8_t*          src,
+            size_t            srcSize,
+            uint32_t*         dst,
+            uint32_t          dstSize);
 
   };
 
@@ -389,9 +389,7 @@ namespace dxvk {
       ? spv::OpSpecConstantTrue
       : spv::OpSpecConstantFalse;
     
-    m_typeConstDefs.putIns  (op, 3);
-    m_typeConstDefs.putWord (typeId);
-    m_typeConstDefs.putWord (resultId);
+    this->putTypeConst(op, typeId, resultId, 0, nullptr);
     return resultId;
   }
     
@@ -401,10 +399,7 @@ namespace dxvk {
           uint32_t                value) {
     uint32_t resultId = this->allocateId();
     
-    m_typeConstDefs.putIns  (spv::OpSpecConstant, 4);
-    m_typeConstDefs.putWord (typeId);
-    m_typeConstDefs.putWord (resultId);
-    m_typeConstDefs.putWord (value);
+    this->putTypeConst(spv::OpSpecConstant, typeId, resultId, 1, &value);
     return resultId;
   }
   
@@ -505,17 +500,21 @@ namespace dxvk {
   }
   
 
-  void SpirvModule::decorateXfb(
+  void SpirvModule::decorateStream(
           uint32_t                object,
-          uint32_t                streamId,
-          uint32_t                bufferId,
-          uint32_t                offset,
-          uint32_t                stride) {
+          uint32_t                streamId) {
     m_annotations.putIns  (spv::OpDecorate, 4);
     m_annotations.putWord (object);
     m_annotations.putWord (spv::DecorationStream);
     m_annotations.putInt32(streamId);
-
+  }
+  
+  
+  void SpirvModule::decorateXfb(
+          uint32_t                object,
+          uint32_t                bufferId,
+          uint32_t                offset,
+          uint32_t                stride) {
     m_annotations.putIns  (spv::OpDecorate, 4);
     m_annotations.putWord (object);
     m_annotations.putWord (spv::DecorationXfbBuffer);
@@ -642,12 +641,10 @@ namespace dxvk {
   uint32_t SpirvModule::defArrayTypeUnique(
           uint32_t                typeId,
           uint32_t                length) {
+    std::array<uint32_t, 2> args = {{ typeId, length }};
+
     uint32_t resultId = this->allocateId();
-    
-    m_typeConstDefs.putIns (spv::OpTypeArray, 4);
-    m_typeConstDefs.putWord(resultId);
-    m_typeConstDefs.putWord(typeId);
-    m_typeConstDefs.putWord(length);
+    this->putTypeConst(spv::OpTypeArray, 0, resultId, args.size(), args.data());
     return resultId;
   }
   
@@ -664,10 +661,7 @@ namespace dxvk {
   uint32_t SpirvModule::defRuntimeArrayTypeUnique(
           uint32_t                typeId) {
     uint32_t resultId = this->allocateId();
-    
-    m_typeConstDefs.putIns (spv::OpTypeRuntimeArray, 3);
-    m_typeConstDefs.putWord(resultId);
-    m_typeConstDefs.putWord(typeId);
+    this->putTypeConst(spv::OpTypeRuntimeArray, 0, resultId, 1, &typeId);
     return resultId;
   }
   
@@ -699,12 +693,7 @@ namespace dxvk {
           uint32_t                memberCount,
     const uint32_t*               memberTypes) {
     uint32_t resultId = this->allocateId();
-    
-    m_typeConstDefs.putIns (spv::OpTypeStruct, 2 + memberCount);
-    m_typeConstDefs.putWord(resultId);
-    
-    for (uint32_t i = 0; i < memberCount; i++)
-      m_typeConstDefs.putWord(memberTypes[i]);
+    this->putTypeConst(spv::OpTypeStruct, 0, resultId, memberCount, memberTypes);
     return resultId;
   }
   
@@ -3369,6 +3358,38 @@ namespace dxvk {
   }
 
 
+  uint32_t SpirvModule::opGroupNonUniformAllEqual(
+          uint32_t                resultType,
+          uint32_t                execution,
+          uint32_t                value) {
+    uint32_t resultId = this->allocateId();
+
+    m_code.putIns(spv::OpGroupNonUniformAllEqual, 5);
+    m_code.putWord(resultType);
+    m_code.putWord(resultId);
+    m_code.putWord(execution);
+    m_code.putWord(value);
+    return resultId;
+  }
+
+
+  uint32_t SpirvModule::opGroupNonUniformIAdd(
+          uint32_t                resultType,
+          uint32_t                execution,
+          uint32_t                operation,
+          uint32_t                value) {
+    uint32_t resultId = this->allocateId();
+
+    m_code.putIns(spv::OpGroupNonUniformIAdd, 6);
+    m_code.putWord(resultType);
+    m_code.putWord(resultId);
+    m_code.putWord(execution);
+    m_code.putWord(operation);
+    m_code.putWord(value);
+    return resultId;
+  }
+
+
   void SpirvModule::opControlBarrier(
           uint32_t                execution,
           uint32_t                memory,
@@ -3503,27 +3524,14 @@ namespace dxvk {
           spv::Op                 op, 
           uint32_t                argCount,
     const uint32_t*               argIds) {
-    // Since the type info is stored in the code buffer,
-    // we can use the code buffer to look up type IDs as
-    // well. Result IDs are always stored as argument 1.
-    for (auto ins : m_typeConstDefs) {
-      bool match = ins.opCode() == op
-                && ins.length() == 2 + argCount;
-      
-      for (uint32_t i = 0; i < argCount && match; i++)
-        match &= ins.arg(2 + i) == argIds[i];
-      
-      if (match)
-        return ins.arg(1);
-    }
+    uint32_t resultId = this->findTypeConst(op, 0, argCount, argIds);
+
+    if (resultId)
+      return resultId;
     
     // Type not yet declared, create a new one.
-    uint32_t resultId = this->allocateId();
-    m_typeConstDefs.putIns (op, 2 + argCount);
-    m_typeConstDefs.putWord(resultId);
-    
-    for (uint32_t i = 0; i < argCount; i++)
-      m_typeConstDefs.putWord(argIds[i]);
+    resultId = this->allocateId();
+    this->putTypeConst(op, 0, resultId, argCount, argIds);
     return resultId;
   }
   
@@ -3534,27 +3542,89 @@ namespace dxvk {
           uint32_t                argCount,
     const uint32_t*               argIds) {
     // Avoid declaring constants multiple times
-    for (auto ins : m_typeConstDefs) {
-      bool match = ins.opCode() == op
-                && ins.length() == 3 + argCount
-                && ins.arg(1)   == typeId;
-      
+    uint32_t resultId = this->findTypeConst(op, typeId, argCount, argIds);
+
+    if (resultId)
+      return resultId;
+    
+    // Constant not yet declared, make a new one
+    resultId = this->allocateId();
+    this->putTypeConst(op, typeId, resultId, argCount, argIds);
+    return resultId;
+  }
+
+
+  uint32_t SpirvModule::findTypeConst(
+          spv::Op                 op,
+          uint32_t                typeId,
+          uint32_t                argCount,
+    const uint32_t*               argIds) const {
+    // Types store the result ID as the first operand, constants
+    // store the type ID first and the result ID second. Type IDs
+    // are never zero, so we can use that to distinguish the two.
+    const uint32_t argOffset = typeId ? 3 : 2;
+
+    auto entries = m_typeConstIndex.equal_range(
+      hashTypeConst(op, typeId, argCount, argIds));
+
+    for (auto e = entries.first; e != entries.second; e++) {
+      const uint32_t* code = m_typeConstDefs.data() + e->second;
+
+      bool match = code[0] == ((argOffset + argCount) << spv::WordCountShift | op)
+                && (!typeId || code[1] == typeId);
+
       for (uint32_t i = 0; i < argCount && match; i++)
-        match &= ins.arg(3 + i) == argIds[i];
-      
+        match &= code[argOffset + i] == argIds[i];
+
       if (match)
-        return ins.arg(2);
+        return code[argOffset - 1];
     }
-    
-    // Constant not yet declared, make a new one
-    uint32_t resultId = this->allocateId();
-    m_typeConstDefs.putIns (op, 3 + argCount);
-    m_typeConstDefs.putWord(typeId);
+
+    return 0;
+  }
+
+
+  void SpirvModule::putTypeConst(
+          spv::Op                 op,
+          uint32_t                typeId,
+          uint32_t                resultId,
+          uint32_t                argCount,
+    const uint32_t*               argIds) {
+    const uint32_t offset = m_typeConstDefs.dwords();
+
+    // Only index the first occurence of any declaration so that
+    // lookups return the same ID as a linear search would. This
+    // matters for types that were explicitly declared as unique.
+    bool indexed = this->findTypeConst(op, typeId, argCount, argIds) == 0;
+
+    m_typeConstDefs.putIns (op, (typeId ? 3 : 2) + argCount);
+
+    if (typeId)
+      m_typeConstDefs.putWord(typeId);
+
     m_typeConstDefs.putWord(resultId);
-    
+
     for (uint32_t i = 0; i < argCount; i++)
       m_typeConstDefs.putWord(argIds[i]);
-    return resultId;
+
+    if (indexed) {
+      m_typeConstIndex.insert({ hashTypeConst(
+        op, typeId, argCount, argIds), offset });
+    }
+  }
+
+
+  size_t SpirvModule::hashTypeConst(
+          spv::Op                 op,
+          uint32_t                typeId,
+          uint32_t                argCount,
+    const uint32_t*               argIds) {
+    size_t hash = (size_t(op) << 16) ^ typeId;
+
+    for (uint32_t i = 0; i < argCount; i++)
+      hash = (hash * 0x100000001b3ull) ^ argIds[i];
+
+    return hash;
   }
   
   
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <unordered_map>
+
 #include "spirv_code_buffer.h"
 
 namespace dxvk {
@@ -217,9 +219,12 @@ namespace dxvk {
             uint32_t                object,
             uint32_t                specId);
     
+    void decorateStream(
+            uint32_t                object,
+            uint32_t                streamId);
+    
     void decorateXfb(
             uint32_t                object,
-            uint32_t                streamId,
             uint32_t                bufferId,
             uint32_t                offset,
             uint32_t                stride);
@@ -1138,6 +1143,17 @@ namespace dxvk {
             uint32_t                execution,
             uint32_t                value);
     
+    uint32_t opGroupNonUniformAllEqual(
+            uint32_t                resultType,
+            uint32_t                execution,
+            uint32_t                value);
+    
+    uint32_t opGroupNonUniformIAdd(
+            uint32_t                resultType,
+            uint32_t                execution,
+            uint32_t                operation,
+            uint32_t                value);
+    
     void opControlBarrier(
             uint32_t                execution,
             uint32_t                memory,
@@ -1203,6 +1219,10 @@ namespace dxvk {
     SpirvCodeBuffer m_typeConstDefs;
     SpirvCodeBuffer m_variables;
     SpirvCodeBuffer m_code;
+
+    // Maps hashes of type and constant declarations
+    // to their word offset within m_typeConstDefs
+    std::unordered_multimap<size_t, uint32_t> m_typeConstIndex;
     
     uint32_t defType(
             spv::Op                 op, 
@@ -1215,6 +1235,25 @@ namespace dxvk {
             uint32_t                argCount,
       const uint32_t*               argIds);
     
+    uint32_t findTypeConst(
+            spv::Op                 op,
+            uint32_t                typeId,
+            uint32_t                argCount,
+      const uint32_t*               argIds) const;
+
+    void putTypeConst(
+            spv::Op                 op,
+            uint32_t                typeId,
+            uint32_t                resultId,
+            uint32_t                argCount,
+      const uint32_t*               argIds);
+
+    static size_t hashTypeConst(
+            spv::Op                 op,
+            uint32_t                typeId,
+            uint32_t                argCount,
+      const uint32_t*               argIds);
+    
     void instImportGlsl450();
     
     uint32_t getImageOperandWordCount(
@@ -0,0 +1,932 @@
+#define SPV_ENABLE_UTILITY_CODE
+
+#include <chrono>
+#include <cstring>
+
+#include "spirv_optimizer.h"
+
+namespace dxvk {
+
+  SpirvOptimizer::SpirvOptimizer(const SpirvCodeBuffer& code) {
+    m_stats.inputDwords = code.dwords();
+    m_valid = this->parse(code);
+  }
+
+
+  SpirvOptimizer::~SpirvOptimizer() {
+
+  }
+
+
+  bool SpirvOptimizer::run() {
+    if (!m_valid)
+      return false;
+
+    auto t0 = std::chrono::high_resolution_clock::now();
+
+    this->forwardLoadsAndStores();
+    this->foldConstants();
+    this->removeUnreachableBlocks();
+    this->eliminateDeadCode();
+
+    m_valid = this->validate();
+
+    auto t1 = std::chrono::high_resolution_clock::now();
+
+    m_stats.outputDwords = 5;
+
+    for (const auto& ins : m_ins)
+      m_stats.outputDwords += ins.length;
+
+    m_stats.timeUs = std::chrono::duration_cast<std::chrono::microseconds>(t1 - t0).count();
+    return m_valid;
+  }
+
+
+  SpirvCodeBuffer SpirvOptimizer::getCode() const {
+    std::vector<uint32_t> code;
+    code.reserve(m_stats.outputDwords);
+    code.insert(code.end(), m_words.begin(), m_words.begin() + 5);
+    code[3] = m_bound;
+
+    for (const auto& ins : m_ins) {
+      code.insert(code.end(),
+        m_words.begin() + ins.offset,
+        m_words.begin() + ins.offset + ins.length);
+    }
+
+    return SpirvCodeBuffer(code.size(), code.data());
+  }
+
+
+  SpirvCodeBuffer SpirvOptimizer::optimize(SpirvCodeBuffer code) {
+    SpirvOptimizer optimizer(code);
+
+    if (!optimizer.run()) {
+      Logger::warn("SpirvOptimizer: Failed to optimize module, using original code");
+      return code;
+    }
+
+    if (Logger::logLevel() <= LogLevel::Debug) {
+      const SpirvOptimizerStats& stats = optimizer.getStats();
+
+      Logger::debug(str::format("SpirvOptimizer: ",
+        stats.inputDwords, " -> ", stats.outputDwords, " dwords in ", stats.timeUs, " us"));
+      Logger::debug(str::format("  forwarded loads:  ", stats.forwardedLoads));
+      Logger::debug(str::format("  removed stores:   ", stats.removedStores));
+      Logger::debug(str::format("  folded constants: ", stats.foldedConstants));
+      Logger::debug(str::format("  folded branches:  ", stats.foldedBranches));
+      Logger::debug(str::format("  removed blocks:   ", stats.removedBlocks));
+      Logger::debug(str::format("  removed code:     ", stats.removedCode));
+      Logger::debug(str::format("  removed decls:    ", stats.removedDecls));
+    }
+
+    return optimizer.getCode();
+  }
+
+
+  bool SpirvOptimizer::validate(const SpirvCodeBuffer& code) {
+    SpirvOptimizer optimizer(code);
+
+    return optimizer.m_valid
+        && optimizer.validate();
+  }
+
+
+  bool SpirvOptimizer::parse(const SpirvCodeBuffer& code) {
+    const uint32_t* data = code.data();
+    const uint32_t  size = code.dwords();
+
+    if (size < 5 || data[0] != spv::MagicNumber)
+      return false;
+
+    m_words.assign(data, data + size);
+    m_bound = data[3];
+    m_firstFunction = ~0u;
+    m_removedIds.assign(m_bound, false);
+
+    for (uint32_t offset = 5; offset < size; ) {
+      const uint32_t length = data[offset] >> spv::WordCountShift;
+      const spv::Op  opCode = spv::Op(data[offset] & spv::OpCodeMask);
+
+      if (!length || offset + length > size)
+        return false;
+
+      if (opCode == spv::OpFunction && m_firstFunction == ~0u)
+        m_firstFunction = m_ins.size();
+
+      if (opCode == spv::OpExtInstImport && length > 2) {
+        const char* name = reinterpret_cast<const char*>(&data[offset + 2]);
+
+        if (!std::strncmp(name, "GLSL.std.450", 4 * (length - 2)))
+          m_glslExtId = data[offset + 1];
+      }
+
+      m_ins.push_back({ offset, length });
+      offset += length;
+    }
+
+    if (m_firstFunction == ~0u)
+      m_firstFunction = m_ins.size();
+
+    // Result IDs and the operands that passes use to index
+    // per-ID arrays must be within the ID bound
+    for (uint32_t i = 0; i < m_ins.size(); i++) {
+      const spv::Op opCode = op(i);
+      uint32_t resultIndex = getResultIndex(opCode);
+
+      if (resultIndex && arg(i, resultIndex) >= m_bound)
+        return false;
+
+      if (resultIndex == 2 && arg(i, 1) >= m_bound)
+        return false;
+
+      if ((opCode == spv::OpLoad  && arg(i, 3) >= m_bound)
+       || (opCode == spv::OpStore && arg(i, 1) >= m_bound))
+        return false;
+    }
+
+    return true;
+  }
+
+
+  void SpirvOptimizer::forwardLoadsAndStores() {
+    // Find variables that are only ever accessed as a whole through
+    // plain OpLoad and OpStore instructions. Any other reference,
+    // e.g. through an access chain or a function call, disqualifies
+    // a variable since it might get modified indirectly. Literal
+    // operands that happen to match a variable ID will also
+    // disqualify it, which is conservative but harmless.
+    constexpr uint8_t VarCandidate = 0x1;
+    constexpr uint8_t VarLoaded    = 0x2;
+    constexpr uint8_t VarEscaped   = 0x4;
+
+    std::vector<uint8_t> vars(m_bound, 0);
+
+    for (uint32_t i = 0; i < m_ins.size(); i++) {
+      if (op(i) != spv::OpVariable)
+        continue;
+
+      uint32_t storage = arg(i, 3);
+
+      if (storage == spv::StorageClassPrivate
+       || storage == spv::StorageClassFunction)
+        vars[arg(i, 2)] = VarCandidate;
+    }
+
+    for (uint32_t i = 0; i < m_ins.size(); i++) {
+      const spv::Op opCode = op(i);
+
+      if (opCode == spv::OpName
+       || opCode == spv::OpMemberName)
+        continue;
+
+      uint32_t first = 1;
+
+      if (opCode == spv::OpLoad) {
+        uint32_t ptr = arg(i, 3);
+
+        if (vars[ptr] && m_ins[i].length > 4)
+          vars[ptr] |= VarEscaped;
+
+        first = 4;
+      } else if (opCode == spv::OpStore) {
+        uint32_t ptr = arg(i, 1);
+
+        if (vars[ptr] && m_ins[i].length > 3)
+          vars[ptr] |= VarEscaped;
+
+        first = 2;
+      }
+
+      const uint32_t resultIndex = getResultIndex(opCode);
+
+      for (uint32_t j = first; j < m_ins[i].length; j++) {
+        uint32_t word = arg(i, j);
+
+        if (j != resultIndex && word < m_bound && vars[word])
+          vars[word] |= VarEscaped;
+      }
+    }
+
+    // Forward values within each block. Since the store or
+    // load we take the value from precedes the load in the
+    // same block, the value is guaranteed to dominate it.
+    std::vector<uint32_t> values(m_bound, 0);
+    std::vector<uint32_t> touched;
+
+    for (uint32_t i = m_firstFunction; i < m_ins.size(); i++) {
+      if (isRemoved(i))
+        continue;
+
+      switch (op(i)) {
+        case spv::OpFunction:
+        case spv::OpFunctionCall:
+        case spv::OpLabel: {
+          for (uint32_t id : touched)
+            values[id] = 0;
+
+          touched.clear();
+        } break;
+
+        case spv::OpStore: {
+          uint32_t ptr = arg(i, 1);
+
+          if (vars[ptr] == VarCandidate) {
+            if (!values[ptr])
+              touched.push_back(ptr);
+
+            values[ptr] = arg(i, 2);
+          }
+        } break;
+
+        case spv::OpLoad: {
+          uint32_t ptr = arg(i, 3);
+
+          if (vars[ptr] == VarCandidate) {
+            if (values[ptr]) {
+              replaceWithCopy(i, arg(i, 1), arg(i, 2), values[ptr]);
+              m_stats.forwardedLoads += 1;
+            } else {
+              touched.push_back(ptr);
+              values[ptr] = arg(i, 2);
+            }
+          }
+        } break;
+
+        default:
+          break;
+      }
+    }
+
+    // Stores to variables that are not read anymore are dead.
+    // The variables themselves will be removed later on.
+    for (uint32_t i = m_firstFunction; i < m_ins.size(); i++) {
+      if (!isRemoved(i) && op(i) == spv::OpLoad)
+        vars[arg(i, 3)] |= VarLoaded;
+    }
+
+    for (uint32_t i = m_firstFunction; i < m_ins.size(); i++) {
+      if (!isRemoved(i) && op(i) == spv::OpStore && vars[arg(i, 1)] == VarCandidate) {
+        removeInstruction(i);
+        m_stats.removedStores += 1;
+      }
+    }
+  }
+
+
+  void SpirvOptimizer::foldConstants() {
+    m_typeKinds.assign(m_bound, ConstKind::None);
+    m_consts.assign(m_bound, ConstInfo());
+    m_constIds.clear();
+
+    // Composite constants, by instruction index, so
+    // that extracting from them can be resolved
+    std::vector<uint32_t> composites(m_bound, ~0u);
+
+    auto getComposite = [&composites] (uint32_t id) {
+      return id < composites.size() ? composites[id] : ~0u;
+    };
+
+    auto getConst = [this] (uint32_t id) {
+      return id < m_consts.size() ? m_consts[id] : ConstInfo();
+    };
+
+    // Blocks that are referenced as a parent by any OpPhi. We
+    // must not remove branches out of those blocks since the
+    // phi would then reference a block that is no predecessor.
+    std::vector<bool> phiParents(m_bound, false);
+
+    for (uint32_t i = 0; i < m_ins.size(); i++) {
+      switch (op(i)) {
+        case spv::OpTypeBool:
+          m_typeKinds[arg(i, 1)] = ConstKind::Bool;
+          break;
+
+        case spv::OpTypeInt:
+          if (arg(i, 2) == 32)
+            m_typeKinds[arg(i, 1)] = ConstKind::Int;
+          break;
+
+        case spv::OpTypeFloat:
+          if (arg(i, 2) == 32)
+            m_typeKinds[arg(i, 1)] = ConstKind::Float;
+          break;
+
+        case spv::OpConstant:
+        case spv::OpConstantTrue:
+        case spv::OpConstantFalse: {
+          uint32_t typeId = arg(i, 1);
+          ConstKind kind = m_typeKinds[typeId];
+
+          if (kind == ConstKind::None || (kind == ConstKind::Bool) == (op(i) == spv::OpConstant))
+            break;
+
+          if (kind != ConstKind::Bool && m_ins[i].length != 4)
+            break;
+
+          ConstInfo info;
+          info.typeId = typeId;
+          info.kind   = kind;
+          info.value  = kind == ConstKind::Bool
+            ? uint32_t(op(i) == spv::OpConstantTrue)
+            : arg(i, 3);
+
+          m_consts[arg(i, 2)] = info;
+          m_constIds.insert({ getConstantKey(info.typeId, info.value), arg(i, 2) });
+        } break;
+
+        case spv::OpConstantComposite:
+          composites[arg(i, 2)] = i;
+          break;
+
+        case spv::OpPhi:
+          for (uint32_t j = 4; j < m_ins[i].length; j += 2) {
+            if (arg(i, j) < m_bound)
+              phiParents[arg(i, j)] = true;
+          }
+          break;
+
+        default:
+          break;
+      }
+    }
+
+    uint32_t label   = 0;
+    uint32_t prevIns = ~0u;
+
+    for (uint32_t i = m_firstFunction; i < m_ins.size(); i++) {
+      if (isRemoved(i))
+        continue;
+
+      const spv::Op opCode = op(i);
+
+      uint32_t resultType = arg(i, 1);
+      uint32_t resultId   = arg(i, 2);
+
+      switch (opCode) {
+        case spv::OpLabel:
+          label = arg(i, 1);
+          break;
+
+        case spv::OpCopyObject: {
+          m_consts[resultId] = getConst(arg(i, 3));
+          composites[resultId] = getComposite(arg(i, 3));
+        } break;
+
+        case spv::OpCompositeExtract: {
+          uint32_t composite = getComposite(arg(i, 3));
+          uint32_t index     = arg(i, 4);
+
+          if (composite == ~0u || m_ins[i].length != 5 || index >= m_ins[composite].length - 3)
+            break;
+
+          uint32_t member = arg(composite, 3 + index);
+          replaceWithCopy(i, resultType, resultId, member);
+
+          m_consts[resultId] = getConst(member);
+          composites[resultId] = getComposite(member);
+          m_stats.foldedConstants += 1;
+        } break;
+
+        case spv::OpSelect: {
+          ConstInfo cond = getConst(arg(i, 3));
+
+          if (cond.kind != ConstKind::Bool)
+            break;
+
+          uint32_t operand = cond.value ? arg(i, 4) : arg(i, 5);
+          replaceWithCopy(i, resultType, resultId, operand);
+
+          m_consts[resultId] = getConst(operand);
+          composites[resultId] = getComposite(operand);
+          m_stats.foldedConstants += 1;
+        } break;
+
+        case spv::OpBranchConditional: {
+          ConstInfo cond = getConst(arg(i, 1));
+
+          // Only fold branches of selection constructs, loop
+          // headers as well as breaks and continues are left
+          // alone so that structured control flow stays valid.
+          if (cond.kind != ConstKind::Bool || prevIns == ~0u
+           || op(prevIns) != spv::OpSelectionMerge || phiParents[label])
+            break;
+
+          replaceWithBranch(i, cond.value ? arg(i, 2) : arg(i, 3));
+          removeInstruction(prevIns);
+          m_stats.foldedBranches += 1;
+        } break;
+
+        default: {
+          ConstInfo result;
+
+          if (resultId < m_bound && this->evaluate(i, result)) {
+            uint32_t constId = this->getConstant(result);
+            replaceWithCopy(i, resultType, resultId, constId);
+
+            m_consts[resultId] = result;
+            m_stats.foldedConstants += 1;
+          }
+        }
+      }
+
+      prevIns = i;
+    }
+
+    // Declare new constants right before the first
+    // function, after all existing types and constants
+    m_ins.insert(m_ins.begin() + m_firstFunction,
+      m_newDecls.begin(), m_newDecls.end());
+    m_firstFunction += m_newDecls.size();
+    m_newDecls.clear();
+  }
+
+
+  void SpirvOptimizer::removeUnreachableBlocks() {
+    // Only folded branches can make blocks unreachable,
+    // we leave the structure of other modules alone.
+    if (!m_stats.foldedBranches)
+      return;
+
+    struct Block {
+      uint32_t first;
+      uint32_t end;
+      bool     live;
+    };
+
+    // Maps labels and IDs defined within a block to that block
+    std::vector<Block>    blocks;
+    std::vector<uint32_t> blockIds(m_bound, ~0u);
+    std::vector<uint32_t> worklist;
+
+    bool inBlock = false;
+    bool isEntry = false;
+
+    for (uint32_t i = m_firstFunction; i < m_ins.size(); i++) {
+      if (isRemoved(i))
+        continue;
+
+      switch (op(i)) {
+        case spv::OpFunction:
+          isEntry = true;
+          break;
+
+        case spv::OpFunctionEnd:
+          inBlock = false;
+          break;
+
+        case spv::OpLabel:
+          if (isEntry)
+            worklist.push_back(blocks.size());
+
+          blocks.push_back({ i, i, isEntry });
+          inBlock = true;
+          isEntry = false;
+          break;
+
+        default:
+          break;
+      }
+
+      if (!inBlock)
+        continue;
+
+      uint32_t resultIndex = getResultIndex(op(i));
+
+      if (resultIndex)
+        blockIds[arg(i, resultIndex)] = blocks.size() - 1;
+
+      blocks.back().end = i + 1;
+    }
+
+    // Starting at the entry blocks, keep every block that a live
+    // block references. Besides branch targets, this includes merge
+    // blocks, continue targets, phi parents and blocks defining an
+    // operand, so that the remaining code never uses removed IDs.
+    while (!worklist.empty()) {
+      const Block block = blocks[worklist.back()];
+      worklist.pop_back();
+
+      for (uint32_t i = block.first; i < block.end; i++) {
+        if (isRemoved(i))
+          continue;
+
+        this->forEachOperand(i, [&] (uint32_t id) {
+          uint32_t index = blockIds[id];
+
+          if (index != ~0u && !blocks[index].live) {
+            blocks[index].live = true;
+            worklist.push_back(index);
+          }
+        });
+      }
+    }
+
+    for (const auto& block : blocks) {
+      if (block.live)
+        continue;
+
+      for (uint32_t i = block.first; i < block.end; i++) {
+        if (isRemoved(i))
+          continue;
+
+        uint32_t resultIndex = getResultIndex(op(i));
+
+        if (resultIndex)
+          m_removedIds[arg(i, resultIndex)] = true;
+
+        removeInstruction(i);
+      }
+
+      m_stats.removedBlocks += 1;
+    }
+  }
+
+
+  bool SpirvOptimizer::evaluate(uint32_t ins, ConstInfo& result) const {
+    const spv::Op opCode = op(ins);
+    const uint32_t length = m_ins[ins].length;
+
+    if (length != 4 && length != 5)
+      return false;
+
+    result.typeId = arg(ins, 1);
+
+    if (result.typeId >= m_typeKinds.size())
+      return false;
+
+    result.kind = m_typeKinds[result.typeId];
+
+    if (result.kind == ConstKind::None)
+      return false;
+
+    const uint32_t idA = arg(ins, 3);
+    const uint32_t idB = length == 5 ? arg(ins, 4) : idA;
+
+    if (idA >= m_consts.size() || idB >= m_consts.size())
+      return false;
+
+    const ConstInfo& a = m_consts[idA];
+    const ConstInfo& b = m_consts[idB];
+
+    if (a.kind == ConstKind::None || b.kind == ConstKind::None)
+      return false;
+
+    const uint32_t ua = a.value;
+    const uint32_t ub = b.value;
+    const int32_t  sa = int32_t(a.value);
+    const int32_t  sb = int32_t(b.value);
+
+    // Bit casts preserve the bit pattern, so they can be
+    // folded between 32-bit integer and float types.
+    if (opCode == spv::OpBitcast) {
+      result.value = ua;
+      return result.kind != ConstKind::Bool
+          && a.kind      != ConstKind::Bool;
+    }
+
+    // Only integer and boolean operations are folded. Floating
+    // point results may depend on the rounding and denorm modes
+    // used by the driver, so we leave those alone.
+    if (a.kind == ConstKind::Int && b.kind == ConstKind::Int) {
+      if (result.kind == ConstKind::Int) {
+        switch (opCode) {
+          case spv::OpIAdd:                 result.value = ua + ub; return true;
+          case spv::OpISub:                 result.value = ua - ub; return true;
+          case spv::OpIMul:                 result.value = ua * ub; return true;
+          case spv::OpUDiv:                 result.value = ub ? ua / ub : 0; return ub != 0;
+          case spv::OpUMod:                 result.value = ub ? ua % ub : 0; return ub != 0;
+          case spv::OpBitwiseAnd:           result.value = ua & ub; return true;
+          case spv::OpBitwiseOr:            result.value = ua | ub; return true;
+          case spv::OpBitwiseXor:           result.value = ua ^ ub; return true;
+          case spv::OpShiftLeftLogical:     result.value = ua << (ub & 31); return ub < 32;
+          case spv::OpShiftRightLogical:    result.value = ua >> (ub & 31); return ub < 32;
+          case spv::OpShiftRightArithmetic: result.value = uint32_t(sa >> (ub & 31)); return ub < 32;
+          case spv::OpNot:                  result.value = ~ua; return length == 4;
+          case spv::OpSNegate:              result.value = 0u - ua; return length == 4;
+          default:                          return false;
+        }
+      }
+
+      if (result.kind == ConstKind::Bool && length == 5) {
+        switch (opCode) {
+          case spv::OpIEqual:               result.value = ua == ub; return true;
+          case spv::OpINotEqual:            result.value = ua != ub; return true;
+          case spv::OpUGreaterThan:         result.value = ua >  ub; return true;
+          case spv::OpUGreaterThanEqual:    result.value = ua >= ub; return true;
+          case spv::OpULessThan:            result.value = ua <  ub; return true;
+          case spv::OpULessThanEqual:       result.value = ua <= ub; return true;
+          case spv::OpSGreaterThan:         result.value = sa >  sb; return true;
+          case spv::OpSGreaterThanEqual:    result.value = sa >= sb; return true;
+          case spv::OpSLessThan:            result.value = sa <  sb; return true;
+          case spv::OpSLessThanEqual:       result.value = sa <= sb; return true;
+          default:                          return false;
+        }
+      }
+    }
+
+    if (a.kind == ConstKind::Bool && b.kind == ConstKind::Bool
+     && result.kind == ConstKind::Bool) {
+      switch (opCode) {
+        case spv::OpLogicalAnd:             result.value = ua && ub; return true;
+        case spv::OpLogicalOr:              result.value = ua || ub; return true;
+        case spv::OpLogicalEqual:           result.value = ua == ub; return true;
+        case spv::OpLogicalNotEqual:        result.value = ua != ub; return true;
+        case spv::OpLogicalNot:             result.value = !ua; return length == 4;
+        default:                            return false;
+      }
+    }
+
+    return false;
+  }
+
+
+  void SpirvOptimizer::eliminateDeadCode() {
+    std::vector<uint32_t> counts(m_bound, 0);
+    std::vector<uint32_t> defs(m_bound, ~0u);
+    std::vector<uint32_t> worklist;
+
+    for (uint32_t i = 0; i < m_ins.size(); i++) {
+      if (isRemoved(i))
+        continue;
+
+      this->forEachOperand(i, [&counts] (uint32_t id) {
+        counts[id] += 1;
+      });
+
+      if (this->isRemovable(i))
+        defs[arg(i, getResultIndex(op(i)))] = i;
+    }
+
+    for (uint32_t id = 0; id < m_bound; id++) {
+      if (defs[id] != ~0u && !counts[id])
+        worklist.push_back(defs[id]);
+    }
+
+    while (!worklist.empty()) {
+      uint32_t ins = worklist.back();
+      worklist.pop_back();
+
+      this->forEachOperand(ins, [&] (uint32_t id) {
+        if (!(--counts[id]) && defs[id] != ~0u)
+          worklist.push_back(defs[id]);
+      });
+
+      m_removedIds[arg(ins, getResultIndex(op(ins)))] = true;
+
+      if (ins < m_firstFunction)
+        m_stats.removedDecls += 1;
+      else
+        m_stats.removedCode += 1;
+
+      removeInstruction(ins);
+    }
+
+    // Debug names are not counted as uses, and removed blocks
+    // may contain decorated objects, so strip both of these.
+    for (uint32_t i = 0; i < m_firstFunction; i++) {
+      if (isRemoved(i))
+        continue;
+
+      if ((op(i) == spv::OpName || op(i) == spv::OpMemberName || op(i) == spv::OpDecorate)
+       && arg(i, 1) < m_bound && m_removedIds[arg(i, 1)])
+        removeInstruction(i);
+    }
+  }
+
+
+  bool SpirvOptimizer::validate() const {
+    std::vector<bool> defined(m_bound, false);
+
+    bool inFunction = false;
+    bool inBlock    = false;
+
+    spv::Op prevOp = spv::OpNop;
+
+    for (uint32_t i = 0; i < m_ins.size(); i++) {
+      if (isRemoved(i))
+        continue;
+
+      const spv::Op opCode = op(i);
+
+      // Merge instructions must directly precede the
+      // branch instruction of their header block
+      if (prevOp == spv::OpSelectionMerge
+       && opCode != spv::OpBranchConditional
+       && opCode != spv::OpSwitch)
+        return false;
+
+      if (prevOp == spv::OpLoopMerge
+       && opCode != spv::OpBranchConditional
+       && opCode != spv::OpBranch)
+        return false;
+
+      // Result IDs must be defined exactly once
+      uint32_t resultIndex = getResultIndex(opCode);
+
+      if (resultIndex) {
+        uint32_t id = arg(i, resultIndex);
+
+        if (id >= m_bound || defined[id])
+          return false;
+
+        defined[id] = true;
+      }
+
+      // Removed objects must not be referenced anymore. Names
+      // and decorations only have a single ID operand.
+      bool valid = true;
+
+      if (opCode == spv::OpName || opCode == spv::OpMemberName
+       || opCode == spv::OpDecorate || opCode == spv::OpMemberDecorate) {
+        valid = arg(i, 1) >= m_bound || !m_removedIds[arg(i, 1)];
+      } else {
+        this->forEachOperand(i, [&] (uint32_t id) {
+          valid &= !m_removedIds[id];
+        });
+      }
+
+      if (!valid)
+        return false;
+
+      // Every block must end with exactly one terminator
+      switch (opCode) {
+        case spv::OpFunction:
+          if (inFunction)
+            return false;
+          inFunction = true;
+          break;
+
+        case spv::OpFunctionEnd:
+          if (!inFunction || inBlock)
+            return false;
+          inFunction = false;
+          break;
+
+        case spv::OpLabel:
+          if (!inFunction || inBlock)
+            return false;
+          inBlock = true;
+          break;
+
+        case spv::OpBranch:
+        case spv::OpBranchConditional:
+        case spv::OpSwitch:
+        case spv::OpReturn:
+        case spv::OpReturnValue:
+        case spv::OpKill:
+        case spv::OpUnreachable:
+          if (!inBlock)
+            return false;
+          inBlock = false;
+          break;
+
+        default:
+          break;
+      }
+
+      prevOp = opCode;
+    }
+
+    return !inFunction;
+  }
+
+
+  void SpirvOptimizer::removeInstruction(uint32_t ins) {
+    m_ins[ins].length = 0;
+  }
+
+
+  void SpirvOptimizer::replaceWithCopy(
+          uint32_t                ins,
+          uint32_t                typeId,
+          uint32_t                resultId,
+          uint32_t                operandId) {
+    m_ins[ins] = { uint32_t(m_words.size()), 4 };
+
+    m_words.push_back(spv::OpCopyObject | (4 << spv::WordCountShift));
+    m_words.push_back(typeId);
+    m_words.push_back(resultId);
+    m_words.push_back(operandId);
+  }
+
+
+  void SpirvOptimizer::replaceWithBranch(
+          uint32_t                ins,
+          uint32_t                labelId) {
+    m_ins[ins] = { uint32_t(m_words.size()), 2 };
+
+    m_words.push_back(spv::OpBranch | (2 << spv::WordCountShift));
+    m_words.push_back(labelId);
+  }
+
+
+  uint32_t SpirvOptimizer::getConstant(const ConstInfo& info) {
+    auto entry = m_constIds.find(getConstantKey(info.typeId, info.value));
+
+    if (entry != m_constIds.end())
+      return entry->second;
+
+    uint32_t constId = m_bound++;
+    m_constIds.insert({ getConstantKey(info.typeId, info.value), constId });
+    m_consts.push_back(info);
+    m_removedIds.push_back(false);
+
+    m_newDecls.push_back({ uint32_t(m_words.size()), 0 });
+
+    if (info.kind == ConstKind::Bool) {
+      m_words.push_back((info.value ? spv::OpConstantTrue : spv::OpConstantFalse) | (3 << spv::WordCountShift));
+      m_words.push_back(info.typeId);
+      m_words.push_back(constId);
+      m_newDecls.back().length = 3;
+    } else {
+      m_words.push_back(spv::OpConstant | (4 << spv::WordCountShift));
+      m_words.push_back(info.typeId);
+      m_words.push_back(constId);
+      m_words.push_back(info.value);
+      m_newDecls.back().length = 4;
+    }
+
+    return constId;
+  }
+
+
+  bool SpirvOptimizer::isRemovable(uint32_t ins) const {
+    const spv::Op opCode = op(ins);
+
+    switch (opCode) {
+      // Types
+      case spv::OpTypeVoid:
+      case spv::OpTypeBool:
+      case spv::OpTypeInt:
+      case spv::OpTypeFloat:
+      case spv::OpTypeVector:
+      case spv::OpTypeMatrix:
+      case spv::OpTypeImage:
+      case spv::OpTypeSampler:
+      case spv::OpTypeSampledImage:
+      case spv::OpTypeArray:
+      case spv::OpTypeRuntimeArray:
+      case spv::OpTypeStruct:
+      case spv::OpTypePointer:
+      case spv::OpTypeFunction:
+      // Constants and variables
+      case spv::OpConstant:
+      case spv::OpConstantTrue:
+      case spv::OpConstantFalse:
+      case spv::OpConstantComposite:
+      case spv::OpConstantNull:
+      case spv::OpSpecConstant:
+      case spv::OpSpecConstantTrue:
+      case spv::OpSpecConstantFalse:
+      case spv::OpSpecConstantComposite:
+      case spv::OpSpecConstantOp:
+      case spv::OpVariable:
+      case spv::OpUndef:
+        return true;
+
+      // Loads with memory operands may be volatile
+      case spv::OpLoad:
+        return m_ins[ins].length == 4;
+
+      // Only extended instructions that do not
+      // write to memory through a pointer operand
+      case spv::OpExtInst:
+        return arg(ins, 3) == m_glslExtId
+            && arg(ins, 4) != spv::GLSLstd450Modf
+            && arg(ins, 4) != spv::GLSLstd450Frexp;
+
+      default:
+        return isPureOp(opCode);
+    }
+  }
+
+
+  uint32_t SpirvOptimizer::getResultIndex(spv::Op op) {
+    bool hasResult = false;
+    bool hasType   = false;
+
+    spv::HasResultAndType(op, &hasResult, &hasType);
+    return hasResult ? (hasType ? 2 : 1) : 0;
+  }
+
+
+  bool SpirvOptimizer::isPureOp(spv::Op op) {
+    // Instructions without a typed result only exist
+    // for their side effects and are never removable
+    if (getResultIndex(op) != 2)
+      return false;
+
+    // Core instruction classes that only compute a value from
+    // their operands. Atomics, function calls and anything that
+    // writes memory lie outside of these opcode ranges.
+    return (op >= spv::OpAccessChain          && op <= spv::OpInBoundsPtrAccessChain)
+        || (op >= spv::OpVectorExtractDynamic && op <= spv::OpTranspose)
+        || (op >= spv::OpSampledImage         && op <= spv::OpImageQuerySamples)
+        || (op >= spv::OpConvertFToU          && op <= spv::OpBitcast)
+        || (op >= spv::OpSNegate              && op <= spv::OpFwidthCoarse)
+        || (op == spv::OpPhi);
+  }
+
+}
@@ -0,0 +1,226 @@
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+
+#include "spirv_code_buffer.h"
+
+namespace dxvk {
+
+  /**
+   * \brief SPIR-V optimizer statistics
+   *
+   * Collected while running the optimizer on a single
+   * module. Used for logging and to compare the size
+   * of the module before and after optimization.
+   */
+  struct SpirvOptimizerStats {
+    uint32_t inputDwords      = 0;
+    uint32_t outputDwords     = 0;
+    uint32_t forwardedLoads   = 0;
+    uint32_t removedStores    = 0;
+    uint32_t foldedConstants  = 0;
+    uint32_t foldedBranches   = 0;
+    uint32_t removedBlocks    = 0;
+    uint32_t removedCode      = 0;
+    uint32_t removedDecls     = 0;
+    uint64_t timeUs           = 0;
+  };
+
+
+  /**
+   * \brief SPIR-V optimizer
+   *
+   * Runs a fixed set of cheap, conservative passes over a
+   * complete SPIR-V module as generated by the shader
+   * front-ends:
+   *
+   * - Local load/store forwarding: Loads from function-local and
+   *   private variables are replaced with the value last stored to
+   *   or loaded from them in the same block, and stores to variables
+   *   that are never read are removed.
+   * - Constant folding: Scalar integer and boolean operations on
+   *   constants are evaluated, and selection branches on constant
+   *   conditions are turned into unconditional branches. Blocks
+   *   that become unreachable this way are removed.
+   * - Dead code elimination: Instructions without side effects
+   *   whose results are never used are removed.
+   * - Unused declaration stripping: Types, constants and variables
+   *   that are not referenced anymore are removed.
+   *
+   * Passes never renumber IDs. Replaced instructions are
+   * turned into \c OpCopyObject so that no uses need to
+   * be rewritten, which drivers eliminate for free.
+   */
+  class SpirvOptimizer {
+
+  public:
+
+    SpirvOptimizer(const SpirvCodeBuffer& code);
+
+    ~SpirvOptimizer();
+
+    /**
+     * \brief Runs all optimization passes
+     *
+     * \returns \c true if the module could be parsed and the
+     *    optimized module passed validation, \c false otherwise.
+     */
+    bool run();
+
+    /**
+     * \brief Retrieves optimized code
+     * \returns Optimized SPIR-V module
+     */
+    SpirvCodeBuffer getCode() const;
+
+    /**
+     * \brief Retrieves statistics
+     * \returns Optimizer statistics
+     */
+    const SpirvOptimizerStats& getStats() const {
+      return m_stats;
+    }
+
+    /**
+     * \brief Optimizes a module
+     *
+     * Convenience method that runs the optimizer and logs
+     * statistics. Returns the original code if optimization
+     * fails for any reason, so this never breaks shaders.
+     * \param [in] code The SPIR-V module
+     * \returns Optimized SPIR-V module
+     */
+    static SpirvCodeBuffer optimize(SpirvCodeBuffer code);
+
+    /**
+     * \brief Validates a module
+     *
+     * Performs the same structural checks that are run
+     * on optimized code, i.e. unique result IDs, valid
+     * block structure and merge instruction placement.
+     * This is not a full SPIR-V validator.
+     * \param [in] code The SPIR-V module
+     * \returns \c true if the module passed validation
+     */
+    static bool validate(const SpirvCodeBuffer& code);
+
+  private:
+
+    struct Instruction {
+      uint32_t offset;
+      uint32_t length;
+    };
+
+    enum class ConstKind : uint32_t {
+      None, Bool, Int, Float,
+    };
+
+    struct ConstInfo {
+      uint32_t  typeId = 0;
+      uint32_t  value  = 0;
+      ConstKind kind   = ConstKind::None;
+    };
+
+    std::vector<uint32_t>     m_words;
+    std::vector<Instruction>  m_ins;
+    std::vector<Instruction>  m_newDecls;
+
+    bool                      m_valid         = false;
+    uint32_t                  m_bound         = 0;
+    uint32_t                  m_firstFunction = 0;
+    uint32_t                  m_glslExtId     = 0;
+
+    SpirvOptimizerStats       m_stats;
+
+    std::vector<ConstKind>    m_typeKinds;
+    std::vector<ConstInfo>    m_consts;
+    std::vector<bool>         m_removedIds;
+
+    std::unordered_map<uint64_t, uint32_t> m_constIds;
+
+    bool parse(const SpirvCodeBuffer& code);
+
+    void forwardLoadsAndStores();
+
+    void foldConstants();
+
+    void removeUnreachableBlocks();
+
+    void eliminateDeadCode();
+
+    bool validate() const;
+
+    bool evaluate(
+            uint32_t                ins,
+            ConstInfo&              result) const;
+
+    spv::Op op(uint32_t ins) const {
+      return spv::Op(m_words[m_ins[ins].offset] & spv::OpCodeMask);
+    }
+
+    uint32_t arg(uint32_t ins, uint32_t idx) const {
+      return idx < m_ins[ins].length
+        ? m_words[m_ins[ins].offset + idx]
+        : 0u;
+    }
+
+    bool isRemoved(uint32_t ins) const {
+      return m_ins[ins].length == 0;
+    }
+
+    void removeInstruction(uint32_t ins);
+
+    void replaceWithCopy(
+            uint32_t                ins,
+            uint32_t                typeId,
+            uint32_t                resultId,
+            uint32_t                operandId);
+
+    void replaceWithBranch(
+            uint32_t                ins,
+            uint32_t                labelId);
+
+    uint32_t getConstant(
+      const ConstInfo&              info);
+
+    bool isRemovable(uint32_t ins) const;
+
+    /**
+     * \brief Iterates over potential ID operands
+     *
+     * Visits all operand words that are within the ID bound,
+     * except for the result ID. Since literal operands are
+     * included, this over-approximates the actual uses of an
+     * ID, which is safe for the purpose of removing code.
+     * Debug names are ignored since they do not keep
+     * an object alive.
+     */
+    template<typename Fn>
+    void forEachOperand(uint32_t ins, const Fn& fn) const {
+      const spv::Op opCode = op(ins);
+
+      if (opCode == spv::OpName || opCode == spv::OpMemberName)
+        return;
+
+      const uint32_t resultIndex = getResultIndex(opCode);
+
+      for (uint32_t i = 1; i < m_ins[ins].length; i++) {
+        uint32_t word = m_words[m_ins[ins].offset + i];
+
+        if (i != resultIndex && word < m_bound)
+          fn(word);
+      }
+    }
+
+    static uint64_t getConstantKey(uint32_t typeId, uint32_t value) {
+      return (uint64_t(typeId) << 32) | value;
+    }
+
+    static uint32_t getResultIndex(spv::Op op);
+
+    static bool isPureOp(spv::Op op);
+
+  };
+
+}
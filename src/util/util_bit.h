@@ -14,7 +14,10 @@
 #endif
 
 #include "util_likely.h"
+#include <cstddef>
+#include <cstdint>
 #include <cstring>
+#include <iterator>
 #include <type_traits>
 
 namespace dxvk::bit {
@@ -111,5 +114,191 @@ namespace dxvk::bit {
     shift += count;
     return shift > Bits ? shift - Bits : 0;
   }
-  
+
+  /**
+   * \brief Set bit iterator
+   *
+   * Iterates over the indices of all set bits
+   * in a 32-bit mask in ascending order.
+   */
+  class BitMask {
+
+  public:
+
+    class iterator {
+
+    public:
+
+      using iterator_category = std::input_iterator_tag;
+      using value_type        = uint32_t;
+      using difference_type   = uint32_t;
+      using pointer           = const uint32_t*;
+      using reference         = uint32_t;
+
+      explicit iterator(uint32_t flags)
+      : m_mask(flags) { }
+
+      iterator& operator ++ () {
+        m_mask &= m_mask - 1;
+        return *this;
+      }
+
+      iterator operator ++ (int) {
+        iterator retval = *this;
+        m_mask &= m_mask - 1;
+        return retval;
+      }
+
+      uint32_t operator * () const {
+        return tzcnt(m_mask);
+      }
+
+      bool operator == (iterator other) const { return m_mask == other.m_mask; }
+      bool operator != (iterator other) const { return m_mask != other.m_mask; }
+
+    private:
+
+      uint32_t m_mask;
+
+    };
+
+    BitMask()
+    : m_mask(0) { }
+
+    explicit BitMask(uint32_t n)
+    : m_mask(n) { }
+
+    iterator begin() const {
+      return iterator(m_mask);
+    }
+
+    iterator end() const {
+      return iterator(0);
+    }
+
+  private:
+
+    uint32_t m_mask;
+
+  };
+
+
+  /**
+   * \brief Fixed-size bit set
+   *
+   * Unlike \c std::bitset, this exposes the underlying
+   * dwords so that users can scan for set bits one word
+   * at a time rather than testing every bit.
+   * \tparam Bits Number of bits
+   */
+  template<size_t Bits>
+  class bitset {
+    static constexpr size_t Dwords = (Bits + 31) / 32;
+  public:
+
+    constexpr bitset()
+    : m_dwords() { }
+
+    constexpr bool get(uint32_t idx) const {
+      return m_dwords[idx / 32] & (1u << (idx % 32));
+    }
+
+    constexpr void set(uint32_t idx, bool value) {
+      uint32_t bit = 1u << (idx % 32);
+
+      if (value)
+        m_dwords[idx / 32] |= bit;
+      else
+        m_dwords[idx / 32] &= ~bit;
+    }
+
+    /**
+     * \brief Sets all bits
+     *
+     * Bits past the end of the set remain
+     * cleared, so that dword scans stay valid.
+     */
+    constexpr void setAll() {
+      for (size_t i = 0; i < Dwords; i++)
+        m_dwords[i] = ~0u;
+
+      if constexpr (Bits % 32 != 0)
+        m_dwords[Dwords - 1] = (1u << (Bits % 32)) - 1;
+    }
+
+    constexpr void clearAll() {
+      for (size_t i = 0; i < Dwords; i++)
+        m_dwords[i] = 0;
+    }
+
+    constexpr bool any() const {
+      for (size_t i = 0; i < Dwords; i++) {
+        if (m_dwords[i] != 0)
+          return true;
+      }
+
+      return false;
+    }
+
+    constexpr uint32_t dword(uint32_t idx) const {
+      return m_dwords[idx];
+    }
+
+    constexpr size_t bitCount() const {
+      return Bits;
+    }
+
+    constexpr size_t dwordCount() const {
+      return Dwords;
+    }
+
+    constexpr bool operator [] (uint32_t idx) const {
+      return get(idx);
+    }
+
+    /**
+     * \brief Iterates over runs of set bits
+     *
+     * Calls \c fn once per contiguous run of set bits,
+     * with the index of the first bit and the number of
+     * bits in the run. Runs may span dword boundaries.
+     * \param [in] fn Function taking index and count
+     */
+    template<typename Fn>
+    void forEachRange(Fn&& fn) const {
+      uint32_t first = 0;
+      uint32_t count = 0;
+
+      for (uint32_t i = 0; i < Dwords; i++) {
+        uint32_t dw = m_dwords[i];
+
+        while (dw) {
+          uint32_t lo  = tzcnt(dw);
+          uint32_t len = tzcnt(~(dw >> lo));
+          uint32_t idx = 32 * i + lo;
+
+          if (count && first + count == idx) {
+            count += len;
+          } else {
+            if (count)
+              fn(first, count);
+
+            first = idx;
+            count = len;
+          }
+
+          dw = lo + len < 32 ? dw & (~0u << (lo + len)) : 0;
+        }
+      }
+
+      if (count)
+        fn(first, count);
+    }
+
+  private:
+
+    uint32_t m_dwords[Dwords];
+
+  };
+
 }
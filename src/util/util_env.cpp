@@ -55,5 +55,40 @@ namespace dxvk::env {
     auto widePath = str::tows(path);
     return !!CreateDirectoryW(widePath.data(), nullptr);
   }
+
+
+  bool replaceFile(const std::string& src, const std::string& dst) {
+    auto wideSrc = str::tows(src);
+    auto wideDst = str::tows(dst);
+    return !!MoveFileExW(wideSrc.data(), wideDst.data(), MOVEFILE_REPLACE_EXISTING);
+  }
+
+
+  static uint64_t getCpuTime(const FILETIME& kernelTime, const FILETIME& userTime) {
+    uint64_t kernel = (uint64_t(kernelTime.dwHighDateTime) << 32) | kernelTime.dwLowDateTime;
+    uint64_t user   = (uint64_t(userTime  .dwHighDateTime) << 32) | userTime  .dwLowDateTime;
+    // File times are given in 100ns units
+    return (kernel + user) / 10;
+  }
+
+
+  uint64_t getProcessCpuTime() {
+    FILETIME creationTime, exitTime, kernelTime, userTime;
+
+    if (!GetProcessTimes(GetCurrentProcess(), &creationTime, &exitTime, &kernelTime, &userTime))
+      return 0;
+
+    return getCpuTime(kernelTime, userTime);
+  }
+
+
+  uint64_t getThreadCpuTime() {
+    FILETIME creationTime, exitTime, kernelTime, userTime;
+
+    if (!GetThreadTimes(GetCurrentThread(), &creationTime, &exitTime, &kernelTime, &userTime))
+      return 0;
+
+    return getCpuTime(kernelTime, userTime);
+  }
   
 }
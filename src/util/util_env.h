@@ -44,5 +44,31 @@ namespace dxvk::env {
    * \returns \c true on success
    */
   bool createDirectory(const std::string& path);
+
+  /**
+   * \brief Replaces a file
+   * 
+   * Moves the source file to the destination path,
+   * replacing the destination if it already exists.
+   * \param [in] src Path to the new file
+   * \param [in] dst Path to the file to replace
+   * \returns \c true on success
+   */
+  bool replaceFile(const std::string& src, const std::string& dst);
+
+  /**
+   * \brief Queries CPU time used by the process
+   * 
+   * Includes both user and kernel time
+   * of all threads in the process.
+   * \returns CPU time, in microseconds
+   */
+  uint64_t getProcessCpuTime();
+
+  /**
+   * \brief Queries CPU time used by the calling thread
+   * \returns CPU time, in microseconds
+   */
+  uint64_t getThreadCpuTime();
   
 }
@@ -0,0 +1,231 @@
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <vector>
+
+#include <d3dcompiler.h>
+#include <d3d11.h>
+
+#include <windows.h>
+#include <windowsx.h>
+
+#include "../test_utils.h"
+
+using namespace dxvk;
+
+const std::string g_computeShaderCode =
+  "RWByteAddressBuffer counters : register(u0);\n"
+  "RWStructuredBuffer<uint> results : register(u1);\n"
+  "[numthreads(64,1,1)]\n"
+  "void main(uint3 globalId : SV_DispatchThreadID) {\n"
+  "  uint value = (globalId.x % 3) + 1;\n"
+  "  uint prev;\n"
+  "  counters.InterlockedAdd(0, value, prev);\n"
+  "  results[globalId.x] = prev;\n"
+  "  if (globalId.x & 1)\n"
+  "    counters.InterlockedAdd(4, 1);\n"
+  "  counters.InterlockedAdd(8 + 4 * (globalId.x & 3), 1);\n"
+  "}\n";
+
+constexpr uint32_t ThreadGroupSize  = 64;
+constexpr uint32_t ThreadGroupCount = 16;
+constexpr uint32_t ThreadCount      = ThreadGroupSize * ThreadGroupCount;
+constexpr uint32_t CounterCount     = 6;
+
+int WINAPI WinMain(HINSTANCE hInstance,
+                   HINSTANCE hPrevInstance,
+                   LPSTR lpCmdLine,
+                   int nCmdShow) {
+  Com<ID3D11Device>         device;
+  Com<ID3D11DeviceContext>  context;
+  Com<ID3D11ComputeShader>  computeShader;
+
+  Com<ID3D11Buffer> counterBuffer;
+  Com<ID3D11Buffer> resultBuffer;
+  Com<ID3D11Buffer> counterReadBuffer;
+  Com<ID3D11Buffer> resultReadBuffer;
+
+  Com<ID3D11UnorderedAccessView> counterView;
+  Com<ID3D11UnorderedAccessView> resultView;
+
+  if (FAILED(D3D11CreateDevice(
+        nullptr, D3D_DRIVER_TYPE_HARDWARE,
+        nullptr, 0, nullptr, 0, D3D11_SDK_VERSION,
+        &device, nullptr, &context))) {
+    std::cerr << "Failed to create D3D11 device" << std::endl;
+    return 1;
+  }
+
+  Com<ID3DBlob> computeShaderBlob;
+
+  if (FAILED(D3DCompile(
+        g_computeShaderCode.data(),
+        g_computeShaderCode.size(),
+        "Compute shader",
+        nullptr, nullptr,
+        "main", "cs_5_0", 0, 0,
+        &computeShaderBlob,
+        nullptr))) {
+    std::cerr << "Failed to compile compute shader" << std::endl;
+    return 1;
+  }
+
+  if (FAILED(device->CreateComputeShader(
+        computeShaderBlob->GetBufferPointer(),
+        computeShaderBlob->GetBufferSize(),
+        nullptr, &computeShader))) {
+    std::cerr << "Failed to create compute shader" << std::endl;
+    return 1;
+  }
+
+  std::array<uint32_t, CounterCount> counterData = { };
+
+  D3D11_SUBRESOURCE_DATA counterDataInfo;
+  counterDataInfo.pSysMem          = counterData.data();
+  counterDataInfo.SysMemPitch      = 0;
+  counterDataInfo.SysMemSlicePitch = 0;
+
+  D3D11_BUFFER_DESC counterBufferDesc;
+  counterBufferDesc.ByteWidth            = sizeof(uint32_t) * CounterCount;
+  counterBufferDesc.Usage                = D3D11_USAGE_DEFAULT;
+  counterBufferDesc.BindFlags            = D3D11_BIND_UNORDERED_ACCESS;
+  counterBufferDesc.CPUAccessFlags       = 0;
+  counterBufferDesc.MiscFlags            = D3D11_RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS;
+  counterBufferDesc.StructureByteStride  = 0;
+
+  if (FAILED(device->CreateBuffer(&counterBufferDesc, &counterDataInfo, &counterBuffer))) {
+    std::cerr << "Failed to create counter buffer" << std::endl;
+    return 1;
+  }
+
+  D3D11_BUFFER_DESC resultBufferDesc;
+  resultBufferDesc.ByteWidth            = sizeof(uint32_t) * ThreadCount;
+  resultBufferDesc.Usage                = D3D11_USAGE_DEFAULT;
+  resultBufferDesc.BindFlags            = D3D11_BIND_UNORDERED_ACCESS;
+  resultBufferDesc.CPUAccessFlags       = 0;
+  resultBufferDesc.MiscFlags            = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+  resultBufferDesc.StructureByteStride  = sizeof(uint32_t);
+
+  if (FAILED(device->CreateBuffer(&resultBufferDesc, nullptr, &resultBuffer))) {
+    std::cerr << "Failed to create result buffer" << std::endl;
+    return 1;
+  }
+
+  D3D11_BUFFER_DESC readBufferDesc;
+  readBufferDesc.ByteWidth            = counterBufferDesc.ByteWidth;
+  readBufferDesc.Usage                = D3D11_USAGE_STAGING;
+  readBufferDesc.BindFlags            = 0;
+  readBufferDesc.CPUAccessFlags       = D3D11_CPU_ACCESS_READ;
+  readBufferDesc.MiscFlags            = 0;
+  readBufferDesc.StructureByteStride  = 0;
+
+  if (FAILED(device->CreateBuffer(&readBufferDesc, nullptr, &counterReadBuffer))) {
+    std::cerr << "Failed to create readback buffer" << std::endl;
+    return 1;
+  }
+
+  readBufferDesc.ByteWidth = resultBufferDesc.ByteWidth;
+
+  if (FAILED(device->CreateBuffer(&readBufferDesc, nullptr, &resultReadBuffer))) {
+    std::cerr << "Failed to create readback buffer" << std::endl;
+    return 1;
+  }
+
+  D3D11_UNORDERED_ACCESS_VIEW_DESC counterViewDesc;
+  counterViewDesc.Format                = DXGI_FORMAT_R32_TYPELESS;
+  counterViewDesc.ViewDimension         = D3D11_UAV_DIMENSION_BUFFER;
+  counterViewDesc.Buffer.FirstElement   = 0;
+  counterViewDesc.Buffer.NumElements    = CounterCount;
+  counterViewDesc.Buffer.Flags          = D3D11_BUFFER_UAV_FLAG_RAW;
+
+  if (FAILED(device->CreateUnorderedAccessView(counterBuffer.ptr(), &counterViewDesc, &counterView))) {
+    std::cerr << "Failed to create unordered access view" << std::endl;
+    return 1;
+  }
+
+  D3D11_UNORDERED_ACCESS_VIEW_DESC resultViewDesc;
+  resultViewDesc.Format                 = DXGI_FORMAT_UNKNOWN;
+  resultViewDesc.ViewDimension          = D3D11_UAV_DIMENSION_BUFFER;
+  resultViewDesc.Buffer.FirstElement    = 0;
+  resultViewDesc.Buffer.NumElements     = ThreadCount;
+  resultViewDesc.Buffer.Flags           = 0;
+
+  if (FAILED(device->CreateUnorderedAccessView(resultBuffer.ptr(), &resultViewDesc, &resultView))) {
+    std::cerr << "Failed to create unordered access view" << std::endl;
+    return 1;
+  }
+
+  std::array<ID3D11UnorderedAccessView*, 2> views = {
+    counterView.ptr(), resultView.ptr() };
+
+  context->CSSetShader(computeShader.ptr(), nullptr, 0);
+  context->CSSetUnorderedAccessViews(0, views.size(), views.data(), nullptr);
+  context->Dispatch(ThreadGroupCount, 1, 1);
+
+  context->CopyResource(counterReadBuffer.ptr(), counterBuffer.ptr());
+  context->CopyResource(resultReadBuffer.ptr(), resultBuffer.ptr());
+
+  D3D11_MAPPED_SUBRESOURCE mappedResource;
+
+  if (FAILED(context->Map(counterReadBuffer.ptr(), 0, D3D11_MAP_READ, 0, &mappedResource))) {
+    std::cerr << "Failed to map readback buffer" << std::endl;
+    return 1;
+  }
+
+  std::memcpy(counterData.data(), mappedResource.pData, sizeof(uint32_t) * CounterCount);
+  context->Unmap(counterReadBuffer.ptr(), 0);
+
+  std::vector<uint32_t> resultData(ThreadCount);
+
+  if (FAILED(context->Map(resultReadBuffer.ptr(), 0, D3D11_MAP_READ, 0, &mappedResource))) {
+    std::cerr << "Failed to map readback buffer" << std::endl;
+    return 1;
+  }
+
+  std::memcpy(resultData.data(), mappedResource.pData, sizeof(uint32_t) * ThreadCount);
+  context->Unmap(resultReadBuffer.ptr(), 0);
+  context->ClearState();
+
+  // Every thread must have received a distinct old value, so
+  // that sorting the (old value, increment) pairs yields an
+  // uninterrupted sequence of prefix sums.
+  std::vector<std::pair<uint32_t, uint32_t>> pairs(ThreadCount);
+
+  for (uint32_t i = 0; i < ThreadCount; i++)
+    pairs[i] = { resultData[i], (i % 3) + 1 };
+
+  std::sort(pairs.begin(), pairs.end());
+
+  uint32_t expected = 0;
+  bool success = true;
+
+  for (const auto& p : pairs) {
+    if (p.first != expected) {
+      std::cerr << "Unexpected old value " << p.first << ", expected " << expected << std::endl;
+      success = false;
+      break;
+    }
+
+    expected += p.second;
+  }
+
+  if (counterData[0] != expected) {
+    std::cerr << "Uniform counter is " << counterData[0] << ", expected " << expected << std::endl;
+    success = false;
+  }
+
+  if (counterData[1] != ThreadCount / 2) {
+    std::cerr << "Partial counter is " << counterData[1] << ", expected " << (ThreadCount / 2) << std::endl;
+    success = false;
+  }
+
+  for (uint32_t i = 2; i < CounterCount; i++) {
+    if (counterData[i] != ThreadCount / 4) {
+      std::cerr << "Divergent counter " << (i - 2) << " is " << counterData[i] << ", expected " << (ThreadCount / 4) << std::endl;
+      success = false;
+    }
+  }
+
+  std::cout << (success ? "Atomic results are correct" : "Atomic results are incorrect") << std::endl;
+  return success ? 0 : 1;
+}
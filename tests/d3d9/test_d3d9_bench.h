@@ -0,0 +1,285 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+
+#include <d3d9.h>
+
+#include "../test_utils.h"
+
+/**
+ * \brief D3D9 CPU overhead benchmark
+ *
+ * Creates a windowed device and measures the CPU time
+ * spent recording each frame. Derived apps draw one
+ * frame per pattern, and the average frame time is
+ * printed once for every pattern in turn.
+ */
+class D3D9BenchApp {
+
+public:
+
+  D3D9BenchApp(HWND window, uint32_t patternCount, uint32_t drawsPerFrame)
+  : m_window(window), m_patternCount(patternCount), m_drawsPerFrame(drawsPerFrame) {
+    HRESULT status = Direct3DCreate9Ex(D3D_SDK_VERSION, &m_d3d);
+
+    if (FAILED(status))
+      throw dxvk::DxvkError("Failed to create D3D9 interface");
+
+    D3DPRESENT_PARAMETERS params;
+    getPresentParams(params);
+
+    status = m_d3d->CreateDeviceEx(
+      D3DADAPTER_DEFAULT,
+      D3DDEVTYPE_HAL,
+      m_window,
+      D3DCREATE_HARDWARE_VERTEXPROCESSING,
+      &params,
+      nullptr,
+      &m_device);
+
+    if (FAILED(status))
+      throw dxvk::DxvkError("Failed to create D3D9 device");
+  }
+
+  virtual ~D3D9BenchApp() { }
+
+  void run() {
+    this->adjustBackBuffer();
+
+    auto t0 = std::chrono::high_resolution_clock::now();
+
+    m_device->BeginScene();
+
+    m_device->Clear(0, nullptr, D3DCLEAR_TARGET,
+      D3DCOLOR_RGBA(44, 62, 80, 0), 0, 0);
+
+    this->drawFrame(m_pattern);
+
+    m_device->EndScene();
+
+    auto t1 = std::chrono::high_resolution_clock::now();
+    m_totalUs += std::chrono::duration_cast<std::chrono::microseconds>(t1 - t0).count();
+
+    // The back buffer is undefined after presentation,
+    // so results must be gathered before presenting
+    std::string results;
+
+    if (m_frameId + 1 == FramesPerRun)
+      results = this->getPatternResults(m_pattern);
+
+    m_device->PresentEx(nullptr, nullptr, nullptr, nullptr, 0);
+
+    if (++m_frameId == FramesPerRun) {
+      std::cout << this->getPatternName(m_pattern) << ": "
+                << (m_totalUs / FramesPerRun) << " us per frame, "
+                << m_drawsPerFrame << " draws";
+
+      if (!results.empty())
+        std::cout << ", " << results;
+
+      std::cout << std::endl;
+
+      m_pattern = (m_pattern + 1) % m_patternCount;
+      m_frameId = 0;
+      m_totalUs = 0;
+    }
+  }
+
+protected:
+
+  static constexpr uint32_t FramesPerRun = 200;
+
+  dxvk::Com<IDirect3DDevice9Ex> m_device;
+
+  virtual const char* getPatternName(uint32_t pattern) const = 0;
+
+  virtual void drawFrame(uint32_t pattern) = 0;
+
+  /**
+   * \brief Gathers additional pattern results
+   *
+   * Called after the last frame of each run has been
+   * drawn, outside of the measured time. The text is
+   * appended to the line printed for the pattern.
+   * \param [in] pattern The pattern that was drawn
+   * \returns Result text, may be empty
+   */
+  virtual std::string getPatternResults(uint32_t pattern) {
+    return std::string();
+  }
+
+  /**
+   * \brief Computes a checksum of the back buffer
+   *
+   * Reads back the image drawn so far, so that
+   * runs with different options can be compared.
+   * \returns FNV-1a hash of all pixels
+   */
+  uint32_t getBackBufferChecksum() {
+    dxvk::Com<IDirect3DSurface9> backBuffer;
+    dxvk::Com<IDirect3DSurface9> readback;
+
+    HRESULT status = m_device->GetBackBuffer(0, 0, D3DBACKBUFFER_TYPE_MONO, &backBuffer);
+    if (FAILED(status))
+      throw dxvk::DxvkError("Failed to get back buffer");
+
+    D3DSURFACE_DESC desc;
+    backBuffer->GetDesc(&desc);
+
+    status = m_device->CreateOffscreenPlainSurface(desc.Width, desc.Height,
+      desc.Format, D3DPOOL_SYSTEMMEM, &readback, nullptr);
+    if (FAILED(status))
+      throw dxvk::DxvkError("Failed to create readback surface");
+
+    status = m_device->GetRenderTargetData(backBuffer.ptr(), readback.ptr());
+    if (FAILED(status))
+      throw dxvk::DxvkError("Failed to read back image");
+
+    D3DLOCKED_RECT rect;
+    status = readback->LockRect(&rect, nullptr, D3DLOCK_READONLY);
+    if (FAILED(status))
+      throw dxvk::DxvkError("Failed to lock readback surface");
+
+    // FNV-1a over all pixels, ignoring the undefined X channel
+    uint32_t hash = 2166136261u;
+
+    for (uint32_t y = 0; y < desc.Height; y++) {
+      auto row = reinterpret_cast<const uint32_t*>(
+        reinterpret_cast<const char*>(rect.pBits) + y * rect.Pitch);
+
+      for (uint32_t x = 0; x < desc.Width; x++)
+        hash = (hash ^ (row[x] & 0xFFFFFFu)) * 16777619u;
+    }
+
+    readback->UnlockRect();
+    return hash;
+  }
+
+private:
+
+  struct Extent2D {
+    uint32_t w, h;
+  };
+
+  HWND                          m_window;
+  Extent2D                      m_windowSize = { 1024, 600 };
+
+  dxvk::Com<IDirect3D9Ex>       m_d3d;
+
+  uint32_t                      m_patternCount;
+  uint32_t                      m_drawsPerFrame;
+
+  uint32_t                      m_pattern = 0;
+  uint32_t                      m_frameId = 0;
+  uint64_t                      m_totalUs = 0;
+
+  void adjustBackBuffer() {
+    RECT windowRect = { 0, 0, 1024, 600 };
+    GetClientRect(m_window, &windowRect);
+
+    Extent2D newSize = {
+      static_cast<uint32_t>(windowRect.right - windowRect.left),
+      static_cast<uint32_t>(windowRect.bottom - windowRect.top),
+    };
+
+    if (m_windowSize.w != newSize.w
+     || m_windowSize.h != newSize.h) {
+      m_windowSize = newSize;
+
+      D3DPRESENT_PARAMETERS params;
+      getPresentParams(params);
+      HRESULT status = m_device->ResetEx(&params, nullptr);
+
+      if (FAILED(status))
+        throw dxvk::DxvkError("Device reset failed");
+    }
+  }
+
+  void getPresentParams(D3DPRESENT_PARAMETERS& params) {
+    params.AutoDepthStencilFormat = D3DFMT_UNKNOWN;
+    params.BackBufferCount = 1;
+    params.BackBufferFormat = D3DFMT_X8R8G8B8;
+    params.BackBufferWidth = m_windowSize.w;
+    params.BackBufferHeight = m_windowSize.h;
+    params.EnableAutoDepthStencil = FALSE;
+    params.Flags = 0;
+    params.FullScreen_RefreshRateInHz = 0;
+    params.hDeviceWindow = m_window;
+    params.MultiSampleQuality = 0;
+    params.MultiSampleType = D3DMULTISAMPLE_NONE;
+    params.PresentationInterval = D3DPRESENT_INTERVAL_IMMEDIATE;
+    params.SwapEffect = D3DSWAPEFFECT_DISCARD;
+    params.Windowed = TRUE;
+  }
+
+};
+
+
+inline LRESULT CALLBACK D3D9BenchWindowProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam) {
+  switch (message) {
+    case WM_CLOSE:
+      PostQuitMessage(0);
+      return 0;
+  }
+
+  return DefWindowProc(hWnd, message, wParam, lParam);
+}
+
+
+/**
+ * \brief Runs a benchmark app until its window is closed
+ *
+ * \tparam App Benchmark app type, constructed from a window
+ * \param [in] hInstance Application instance
+ * \param [in] nCmdShow Window show command
+ * \param [in] title Window title
+ * \returns Exit code
+ */
+template<typename App>
+int runD3D9Bench(HINSTANCE hInstance, int nCmdShow, const wchar_t* title) {
+  HWND hWnd;
+  WNDCLASSEXW wc;
+  ZeroMemory(&wc, sizeof(WNDCLASSEX));
+  wc.cbSize = sizeof(WNDCLASSEX);
+  wc.style = CS_HREDRAW | CS_VREDRAW;
+  wc.lpfnWndProc = D3D9BenchWindowProc;
+  wc.hInstance = hInstance;
+  wc.hCursor = LoadCursor(nullptr, IDC_ARROW);
+  wc.hbrBackground = (HBRUSH)COLOR_WINDOW;
+  wc.lpszClassName = L"WindowClass1";
+  RegisterClassExW(&wc);
+
+  hWnd = CreateWindowExW(0,
+    L"WindowClass1",
+    title,
+    WS_OVERLAPPEDWINDOW,
+    300, 300,
+    640, 480,
+    nullptr,
+    nullptr,
+    hInstance,
+    nullptr);
+  ShowWindow(hWnd, nCmdShow);
+
+  MSG msg;
+
+  try {
+    App app(hWnd);
+
+    while (true) {
+      if (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE)) {
+        TranslateMessage(&msg);
+        DispatchMessage(&msg);
+
+        if (msg.message == WM_QUIT)
+          return msg.wParam;
+      } else {
+        app.run();
+      }
+    }
+  } catch (const dxvk::DxvkError& e) {
+    std::cerr << e.message() << std::endl;
+    return msg.wParam;
+  }
+}
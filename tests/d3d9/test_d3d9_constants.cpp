@@ -0,0 +1,238 @@
+#include <array>
+#include <cstring>
+
+#include <d3dcompiler.h>
+
+#include "test_d3d9_bench.h"
+
+using namespace dxvk;
+
+const std::string g_vertexShaderCode = R"(
+
+float4x4 g_viewProj     : register(c0);
+float4x3 g_bones[64]    : register(c4);
+float4   g_lightDir     : register(c200);
+
+struct VS_INPUT {
+  float3 Position : POSITION;
+  float4 Weights  : BLENDWEIGHT;
+  float4 Indices  : BLENDINDICES;
+};
+
+struct VS_OUTPUT {
+  float4 Position : POSITION;
+  float4 Color    : COLOR0;
+};
+
+VS_OUTPUT main( VS_INPUT IN ) {
+  float3 pos = 0.0f;
+
+  for (int i = 0; i < 4; i++)
+    pos += mul(float4(IN.Position, 1.0f), g_bones[(int)IN.Indices[i]]) * IN.Weights[i];
+
+  VS_OUTPUT OUT;
+  OUT.Position = mul(float4(pos, 1.0f), g_viewProj);
+  OUT.Color    = saturate(g_lightDir);
+  return OUT;
+}
+
+)";
+
+const std::string g_pixelShaderCode = R"(
+
+struct VS_OUTPUT {
+  float4 Position : POSITION;
+  float4 Color    : COLOR0;
+};
+
+float4 main( VS_OUTPUT IN ) : COLOR {
+  return IN.Color;
+}
+
+)";
+
+/**
+ * \brief Constant update pattern
+ *
+ * Mimics what engines typically do when drawing
+ * skinned meshes. Per-frame data is either set
+ * once or again for every draw, and the bone
+ * palette is either replaced entirely or only
+ * a single bone changes between draws.
+ */
+enum class UpdatePattern : uint32_t {
+  FullPalette,
+  SingleBone,
+  RedundantPerFrame,
+  Count,
+};
+
+const char* getUpdatePatternName(UpdatePattern pattern) {
+  switch (pattern) {
+    case UpdatePattern::FullPalette:        return "full palette";
+    case UpdatePattern::SingleBone:         return "single bone";
+    case UpdatePattern::RedundantPerFrame:  return "redundant per-frame";
+    default:                                return "?";
+  }
+}
+
+constexpr uint32_t BoneCount      = 64;
+constexpr uint32_t DrawsPerFrame  = 500;
+
+class ConstantsApp : public D3D9BenchApp {
+
+public:
+
+  ConstantsApp(HWND window)
+  : D3D9BenchApp(window, uint32_t(UpdatePattern::Count), DrawsPerFrame) {
+    // Vertex Shader
+    {
+      Com<ID3DBlob> blob;
+
+      HRESULT status = D3DCompile(
+        g_vertexShaderCode.data(),
+        g_vertexShaderCode.length(),
+        nullptr, nullptr, nullptr,
+        "main",
+        "vs_3_0",
+        0, 0, &blob,
+        nullptr);
+
+      if (FAILED(status))
+        throw DxvkError("Failed to compile vertex shader");
+
+      status = m_device->CreateVertexShader(reinterpret_cast<const DWORD*>(blob->GetBufferPointer()), &m_vs);
+
+      if (FAILED(status))
+        throw DxvkError("Failed to create vertex shader");
+    }
+
+    // Pixel Shader
+    {
+      Com<ID3DBlob> blob;
+
+      HRESULT status = D3DCompile(
+        g_pixelShaderCode.data(),
+        g_pixelShaderCode.length(),
+        nullptr, nullptr, nullptr,
+        "main",
+        "ps_3_0",
+        0, 0, &blob,
+        nullptr);
+
+      if (FAILED(status))
+        throw DxvkError("Failed to compile pixel shader");
+
+      status = m_device->CreatePixelShader(reinterpret_cast<const DWORD*>(blob->GetBufferPointer()), &m_ps);
+
+      if (FAILED(status))
+        throw DxvkError("Failed to create pixel shader");
+    }
+
+    m_device->SetVertexShader(m_vs.ptr());
+    m_device->SetPixelShader(m_ps.ptr());
+
+    std::array<float, 36> vertices = {
+       0.0f,  0.5f, 0.0f,   1.0f, 0.0f, 0.0f, 0.0f,   0.0f, 1.0f, 2.0f, 3.0f,   0.0f,
+       0.5f, -0.5f, 0.0f,   0.5f, 0.5f, 0.0f, 0.0f,   4.0f, 5.0f, 6.0f, 7.0f,   0.0f,
+      -0.5f, -0.5f, 0.0f,   0.2f, 0.2f, 0.3f, 0.3f,  60.0f,61.0f,62.0f,63.0f,   0.0f,
+    };
+
+    const size_t vbSize = vertices.size() * sizeof(float);
+
+    HRESULT status = m_device->CreateVertexBuffer(vbSize, 0, 0, D3DPOOL_DEFAULT, &m_vb, nullptr);
+    if (FAILED(status))
+      throw DxvkError("Failed to create vertex buffer");
+
+    void* data = nullptr;
+    status = m_vb->Lock(0, 0, &data, 0);
+    if (FAILED(status))
+      throw DxvkError("Failed to lock vertex buffer");
+
+    std::memcpy(data, vertices.data(), vbSize);
+
+    status = m_vb->Unlock();
+    if (FAILED(status))
+      throw DxvkError("Failed to unlock vertex buffer");
+
+    m_device->SetStreamSource(0, m_vb.ptr(), 0, 12 * sizeof(float));
+
+    std::array<D3DVERTEXELEMENT9, 4> elements;
+    elements[0] = { 0,  0, D3DDECLTYPE_FLOAT3, D3DDECLMETHOD_DEFAULT, D3DDECLUSAGE_POSITION,     0 };
+    elements[1] = { 0, 12, D3DDECLTYPE_FLOAT4, D3DDECLMETHOD_DEFAULT, D3DDECLUSAGE_BLENDWEIGHT,  0 };
+    elements[2] = { 0, 28, D3DDECLTYPE_FLOAT4, D3DDECLMETHOD_DEFAULT, D3DDECLUSAGE_BLENDINDICES, 0 };
+    elements[3] = D3DDECL_END();
+
+    status = m_device->CreateVertexDeclaration(elements.data(), &m_decl);
+    if (FAILED(status))
+      throw DxvkError("Failed to create vertex decl");
+
+    m_device->SetVertexDeclaration(m_decl.ptr());
+
+    // Identity view-projection matrix and bone palette
+    for (uint32_t i = 0; i < 4; i++)
+      m_viewProj[5 * i] = 1.0f;
+
+    for (uint32_t i = 0; i < BoneCount; i++) {
+      for (uint32_t j = 0; j < 3; j++)
+        m_bones[12 * i + 5 * j] = 1.0f;
+    }
+  }
+
+protected:
+
+  const char* getPatternName(uint32_t pattern) const {
+    return getUpdatePatternName(UpdatePattern(pattern));
+  }
+
+  void drawFrame(uint32_t pattern) {
+    std::array<float, 4> lightDir = { 0.5f, 0.5f, 1.0f, 1.0f };
+
+    m_device->SetVertexShaderConstantF(0,   m_viewProj.data(), 4);
+    m_device->SetVertexShaderConstantF(200, lightDir.data(),   1);
+
+    for (uint32_t i = 0; i < DrawsPerFrame; i++) {
+      uint32_t bone = i % BoneCount;
+      m_bones[12 * bone + 3] = float(i) * 0.0001f;
+
+      switch (UpdatePattern(pattern)) {
+        case UpdatePattern::FullPalette:
+          m_device->SetVertexShaderConstantF(4, m_bones.data(), 3 * BoneCount);
+          break;
+
+        case UpdatePattern::RedundantPerFrame:
+          m_device->SetVertexShaderConstantF(0,   m_viewProj.data(), 4);
+          m_device->SetVertexShaderConstantF(200, lightDir.data(),   1);
+          /* fall through */
+
+        case UpdatePattern::SingleBone:
+          m_device->SetVertexShaderConstantF(4 + 3 * bone, &m_bones[12 * bone], 3);
+          break;
+
+        default:
+          break;
+      }
+
+      m_device->DrawPrimitive(D3DPT_TRIANGLELIST, 0, 1);
+    }
+  }
+
+private:
+
+  Com<IDirect3DVertexShader9>   m_vs;
+  Com<IDirect3DPixelShader9>    m_ps;
+  Com<IDirect3DVertexBuffer9>   m_vb;
+  Com<IDirect3DVertexDeclaration9> m_decl;
+
+  std::array<float, 16>             m_viewProj  = { };
+  std::array<float, 12 * BoneCount> m_bones     = { };
+
+};
+
+int WINAPI WinMain(HINSTANCE hInstance,
+                   HINSTANCE hPrevInstance,
+                   LPSTR lpCmdLine,
+                   int nCmdShow) {
+  return runD3D9Bench<ConstantsApp>(hInstance, nCmdShow,
+    L"D3D9 constant update benchmark");
+}
@@ -0,0 +1,214 @@
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+#include "test_d3d9_bench.h"
+
+using namespace dxvk;
+
+struct Vertex {
+  float     x, y, z;
+  D3DCOLOR  color;
+};
+
+/**
+ * \brief Draw pattern
+ *
+ * Each pattern draws one small primitive per grid
+ * cell, with every draw starting where the previous
+ * one ended. Only adjacent list draws without state
+ * changes in between may be merged.
+ *
+ * Run once with \c d3d9.mergeDraws enabled and once
+ * with it disabled. The image checksums must match,
+ * and with merging enabled, the merged draw count in
+ * the HUD (\c DXVK_HUD=drawcalls) must match the
+ * expected count printed for each pattern.
+ */
+enum class DrawPattern : uint32_t {
+  AdjacentLists,
+  StateChange,
+  BaseVertex,
+  Strips,
+  Count,
+};
+
+const char* getDrawPatternName(DrawPattern pattern) {
+  switch (pattern) {
+    case DrawPattern::AdjacentLists:  return "adjacent lists";
+    case DrawPattern::StateChange:    return "state change";
+    case DrawPattern::BaseVertex:     return "base vertex";
+    case DrawPattern::Strips:         return "strips";
+    default:                          return "?";
+  }
+}
+
+constexpr uint32_t GridW          = 40;
+constexpr uint32_t GridH          = 25;
+constexpr uint32_t DrawsPerFrame  = GridW * GridH;
+
+class DrawMergeApp : public D3D9BenchApp {
+
+public:
+
+  DrawMergeApp(HWND window)
+  : D3D9BenchApp(window, uint32_t(DrawPattern::Count), DrawsPerFrame) {
+    std::vector<Vertex>   listVertices;
+    std::vector<Vertex>   stripVertices;
+    std::vector<uint16_t> indices;
+
+    for (uint32_t i = 0; i < DrawsPerFrame; i++) {
+      uint32_t x = i % GridW;
+      uint32_t y = i / GridW;
+
+      float x0 = -1.0f + 2.0f * float(x    ) / float(GridW);
+      float x1 = -1.0f + 2.0f * float(x + 1) / float(GridW);
+      float y0 = -1.0f + 2.0f * float(y    ) / float(GridH);
+      float y1 = -1.0f + 2.0f * float(y + 1) / float(GridH);
+
+      D3DCOLOR color = D3DCOLOR_RGBA((x * 6) & 0xFF, (y * 10) & 0xFF, (i * 7) & 0xFF, 255);
+
+      listVertices.push_back({ x0, y0, 0.0f, color });
+      listVertices.push_back({ x1, y0, 0.0f, color });
+      listVertices.push_back({ x0, y1, 0.0f, color });
+
+      stripVertices.push_back({ x0, y0, 0.0f, color });
+      stripVertices.push_back({ x1, y0, 0.0f, color });
+      stripVertices.push_back({ x0, y1, 0.0f, color });
+      stripVertices.push_back({ x1, y1, 0.0f, color });
+
+      // Each draw uses its own base vertex, so
+      // all draws read the same three indices
+      indices.push_back(0);
+      indices.push_back(1);
+      indices.push_back(2);
+    }
+
+    m_listVb  = createVertexBuffer(listVertices);
+    m_stripVb = createVertexBuffer(stripVertices);
+
+    const size_t ibSize = indices.size() * sizeof(uint16_t);
+
+    HRESULT status = m_device->CreateIndexBuffer(ibSize, 0, D3DFMT_INDEX16, D3DPOOL_DEFAULT, &m_ib, nullptr);
+    if (FAILED(status))
+      throw DxvkError("Failed to create index buffer");
+
+    void* data = nullptr;
+    status = m_ib->Lock(0, 0, &data, 0);
+    if (FAILED(status))
+      throw DxvkError("Failed to lock index buffer");
+
+    std::memcpy(data, indices.data(), ibSize);
+
+    status = m_ib->Unlock();
+    if (FAILED(status))
+      throw DxvkError("Failed to unlock index buffer");
+  }
+
+protected:
+
+  const char* getPatternName(uint32_t pattern) const {
+    return getDrawPatternName(DrawPattern(pattern));
+  }
+
+  void drawFrame(uint32_t pattern) {
+    // Device resets discard all state, so set it every frame
+    setStates();
+
+    bool strips = DrawPattern(pattern) == DrawPattern::Strips;
+
+    m_device->SetStreamSource(0, strips ? m_stripVb.ptr() : m_listVb.ptr(), 0, sizeof(Vertex));
+    m_device->SetIndices(m_ib.ptr());
+
+    for (uint32_t i = 0; i < DrawsPerFrame; i++) {
+      switch (DrawPattern(pattern)) {
+        case DrawPattern::AdjacentLists:
+          m_device->DrawPrimitive(D3DPT_TRIANGLELIST, 3 * i, 1);
+          break;
+
+        case DrawPattern::StateChange:
+          m_device->SetRenderState(D3DRS_TEXTUREFACTOR, (i & 1)
+            ? D3DCOLOR_RGBA(128, 128, 128, 255)
+            : D3DCOLOR_RGBA(255, 255, 255, 255));
+          m_device->DrawPrimitive(D3DPT_TRIANGLELIST, 3 * i, 1);
+          break;
+
+        case DrawPattern::BaseVertex:
+          m_device->DrawIndexedPrimitive(D3DPT_TRIANGLELIST, 3 * i, 0, 3, 3 * i, 1);
+          break;
+
+        case DrawPattern::Strips:
+          m_device->DrawPrimitive(D3DPT_TRIANGLESTRIP, 4 * i, 2);
+          break;
+
+        default:
+          break;
+      }
+    }
+  }
+
+  std::string getPatternResults(uint32_t pattern) {
+    uint32_t expectedMerges = DrawPattern(pattern) == DrawPattern::AdjacentLists
+      ? DrawsPerFrame - 1 : 0;
+
+    std::stringstream str;
+    str << "image 0x" << std::hex << std::setw(8) << std::setfill('0')
+        << getBackBufferChecksum() << std::dec
+        << ", expected " << expectedMerges << " merged draws";
+    return str.str();
+  }
+
+private:
+
+  Com<IDirect3DVertexBuffer9>   m_listVb;
+  Com<IDirect3DVertexBuffer9>   m_stripVb;
+  Com<IDirect3DIndexBuffer9>    m_ib;
+
+  Com<IDirect3DVertexBuffer9> createVertexBuffer(const std::vector<Vertex>& vertices) {
+    Com<IDirect3DVertexBuffer9> vb;
+
+    const size_t vbSize = vertices.size() * sizeof(Vertex);
+
+    HRESULT status = m_device->CreateVertexBuffer(vbSize, 0, 0, D3DPOOL_DEFAULT, &vb, nullptr);
+    if (FAILED(status))
+      throw DxvkError("Failed to create vertex buffer");
+
+    void* data = nullptr;
+    status = vb->Lock(0, 0, &data, 0);
+    if (FAILED(status))
+      throw DxvkError("Failed to lock vertex buffer");
+
+    std::memcpy(data, vertices.data(), vbSize);
+
+    status = vb->Unlock();
+    if (FAILED(status))
+      throw DxvkError("Failed to unlock vertex buffer");
+
+    return vb;
+  }
+
+  void setStates() {
+    m_device->SetFVF(D3DFVF_XYZ | D3DFVF_DIFFUSE);
+
+    m_device->SetRenderState(D3DRS_LIGHTING,      FALSE);
+    m_device->SetRenderState(D3DRS_CULLMODE,      D3DCULL_NONE);
+    m_device->SetRenderState(D3DRS_TEXTUREFACTOR, D3DCOLOR_RGBA(255, 255, 255, 255));
+
+    m_device->SetTextureStageState(0, D3DTSS_COLOROP,   D3DTOP_MODULATE);
+    m_device->SetTextureStageState(0, D3DTSS_COLORARG1, D3DTA_DIFFUSE);
+    m_device->SetTextureStageState(0, D3DTSS_COLORARG2, D3DTA_TFACTOR);
+    m_device->SetTextureStageState(0, D3DTSS_ALPHAOP,   D3DTOP_SELECTARG1);
+    m_device->SetTextureStageState(0, D3DTSS_ALPHAARG1, D3DTA_DIFFUSE);
+    m_device->SetTextureStageState(1, D3DTSS_COLOROP,   D3DTOP_DISABLE);
+  }
+
+};
+
+int WINAPI WinMain(HINSTANCE hInstance,
+                   HINSTANCE hPrevInstance,
+                   LPSTR lpCmdLine,
+                   int nCmdShow) {
+  return runD3D9Bench<DrawMergeApp>(hInstance, nCmdShow,
+    L"D3D9 draw merge test");
+}
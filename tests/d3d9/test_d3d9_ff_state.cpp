@@ -0,0 +1,127 @@
+#include <array>
+#include <cstring>
+
+#include "test_d3d9_bench.h"
+
+using namespace dxvk;
+
+struct Vertex {
+  float     x, y, z;
+  float     nx, ny, nz;
+  D3DCOLOR  color;
+};
+
+/**
+ * \brief State change pattern
+ *
+ * Mimics fixed-function engines that set their
+ * render states before every draw. States are
+ * either left alone, changed and restored to
+ * the same values, or alternate between two
+ * different fixed-function shaders.
+ */
+enum class StatePattern : uint32_t {
+  Static,
+  ChangeAndRestore,
+  Alternate,
+  Count,
+};
+
+const char* getStatePatternName(StatePattern pattern) {
+  switch (pattern) {
+    case StatePattern::Static:            return "static";
+    case StatePattern::ChangeAndRestore:  return "change and restore";
+    case StatePattern::Alternate:         return "alternate";
+    default:                              return "?";
+  }
+}
+
+constexpr uint32_t DrawsPerFrame  = 1000;
+
+class FixedFunctionStateApp : public D3D9BenchApp {
+
+public:
+
+  FixedFunctionStateApp(HWND window)
+  : D3D9BenchApp(window, uint32_t(StatePattern::Count), DrawsPerFrame) {
+    std::array<Vertex, 3> vertices = {{
+      {  0.0f,  0.5f, 0.0f,   0.0f, 0.0f, -1.0f,   D3DCOLOR_RGBA(255,   0,   0, 255) },
+      {  0.5f, -0.5f, 0.0f,   0.0f, 0.0f, -1.0f,   D3DCOLOR_RGBA(  0, 255,   0, 255) },
+      { -0.5f, -0.5f, 0.0f,   0.0f, 0.0f, -1.0f,   D3DCOLOR_RGBA(  0,   0, 255, 255) },
+    }};
+
+    const size_t vbSize = vertices.size() * sizeof(Vertex);
+
+    HRESULT status = m_device->CreateVertexBuffer(vbSize, 0, 0, D3DPOOL_DEFAULT, &m_vb, nullptr);
+    if (FAILED(status))
+      throw DxvkError("Failed to create vertex buffer");
+
+    void* data = nullptr;
+    status = m_vb->Lock(0, 0, &data, 0);
+    if (FAILED(status))
+      throw DxvkError("Failed to lock vertex buffer");
+
+    std::memcpy(data, vertices.data(), vbSize);
+
+    status = m_vb->Unlock();
+    if (FAILED(status))
+      throw DxvkError("Failed to unlock vertex buffer");
+
+    m_device->SetStreamSource(0, m_vb.ptr(), 0, sizeof(Vertex));
+    m_device->SetFVF(D3DFVF_XYZ | D3DFVF_NORMAL | D3DFVF_DIFFUSE);
+  }
+
+protected:
+
+  const char* getPatternName(uint32_t pattern) const {
+    return getStatePatternName(StatePattern(pattern));
+  }
+
+  void drawFrame(uint32_t pattern) {
+    setStates(0);
+
+    for (uint32_t i = 0; i < DrawsPerFrame; i++) {
+      switch (StatePattern(pattern)) {
+        case StatePattern::ChangeAndRestore:
+          setStates(1);
+          setStates(0);
+          break;
+
+        case StatePattern::Alternate:
+          setStates(i & 1);
+          break;
+
+        default:
+          break;
+      }
+
+      m_device->DrawPrimitive(D3DPT_TRIANGLELIST, 0, 1);
+    }
+  }
+
+private:
+
+  Com<IDirect3DVertexBuffer9>   m_vb;
+
+  void setStates(uint32_t variant) {
+    m_device->SetRenderState(D3DRS_LIGHTING,          FALSE);
+    m_device->SetRenderState(D3DRS_NORMALIZENORMALS,  variant);
+    m_device->SetRenderState(D3DRS_TEXTUREFACTOR,     D3DCOLOR_RGBA(128, 128, 128, 255));
+
+    m_device->SetTextureStageState(0, D3DTSS_COLOROP,   variant ? D3DTOP_ADD : D3DTOP_MODULATE);
+    m_device->SetTextureStageState(0, D3DTSS_COLORARG1, D3DTA_DIFFUSE);
+    m_device->SetTextureStageState(0, D3DTSS_COLORARG2, D3DTA_TFACTOR);
+    m_device->SetTextureStageState(0, D3DTSS_ALPHAOP,   D3DTOP_SELECTARG1);
+    m_device->SetTextureStageState(0, D3DTSS_ALPHAARG1, D3DTA_DIFFUSE);
+    m_device->SetTextureStageState(1, D3DTSS_COLOROP,   D3DTOP_DISABLE);
+  }
+
+};
+
+int WINAPI WinMain(HINSTANCE hInstance,
+                   HINSTANCE hPrevInstance,
+                   LPSTR lpCmdLine,
+                   int nCmdShow) {
+  return runD3D9Bench<FixedFunctionStateApp>(hInstance, nCmdShow,
+    L"D3D9 fixed-function state benchmark");
+}
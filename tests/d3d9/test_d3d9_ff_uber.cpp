@@ -0,0 +1,373 @@
+#include <array>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+#include "test_d3d9_bench.h"
+
+using namespace dxvk;
+
+struct Vertex {
+  float     x, y, z;
+  float     nx, ny, nz;
+  D3DCOLOR  diffuse;
+  D3DCOLOR  specular;
+  float     u, v, w;
+};
+
+/**
+ * \brief Fixed-function key pattern
+ *
+ * Each pattern draws one quad per grid cell, and every
+ * cell uses a different fixed-function shader key. All
+ * keys are new in the first frame of the first run, so
+ * with \c d3d9.ffUberShaders enabled, that frame is drawn
+ * with the uber shaders while the specialized shaders
+ * are still being compiled. By the last frame of a run,
+ * all specialized shaders are in use.
+ *
+ * The first and last frame checksums must match, and
+ * the last frame checksum must match the one printed
+ * with \c d3d9.ffUberShaders disabled. Keys that use ops
+ * the uber shaders do not implement are not drawn.
+ */
+enum class KeyPattern : uint32_t {
+  StageOps,
+  StageArgs,
+  VertexState,
+  Count,
+};
+
+const char* getKeyPatternName(KeyPattern pattern) {
+  switch (pattern) {
+    case KeyPattern::StageOps:    return "stage ops";
+    case KeyPattern::StageArgs:   return "stage args";
+    case KeyPattern::VertexState: return "vertex state";
+    default:                      return "?";
+  }
+}
+
+// Same ops as the uber pixel shader implements
+const std::array<D3DTEXTUREOP, 21> StageOps = {
+  D3DTOP_SELECTARG1,              D3DTOP_SELECTARG2,
+  D3DTOP_MODULATE,                D3DTOP_MODULATE2X,
+  D3DTOP_MODULATE4X,              D3DTOP_ADD,
+  D3DTOP_ADDSIGNED,               D3DTOP_ADDSIGNED2X,
+  D3DTOP_SUBTRACT,                D3DTOP_ADDSMOOTH,
+  D3DTOP_BLENDDIFFUSEALPHA,       D3DTOP_BLENDTEXTUREALPHA,
+  D3DTOP_BLENDFACTORALPHA,        D3DTOP_BLENDCURRENTALPHA,
+  D3DTOP_MODULATEALPHA_ADDCOLOR,  D3DTOP_MODULATECOLOR_ADDALPHA,
+  D3DTOP_MODULATEINVALPHA_ADDCOLOR, D3DTOP_MODULATEINVCOLOR_ADDALPHA,
+  D3DTOP_DOTPRODUCT3,             D3DTOP_MULTIPLYADD,
+  D3DTOP_LERP,
+};
+
+const std::array<DWORD, 6> StageSources = {
+  D3DTA_CURRENT,  D3DTA_DIFFUSE,  D3DTA_SPECULAR,
+  D3DTA_TEMP,     D3DTA_TEXTURE,  D3DTA_TFACTOR,
+};
+
+const std::array<DWORD, 4> StageModifiers = {
+  0, D3DTA_COMPLEMENT, D3DTA_ALPHAREPLICATE,
+  D3DTA_COMPLEMENT | D3DTA_ALPHAREPLICATE,
+};
+
+constexpr uint32_t GridW          = 7;
+constexpr uint32_t GridH          = 6;
+constexpr uint32_t DrawsPerFrame  = GridW * GridH;
+
+class FixedFunctionUberApp : public D3D9BenchApp {
+
+public:
+
+  FixedFunctionUberApp(HWND window)
+  : D3D9BenchApp(window, uint32_t(KeyPattern::Count), DrawsPerFrame) {
+    std::vector<Vertex> vertices;
+
+    for (uint32_t i = 0; i < DrawsPerFrame; i++) {
+      uint32_t x = i % GridW;
+      uint32_t y = i / GridW;
+
+      float x0 = -1.0f + 2.0f * float(x    ) / float(GridW);
+      float x1 = -1.0f + 2.0f * float(x + 1) / float(GridW);
+      float y0 = -1.0f + 2.0f * float(y    ) / float(GridH);
+      float y1 = -1.0f + 2.0f * float(y + 1) / float(GridH);
+
+      // Normals are not unit length, so that
+      // D3DRS_NORMALIZENORMALS makes a difference
+      vertices.push_back({ x0, y0, 0.5f,  -0.5f, -0.5f, -1.5f,  D3DCOLOR_RGBA(255,  64,   0, 255), D3DCOLOR_RGBA( 32,  32, 128, 255),  0.0f, 0.0f, 1.0f });
+      vertices.push_back({ x1, y0, 0.5f,   0.5f, -0.5f, -1.5f,  D3DCOLOR_RGBA( 64, 255,   0, 192), D3DCOLOR_RGBA(128,  32,  32, 128),  2.0f, 0.0f, 2.0f });
+      vertices.push_back({ x0, y1, 0.5f,  -0.5f,  0.5f, -1.5f,  D3DCOLOR_RGBA(  0,  64, 255, 128), D3DCOLOR_RGBA( 32, 128,  32,  64),  0.0f, 2.0f, 2.0f });
+      vertices.push_back({ x1, y1, 0.5f,   0.5f,  0.5f, -1.5f,  D3DCOLOR_RGBA(255, 255, 255,  64), D3DCOLOR_RGBA(128, 128, 128,   0),  2.0f, 2.0f, 1.0f });
+    }
+
+    const size_t vbSize = vertices.size() * sizeof(Vertex);
+
+    HRESULT status = m_device->CreateVertexBuffer(vbSize, 0, 0, D3DPOOL_DEFAULT, &m_vb, nullptr);
+    if (FAILED(status))
+      throw DxvkError("Failed to create vertex buffer");
+
+    void* data = nullptr;
+    status = m_vb->Lock(0, 0, &data, 0);
+    if (FAILED(status))
+      throw DxvkError("Failed to lock vertex buffer");
+
+    std::memcpy(data, vertices.data(), vbSize);
+
+    status = m_vb->Unlock();
+    if (FAILED(status))
+      throw DxvkError("Failed to unlock vertex buffer");
+
+    status = m_device->CreateTexture(TextureSize, TextureSize, 1, 0,
+      D3DFMT_A8R8G8B8, D3DPOOL_MANAGED, &m_texture, nullptr);
+    if (FAILED(status))
+      throw DxvkError("Failed to create texture");
+
+    D3DLOCKED_RECT rect;
+    status = m_texture->LockRect(0, &rect, nullptr, 0);
+    if (FAILED(status))
+      throw DxvkError("Failed to lock texture");
+
+    for (uint32_t y = 0; y < TextureSize; y++) {
+      auto row = reinterpret_cast<uint32_t*>(
+        reinterpret_cast<char*>(rect.pBits) + y * rect.Pitch);
+
+      for (uint32_t x = 0; x < TextureSize; x++) {
+        uint32_t checker = ((x / 8) ^ (y / 8)) & 1;
+        row[x] = D3DCOLOR_RGBA(x * 4, y * 4, checker ? 255 : 32, (x + y) * 2);
+      }
+    }
+
+    status = m_texture->UnlockRect(0);
+    if (FAILED(status))
+      throw DxvkError("Failed to unlock texture");
+  }
+
+protected:
+
+  const char* getPatternName(uint32_t pattern) const {
+    return getKeyPatternName(KeyPattern(pattern));
+  }
+
+  void drawFrame(uint32_t pattern) {
+    m_device->SetStreamSource(0, m_vb.ptr(), 0, sizeof(Vertex));
+    m_device->SetFVF(D3DFVF_XYZ | D3DFVF_NORMAL | D3DFVF_DIFFUSE
+      | D3DFVF_SPECULAR | D3DFVF_TEX1 | D3DFVF_TEXCOORDSIZE3(0));
+
+    for (uint32_t i = 0; i < DrawsPerFrame; i++) {
+      setDefaultStates();
+
+      switch (KeyPattern(pattern)) {
+        case KeyPattern::StageOps:    setStageOpStates(i);    break;
+        case KeyPattern::StageArgs:   setStageArgStates(i);   break;
+        case KeyPattern::VertexState: setVertexStates(i);     break;
+        default: break;
+      }
+
+      m_device->DrawPrimitive(D3DPT_TRIANGLESTRIP, 4 * i, 2);
+    }
+
+    if (!m_frameId++)
+      m_firstChecksum = getBackBufferChecksum();
+  }
+
+  std::string getPatternResults(uint32_t pattern) {
+    uint32_t lastChecksum = getBackBufferChecksum();
+    m_frameId = 0;
+
+    std::stringstream str;
+    str << std::hex << std::setfill('0')
+        << "first frame 0x" << std::setw(8) << m_firstChecksum
+        << ", last frame 0x" << std::setw(8) << lastChecksum
+        << (m_firstChecksum == lastChecksum ? ", match" : ", MISMATCH");
+    return str.str();
+  }
+
+private:
+
+  static constexpr uint32_t TextureSize = 64;
+
+  Com<IDirect3DVertexBuffer9>   m_vb;
+  Com<IDirect3DTexture9>        m_texture;
+
+  uint32_t                      m_frameId       = 0;
+  uint32_t                      m_firstChecksum = 0;
+
+  void setDefaultStates() {
+    m_device->SetRenderState(D3DRS_LIGHTING,          FALSE);
+    m_device->SetRenderState(D3DRS_CULLMODE,          D3DCULL_NONE);
+    m_device->SetRenderState(D3DRS_NORMALIZENORMALS,  FALSE);
+    m_device->SetRenderState(D3DRS_LOCALVIEWER,       FALSE);
+    m_device->SetRenderState(D3DRS_SPECULARENABLE,    FALSE);
+    m_device->SetRenderState(D3DRS_DIFFUSEMATERIALSOURCE, D3DMCS_COLOR1);
+    m_device->SetRenderState(D3DRS_FOGENABLE,         FALSE);
+    m_device->SetRenderState(D3DRS_TEXTUREFACTOR,     D3DCOLOR_RGBA(96, 160, 224, 128));
+
+    // Blend over the clear colour so that the alpha
+    // results of all stages affect the checksum
+    m_device->SetRenderState(D3DRS_ALPHABLENDENABLE,  TRUE);
+    m_device->SetRenderState(D3DRS_SRCBLEND,          D3DBLEND_SRCALPHA);
+    m_device->SetRenderState(D3DRS_DESTBLEND,         D3DBLEND_INVSRCALPHA);
+
+    for (uint32_t i = 0; i < 2; i++) {
+      m_device->SetTexture(i, m_texture.ptr());
+
+      m_device->SetTextureStageState(i, D3DTSS_COLORARG0,     D3DTA_CURRENT);
+      m_device->SetTextureStageState(i, D3DTSS_COLORARG1,     D3DTA_TEXTURE);
+      m_device->SetTextureStageState(i, D3DTSS_COLORARG2,     D3DTA_CURRENT);
+      m_device->SetTextureStageState(i, D3DTSS_ALPHAARG0,     D3DTA_CURRENT);
+      m_device->SetTextureStageState(i, D3DTSS_ALPHAARG1,     D3DTA_TEXTURE);
+      m_device->SetTextureStageState(i, D3DTSS_ALPHAARG2,     D3DTA_CURRENT);
+      m_device->SetTextureStageState(i, D3DTSS_RESULTARG,     D3DTA_CURRENT);
+      m_device->SetTextureStageState(i, D3DTSS_TEXCOORDINDEX, 0);
+      m_device->SetTextureStageState(i, D3DTSS_TEXTURETRANSFORMFLAGS, D3DTTFF_DISABLE);
+    }
+
+    m_device->SetTextureStageState(0, D3DTSS_COLOROP, D3DTOP_MODULATE);
+    m_device->SetTextureStageState(0, D3DTSS_ALPHAOP, D3DTOP_MODULATE);
+    m_device->SetTextureStageState(0, D3DTSS_COLORARG2, D3DTA_DIFFUSE);
+    m_device->SetTextureStageState(0, D3DTSS_ALPHAARG2, D3DTA_DIFFUSE);
+    m_device->SetTextureStageState(1, D3DTSS_COLOROP, D3DTOP_DISABLE);
+    m_device->SetTextureStageState(1, D3DTSS_ALPHAOP, D3DTOP_DISABLE);
+  }
+
+  void setStageOpStates(uint32_t cell) {
+    // The first half of the cells only use stage 0,
+    // the second half chains a second stage onto it
+    uint32_t n = StageOps.size();
+
+    m_device->SetTextureStageState(0, D3DTSS_COLOROP,   StageOps[cell % n]);
+    m_device->SetTextureStageState(0, D3DTSS_COLORARG0, D3DTA_SPECULAR);
+    m_device->SetTextureStageState(0, D3DTSS_ALPHAOP,   StageOps[(cell + 7) % n]);
+    m_device->SetTextureStageState(0, D3DTSS_ALPHAARG2, D3DTA_TFACTOR);
+    m_device->SetTextureStageState(0, D3DTSS_ALPHAARG0, D3DTA_DIFFUSE);
+
+    if (cell >= n) {
+      m_device->SetTextureStageState(1, D3DTSS_COLOROP,   StageOps[(cell * 5) % n]);
+      m_device->SetTextureStageState(1, D3DTSS_COLORARG1, D3DTA_TEXTURE | D3DTA_COMPLEMENT);
+      m_device->SetTextureStageState(1, D3DTSS_COLORARG0, D3DTA_TFACTOR);
+      m_device->SetTextureStageState(1, D3DTSS_ALPHAOP,   StageOps[(cell * 3) % n]);
+      m_device->SetTextureStageState(1, D3DTSS_ALPHAARG0, D3DTA_SPECULAR);
+    }
+  }
+
+  void setStageArgStates(uint32_t cell) {
+    uint32_t n = StageSources.size();
+
+    if (cell < n * StageModifiers.size()) {
+      // Every source with every modifier, read by stage 0
+      m_device->SetTextureStageState(0, D3DTSS_COLOROP,   D3DTOP_SELECTARG1);
+      m_device->SetTextureStageState(0, D3DTSS_COLORARG1, StageSources[cell % n] | StageModifiers[cell / n]);
+      m_device->SetTextureStageState(0, D3DTSS_ALPHAOP,   D3DTOP_SELECTARG1);
+      m_device->SetTextureStageState(0, D3DTSS_ALPHAARG1, StageSources[(cell + 3) % n]
+        | StageModifiers[(cell / n + 1) % StageModifiers.size()]);
+    } else {
+      // Stage 0 writes to the temp register, which
+      // stage 1 then combines with the current one
+      static const std::array<D3DTEXTUREOP, 6> ops = {
+        D3DTOP_ADD,       D3DTOP_LERP,        D3DTOP_MULTIPLYADD,
+        D3DTOP_SUBTRACT,  D3DTOP_DOTPRODUCT3, D3DTOP_BLENDCURRENTALPHA,
+      };
+
+      static const std::array<DWORD, 3> arg0 = {
+        D3DTA_TEMP | D3DTA_ALPHAREPLICATE, D3DTA_TFACTOR, D3DTA_SPECULAR,
+      };
+
+      uint32_t i = cell - n * StageModifiers.size();
+
+      m_device->SetTextureStageState(0, D3DTSS_RESULTARG, D3DTA_TEMP);
+
+      m_device->SetTextureStageState(1, D3DTSS_COLOROP,   ops[i % ops.size()]);
+      m_device->SetTextureStageState(1, D3DTSS_COLORARG0, arg0[(i / ops.size()) % arg0.size()]);
+      m_device->SetTextureStageState(1, D3DTSS_COLORARG1, D3DTA_DIFFUSE);
+      m_device->SetTextureStageState(1, D3DTSS_COLORARG2, D3DTA_TEMP);
+      m_device->SetTextureStageState(1, D3DTSS_ALPHAOP,   ops[(i + 1) % ops.size()]);
+      m_device->SetTextureStageState(1, D3DTSS_ALPHAARG0, D3DTA_TEMP);
+      m_device->SetTextureStageState(1, D3DTSS_ALPHAARG1, D3DTA_DIFFUSE);
+      m_device->SetTextureStageState(1, D3DTSS_ALPHAARG2, D3DTA_TEMP | D3DTA_COMPLEMENT);
+    }
+  }
+
+  void setVertexStates(uint32_t cell) {
+    // Each bit of the cell index toggles one state
+    bool lighting = cell & 1;
+
+    m_device->SetRenderState(D3DRS_LIGHTING,          lighting);
+    m_device->SetRenderState(D3DRS_NORMALIZENORMALS,  (cell >> 1) & 1);
+    m_device->SetRenderState(D3DRS_LOCALVIEWER,       (cell >> 2) & 1);
+    m_device->SetRenderState(D3DRS_SPECULARENABLE,    (cell >> 3) & 1);
+    m_device->SetRenderState(D3DRS_DIFFUSEMATERIALSOURCE, (cell >> 4) % 3);
+
+    if (lighting) {
+      D3DMATERIAL9 material = { };
+      material.Diffuse  = { 0.8f, 0.6f, 0.4f, 0.75f };
+      material.Ambient  = { 0.1f, 0.2f, 0.3f, 1.0f };
+      material.Specular = { 1.0f, 1.0f, 1.0f, 1.0f };
+      material.Emissive = { 0.0f, 0.1f, 0.0f, 0.0f };
+      material.Power    = 8.0f;
+      m_device->SetMaterial(&material);
+
+      D3DLIGHT9 light = { };
+      light.Type      = D3DLIGHT_DIRECTIONAL;
+      light.Diffuse   = { 1.0f, 0.9f, 0.8f, 1.0f };
+      light.Specular  = { 0.5f, 0.5f, 0.5f, 1.0f };
+      light.Ambient   = { 0.2f, 0.2f, 0.2f, 1.0f };
+      light.Direction = { 0.3f, -0.2f, 1.0f };
+      m_device->SetLight(0, &light);
+      m_device->LightEnable(0, TRUE);
+
+      light.Type        = D3DLIGHT_POINT;
+      light.Diffuse     = { 0.2f, 0.4f, 1.0f, 1.0f };
+      light.Position    = { 0.5f, 0.5f, -1.0f };
+      light.Range       = 10.0f;
+      light.Attenuation0 = 1.0f;
+      m_device->SetLight(1, &light);
+      m_device->LightEnable(1, (cell % 5) < 2);
+    }
+
+    // Cycle through the texture coordinate
+    // transforms and generation modes
+    D3DMATRIX transform = { {
+      0.5f, 0.0f, 0.0f, 0.0f,
+      0.0f, 0.5f, 0.0f, 0.0f,
+      0.0f, 0.0f, 1.0f, 0.0f,
+      0.1f, 0.2f, 0.0f, 1.0f,
+    } };
+    m_device->SetTransform(D3DTS_TEXTURE0, &transform);
+
+    static const std::array<DWORD, 3> transformFlags = {
+      D3DTTFF_DISABLE, D3DTTFF_COUNT2, D3DTTFF_COUNT3 | D3DTTFF_PROJECTED,
+    };
+
+    static const std::array<DWORD, 3> texcoordIndices = {
+      0, D3DTSS_TCI_CAMERASPACENORMAL, D3DTSS_TCI_CAMERASPACEPOSITION,
+    };
+
+    m_device->SetTextureStageState(0, D3DTSS_TEXTURETRANSFORMFLAGS, transformFlags[cell % 3]);
+    m_device->SetTextureStageState(0, D3DTSS_TEXCOORDINDEX, texcoordIndices[(cell / 3) % 3]);
+
+    // Fog uses the vertex fog path for the last cells
+    if (cell >= 32) {
+      float fogStart = 0.0f;
+      float fogEnd   = 2.0f;
+
+      m_device->SetRenderState(D3DRS_FOGENABLE,       TRUE);
+      m_device->SetRenderState(D3DRS_FOGCOLOR,        D3DCOLOR_RGBA(200, 200, 255, 255));
+      m_device->SetRenderState(D3DRS_FOGTABLEMODE,    D3DFOG_NONE);
+      m_device->SetRenderState(D3DRS_FOGVERTEXMODE,   D3DFOG_LINEAR);
+      m_device->SetRenderState(D3DRS_FOGSTART,        *reinterpret_cast<DWORD*>(&fogStart));
+      m_device->SetRenderState(D3DRS_FOGEND,          *reinterpret_cast<DWORD*>(&fogEnd));
+      m_device->SetRenderState(D3DRS_RANGEFOGENABLE,  cell & 1);
+    }
+  }
+
+};
+
+int WINAPI WinMain(HINSTANCE hInstance,
+                   HINSTANCE hPrevInstance,
+                   LPSTR lpCmdLine,
+                   int nCmdShow) {
+  return runD3D9Bench<FixedFunctionUberApp>(hInstance, nCmdShow,
+    L"D3D9 fixed-function uber shader test");
+}
@@ -0,0 +1,285 @@
+#include <array>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+#include <d3dcompiler.h>
+
+#include "test_d3d9_bench.h"
+
+using namespace dxvk;
+
+struct Vertex {
+  float     x, y, z;
+  D3DCOLOR  color;
+};
+
+const std::string g_vertexShaderCode = R"(
+
+struct VS_INPUT {
+  float3 Position : POSITION;
+  float4 Color    : COLOR0;
+};
+
+struct VS_OUTPUT {
+  float4 Position : POSITION;
+  float4 Color    : COLOR0;
+};
+
+VS_OUTPUT main( VS_INPUT IN ) {
+  VS_OUTPUT OUT;
+  OUT.Position = float4(IN.Position, 1.0f);
+  OUT.Color    = IN.Color;
+  return OUT;
+}
+
+)";
+
+// Scaling by 0.5 is exact, so the result does not
+// depend on whether the driver unrolls the loop or
+// fuses the multiply and add
+const std::string g_pixelShaderCode = R"(
+
+int    g_count : register(i0);
+bool   g_swap  : register(b0);
+
+struct VS_OUTPUT {
+  float4 Position : POSITION;
+  float4 Color    : COLOR0;
+};
+
+float4 main( VS_OUTPUT IN ) : COLOR {
+  float4 color = IN.Color;
+
+  [loop] for (int i = 0; i < g_count; i++)
+    color = color * 0.5f + TINT;
+
+  [branch] if (g_swap)
+    color = color.bgra;
+
+  return color;
+}
+
+)";
+
+/**
+ * \brief Constant value pattern
+ *
+ * Each pattern uses its own pixel shader, which reads
+ * a loop count from \c i0 and a branch condition from
+ * \c b0, and sets these registers before every draw.
+ * The values either never change, cycle through as
+ * many combinations as a shader keeps variants for,
+ * or cycle through more, so that variants keep being
+ * evicted until specialization is disabled for the
+ * shader. The log reports when that happens.
+ *
+ * The first frame of each pattern's first run is drawn
+ * while the variants are still being compiled. The first and
+ * last frame checksums must match, and the last frame
+ * checksum must match the one printed with
+ * \c d3d9.specializeIntBoolConstants disabled.
+ */
+enum class ValuePattern : uint32_t {
+  Static,
+  FewValues,
+  ManyValues,
+  Count,
+};
+
+const char* getValuePatternName(ValuePattern pattern) {
+  switch (pattern) {
+    case ValuePattern::Static:      return "static";
+    case ValuePattern::FewValues:   return "few values";
+    case ValuePattern::ManyValues:  return "many values";
+    default:                        return "?";
+  }
+}
+
+const char* getValuePatternExpectation(ValuePattern pattern) {
+  switch (pattern) {
+    case ValuePattern::Static:      return "1 variant";
+    case ValuePattern::FewValues:   return "8 variants, no evictions";
+    case ValuePattern::ManyValues:  return "specialization disabled";
+    default:                        return "?";
+  }
+}
+
+constexpr uint32_t GridW          = 40;
+constexpr uint32_t GridH          = 25;
+constexpr uint32_t DrawsPerFrame  = GridW * GridH;
+
+class IntBoolConstantsApp : public D3D9BenchApp {
+
+public:
+
+  IntBoolConstantsApp(HWND window)
+  : D3D9BenchApp(window, uint32_t(ValuePattern::Count), DrawsPerFrame) {
+    Com<ID3DBlob> blob;
+
+    HRESULT status = D3DCompile(
+      g_vertexShaderCode.data(),
+      g_vertexShaderCode.length(),
+      nullptr, nullptr, nullptr,
+      "main",
+      "vs_3_0",
+      0, 0, &blob,
+      nullptr);
+
+    if (FAILED(status))
+      throw DxvkError("Failed to compile vertex shader");
+
+    status = m_device->CreateVertexShader(reinterpret_cast<const DWORD*>(blob->GetBufferPointer()), &m_vs);
+
+    if (FAILED(status))
+      throw DxvkError("Failed to create vertex shader");
+
+    // Shaders with identical bytecode share their variants,
+    // so give each pattern a slightly different shader
+    static const std::array<const char*, uint32_t(ValuePattern::Count)> tints = {
+      "float4(0.25f, 0.0f, 0.0f, 0.0f)",
+      "float4(0.0f, 0.25f, 0.0f, 0.0f)",
+      "float4(0.0f, 0.0f, 0.25f, 0.0f)",
+    };
+
+    for (uint32_t i = 0; i < m_ps.size(); i++) {
+      std::array<D3D_SHADER_MACRO, 2> macros = {{
+        { "TINT", tints[i] },
+        { nullptr, nullptr },
+      }};
+
+      Com<ID3DBlob> psBlob;
+
+      status = D3DCompile(
+        g_pixelShaderCode.data(),
+        g_pixelShaderCode.length(),
+        nullptr, macros.data(), nullptr,
+        "main",
+        "ps_3_0",
+        0, 0, &psBlob,
+        nullptr);
+
+      if (FAILED(status))
+        throw DxvkError("Failed to compile pixel shader");
+
+      status = m_device->CreatePixelShader(reinterpret_cast<const DWORD*>(psBlob->GetBufferPointer()), &m_ps[i]);
+
+      if (FAILED(status))
+        throw DxvkError("Failed to create pixel shader");
+    }
+
+    std::vector<Vertex> vertices;
+
+    for (uint32_t i = 0; i < DrawsPerFrame; i++) {
+      uint32_t x = i % GridW;
+      uint32_t y = i / GridW;
+
+      float x0 = -1.0f + 2.0f * float(x    ) / float(GridW);
+      float x1 = -1.0f + 2.0f * float(x + 1) / float(GridW);
+      float y0 = -1.0f + 2.0f * float(y    ) / float(GridH);
+      float y1 = -1.0f + 2.0f * float(y + 1) / float(GridH);
+
+      D3DCOLOR color = D3DCOLOR_RGBA((x * 6) & 0xFF, (y * 10) & 0xFF, (i * 7) & 0xFF, 255);
+
+      vertices.push_back({ x0, y0, 0.0f, color });
+      vertices.push_back({ x1, y0, 0.0f, color });
+      vertices.push_back({ x0, y1, 0.0f, color });
+      vertices.push_back({ x1, y1, 0.0f, color });
+    }
+
+    const size_t vbSize = vertices.size() * sizeof(Vertex);
+
+    status = m_device->CreateVertexBuffer(vbSize, 0, 0, D3DPOOL_DEFAULT, &m_vb, nullptr);
+    if (FAILED(status))
+      throw DxvkError("Failed to create vertex buffer");
+
+    void* data = nullptr;
+    status = m_vb->Lock(0, 0, &data, 0);
+    if (FAILED(status))
+      throw DxvkError("Failed to lock vertex buffer");
+
+    std::memcpy(data, vertices.data(), vbSize);
+
+    status = m_vb->Unlock();
+    if (FAILED(status))
+      throw DxvkError("Failed to unlock vertex buffer");
+  }
+
+protected:
+
+  const char* getPatternName(uint32_t pattern) const {
+    return getValuePatternName(ValuePattern(pattern));
+  }
+
+  void drawFrame(uint32_t pattern) {
+    m_device->SetRenderState(D3DRS_CULLMODE, D3DCULL_NONE);
+
+    m_device->SetFVF(D3DFVF_XYZ | D3DFVF_DIFFUSE);
+    m_device->SetStreamSource(0, m_vb.ptr(), 0, sizeof(Vertex));
+    m_device->SetVertexShader(m_vs.ptr());
+    m_device->SetPixelShader(m_ps[pattern].ptr());
+
+    for (uint32_t i = 0; i < DrawsPerFrame; i++) {
+      uint32_t count = 3;
+      BOOL     swap  = TRUE;
+
+      switch (ValuePattern(pattern)) {
+        case ValuePattern::FewValues:
+          count = i % 4;
+          swap  = (i / 4) & 1;
+          break;
+
+        case ValuePattern::ManyValues:
+          count = i % 12;
+          swap  = (i / 12) & 1;
+          break;
+
+        default:
+          break;
+      }
+
+      // Loop registers hold the count, start and step
+      std::array<int, 4> loop = { int(count), 0, 1, 0 };
+
+      m_device->SetPixelShaderConstantI(0, loop.data(), 1);
+      m_device->SetPixelShaderConstantB(0, &swap, 1);
+      m_device->DrawPrimitive(D3DPT_TRIANGLESTRIP, 4 * i, 2);
+    }
+
+    if (!m_frameId++)
+      m_firstChecksum = getBackBufferChecksum();
+  }
+
+  std::string getPatternResults(uint32_t pattern) {
+    uint32_t lastChecksum = getBackBufferChecksum();
+    m_frameId = 0;
+
+    std::stringstream str;
+    str << std::hex << std::setfill('0')
+        << "first frame 0x" << std::setw(8) << m_firstChecksum
+        << ", last frame 0x" << std::setw(8) << lastChecksum
+        << (m_firstChecksum == lastChecksum ? ", match" : ", MISMATCH")
+        << ", expected " << getValuePatternExpectation(ValuePattern(pattern));
+    return str.str();
+  }
+
+private:
+
+  Com<IDirect3DVertexShader9>   m_vs;
+  Com<IDirect3DVertexBuffer9>   m_vb;
+
+  std::array<Com<IDirect3DPixelShader9>, uint32_t(ValuePattern::Count)> m_ps;
+
+  uint32_t                      m_frameId       = 0;
+  uint32_t                      m_firstChecksum = 0;
+
+};
+
+int WINAPI WinMain(HINSTANCE hInstance,
+                   HINSTANCE hPrevInstance,
+                   LPSTR lpCmdLine,
+                   int nCmdShow) {
+  return runD3D9Bench<IntBoolConstantsApp>(hInstance, nCmdShow,
+    L"D3D9 int and bool constant specialization test");
+}
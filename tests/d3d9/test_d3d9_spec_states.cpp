@@ -0,0 +1,223 @@
+#include <array>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+#include "test_d3d9_bench.h"
+
+using namespace dxvk;
+
+struct Vertex {
+  float     x, y, z;
+  D3DCOLOR  color;
+};
+
+/**
+ * \brief Render state pattern
+ *
+ * Each pattern draws one quad per grid cell and changes
+ * the alpha test function, the fog modes or both before
+ * every draw, which mimics engines that sort draws by
+ * material rather than by state. With spec constants,
+ * every combination needs its own pipeline.
+ *
+ * With \c d3d9.adaptiveSpecConstants enabled, groups that
+ * change at least eight times in a frame are switched to
+ * dynamic values at the end of that frame, and stay
+ * dynamic until they have not changed for 600 frames.
+ * Once a group is dynamic, the graphics pipeline count
+ * in the HUD (\c DXVK_HUD=pipelines) should stop growing,
+ * and the avoided variant count should grow by the
+ * expected amount printed for the pattern each frame.
+ *
+ * The first frame of the first run uses spec constants
+ * and the last one dynamic values, so the first and last
+ * frame checksums must match. The last frame checksum
+ * must also match the one printed with the option
+ * disabled.
+ */
+enum class StatePattern : uint32_t {
+  Static,
+  AlphaFunc,
+  FogMode,
+  AlphaFuncAndFogMode,
+  Count,
+};
+
+const char* getStatePatternName(StatePattern pattern) {
+  switch (pattern) {
+    case StatePattern::Static:              return "static";
+    case StatePattern::AlphaFunc:           return "alpha func";
+    case StatePattern::FogMode:             return "fog mode";
+    case StatePattern::AlphaFuncAndFogMode: return "alpha func and fog mode";
+    default:                                return "?";
+  }
+}
+
+const std::array<D3DCMPFUNC, 4> AlphaFuncs = {
+  D3DCMP_GREATER, D3DCMP_LESS, D3DCMP_GREATEREQUAL, D3DCMP_NOTEQUAL,
+};
+
+// Table fog takes precedence over vertex fog
+const std::array<std::pair<D3DFOGMODE, D3DFOGMODE>, 6> FogModes = {{
+  { D3DFOG_NONE,    D3DFOG_NONE   },
+  { D3DFOG_LINEAR,  D3DFOG_NONE   },
+  { D3DFOG_EXP,     D3DFOG_NONE   },
+  { D3DFOG_EXP2,    D3DFOG_NONE   },
+  { D3DFOG_NONE,    D3DFOG_LINEAR },
+  { D3DFOG_NONE,    D3DFOG_EXP    },
+}};
+
+constexpr uint32_t GridW          = 40;
+constexpr uint32_t GridH          = 25;
+constexpr uint32_t DrawsPerFrame  = GridW * GridH;
+
+class SpecStatesApp : public D3D9BenchApp {
+
+public:
+
+  SpecStatesApp(HWND window)
+  : D3D9BenchApp(window, uint32_t(StatePattern::Count), DrawsPerFrame) {
+    std::vector<Vertex> vertices;
+
+    for (uint32_t i = 0; i < DrawsPerFrame; i++) {
+      uint32_t x = i % GridW;
+      uint32_t y = i / GridW;
+
+      float x0 = -1.0f + 2.0f * float(x    ) / float(GridW);
+      float x1 = -1.0f + 2.0f * float(x + 1) / float(GridW);
+      float y0 = -1.0f + 2.0f * float(y    ) / float(GridH);
+      float y1 = -1.0f + 2.0f * float(y + 1) / float(GridH);
+
+      // Alpha and depth vary across each quad, so that
+      // both alpha test and fog cut through every cell
+      D3DCOLOR c0 = D3DCOLOR_RGBA((x * 6) & 0xFF, (y * 10) & 0xFF, 128,   0);
+      D3DCOLOR c1 = D3DCOLOR_RGBA((x * 6) & 0xFF, (y * 10) & 0xFF, 128, 255);
+
+      vertices.push_back({ x0, y0, 0.1f, c0 });
+      vertices.push_back({ x1, y0, 0.5f, c0 });
+      vertices.push_back({ x0, y1, 0.5f, c1 });
+      vertices.push_back({ x1, y1, 0.9f, c1 });
+    }
+
+    const size_t vbSize = vertices.size() * sizeof(Vertex);
+
+    HRESULT status = m_device->CreateVertexBuffer(vbSize, 0, 0, D3DPOOL_DEFAULT, &m_vb, nullptr);
+    if (FAILED(status))
+      throw DxvkError("Failed to create vertex buffer");
+
+    void* data = nullptr;
+    status = m_vb->Lock(0, 0, &data, 0);
+    if (FAILED(status))
+      throw DxvkError("Failed to lock vertex buffer");
+
+    std::memcpy(data, vertices.data(), vbSize);
+
+    status = m_vb->Unlock();
+    if (FAILED(status))
+      throw DxvkError("Failed to unlock vertex buffer");
+  }
+
+protected:
+
+  const char* getPatternName(uint32_t pattern) const {
+    return getStatePatternName(StatePattern(pattern));
+  }
+
+  void drawFrame(uint32_t pattern) {
+    // Device resets discard all state, so set it every frame
+    setStates();
+
+    bool alphaFunc = StatePattern(pattern) == StatePattern::AlphaFunc
+                  || StatePattern(pattern) == StatePattern::AlphaFuncAndFogMode;
+    bool fogMode   = StatePattern(pattern) == StatePattern::FogMode
+                  || StatePattern(pattern) == StatePattern::AlphaFuncAndFogMode;
+
+    for (uint32_t i = 0; i < DrawsPerFrame; i++) {
+      if (alphaFunc)
+        m_device->SetRenderState(D3DRS_ALPHAFUNC, AlphaFuncs[i % AlphaFuncs.size()]);
+
+      if (fogMode) {
+        const auto& modes = FogModes[i % FogModes.size()];
+        m_device->SetRenderState(D3DRS_FOGTABLEMODE,  modes.first);
+        m_device->SetRenderState(D3DRS_FOGVERTEXMODE, modes.second);
+      }
+
+      m_device->DrawPrimitive(D3DPT_TRIANGLESTRIP, 4 * i, 2);
+    }
+
+    if (!m_frameId++)
+      m_firstChecksum = getBackBufferChecksum();
+  }
+
+  std::string getPatternResults(uint32_t pattern) {
+    uint32_t lastChecksum = getBackBufferChecksum();
+    m_frameId = 0;
+
+    // Every draw uses different values than the previous
+    // one, so every draw avoids a pipeline variant
+    uint32_t expectedAvoided = 0;
+
+    if (StatePattern(pattern) == StatePattern::AlphaFunc
+     || StatePattern(pattern) == StatePattern::FogMode)
+      expectedAvoided = DrawsPerFrame;
+
+    if (StatePattern(pattern) == StatePattern::AlphaFuncAndFogMode)
+      expectedAvoided = 2 * DrawsPerFrame;
+
+    std::stringstream str;
+    str << std::hex << std::setfill('0')
+        << "first frame 0x" << std::setw(8) << m_firstChecksum
+        << ", last frame 0x" << std::setw(8) << lastChecksum
+        << (m_firstChecksum == lastChecksum ? ", match" : ", MISMATCH")
+        << std::dec << ", expected " << expectedAvoided << " avoided variants per frame";
+    return str.str();
+  }
+
+private:
+
+  Com<IDirect3DVertexBuffer9>   m_vb;
+
+  uint32_t                      m_frameId       = 0;
+  uint32_t                      m_firstChecksum = 0;
+
+  void setStates() {
+    float fogStart   = 0.2f;
+    float fogEnd     = 0.8f;
+    float fogDensity = 2.0f;
+
+    m_device->SetFVF(D3DFVF_XYZ | D3DFVF_DIFFUSE);
+    m_device->SetStreamSource(0, m_vb.ptr(), 0, sizeof(Vertex));
+
+    m_device->SetRenderState(D3DRS_LIGHTING,          FALSE);
+    m_device->SetRenderState(D3DRS_CULLMODE,          D3DCULL_NONE);
+
+    m_device->SetRenderState(D3DRS_ALPHATESTENABLE,   TRUE);
+    m_device->SetRenderState(D3DRS_ALPHAFUNC,         D3DCMP_GREATER);
+    m_device->SetRenderState(D3DRS_ALPHAREF,          128);
+
+    m_device->SetRenderState(D3DRS_FOGENABLE,         TRUE);
+    m_device->SetRenderState(D3DRS_FOGCOLOR,          D3DCOLOR_RGBA(220, 200, 255, 255));
+    m_device->SetRenderState(D3DRS_FOGTABLEMODE,      D3DFOG_LINEAR);
+    m_device->SetRenderState(D3DRS_FOGVERTEXMODE,     D3DFOG_NONE);
+    m_device->SetRenderState(D3DRS_FOGSTART,          *reinterpret_cast<DWORD*>(&fogStart));
+    m_device->SetRenderState(D3DRS_FOGEND,            *reinterpret_cast<DWORD*>(&fogEnd));
+    m_device->SetRenderState(D3DRS_FOGDENSITY,        *reinterpret_cast<DWORD*>(&fogDensity));
+
+    m_device->SetTextureStageState(0, D3DTSS_COLOROP,   D3DTOP_SELECTARG1);
+    m_device->SetTextureStageState(0, D3DTSS_COLORARG1, D3DTA_DIFFUSE);
+    m_device->SetTextureStageState(0, D3DTSS_ALPHAOP,   D3DTOP_SELECTARG1);
+    m_device->SetTextureStageState(0, D3DTSS_ALPHAARG1, D3DTA_DIFFUSE);
+    m_device->SetTextureStageState(1, D3DTSS_COLOROP,   D3DTOP_DISABLE);
+  }
+
+};
+
+int WINAPI WinMain(HINSTANCE hInstance,
+                   HINSTANCE hPrevInstance,
+                   LPSTR lpCmdLine,
+                   int nCmdShow) {
+  return runD3D9Bench<SpecStatesApp>(hInstance, nCmdShow,
+    L"D3D9 adaptive spec constant test");
+}
@@ -0,0 +1,503 @@
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "../../src/dxvk/dxvk_state_cache.h"
+
+#include <shellapi.h>
+#include <windows.h>
+#include <windowsx.h>
+
+namespace dxvk {
+  Logger Logger::s_instance("dxvk-cache-tool.log");
+}
+
+using namespace dxvk;
+
+constexpr size_t StreamBufferSize = 1 << 20;
+
+const char* g_stageNames[] = { "VS", "TCS", "TES", "GS", "FS", "CS" };
+
+
+struct Sha1HashFn {
+  size_t operator () (const Sha1Hash& hash) const {
+    return hash.dword(0);
+  }
+};
+
+
+/**
+ * \brief Returns shader key for a given stage slot
+ */
+const DxvkShaderKey& getStageKey(const DxvkStateCacheKey& key, uint32_t stage) {
+  const DxvkShaderKey* keys[] = { &key.vs, &key.tcs, &key.tes, &key.gs, &key.fs, &key.cs };
+  return *keys[stage];
+}
+
+
+/**
+ * \brief Sequential state cache reader
+ *
+ * Streams entries from a state cache file without
+ * keeping them in memory, so that very large cache
+ * files can be processed.
+ */
+class StateCacheReader {
+
+public:
+
+  StateCacheReader(const std::string& fileName)
+  : m_name(fileName), m_buffer(StreamBufferSize) {
+    m_file.rdbuf()->pubsetbuf(m_buffer.data(), m_buffer.size());
+    m_file.open(fileName, std::ios_base::binary);
+  }
+
+  bool open() {
+    if (!m_file) {
+      std::cerr << m_name << ": Failed to open file" << std::endl;
+      return false;
+    }
+
+    DxvkStateCacheHeader expected;
+
+    if (!DxvkStateCache::readCacheHeader(m_file, m_header)) {
+      std::cerr << m_name << ": Invalid state cache header" << std::endl;
+      return false;
+    }
+
+    if (m_header.version < 2 || m_header.version > expected.version) {
+      std::cerr << m_name << ": State cache version v" << m_header.version << " not supported" << std::endl;
+      return false;
+    }
+
+    size_t expectedSize = m_header.version <= 4
+      ? sizeof(DxvkStateCacheEntryV4)
+      : sizeof(DxvkStateCacheEntry);
+
+    if (m_header.entrySize != expectedSize) {
+      std::cerr << m_name << ": State cache entry size mismatch" << std::endl;
+      return false;
+    }
+
+    return true;
+  }
+
+  bool next(DxvkStateCacheEntry& entry) {
+    while (m_file) {
+      entry = DxvkStateCacheEntry();
+
+      if (DxvkStateCache::readCacheEntry(m_header.version, m_file, entry)) {
+        m_numEntries += 1;
+        return true;
+      } else if (m_file) {
+        m_numInvalid += 1;
+      }
+    }
+
+    return false;
+  }
+
+  uint32_t version() const {
+    return m_header.version;
+  }
+
+  size_t numEntries() const {
+    return m_numEntries;
+  }
+
+  size_t numInvalid() const {
+    return m_numInvalid;
+  }
+
+private:
+
+  std::string           m_name;
+  std::vector<char>     m_buffer;
+  std::ifstream         m_file;
+  DxvkStateCacheHeader  m_header;
+
+  size_t                m_numEntries = 0;
+  size_t                m_numInvalid = 0;
+
+};
+
+
+/**
+ * \brief Deduplicating state cache writer
+ *
+ * Writes entries in the current state cache format
+ * and drops entries that have already been written.
+ */
+class StateCacheWriter {
+
+public:
+
+  StateCacheWriter(const std::string& fileName)
+  : m_name(fileName), m_buffer(StreamBufferSize) {
+    m_file.rdbuf()->pubsetbuf(m_buffer.data(), m_buffer.size());
+    m_file.open(fileName, std::ios_base::binary | std::ios_base::trunc);
+
+    if (m_file)
+      DxvkStateCache::writeCacheHeader(m_file);
+  }
+
+  bool ok() const {
+    return bool(m_file);
+  }
+
+  void write(DxvkStateCacheEntry& entry) {
+    // Entries returned by the reader have their check sum
+    // cleared, so hashing them yields the file check sum
+    if (!m_hashes.insert(Sha1Hash::compute(entry)).second) {
+      m_numDuplicates += 1;
+      return;
+    }
+
+    DxvkStateCache::writeCacheEntry(m_file, entry);
+    m_numWritten += 1;
+  }
+
+  bool finish() {
+    m_file.flush();
+
+    if (!m_file) {
+      std::cerr << m_name << ": Failed to write file" << std::endl;
+      return false;
+    }
+
+    return true;
+  }
+
+  size_t numWritten() const {
+    return m_numWritten;
+  }
+
+  size_t numDuplicates() const {
+    return m_numDuplicates;
+  }
+
+private:
+
+  std::string         m_name;
+  std::vector<char>   m_buffer;
+  std::ofstream       m_file;
+
+  std::unordered_set<Sha1Hash, Sha1HashFn> m_hashes;
+
+  size_t              m_numWritten    = 0;
+  size_t              m_numDuplicates = 0;
+
+};
+
+
+/**
+ * \brief Reads shader key list
+ *
+ * Accepts one shader per line, either as a plain key
+ * such as \c VS_<sha1> or as a shader dump file name
+ * as written to \c DXVK_SHADER_DUMP_PATH, in which
+ * case the directory and extensions are stripped.
+ */
+bool readShaderList(const std::string& fileName, std::unordered_set<std::string>& keys) {
+  std::ifstream file(fileName);
+
+  if (!file) {
+    std::cerr << fileName << ": Failed to open file" << std::endl;
+    return false;
+  }
+
+  std::string line;
+
+  while (std::getline(file, line)) {
+    size_t start = line.find_last_of("/\\");
+    start = start != std::string::npos ? start + 1 : 0;
+
+    size_t end = line.find_first_of(". \t\r", start);
+    end = end != std::string::npos ? end : line.size();
+
+    if (end > start)
+      keys.insert(line.substr(start, end - start));
+  }
+
+  return true;
+}
+
+
+int mergeCaches(const std::string& output, const std::vector<std::string>& inputs) {
+  StateCacheWriter writer(output);
+
+  if (!writer.ok()) {
+    std::cerr << output << ": Failed to create file" << std::endl;
+    return 1;
+  }
+
+  size_t numInvalid = 0;
+
+  for (const auto& input : inputs) {
+    StateCacheReader reader(input);
+
+    if (!reader.open())
+      return 1;
+
+    DxvkStateCacheEntry entry;
+
+    while (reader.next(entry))
+      writer.write(entry);
+
+    std::cout << input << ": " << reader.numEntries() << " entries (v" << reader.version() << ")";
+
+    if (reader.numInvalid())
+      std::cout << ", " << reader.numInvalid() << " invalid";
+
+    std::cout << std::endl;
+    numInvalid += reader.numInvalid();
+  }
+
+  if (!writer.finish())
+    return 1;
+
+  std::cout << output << ": " << writer.numWritten() << " entries written, "
+            << writer.numDuplicates() << " duplicates and "
+            << numInvalid << " invalid entries dropped" << std::endl;
+  return 0;
+}
+
+
+int pruneCache(const std::string& output, const std::string& input, const std::string& shaderList) {
+  std::unordered_set<std::string> shaders;
+
+  if (!readShaderList(shaderList, shaders))
+    return 1;
+
+  StateCacheReader reader(input);
+
+  if (!reader.open())
+    return 1;
+
+  StateCacheWriter writer(output);
+
+  if (!writer.ok()) {
+    std::cerr << output << ": Failed to create file" << std::endl;
+    return 1;
+  }
+
+  const DxvkShaderKey nullKey;
+  std::unordered_map<DxvkShaderKey, bool, DxvkHash, DxvkEq> known;
+
+  DxvkStateCacheEntry entry;
+  size_t numPruned = 0;
+
+  while (reader.next(entry)) {
+    bool valid = true;
+
+    for (uint32_t i = 0; i < 6 && valid; i++) {
+      const DxvkShaderKey& key = getStageKey(entry.shaders, i);
+
+      if (key.eq(nullKey))
+        continue;
+
+      auto k = known.find(key);
+
+      if (k == known.end())
+        k = known.insert({ key, shaders.find(key.toString()) != shaders.end() }).first;
+
+      valid = k->second;
+    }
+
+    if (valid)
+      writer.write(entry);
+    else
+      numPruned += 1;
+  }
+
+  if (!writer.finish())
+    return 1;
+
+  std::cout << output << ": " << writer.numWritten() << " entries written, "
+            << numPruned << " entries with missing shaders, "
+            << writer.numDuplicates() << " duplicates and "
+            << reader.numInvalid() << " invalid entries dropped" << std::endl;
+  return 0;
+}
+
+
+int validateCaches(const std::vector<std::string>& inputs) {
+  int result = 0;
+
+  for (const auto& input : inputs) {
+    StateCacheReader reader(input);
+
+    if (!reader.open()) {
+      result = 1;
+      continue;
+    }
+
+    DxvkStateCacheEntry entry;
+
+    while (reader.next(entry))
+      continue;
+
+    DxvkStateCacheHeader current;
+
+    std::cout << input << ": v" << reader.version() << ", "
+              << reader.numEntries() << " valid, "
+              << reader.numInvalid() << " invalid entries";
+
+    if (reader.version() != current.version)
+      std::cout << " (outdated)";
+
+    std::cout << std::endl;
+
+    if (reader.numInvalid())
+      result = 1;
+  }
+
+  return result;
+}
+
+
+/**
+ * \brief Returns printable render pass format
+ *
+ * Formats are grouped by name, since the hash and compare
+ * functions of \c DxvkRenderPassFormat live in the main
+ * library, which this tool does not link against.
+ */
+std::string getFormatName(const DxvkRenderPassFormat& format) {
+  std::string name = str::format("samples ", uint32_t(format.sampleCount));
+
+  for (uint32_t i = 0; i < MaxNumRenderTargets; i++) {
+    if (format.color[i].format != VK_FORMAT_UNDEFINED)
+      name += str::format(", rt", i, " ", uint32_t(format.color[i].format));
+  }
+
+  if (format.depth.format != VK_FORMAT_UNDEFINED)
+    name += str::format(", ds ", uint32_t(format.depth.format));
+
+  return name;
+}
+
+
+int reportCache(const std::string& input) {
+  StateCacheReader reader(input);
+
+  if (!reader.open())
+    return 1;
+
+  const DxvkShaderKey nullKey;
+
+  std::unordered_set<Sha1Hash, Sha1HashFn> hashes;
+  std::unordered_set<DxvkShaderKey, DxvkHash, DxvkEq> stageShaders[6];
+  std::unordered_map<std::string, size_t> formats;
+
+  size_t stageEntries[6] = { };
+  size_t numGraphics   = 0;
+  size_t numCompute    = 0;
+  size_t numDuplicates = 0;
+
+  DxvkStateCacheEntry entry;
+
+  while (reader.next(entry)) {
+    if (!hashes.insert(Sha1Hash::compute(entry)).second) {
+      numDuplicates += 1;
+      continue;
+    }
+
+    for (uint32_t i = 0; i < 6; i++) {
+      const DxvkShaderKey& key = getStageKey(entry.shaders, i);
+
+      if (!key.eq(nullKey)) {
+        stageShaders[i].insert(key);
+        stageEntries[i] += 1;
+      }
+    }
+
+    if (entry.shaders.cs.eq(nullKey)) {
+      formats[getFormatName(entry.format)] += 1;
+      numGraphics += 1;
+    } else {
+      numCompute += 1;
+    }
+  }
+
+  std::cout << input << ": v" << reader.version() << std::endl
+            << "  Entries:    " << reader.numEntries() << std::endl
+            << "  Invalid:    " << reader.numInvalid() << std::endl
+            << "  Duplicates: " << numDuplicates << std::endl
+            << "  Graphics:   " << numGraphics << std::endl
+            << "  Compute:    " << numCompute << std::endl
+            << std::endl
+            << "Shader stages:" << std::endl;
+
+  for (uint32_t i = 0; i < 6; i++) {
+    if (stageEntries[i] == 0)
+      continue;
+
+    std::cout << "  " << g_stageNames[i] << ": "
+              << stageShaders[i].size() << " shaders, "
+              << stageEntries[i] << " entries" << std::endl;
+  }
+
+  std::vector<std::pair<std::string, size_t>> sortedFormats(
+    formats.begin(), formats.end());
+
+  std::sort(sortedFormats.begin(), sortedFormats.end(),
+    [] (const auto& a, const auto& b) { return a.second > b.second; });
+
+  std::cout << std::endl << "Render pass formats: " << sortedFormats.size() << std::endl;
+
+  for (const auto& f : sortedFormats)
+    std::cout << "  " << f.second << " entries: " << f.first << std::endl;
+
+  return 0;
+}
+
+
+void printUsage() {
+  std::cerr << "Usage:" << std::endl
+            << "  dxvk-cache-tool merge    output.dxvk-cache input.dxvk-cache..." << std::endl
+            << "  dxvk-cache-tool prune    output.dxvk-cache input.dxvk-cache shaders.txt" << std::endl
+            << "  dxvk-cache-tool validate input.dxvk-cache..." << std::endl
+            << "  dxvk-cache-tool report   input.dxvk-cache" << std::endl;
+}
+
+
+int WINAPI WinMain(HINSTANCE hInstance,
+                   HINSTANCE hPrevInstance,
+                   LPSTR lpCmdLine,
+                   int nCmdShow) {
+  int     argc = 0;
+  LPWSTR* argv = CommandLineToArgvW(
+    GetCommandLineW(), &argc);
+
+  std::vector<std::string> args;
+
+  for (int i = 1; i < argc; i++)
+    args.push_back(str::fromws(argv[i]));
+
+  if (args.size() < 2) {
+    printUsage();
+    return 1;
+  }
+
+  const std::string& command = args[0];
+
+  if (command == "merge" && args.size() >= 3)
+    return mergeCaches(args[1], std::vector<std::string>(args.begin() + 2, args.end()));
+
+  if (command == "prune" && args.size() == 4)
+    return pruneCache(args[1], args[2], args[3]);
+
+  if (command == "validate")
+    return validateCaches(std::vector<std::string>(args.begin() + 1, args.end()));
+
+  if (command == "report" && args.size() == 2)
+    return reportCache(args[1]);
+
+  printUsage();
+  return 1;
+}
@@ -0,0 +1,671 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../../src/dxbc/dxbc_module.h"
+#include "../../src/dxso/dxso_module.h"
+#include "../../src/dxso/dxso_tables.h"
+#include "../../src/dxvk/dxvk_shader.h"
+#include "../../src/spirv/spirv_compression.h"
+#include "../../src/spirv/spirv_optimizer.h"
+#include "../../src/util/thread.h"
+
+#include <shellapi.h>
+#include <windows.h>
+#include <windowsx.h>
+#include <psapi.h>
+
+namespace dxvk {
+  Logger Logger::s_instance("shader-bench.log");
+}
+
+using namespace dxvk;
+
+
+enum class ShaderType {
+  Dxbc, Dxso,
+};
+
+
+/**
+ * \brief Shader file to compile
+ */
+struct ShaderEntry {
+  std::string path;
+  ShaderType  type;
+};
+
+
+/**
+ * \brief Compilation result for a single shader
+ *
+ * The translation time is the best time out of
+ * all iterations, since that is the least noisy
+ * number to compare between runs.
+ */
+struct ShaderResult {
+  std::string stage     = "-";
+  std::string status    = "ok";
+  size_t      inputSize = 0;
+  size_t      spirvSize = 0;
+  uint64_t    timeUs    = ~0ull;
+  uint64_t    totalUs   = 0;
+  bool        structOk  = false;
+
+  size_t      compressedSize = 0;
+  size_t      legacySize     = 0;
+  uint64_t    decodeNs       = 0;
+  uint64_t    legacyDecodeNs = 0;
+};
+
+
+/**
+ * \brief Benchmark options
+ */
+struct BenchOptions {
+  uint32_t    numThreads  = 0;
+  uint32_t    iterations  = 1;
+  bool        optimize    = false;
+  bool        compression = false;
+  std::string outputFile;
+};
+
+
+/**
+ * \brief Number of decode runs per shader
+ *
+ * Decoding a single module takes a few microseconds
+ * at most, so take the best out of several runs.
+ */
+constexpr uint32_t DecodeIterations = 16;
+
+
+const char* getStageName(VkShaderStageFlagBits stage) {
+  switch (stage) {
+    case VK_SHADER_STAGE_VERTEX_BIT:                  return "VS";
+    case VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT:    return "HS";
+    case VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT: return "DS";
+    case VK_SHADER_STAGE_GEOMETRY_BIT:                return "GS";
+    case VK_SHADER_STAGE_FRAGMENT_BIT:                return "PS";
+    case VK_SHADER_STAGE_COMPUTE_BIT:                 return "CS";
+    default:                                          return "?";
+  }
+}
+
+
+bool hasExtension(const std::string& path, const std::string& ext) {
+  return path.size() > ext.size()
+      && path.compare(path.size() - ext.size(), ext.size(), ext) == 0;
+}
+
+
+/**
+ * \brief Collects shader files
+ *
+ * Recursively searches the given directory for
+ * \c .dxbc and \c .dxso files, as they are written
+ * by \c DXVK_SHADER_DUMP_PATH. Regular files are
+ * added directly if their extension matches.
+ */
+void findShaders(const std::string& path, std::vector<ShaderEntry>& entries) {
+  if (hasExtension(path, ".dxbc")) {
+    entries.push_back({ path, ShaderType::Dxbc });
+    return;
+  }
+
+  if (hasExtension(path, ".dxso")) {
+    entries.push_back({ path, ShaderType::Dxso });
+    return;
+  }
+
+  WIN32_FIND_DATAW data;
+  HANDLE handle = ::FindFirstFileW(str::tows(path + "\\*").data(), &data);
+
+  if (handle == INVALID_HANDLE_VALUE)
+    return;
+
+  do {
+    std::string name = str::fromws(data.cFileName);
+
+    if (name == "." || name == "..")
+      continue;
+
+    std::string child = path + "\\" + name;
+
+    if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+      findShaders(child, entries);
+    else if (hasExtension(name, ".dxbc") || hasExtension(name, ".dxso"))
+      findShaders(child, entries);
+  } while (::FindNextFileW(handle, &data));
+
+  ::FindClose(handle);
+}
+
+
+Rc<DxvkShader> compileDxbc(
+  const std::vector<char>&  code,
+  const std::string&        name,
+  const BenchOptions&       options) {
+  DxbcModuleInfo moduleInfo;
+  moduleInfo.options.useSubgroupOpsForAtomicCounters = true;
+  moduleInfo.options.useDemoteToHelperInvocation = true;
+  moduleInfo.options.optimizeShaders = options.optimize;
+  moduleInfo.options.minSsboAlignment = 4;
+  moduleInfo.tess = nullptr;
+  moduleInfo.xfb = nullptr;
+
+  DxbcReader reader(code.data(), code.size());
+  DxbcModule module(reader);
+  return module.compile(moduleInfo, name);
+}
+
+
+/**
+ * \brief Checks that DXSO bytecode fits the file
+ *
+ * The DXSO reader has no notion of the buffer size and
+ * reads until it finds an end token, so walk the token
+ * stream with bounds checks before handing it over.
+ * Instruction lengths are determined the same way the
+ * decoder does it.
+ */
+void validateDxsoLength(const std::vector<char>& code) {
+  size_t tokenCount = code.size() / sizeof(uint32_t);
+
+  auto readToken = [&code] (size_t idx) {
+    uint32_t token;
+    std::memcpy(&token, &code[idx * sizeof(uint32_t)], sizeof(token));
+    return token;
+  };
+
+  if (!tokenCount)
+    throw DxvkError("Bytecode exceeds file size");
+
+  uint32_t version = readToken(0);
+  uint32_t major = (version >> 8) & 0xff;
+  uint32_t minor = (version >> 0) & 0xff;
+
+  for (size_t pos = 1; pos < tokenCount; ) {
+    uint32_t token = readToken(pos++);
+    auto opcode = DxsoOpcode(token & 0xffff);
+
+    if (opcode == DxsoOpcode::End)
+      return;
+
+    uint32_t length = 0;
+
+    if (opcode == DxsoOpcode::Comment)
+      length = (token & 0x7fff0000) >> 16;
+    else if (opcode == DxsoOpcode::Phase)
+      length = 0;
+    else if (major >= 2)
+      length = (token & 0x0f000000) >> 24;
+    else
+      length = DxsoGetDefaultOpcodeLength(opcode);
+
+    if (length == InvalidOpcodeLength)
+      throw DxvkError("Invalid opcode");
+
+    if (major == 1 && minor == 4
+     && (opcode == DxsoOpcode::Tex || opcode == DxsoOpcode::TexCoord))
+      length += 1;
+
+    pos += length;
+  }
+
+  throw DxvkError("Bytecode exceeds file size");
+}
+
+
+Rc<DxvkShader> compileDxso(
+  const std::vector<char>&  code,
+  const std::string&        name,
+  const BenchOptions&       options) {
+  validateDxsoLength(code);
+
+  DxsoModuleInfo moduleInfo;
+  moduleInfo.options.useDemoteToHelperInvocation = true;
+  moduleInfo.options.strictConstantCopies = false;
+  moduleInfo.options.d3d9FloatEmulation = true;
+  moduleInfo.options.strictPow = true;
+  moduleInfo.options.optimizeShaders = options.optimize;
+
+  DxsoReader reader(code.data());
+  DxsoModule module(reader);
+
+  DxsoAnalysisInfo analysis = module.analyze();
+
+  return module.compile(moduleInfo, name, analysis);
+}
+
+
+/**
+ * \brief Previous SPIR-V compression format
+ *
+ * Stores each word with its leading zero bytes removed,
+ * packed into 64-bit words, plus a 64-bit mask of 2-bit
+ * byte counts for every 32 words. Kept here so that the
+ * current format can be compared against it on the same
+ * shaders, both in size and in decode time.
+ */
+class LegacyCompressedBuffer {
+  constexpr static uint32_t NumMaskWords = 32;
+public:
+
+  LegacyCompressedBuffer(const SpirvCodeBuffer& code)
+  : m_size(code.dwords()) {
+    const uint32_t* data = code.data();
+
+    m_mask.reserve((m_size + NumMaskWords - 1) / NumMaskWords);
+    m_code.reserve((m_size + 1) / 2);
+
+    uint64_t dstWord  = 0;
+    uint32_t dstShift = 0;
+
+    for (uint32_t i = 0; i < m_size; i += NumMaskWords) {
+      uint64_t byteCounts = 0;
+
+      for (uint32_t w = 0; w < NumMaskWords && i + w < m_size; w++) {
+        uint64_t word = data[i + w];
+        uint64_t bytes = 0;
+
+        if      (word < (1 <<  8)) bytes = 0;
+        else if (word < (1 << 16)) bytes = 1;
+        else if (word < (1 << 24)) bytes = 2;
+        else                       bytes = 3;
+
+        byteCounts |= bytes << (2 * w);
+
+        uint32_t bits = 8 * bytes + 8;
+        uint32_t rem  = bit::pack(dstWord, dstShift, word, bits);
+
+        if (unlikely(rem != 0)) {
+          m_code.push_back(dstWord);
+
+          dstWord  = 0;
+          dstShift = 0;
+
+          bit::pack(dstWord, dstShift, word >> (bits - rem), rem);
+        }
+      }
+
+      m_mask.push_back(byteCounts);
+    }
+
+    if (dstShift)
+      m_code.push_back(dstWord);
+  }
+
+  SpirvCodeBuffer decompress() const {
+    SpirvCodeBuffer code(m_size);
+    uint32_t* data = code.data();
+
+    if (m_size == 0)
+      return code;
+
+    uint32_t maskIdx = 0;
+    uint32_t codeIdx = 0;
+
+    uint64_t srcWord  = m_code[codeIdx++];
+    uint32_t srcShift = 0;
+
+    for (uint32_t i = 0; i < m_size; i += NumMaskWords) {
+      uint64_t srcMask = m_mask[maskIdx++];
+
+      for (uint32_t w = 0; w < NumMaskWords && i + w < m_size; w++) {
+        uint32_t bits = 8 * ((srcMask & 3) + 1);
+
+        uint64_t word = 0;
+        uint32_t rem = bit::unpack(word, srcWord, srcShift, bits);
+
+        if (unlikely(rem != 0)) {
+          srcWord  = m_code[codeIdx++];
+          srcShift = 0;
+
+          uint64_t tmp = 0;
+          bit::unpack(tmp, srcWord, srcShift, rem);
+          word |= tmp << (bits - rem);
+        }
+
+        data[i + w] = word;
+        srcMask >>= 2;
+      }
+    }
+
+    return code;
+  }
+
+  size_t compressedSize() const {
+    return (m_mask.size() + m_code.size()) * sizeof(uint64_t);
+  }
+
+private:
+
+  uint32_t              m_size;
+  std::vector<uint64_t> m_mask;
+  std::vector<uint64_t> m_code;
+
+};
+
+
+/**
+ * \brief Measures decode time of a compressed buffer
+ *
+ * \param [in] compressed Compressed buffer
+ * \param [in] code Original code to compare against
+ * \param [out] decodeNs Best decode time
+ * \returns \c false if the decoded code differs
+ */
+template<typename T>
+bool measureDecode(const T& compressed, const SpirvCodeBuffer& code, uint64_t& decodeNs) {
+  decodeNs = ~0ull;
+
+  for (uint32_t i = 0; i < DecodeIterations; i++) {
+    auto t0 = std::chrono::high_resolution_clock::now();
+    SpirvCodeBuffer decoded = compressed.decompress();
+    auto t1 = std::chrono::high_resolution_clock::now();
+
+    uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+    decodeNs = std::min(decodeNs, ns);
+
+    if (decoded.dwords() != code.dwords()
+     || std::memcmp(decoded.data(), code.data(), code.size()))
+      return false;
+  }
+
+  return true;
+}
+
+
+void measureCompression(const SpirvCodeBuffer& code, ShaderResult& result) {
+  SpirvCompressedBuffer  compressed(code);
+  LegacyCompressedBuffer legacy(code);
+
+  result.compressedSize = compressed.compressedSize();
+  result.legacySize     = legacy.compressedSize();
+
+  // Both buffers were just built from the same
+  // code, so neither decoder starts out cold
+  if (!measureDecode(compressed, code, result.decodeNs))
+    result.status = "decode_mismatch";
+  else if (!measureDecode(legacy, code, result.legacyDecodeNs))
+    result.status = "legacy_decode_mismatch";
+}
+
+
+ShaderResult runShader(const ShaderEntry& entry, const BenchOptions& options) {
+  ShaderResult result;
+
+  std::ifstream file(entry.path, std::ios::binary);
+  std::vector<char> code(
+    (std::istreambuf_iterator<char>(file)),
+    (std::istreambuf_iterator<char>()));
+
+  result.inputSize = code.size();
+
+  if (!file || code.empty()) {
+    result.status = "read_failed";
+    result.timeUs = 0;
+    return result;
+  }
+
+  try {
+    Rc<DxvkShader> shader;
+
+    for (uint32_t i = 0; i < options.iterations; i++) {
+      auto t0 = std::chrono::high_resolution_clock::now();
+
+      shader = entry.type == ShaderType::Dxbc
+        ? compileDxbc(code, entry.path, options)
+        : compileDxso(code, entry.path, options);
+
+      auto t1 = std::chrono::high_resolution_clock::now();
+      uint64_t us = std::chrono::duration_cast<std::chrono::microseconds>(t1 - t0).count();
+
+      result.timeUs   = std::min(result.timeUs, us);
+      result.totalUs += us;
+    }
+
+    std::stringstream spirv;
+    shader->dump(spirv);
+
+    SpirvCodeBuffer code(spirv);
+
+    result.stage     = getStageName(shader->stage());
+    result.spirvSize = code.size();
+    // This is only the optimizer's structural self-check,
+    // not a full validator. Use spirv-val for that.
+    result.structOk  = SpirvOptimizer::validate(code);
+
+    if (!result.structOk)
+      result.status = "structure_check_failed";
+    else if (options.compression)
+      measureCompression(code, result);
+  } catch (const DxvkError& e) {
+    Logger::err(str::format(entry.path, ": ", e.message()));
+    result.status = "compile_failed";
+    result.timeUs = 0;
+  }
+
+  return result;
+}
+
+
+uint64_t getPeakMemory() {
+  PROCESS_MEMORY_COUNTERS counters = { };
+  counters.cb = sizeof(counters);
+
+  if (!::K32GetProcessMemoryInfo(::GetCurrentProcess(), &counters, sizeof(counters)))
+    return 0;
+
+  return counters.PeakWorkingSetSize;
+}
+
+
+/**
+ * \brief Writes results as CSV
+ *
+ * One line per shader, followed by a line named
+ * \c total that contains aggregate numbers, with
+ * the wall time in the \c total_us column. Peak
+ * memory usage is only logged for the whole run
+ * since shaders are compiled in parallel.
+ *
+ * In compression mode, the compressed size and best
+ * decode time with both the current and the previous
+ * compression format are appended to each line.
+ */
+void writeReport(
+        std::ostream&               stream,
+  const BenchOptions&               options,
+  const std::vector<ShaderEntry>&   entries,
+  const std::vector<ShaderResult>&  results,
+        uint64_t                    wallUs) {
+  stream << "file,type,stage,status,input_bytes,spirv_bytes,time_us,total_us";
+
+  if (options.compression)
+    stream << ",compressed_bytes,legacy_bytes,decode_ns,legacy_decode_ns";
+
+  stream << std::endl;
+
+  ShaderResult total;
+  total.timeUs = 0;
+
+  uint32_t numFailed = 0;
+  uint32_t numStructFailed = 0;
+
+  for (size_t i = 0; i < entries.size(); i++) {
+    const ShaderResult& r = results[i];
+
+    stream << entries[i].path << ","
+           << (entries[i].type == ShaderType::Dxbc ? "dxbc" : "dxso") << ","
+           << r.stage << "," << r.status << ","
+           << r.inputSize << "," << r.spirvSize << ","
+           << r.timeUs << "," << r.totalUs;
+
+    if (options.compression)
+      stream << "," << r.compressedSize << "," << r.legacySize << "," << r.decodeNs << "," << r.legacyDecodeNs;
+
+    stream << std::endl;
+
+    total.inputSize += r.inputSize;
+    total.spirvSize += r.spirvSize;
+    total.timeUs    += r.timeUs;
+    total.totalUs   += r.totalUs;
+
+    total.compressedSize += r.compressedSize;
+    total.legacySize     += r.legacySize;
+    total.decodeNs       += r.decodeNs;
+    total.legacyDecodeNs += r.legacyDecodeNs;
+
+    if (r.status == "structure_check_failed")
+      numStructFailed += 1;
+    else if (r.status != "ok")
+      numFailed += 1;
+  }
+
+  stream << "total,-,-,"
+         << (numFailed || numStructFailed ? "failed" : "ok") << ","
+         << total.inputSize << "," << total.spirvSize << ","
+         << total.timeUs << "," << wallUs;
+
+  if (options.compression)
+    stream << "," << total.compressedSize << "," << total.legacySize << "," << total.decodeNs << "," << total.legacyDecodeNs;
+
+  stream << std::endl;
+
+  Logger::info(str::format(
+    entries.size(), " shaders, ", numFailed, " failed, ", numStructFailed, " failed structure checks, ",
+    total.spirvSize, " bytes SPIR-V, ", total.timeUs, " us translation time, ",
+    wallUs, " us wall time, ", getPeakMemory() >> 10, " kB peak memory"));
+
+  if (options.compression && total.spirvSize) {
+    // The compressed buffer is what each DxvkShader keeps in memory
+    Logger::info(str::format(
+      "compressed: ", total.compressedSize, " bytes (", (100 * total.compressedSize) / total.spirvSize, "%), ",
+      "previous format: ", total.legacySize, " bytes (", (100 * total.legacySize) / total.spirvSize, "%), ",
+      "DxvkShader memory saved: ", int64_t(total.legacySize) - int64_t(total.compressedSize), " bytes, ",
+      "decode: ", total.decodeNs / 1000, " us (", (total.spirvSize * 1000) / std::max<uint64_t>(total.decodeNs, 1), " MB/s), ",
+      "previous format decode: ", total.legacyDecodeNs / 1000, " us (", (total.spirvSize * 1000) / std::max<uint64_t>(total.legacyDecodeNs, 1), " MB/s)"));
+  }
+}
+
+
+void printUsage() {
+  std::cerr << "Usage: shader-bench [options] <directory|file>..." << std::endl
+            << "  -j <n>         Number of worker threads (default: all cores)" << std::endl
+            << "  -n <n>         Number of iterations per shader (default: 1)" << std::endl
+            << "  -o <file.csv>  Write report to file instead of stdout" << std::endl
+            << "  --optimize     Run the SPIR-V optimizer" << std::endl
+            << "  --compression  Measure SPIR-V compression ratio and decode time" << std::endl;
+}
+
+
+int WINAPI WinMain(HINSTANCE hInstance,
+                   HINSTANCE hPrevInstance,
+                   LPSTR lpCmdLine,
+                   int nCmdShow) {
+  int     argc = 0;
+  LPWSTR* argv = CommandLineToArgvW(
+    GetCommandLineW(), &argc);
+
+  BenchOptions options;
+  std::vector<std::string> paths;
+
+  try {
+    for (int i = 1; i < argc; i++) {
+      std::string arg = str::fromws(argv[i]);
+
+      if (arg == "-j" && i + 1 < argc)
+        options.numThreads = std::stoul(str::fromws(argv[++i]));
+      else if (arg == "-n" && i + 1 < argc)
+        options.iterations = std::max(1ul, std::stoul(str::fromws(argv[++i])));
+      else if (arg == "-o" && i + 1 < argc)
+        options.outputFile = str::fromws(argv[++i]);
+      else if (arg == "--optimize")
+        options.optimize = true;
+      else if (arg == "--compression")
+        options.compression = true;
+      else
+        paths.push_back(arg);
+    }
+  } catch (const std::logic_error&) {
+    // Thrown by std::stoul for invalid or out-of-range numbers
+    printUsage();
+    return 1;
+  }
+
+  if (paths.empty()) {
+    printUsage();
+    return 1;
+  }
+
+  std::vector<ShaderEntry> entries;
+
+  for (const auto& path : paths)
+    findShaders(path, entries);
+
+  if (entries.empty()) {
+    std::cerr << "No shaders found" << std::endl;
+    return 1;
+  }
+
+  std::sort(entries.begin(), entries.end(),
+    [] (const ShaderEntry& a, const ShaderEntry& b) {
+      return a.path < b.path;
+    });
+
+  if (!options.numThreads)
+    options.numThreads = dxvk::thread::hardware_concurrency();
+
+  options.numThreads = std::min<uint32_t>(options.numThreads, entries.size());
+
+  // Workers pick shaders in order, results are
+  // stored by index so the report is stable.
+  std::vector<ShaderResult> results(entries.size());
+  std::atomic<size_t> nextEntry = { 0 };
+
+  auto t0 = std::chrono::high_resolution_clock::now();
+
+  std::vector<dxvk::thread> workers;
+
+  for (uint32_t i = 0; i < options.numThreads; i++) {
+    workers.emplace_back([&] {
+      size_t index;
+
+      while ((index = nextEntry++) < entries.size())
+        results[index] = runShader(entries[index], options);
+    });
+  }
+
+  for (auto& worker : workers)
+    worker.join();
+
+  auto t1 = std::chrono::high_resolution_clock::now();
+  uint64_t wallUs = std::chrono::duration_cast<std::chrono::microseconds>(t1 - t0).count();
+
+  if (options.outputFile.empty()) {
+    writeReport(std::cout, options, entries, results, wallUs);
+  } else {
+    std::ofstream file(options.outputFile, std::ios::binary | std::ios::trunc);
+
+    if (!file) {
+      std::cerr << "Failed to open " << options.outputFile << std::endl;
+      return 1;
+    }
+
+    writeReport(file, options, entries, results, wallUs);
+  }
+
+  bool success = std::all_of(results.begin(), results.end(),
+    [] (const ShaderResult& r) { return r.status == "ok"; });
+
+  return success ? 0 : 2;
+}
@@ -0,0 +1,312 @@
+#include <array>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../../src/spirv/spirv_module.h"
+#include "../../src/spirv/spirv_optimizer.h"
+
+#include <shellapi.h>
+#include <windows.h>
+#include <windowsx.h>
+
+namespace dxvk {
+  Logger Logger::s_instance("spirv-optimizer-test.log");
+}
+
+using namespace dxvk;
+
+
+/**
+ * \brief Test module builder
+ *
+ * Sets up a compute shader entry point and the types
+ * most tests need. Values that should survive the
+ * optimizer are written to a workgroup variable,
+ * which the optimizer never touches.
+ */
+struct TestModule {
+  SpirvModule module;
+
+  uint32_t voidType;
+  uint32_t boolType;
+  uint32_t uintType;
+  uint32_t uintPtrType;
+  uint32_t funcPtrType;
+  uint32_t output;
+  uint32_t entryPoint;
+
+  TestModule() {
+    module.enableCapability(spv::CapabilityShader);
+    module.setMemoryModel(spv::AddressingModelLogical, spv::MemoryModelGLSL450);
+
+    voidType    = module.defVoidType();
+    boolType    = module.defBoolType();
+    uintType    = module.defIntType(32, 0);
+    uintPtrType = module.defPointerType(uintType, spv::StorageClassWorkgroup);
+    funcPtrType = module.defPointerType(uintType, spv::StorageClassFunction);
+    output      = module.newVar(uintPtrType, spv::StorageClassWorkgroup);
+    entryPoint  = module.allocateId();
+
+    module.addEntryPoint(entryPoint, spv::ExecutionModelGLCompute, "main", 0, nullptr);
+    module.setLocalSize(entryPoint, 1, 1, 1);
+
+    module.functionBegin(voidType, entryPoint,
+      module.defFunctionType(voidType, 0, nullptr),
+      spv::FunctionControlMaskNone);
+    module.opLabel(module.allocateId());
+  }
+
+  SpirvCodeBuffer finish() {
+    module.opReturn();
+    module.functionEnd();
+    return module.compile();
+  }
+};
+
+
+/**
+ * \brief Counts instructions with the given opcode
+ */
+uint32_t countOps(SpirvCodeBuffer& code, spv::Op op) {
+  uint32_t count = 0;
+
+  for (auto ins : code) {
+    if (ins.opCode() == op)
+      count += 1;
+  }
+
+  return count;
+}
+
+
+/**
+ * \brief Runs the optimizer on a module
+ *
+ * The optimized module must pass the
+ * optimizer's own structural checks.
+ */
+bool optimize(SpirvCodeBuffer& code, SpirvOptimizerStats& stats) {
+  SpirvOptimizer optimizer(code);
+
+  if (!optimizer.run())
+    return false;
+
+  stats = optimizer.getStats();
+  code  = optimizer.getCode();
+  return SpirvOptimizer::validate(code);
+}
+
+
+bool testLoadStoreForwarding() {
+  TestModule m;
+
+  uint32_t var = m.module.newVar(m.funcPtrType, spv::StorageClassFunction);
+  m.module.opStore(var, m.module.constu32(1));
+  m.module.opStore(m.output, m.module.opLoad(m.uintType, var));
+
+  SpirvCodeBuffer code = m.finish();
+  SpirvOptimizerStats stats;
+
+  if (!optimize(code, stats))
+    return false;
+
+  // The load is forwarded, which leaves the local
+  // variable without readers, so it can go away
+  return stats.forwardedLoads == 1
+      && stats.removedStores  == 1
+      && countOps(code, spv::OpLoad)     == 0
+      && countOps(code, spv::OpStore)    == 1
+      && countOps(code, spv::OpVariable) == 1;
+}
+
+
+bool testConstantFolding() {
+  TestModule m;
+
+  uint32_t sum = m.module.opIAdd(m.uintType,
+    m.module.constu32(2), m.module.constu32(3));
+  uint32_t cond = m.module.opIEqual(m.boolType,
+    sum, m.module.constu32(5));
+
+  m.module.opStore(m.output, m.module.opSelect(m.uintType,
+    cond, sum, m.module.constu32(0)));
+
+  SpirvCodeBuffer code = m.finish();
+  SpirvOptimizerStats stats;
+
+  if (!optimize(code, stats))
+    return false;
+
+  return stats.foldedConstants == 3
+      && countOps(code, spv::OpIAdd)   == 0
+      && countOps(code, spv::OpIEqual) == 0
+      && countOps(code, spv::OpSelect) == 0;
+}
+
+
+bool testBranchFolding() {
+  TestModule m;
+
+  uint32_t trueLabel  = m.module.allocateId();
+  uint32_t falseLabel = m.module.allocateId();
+  uint32_t mergeLabel = m.module.allocateId();
+
+  m.module.opSelectionMerge(mergeLabel, spv::SelectionControlMaskNone);
+  m.module.opBranchConditional(m.module.constBool(true), trueLabel, falseLabel);
+
+  m.module.opLabel(trueLabel);
+  m.module.opStore(m.output, m.module.constu32(1));
+  m.module.opBranch(mergeLabel);
+
+  m.module.opLabel(falseLabel);
+  m.module.opStore(m.output, m.module.constu32(2));
+  m.module.opBranch(mergeLabel);
+
+  m.module.opLabel(mergeLabel);
+
+  SpirvCodeBuffer code = m.finish();
+  SpirvOptimizerStats stats;
+
+  if (!optimize(code, stats))
+    return false;
+
+  // The else block is unreachable and must be removed
+  // together with the merge instruction
+  return stats.foldedBranches == 1
+      && stats.removedBlocks  == 1
+      && countOps(code, spv::OpSelectionMerge)    == 0
+      && countOps(code, spv::OpBranchConditional) == 0
+      && countOps(code, spv::OpLabel)             == 3
+      && countOps(code, spv::OpStore)             == 1;
+}
+
+
+bool testBranchFoldingPhi() {
+  TestModule m;
+
+  uint32_t trueLabel  = m.module.allocateId();
+  uint32_t falseLabel = m.module.allocateId();
+  uint32_t mergeLabel = m.module.allocateId();
+
+  m.module.opSelectionMerge(mergeLabel, spv::SelectionControlMaskNone);
+  m.module.opBranchConditional(m.module.constBool(false), trueLabel, falseLabel);
+
+  m.module.opLabel(trueLabel);
+  m.module.opBranch(mergeLabel);
+
+  m.module.opLabel(falseLabel);
+  m.module.opBranch(mergeLabel);
+
+  m.module.opLabel(mergeLabel);
+
+  std::array<SpirvPhiLabel, 2> phiLabels = {{
+    { m.module.constu32(1), trueLabel  },
+    { m.module.constu32(2), falseLabel },
+  }};
+
+  m.module.opStore(m.output, m.module.opPhi(m.uintType,
+    phiLabels.size(), phiLabels.data()));
+
+  SpirvCodeBuffer code = m.finish();
+  SpirvOptimizerStats stats;
+
+  if (!optimize(code, stats))
+    return false;
+
+  // The phi still references the unreachable
+  // block, so that block has to be kept
+  return stats.foldedBranches == 1
+      && stats.removedBlocks  == 0
+      && countOps(code, spv::OpLabel) == 4;
+}
+
+
+bool testDeadCodeElimination() {
+  TestModule m;
+
+  m.module.constf32(1.0f);
+
+  uint32_t value = m.module.opLoad(m.uintType, m.output);
+  m.module.opIAdd(m.uintType, value, value);
+
+  SpirvCodeBuffer code = m.finish();
+  SpirvOptimizerStats stats;
+
+  if (!optimize(code, stats))
+    return false;
+
+  // The unused load and addition are removed,
+  // as are the float type and constant
+  return stats.removedCode  == 2
+      && stats.removedDecls >= 2
+      && countOps(code, spv::OpLoad)      == 0
+      && countOps(code, spv::OpTypeFloat) == 0;
+}
+
+
+bool testValidation() {
+  TestModule m;
+
+  uint32_t mergeLabel = m.module.allocateId();
+
+  // A merge instruction that is not followed
+  // by a conditional branch is invalid
+  m.module.opSelectionMerge(mergeLabel, spv::SelectionControlMaskNone);
+  m.module.opBranch(mergeLabel);
+  m.module.opLabel(mergeLabel);
+
+  SpirvCodeBuffer code = m.finish();
+
+  return !SpirvOptimizer::validate(code)
+      &&  SpirvOptimizer::validate(TestModule().finish());
+}
+
+
+bool testInvalidInput() {
+  std::vector<uint32_t> data = { spv::MagicNumber, 0x10000, 0, 4, 0, 0xFFFF0000 };
+  SpirvCodeBuffer code(data.size(), data.data());
+
+  // The optimizer must reject the module and
+  // return it without any modifications
+  SpirvCodeBuffer result = SpirvOptimizer::optimize(code);
+
+  return !SpirvOptimizer(code).run()
+      && result.dwords() == code.dwords();
+}
+
+
+int WINAPI WinMain(HINSTANCE hInstance,
+                   HINSTANCE hPrevInstance,
+                   LPSTR lpCmdLine,
+                   int nCmdShow) {
+  const std::vector<std::pair<const char*, std::function<bool ()>>> tests = {
+    { "load/store forwarding",  testLoadStoreForwarding },
+    { "constant folding",       testConstantFolding     },
+    { "branch folding",         testBranchFolding       },
+    { "branch folding (phi)",   testBranchFoldingPhi    },
+    { "dead code elimination",  testDeadCodeElimination },
+    { "validation",             testValidation          },
+    { "invalid input",          testInvalidInput        },
+  };
+
+  uint32_t failures = 0;
+
+  for (const auto& test : tests) {
+    bool passed = false;
+
+    try {
+      passed = test.second();
+    } catch (const DxvkError& e) {
+      std::cerr << e.message() << std::endl;
+    }
+
+    std::cout << test.first << ": " << (passed ? "passed" : "FAILED") << std::endl;
+
+    if (!passed)
+      failures += 1;
+  }
+
+  return failures ? 1 : 0;
+}